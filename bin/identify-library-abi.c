@@ -37,13 +37,12 @@
 #include <steam-runtime-tools/architecture.h>
 #include <steam-runtime-tools/architecture-internal.h>
 #include <steam-runtime-tools/glib-backports-internal.h>
+#include <steam-runtime-tools/ld-cache-internal.h>
 #include <steam-runtime-tools/utils-internal.h>
 
-/* nftw() doesn't have a user_data argument so we need to use a global
- * variable */
-static GPtrArray *nftw_libraries = NULL;
-
 static gchar *opt_directory = FALSE;
+static gint opt_jobs = 0;
+static gchar **opt_ld_so_cache = NULL;
 static gboolean opt_ldconfig = FALSE;
 static gboolean opt_ldconfig_paths = FALSE;
 static gboolean opt_one_line = FALSE;
@@ -51,12 +50,21 @@ static gboolean opt_print0 = FALSE;
 static gboolean opt_print_version = FALSE;
 static gboolean opt_quiet = FALSE;
 static gboolean opt_skip_unversioned = FALSE;
+static gboolean opt_unordered = FALSE;
 
 static const GOptionEntry option_entries[] =
 {
   { "directory", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME,
     &opt_directory, "Check the word size for the libraries recursively found in this directory",
     "PATH" },
+  { "jobs", 'j', G_OPTION_FLAG_NONE, G_OPTION_ARG_INT,
+    &opt_jobs, "Check up to N libraries in parallel [default: number of CPUs]",
+    "N" },
+  { "ld-so-cache", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME_ARRAY,
+    &opt_ld_so_cache, "Check the word size for the libraries listed in this "
+    "cache generated by ldconfig, typically /etc/ld.so.cache. "
+    "May be repeated.",
+    "PATH" },
   { "ldconfig", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
     &opt_ldconfig, "Check the word size for the libraries listed in ldconfig", NULL },
   { "ldconfig-paths", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
@@ -71,30 +79,59 @@ static const GOptionEntry option_entries[] =
   { "skip-unversioned", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
     &opt_skip_unversioned, "Skip the libraries that have a filename that end with "
     "just \".so\"", NULL },
+  { "unordered", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+    &opt_unordered, "Output libraries as soon as they have been checked, "
+    "instead of in the order they were found", NULL },
   { "version", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_print_version,
     "Print version number and exit", NULL },
   { NULL }
 };
 
-static gint
-list_libraries_helper (const char *fpath,
-                       const struct stat *sb,
-                       int typeflag,
-                       struct FTW *ftwbuf)
+/*
+ * Classifier:
+ *
+ * Identifies the ABI of libraries in a thread pool, writing each
+ * result to @out as soon as possible.
+ */
+typedef struct
 {
-  if (typeflag == FTW_SL)
-    {
-      if (strstr (fpath, ".so.") != NULL
-          || (!opt_skip_unversioned && g_str_has_suffix (fpath, ".so")))
-        g_ptr_array_add (nftw_libraries, g_strdup (fpath));
-    }
-  return 0;
-}
+  GThreadPool *pool;
+  FILE *out;
+  char separator;
+  /* Protects the members below */
+  GMutex mutex;
+  /* Number of calls to classifier_add() so far */
+  gsize n_added;
+  /* If not NULL, a ring buffer of results that have not been written
+   * yet. The result for the library with index i is in slot
+   * (i & (n_slots - 1)), and is NULL if not yet ready, or
+   * classifier_skipped if there is nothing to print.
+   * Not used with --unordered. */
+  gchar **pending;
+  /* Number of slots in @pending, always a power of 2 */
+  gsize n_slots;
+  /* Index of the next library whose result is to be written */
+  gsize next_to_write;
+} Classifier;
+
+typedef struct
+{
+  gchar *path;
+  gsize index;
+} ClassifierJob;
 
-static void
-print_library_details (const gchar *library_path,
-                       const gchar separator,
-                       FILE *original_stdout)
+static char classifier_skipped[] = "";
+
+/* nftw() doesn't have a user_data argument so we need to use a global
+ * variable */
+static Classifier *nftw_classifier = NULL;
+
+/*
+ * Returns: (transfer full) (nullable): "PATH=ABI", or %NULL if
+ *  @library_path should not be listed
+ */
+static gchar *
+format_library_details (const gchar *library_path)
 {
   const gchar *identifier = NULL;
   g_autoptr(GError) error = NULL;
@@ -108,10 +145,170 @@ print_library_details (const gchar *library_path,
       if (error->domain == SRT_ARCHITECTURE_ERROR)
         identifier = "?";
       else
-        return;
+        return NULL;
+    }
+
+  return g_strdup_printf ("%s=%s", library_path, identifier);
+}
+
+/* Must be called with the mutex held */
+static void
+classifier_write_locked (Classifier *self,
+                         const char *details)
+{
+  fputs (details, self->out);
+  fputc (self->separator, self->out);
+}
+
+static void
+classifier_job_cb (gpointer data,
+                   gpointer user_data)
+{
+  ClassifierJob *job = data;
+  Classifier *self = user_data;
+  g_autofree gchar *details = NULL;
+
+  details = format_library_details (job->path);
+
+  g_mutex_lock (&self->mutex);
+
+  if (self->pending == NULL)
+    {
+      if (details != NULL)
+        classifier_write_locked (self, details);
+    }
+  else
+    {
+      gsize mask = self->n_slots - 1;
+
+      self->pending[job->index & mask] =
+        details != NULL ? g_steal_pointer (&details) : classifier_skipped;
+
+      /* Write out everything that is ready and is not waiting for
+       * an earlier library */
+      while (self->next_to_write < self->n_added
+             && self->pending[self->next_to_write & mask] != NULL)
+        {
+          gchar *ready = self->pending[self->next_to_write & mask];
+
+          if (ready != classifier_skipped)
+            {
+              classifier_write_locked (self, ready);
+              g_free (ready);
+            }
+
+          self->pending[self->next_to_write & mask] = NULL;
+          self->next_to_write++;
+        }
     }
 
-  fprintf (original_stdout, "%s=%s%c", library_path, identifier, separator);
+  g_mutex_unlock (&self->mutex);
+
+  g_free (job->path);
+  g_free (job);
+}
+
+static gboolean
+classifier_init (Classifier *self,
+                 FILE *out,
+                 char separator,
+                 GError **error)
+{
+  gint max_threads = opt_jobs;
+
+  if (max_threads <= 0)
+    max_threads = g_get_num_processors ();
+
+  self->out = out;
+  self->separator = separator;
+  g_mutex_init (&self->mutex);
+
+  if (!opt_unordered)
+    {
+      self->n_slots = 64;
+      self->pending = g_new0 (gchar *, self->n_slots);
+    }
+
+  self->pool = g_thread_pool_new (classifier_job_cb, self, max_threads,
+                                  FALSE, error);
+
+  return (self->pool != NULL);
+}
+
+/*
+ * @path: (transfer full): A library to identify
+ */
+static void
+classifier_add (Classifier *self,
+                gchar *path)
+{
+  ClassifierJob *job = g_new0 (ClassifierJob, 1);
+  g_autoptr(GError) error = NULL;
+
+  job->path = path;
+
+  g_mutex_lock (&self->mutex);
+
+  /* If every slot is waiting to be written, double the size of the
+   * ring buffer, moving each waiting result to its new slot */
+  if (self->pending != NULL
+      && self->n_added - self->next_to_write == self->n_slots)
+    {
+      gsize n_slots = self->n_slots * 2;
+      gchar **pending = g_new0 (gchar *, n_slots);
+      gsize i;
+
+      for (i = self->next_to_write; i < self->n_added; i++)
+        pending[i & (n_slots - 1)] = self->pending[i & (self->n_slots - 1)];
+
+      g_free (self->pending);
+      self->pending = pending;
+      self->n_slots = n_slots;
+    }
+
+  job->index = self->n_added++;
+  g_mutex_unlock (&self->mutex);
+
+  /* If this fails, the job is still queued for an existing thread */
+  if (!g_thread_pool_push (self->pool, job, &error))
+    g_warning ("%s", error->message);
+}
+
+/*
+ * Wait for all libraries to be identified.
+ */
+static void
+classifier_finish (Classifier *self)
+{
+  if (self->pool != NULL)
+    g_thread_pool_free (g_steal_pointer (&self->pool), FALSE, TRUE);
+
+  if (self->pending != NULL)
+    {
+      g_assert (self->next_to_write == self->n_added);
+      g_clear_pointer (&self->pending, g_free);
+    }
+
+  g_mutex_clear (&self->mutex);
+}
+
+static gboolean
+is_wanted_library (const char *path)
+{
+  return (strstr (path, ".so.") != NULL
+          || (!opt_skip_unversioned && g_str_has_suffix (path, ".so")));
+}
+
+static gint
+list_libraries_helper (const char *fpath,
+                       const struct stat *sb,
+                       int typeflag,
+                       struct FTW *ftwbuf)
+{
+  if (typeflag == FTW_SL && is_wanted_library (fpath))
+    classifier_add (nftw_classifier, g_strdup (fpath));
+
+  return 0;
 }
 
 static gboolean had_paths_output = FALSE;
@@ -120,18 +317,19 @@ static gboolean
 run_ldconfig (const char *ldconfig,
               char separator,
               FILE *original_stdout,
+              Classifier *classifier,
               GError **error)
 {
   const gchar *ldconfig_argv[] =
     {
       "<placeholder>", "-XNv", NULL,
     };
-  g_auto(GStrv) ldconfig_entries = NULL;
   g_autofree gchar *library_prefix = NULL;
   g_autofree gchar *output = NULL;
   g_autofree gchar *ignore = NULL;
   gint wait_status = 0;
-  gsize i;
+  char *line;
+  char *next_line;
 
   ldconfig_argv[0] = ldconfig;
 
@@ -155,28 +353,27 @@ run_ldconfig (const char *ldconfig,
   if (output == NULL)
     return glnx_throw (error, "ldconfig didn't produce anything in output");
 
-  ldconfig_entries = g_strsplit (output, "\n", -1);
-
-  if (ldconfig_entries == NULL)
-    return glnx_throw (error, "ldconfig didn't produce anything in output");
-
-  for (i = 0; ldconfig_entries[i] != NULL; i++)
+  /* Split the output into lines in-place, instead of copying it */
+  for (line = output; line != NULL; line = next_line)
     {
-      g_auto(GStrv) line_elements = NULL;
-      const gchar *library = NULL;
       const gchar *colon = NULL;
-      g_autofree gchar *library_path = NULL;
+      char *arrow;
+
+      next_line = strchr (line, '\n');
+
+      if (next_line != NULL)
+        *next_line++ = '\0';
 
       /* skip empty lines */
-      if (ldconfig_entries[i][0] == '\0')
+      if (line[0] == '\0')
         continue;
 
-      colon = strchr (ldconfig_entries[i], ':');
+      colon = strchr (line, ':');
 
       if (colon != NULL)
         {
           g_clear_pointer (&library_prefix, g_free);
-          library_prefix = g_strndup (ldconfig_entries[i], colon - ldconfig_entries[i]);
+          library_prefix = g_strndup (line, colon - line);
 
           if (opt_ldconfig_paths)
             {
@@ -196,11 +393,40 @@ run_ldconfig (const char *ldconfig,
       if (opt_ldconfig_paths)
         continue;
 
-      line_elements = g_strsplit (ldconfig_entries[i], " -> ", 2);
-      library = g_strstrip (line_elements[0]);
-      library_path = g_build_filename (library_prefix, library, NULL);
+      arrow = strstr (line, " -> ");
+
+      if (arrow != NULL)
+        *arrow = '\0';
+
+      classifier_add (classifier,
+                      g_build_filename (library_prefix, g_strstrip (line),
+                                        NULL));
+    }
+
+  return TRUE;
+}
+
+static gboolean
+read_ld_so_cache (const char *path,
+                  Classifier *classifier,
+                  GError **error)
+{
+  g_autoptr(GPtrArray) libraries = NULL;
+  gsize i;
+
+  libraries = _srt_ld_cache_list_libraries (AT_FDCWD, path, error);
+
+  if (libraries == NULL)
+    return FALSE;
+
+  for (i = 0; i < libraries->len; i++)
+    {
+      gchar *library = g_ptr_array_index (libraries, i);
+
+      if (opt_skip_unversioned && g_str_has_suffix (library, ".so"))
+        continue;
 
-      print_library_details (library_path, separator, original_stdout);
+      classifier_add (classifier, g_strdup (library));
     }
 
   return TRUE;
@@ -212,6 +438,8 @@ run (int argc,
      GError **error)
 {
   g_autoptr(FILE) original_stdout = NULL;
+  Classifier classifier = {};
+  gboolean ret = FALSE;
   gsize i;
   char separator = '\n';
 
@@ -227,6 +455,10 @@ run (int argc,
   if (opt_print0)
     separator = '\0';
 
+  if (!opt_ldconfig_paths
+      && !classifier_init (&classifier, original_stdout, separator, error))
+    goto out;
+
   if (opt_ldconfig || opt_ldconfig_paths)
     {
       if (g_file_test ("/etc/ld-x86_64-pc-linux-gnu.cache", G_FILE_TEST_EXISTS)
@@ -236,46 +468,62 @@ run (int argc,
         {
           /* Exherbo */
           if (!run_ldconfig ("/usr/x86_64-pc-linux-gnu/bin/ldconfig", separator,
-                             original_stdout, error))
-            return FALSE;
+                             original_stdout, &classifier, error))
+            goto out;
 
           if (!run_ldconfig ("/usr/i686-pc-linux-gnu/bin/ldconfig", separator,
-                             original_stdout, error))
-            return FALSE;
+                             original_stdout, &classifier, error))
+            goto out;
         }
       else
         {
-          if (!run_ldconfig ("/sbin/ldconfig", separator, original_stdout, error))
-            return FALSE;
+          if (!run_ldconfig ("/sbin/ldconfig", separator, original_stdout,
+                             &classifier, error))
+            goto out;
+        }
+    }
+  else if (opt_ld_so_cache != NULL)
+    {
+      for (i = 0; opt_ld_so_cache[i] != NULL; i++)
+        {
+          if (!read_ld_so_cache (opt_ld_so_cache[i], &classifier, error))
+            goto out;
         }
     }
   else if (opt_directory != NULL)
     {
       g_autofree gchar *real_directory = NULL;
 
-      nftw_libraries = g_ptr_array_new_full (512, g_free);
       real_directory = realpath (opt_directory, NULL);
 
       if (real_directory == NULL)
-        return glnx_throw_errno_prefix (error, "Unable to find real path of \"%s\"", opt_directory);
-
-      if (nftw (real_directory, list_libraries_helper, 10, FTW_DEPTH|FTW_PHYS) < 0)
         {
-          g_ptr_array_free (nftw_libraries, TRUE);
-          return glnx_throw_errno_prefix (error, "Unable to iterate through \"%s\"", opt_directory);
+          glnx_throw_errno_prefix (error, "Unable to find real path of \"%s\"", opt_directory);
+          goto out;
         }
 
-      for (i = 0; i < nftw_libraries->len; i++)
-        print_library_details (g_ptr_array_index (nftw_libraries, i), separator,
-                               original_stdout);
+      nftw_classifier = &classifier;
 
-      g_ptr_array_free (nftw_libraries, TRUE);
+      if (nftw (real_directory, list_libraries_helper, 10, FTW_DEPTH|FTW_PHYS) < 0)
+        {
+          glnx_throw_errno_prefix (error, "Unable to iterate through \"%s\"", opt_directory);
+          goto out;
+        }
     }
 
   if (opt_one_line && had_paths_output)
     fputc ('\n', original_stdout);
 
-  return TRUE;
+  ret = TRUE;
+
+out:
+  /* Even on error, wait for the libraries that were already found,
+   * so that we don't write to original_stdout after closing it */
+  if (!opt_ldconfig_paths)
+    classifier_finish (&classifier);
+
+  nftw_classifier = NULL;
+  return ret;
 }
 
 int
@@ -308,9 +556,11 @@ main (int argc,
       goto out;
     }
 
-  if ((opt_ldconfig + (opt_directory != NULL) + opt_ldconfig_paths) != 1)
+  if ((opt_ldconfig + (opt_directory != NULL) + opt_ldconfig_paths
+       + (opt_ld_so_cache != NULL)) != 1)
     {
-      glnx_throw (&error, "Exactly one of --ldconfig, --ldconfig-paths, --directory is required");
+      glnx_throw (&error, "Exactly one of --ldconfig, --ldconfig-paths, "
+                          "--ld-so-cache, --directory is required");
       status = EX_USAGE;
       goto out;
     }
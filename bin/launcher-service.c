@@ -40,6 +40,7 @@
 #include <gio/gio.h>
 #include <gio/gunixfdlist.h>
 
+#include "steam-runtime-tools/env-overlay-internal.h"
 #include "steam-runtime-tools/glib-backports-internal.h"
 #include "steam-runtime-tools/launcher-internal.h"
 #include "steam-runtime-tools/log-internal.h"
@@ -460,6 +461,7 @@ handle_launch (PvLauncher1           *object,
   const gint *fds = NULL;
   gint fds_len = 0;
   g_autofree FdMapEntry *fd_map = NULL;
+  g_autoptr(SrtEnvBuilder) env_builder = NULL;
   g_auto(GStrv) env = NULL;
   g_auto(GStrv) unset_env = NULL;
   gint32 max_fd;
@@ -549,20 +551,11 @@ handle_launch (PvLauncher1           *object,
     }
 
   if (arg_flags & PV_LAUNCH_FLAGS_CLEAR_ENV)
-    {
-      char *empty[] = { NULL };
-
-      env = g_strdupv (empty);
-    }
+    env_builder = _srt_env_builder_new (NULL);
   else
-    {
-      env = g_strdupv (self->child_environ);
-    }
+    env_builder = _srt_env_builder_new (_srt_const_strv (self->child_environ));
 
-  if (self->main_pid_str != NULL)
-    env = g_environ_setenv (env, "MAINPID", self->main_pid_str, TRUE);
-  else
-    env = g_environ_unsetenv (env, "MAINPID");
+  _srt_env_builder_set (env_builder, "MAINPID", self->main_pid_str);
 
   n_envs = g_variant_n_children (arg_envs);
   for (i = 0; i < n_envs; i++)
@@ -575,7 +568,7 @@ handle_launch (PvLauncher1           *object,
       if (g_strcmp0 (var, "PWD") == 0)
         continue;
 
-      env = g_environ_setenv (env, var, val, TRUE);
+      _srt_env_builder_set (env_builder, var, val);
     }
 
   g_variant_lookup (arg_options, "unset-env", "^as", &unset_env);
@@ -587,14 +580,15 @@ handle_launch (PvLauncher1           *object,
         continue;
 
       g_debug ("Unsetting the environment variable %s...", unset_env[i]);
-      env = g_environ_unsetenv (env, unset_env[i]);
+      _srt_env_builder_set (env_builder, unset_env[i], NULL);
     }
 
   if (arg_cwd_path == NULL)
-    env = g_environ_setenv (env, "PWD", self->original_cwd_l,
-                            TRUE);
+    _srt_env_builder_set (env_builder, "PWD", self->original_cwd_l);
   else
-    env = g_environ_setenv (env, "PWD", arg_cwd_path, TRUE);
+    _srt_env_builder_set (env_builder, "PWD", arg_cwd_path);
+
+  env = _srt_env_builder_free_to_environ (g_steal_pointer (&env_builder));
 
   /* We use LEAVE_DESCRIPTORS_OPEN and set CLOEXEC in the child_setup,
    * to work around a deadlock in GLib < 2.60 */
@@ -53,6 +53,7 @@ enum
   OPTION_HELP = 1,
   OPTION_EXPECTATION,
   OPTION_IGNORE_EXTRA_DRIVERS,
+  OPTION_JOBS,
   OPTION_NO_GRAPHICS_TESTS,
   OPTION_NO_LIBRARIES,
   OPTION_VERBOSE,
@@ -63,6 +64,7 @@ struct option long_options[] =
 {
     { "expectations", required_argument, NULL, OPTION_EXPECTATION },
     { "ignore-extra-drivers", no_argument, NULL, OPTION_IGNORE_EXTRA_DRIVERS },
+    { "jobs", required_argument, NULL, OPTION_JOBS },
     { "no-graphics-tests", no_argument, NULL, OPTION_NO_GRAPHICS_TESTS },
     { "no-libraries", no_argument, NULL, OPTION_NO_LIBRARIES },
     { "verbose", no_argument, NULL, OPTION_VERBOSE },
@@ -1052,6 +1054,7 @@ static const char * const locales[] =
   "C",
   "C.UTF-8",
   "en_US.UTF-8",
+  NULL
 };
 
 int
@@ -1107,6 +1110,7 @@ main (int argc,
   SrtDriverFlags extra_driver_flags = SRT_DRIVER_FLAGS_INCLUDE_ALL;
   gboolean check_graphics = TRUE;
   gboolean check_libraries = TRUE;
+  guint64 jobs = 0;
 
   _srt_setenv_disable_gio_modules ();
 
@@ -1136,6 +1140,17 @@ main (int argc,
             extra_driver_flags = SRT_DRIVER_FLAGS_NONE;
             break;
 
+          case OPTION_JOBS:
+            if (!g_ascii_string_to_unsigned (optarg, 10, 0, G_MAXUINT,
+                                             &jobs, &error))
+              {
+                g_printerr ("%s: --jobs: %s\n",
+                            program_invocation_short_name, error->message);
+                g_clear_error (&error);
+                usage (1);
+              }
+            break;
+
           case OPTION_NO_GRAPHICS_TESTS:
             check_graphics = FALSE;
             break;
@@ -1200,6 +1215,7 @@ main (int argc,
   else
     {
       info = srt_system_info_new (expectations);
+      _srt_system_info_set_max_parallel_checks (info, (guint) jobs);
 
       /* For unit testing */
       srt_system_info_set_sysroot (info, g_getenv ("SRT_TEST_SYSROOT"));
@@ -1350,6 +1366,13 @@ main (int argc,
 
   g_assert (multiarch_tuples[G_N_ELEMENTS (multiarch_tuples) - 1] == NULL);
 
+  /* Run the checks for all architectures at the same time,
+   * instead of waiting for each architecture's checks in turn */
+  _srt_system_info_prefetch_for_abis (info, multiarch_tuples, NULL);
+
+  if (check_graphics)
+    _srt_system_info_check_graphics_for_abis (info, multiarch_tuples);
+
   for (gsize i = 0; i < G_N_ELEMENTS (multiarch_tuples) - 1; i++)
     {
       GList *libraries = NULL;
@@ -1483,6 +1506,9 @@ main (int argc,
 
   json_builder_end_object (builder);
 
+  /* Check all the locales we will report in one go */
+  _srt_system_info_prefetch_locales (info, locales);
+
   json_builder_set_member_name (builder, "locale-issues");
   json_builder_begin_array (builder);
   locale_issues = srt_system_info_get_locale_issues (info);
@@ -1492,7 +1518,7 @@ main (int argc,
   json_builder_set_member_name (builder, "locales");
   json_builder_begin_object (builder);
 
-  for (gsize i = 0; i < G_N_ELEMENTS (locales); i++)
+  for (gsize i = 0; locales[i] != NULL; i++)
     {
       SrtLocale *locale = srt_system_info_check_locale (info, locales[i],
                                                         &error);
@@ -150,7 +150,7 @@ mock_get_charset (const char **charset)
 }
 #endif
 
-static gchar *opt_locale = NULL;
+static GPtrArray *opt_locales = NULL;
 static gboolean opt_print_version = FALSE;
 
 static gboolean
@@ -159,14 +159,59 @@ opt_locale_cb (const char *name,
                gpointer data,
                GError **error)
 {
-  if (opt_locale != NULL)
+  if (opt_locales == NULL)
+    opt_locales = g_ptr_array_new_with_free_func (g_free);
+
+  g_ptr_array_add (opt_locales, g_strdup (value));
+  return TRUE;
+}
+
+/*
+ * Try to set @locale_name and describe the result as a JSON object.
+ * Returns: %TRUE if the locale could be set
+ */
+static gboolean
+check_locale (JsonBuilder *builder,
+              const char *locale_name)
+{
+  const char *locale_result;
+  const char *charset;
+  gboolean is_utf8;
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "requested");
+  json_builder_add_string_value (builder, locale_name);
+
+#ifdef MOCK_CHECK_LOCALE
+  locale_result = mock_setlocale (locale_name);
+#else
+  locale_result = setlocale (LC_ALL, locale_name);
+#endif
+
+  if (locale_result == NULL)
     {
-      g_set_error (error, G_OPTION_ERROR, G_OPTION_ERROR_FAILED,
-                   "At most one locale is expected");
+      int saved_errno = errno;
+
+      json_builder_set_member_name (builder, "error");
+      json_builder_add_string_value (builder,
+                                     g_strerror (saved_errno));
+      json_builder_end_object (builder);
       return FALSE;
     }
 
-  opt_locale = g_strdup (value);
+#ifdef MOCK_CHECK_LOCALE
+  is_utf8 = mock_get_charset (&charset);
+#else
+  is_utf8 = g_get_charset (&charset);
+#endif
+
+  json_builder_set_member_name (builder, "result");
+  json_builder_add_string_value (builder, locale_result);
+  json_builder_set_member_name (builder, "charset");
+  json_builder_add_string_value (builder, charset);
+  json_builder_set_member_name (builder, "is_utf8");
+  json_builder_add_boolean_value (builder, is_utf8);
+  json_builder_end_object (builder);
   return TRUE;
 }
 
@@ -176,8 +221,8 @@ static const GOptionEntry option_entries[] =
     "Print version number and exit", NULL },
   { G_OPTION_REMAINING, 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_CALLBACK,
     opt_locale_cb,
-    "The locale to test [default: use environment variables]",
-    "[LOCALE]" },
+    "The locales to test [default: use environment variables]",
+    "[LOCALE...]" },
   { NULL }
 };
 
@@ -187,15 +232,11 @@ main (int argc,
 {
   GOptionContext *option_context = NULL;
   GError *local_error = NULL;
-  const char *locale_result;
-  const char *locale_name;
-  const char *charset;
   gchar *json = NULL;
   JsonNode *root = NULL;
   JsonBuilder *builder = NULL;
   JsonGenerator *generator = NULL;
   int ret = 1;
-  gboolean is_utf8;
 
   option_context = g_option_context_new ("");
   g_option_context_add_main_entries (option_context, option_entries, NULL);
@@ -221,50 +262,34 @@ main (int argc,
 
   _srt_setenv_disable_gio_modules ();
 
-  if (opt_locale == NULL)
-    locale_name = "";
-  else
-    locale_name = opt_locale;
-
   builder = json_builder_new ();
-  json_builder_begin_object (builder);
-  json_builder_set_member_name (builder, "requested");
-  json_builder_add_string_value (builder, locale_name);
-
-#ifdef MOCK_CHECK_LOCALE
-  locale_result = mock_setlocale (locale_name);
-#else
-  locale_result = setlocale (LC_ALL, locale_name);
-#endif
 
-  if (locale_result == NULL)
+  if (opt_locales == NULL || opt_locales->len <= 1)
     {
-      int saved_errno = errno;
-
-      json_builder_set_member_name (builder, "error");
-      json_builder_add_string_value (builder,
-                                     g_strerror (saved_errno));
-      ret = 1;
+      /* Backwards-compatible mode: one object, and exit status 1
+       * if the locale could not be set */
+      if (check_locale (builder,
+                        opt_locales == NULL ? "" : g_ptr_array_index (opt_locales, 0)))
+        ret = 0;
+      else
+        ret = 1;
     }
   else
     {
-#ifdef MOCK_CHECK_LOCALE
-      is_utf8 = mock_get_charset (&charset);
-#else
-      is_utf8 = g_get_charset (&charset);
-#endif
+      guint i;
+
+      /* Multiple locales: an array of objects in the same order as
+       * the arguments. Failing to set a locale is reported in its
+       * object, so we only fail if we can't produce the array. */
+      json_builder_begin_array (builder);
 
-      json_builder_set_member_name (builder, "result");
-      json_builder_add_string_value (builder, locale_result);
-      json_builder_set_member_name (builder, "charset");
-      json_builder_add_string_value (builder, charset);
-      json_builder_set_member_name (builder, "is_utf8");
-      json_builder_add_boolean_value (builder, is_utf8);
+      for (i = 0; i < opt_locales->len; i++)
+        check_locale (builder, g_ptr_array_index (opt_locales, i));
+
+      json_builder_end_array (builder);
       ret = 0;
     }
 
-  json_builder_end_object (builder);
-
   root = json_builder_get_root (builder);
   generator = json_generator_new ();
   json_generator_set_pretty (generator, TRUE);
@@ -281,7 +306,7 @@ out:
   g_clear_error (&local_error);
   g_clear_pointer (&root, json_node_free);
   g_clear_pointer (&option_context, g_option_context_free);
-  g_free (opt_locale);
+  g_clear_pointer (&opt_locales, g_ptr_array_unref);
   g_free (json);
   return ret;
 }
@@ -28,6 +28,9 @@
  * for symbols, and outputs a parsable JSON with the eventual missing versions.
  * This helper is a complementary of `inspect-library` and depends on `libelf`.
  *
+ * With --batch, it reads a list of requests instead, and inspects each
+ * of them in turn: see run_batch().
+ *
  * For a usage example see `srt_check_library_presence` in
  * `steam-runtime-tools/library.c`.
  */
@@ -90,16 +93,20 @@ close_elf (void *pp)
 enum
 {
   OPTION_HELP = 1,
+  OPTION_BATCH,
   OPTION_DEB_SYMBOLS,
   OPTION_VERSION,
   OPTION_SONAME_FOR_SYMBOLS,
+  OPTION_TIMEOUT,
 };
 
 struct option long_options[] =
 {
+    { "batch", required_argument, NULL, OPTION_BATCH },
     { "soname-for-symbols", required_argument, NULL, OPTION_SONAME_FOR_SYMBOLS },
     { "deb-symbols", no_argument, NULL, OPTION_DEB_SYMBOLS },
     { "help", no_argument, NULL, OPTION_HELP },
+    { "timeout", required_argument, NULL, OPTION_TIMEOUT },
     { "version", no_argument, NULL, OPTION_VERSION },
 
     { NULL, 0, NULL, 0 }
@@ -122,6 +129,8 @@ usage (int code)
 
   fprintf (fp, "Usage: %s [OPTIONS] LIBRARY_PATH SYMBOLS_FILENAME\n",
            program_invocation_short_name);
+  fprintf (fp, "       %s --batch=REQUESTS [--timeout=SECONDS]\n",
+           program_invocation_short_name);
   exit (code);
 }
 
@@ -347,10 +356,14 @@ open_elf (const char *file_path,
   return true;
 }
 
-int
-main (int argc,
-      char **argv)
+static bool in_batch = false;
+
+static int
+inspect_library (int argc,
+                 char **argv)
 {
+  const char *batch_path = NULL;
+  unsigned int timeout = 0;
   const char *soname_for_symbols = NULL;
   const char *library_path;
   const char *version;
@@ -380,6 +393,20 @@ main (int argc,
             soname_for_symbols = optarg;
             break;
 
+          case OPTION_BATCH:
+            /* Requests in a batch cannot themselves be batches */
+            if (in_batch)
+              usage (1);
+
+            batch_path = optarg;
+            break;
+
+          case OPTION_TIMEOUT:
+            if (!parse_timeout (optarg, &timeout))
+              usage (1);
+
+            break;
+
           case OPTION_DEB_SYMBOLS:
             deb_symbols = true;
             break;
@@ -405,6 +432,15 @@ main (int argc,
         }
     }
 
+  if (batch_path != NULL)
+    {
+      if (argc != optind)
+        usage (1);
+
+      in_batch = true;
+      return run_batch (batch_path, timeout, inspect_library);
+    }
+
   if (argc != optind + 2)
     {
       usage (1);
@@ -545,3 +581,10 @@ main (int argc,
 
   return 0;
 }
+
+int
+main (int argc,
+      char **argv)
+{
+  return inspect_library (argc, argv);
+}
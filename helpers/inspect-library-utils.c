@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <getopt.h>
+#include <limits.h>
 #include <link.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -35,8 +36,12 @@
 #include <string.h>
 #include <sysexits.h>
 #include <assert.h>
+#include <signal.h>
 #include <unistd.h>
 
+#include <sys/types.h>
+#include <sys/wait.h>
+
 #include "inspect-library-utils.h"
 
 /*
@@ -99,3 +104,293 @@ print_argz (const char *name,
   while ((entry = argz_next (argz_values, argz_n, entry)))
     print_array_entry (entry, name);
 }
+
+/*
+ * Copy the contents of @fp to stdout, adding a trailing newline if
+ * necessary, so that the next line we print starts on a line of its own.
+ */
+static void
+copy_to_stdout (FILE *fp)
+{
+  char buf[4096];
+  size_t n;
+  char last = '\n';
+
+  rewind (fp);
+
+  while ((n = fread (buf, 1, sizeof (buf), fp)) > 0)
+    {
+      fwrite (buf, 1, n, stdout);
+      last = buf[n - 1];
+    }
+
+  if (last != '\n')
+    putc ('\n', stdout);
+}
+
+/*
+ * Print the contents of @fp to stdout as a single escaped line
+ * named @name, or nothing if @fp is empty.
+ */
+static void
+print_escaped_file (const char *name,
+                    FILE *fp)
+{
+  autofree char *contents = NULL;
+  size_t len = 0;
+  long size;
+
+  if (fseek (fp, 0, SEEK_END) != 0 || (size = ftell (fp)) <= 0)
+    return;
+
+  rewind (fp);
+  contents = xcalloc (size + 1, 1);
+  len = fread (contents, 1, size, fp);
+  contents[len] = '\0';
+
+  fprintf (stdout, "%s=", name);
+  print_strescape (contents);
+  putc ('\n', stdout);
+}
+
+/*
+ * Inspect one library in a subprocess, so that libraries and their
+ * dependencies loaded by one request cannot influence the next, and
+ * a crash only affects the request that caused it.
+ *
+ * The subprocess's output is followed by lines describing its stderr
+ * and exit status, and then an "end=" line repeating @name, so that
+ * the caller can match up the results with its requests.
+ */
+static void
+run_one (const char *name,
+         int argc,
+         char **argv,
+         unsigned int timeout,
+         InspectLibraryFunc func)
+{
+  autofclose FILE *out = NULL;
+  autofclose FILE *err = NULL;
+  int wstatus;
+  pid_t pid;
+
+  out = tmpfile ();
+  err = tmpfile ();
+
+  if (out == NULL || err == NULL)
+    {
+      int saved_errno = errno;
+
+      fputs ("stderr=", stdout);
+      print_strescape ("Unable to create temporary file: ");
+      print_strescape (strerror (saved_errno));
+      printf ("\nexit_status=%d\n", EX_OSERR);
+      goto out;
+    }
+
+  fflush (stdout);
+  fflush (stderr);
+
+  pid = fork ();
+
+  if (pid < 0)
+    {
+      int saved_errno = errno;
+
+      fputs ("stderr=", stdout);
+      print_strescape ("Unable to fork: ");
+      print_strescape (strerror (saved_errno));
+      printf ("\nexit_status=%d\n", EX_OSERR);
+      goto out;
+    }
+
+  if (pid == 0)
+    {
+      if (dup2 (fileno (out), STDOUT_FILENO) < 0
+          || dup2 (fileno (err), STDERR_FILENO) < 0)
+        _exit (EX_OSERR);
+
+      /* The default action for SIGALRM is to terminate the process */
+      signal (SIGALRM, SIG_DFL);
+
+      if (timeout > 0)
+        alarm (timeout);
+
+      /* Make getopt_long() start again from the beginning */
+      optind = 0;
+      exit (func (argc, argv));
+    }
+
+  while (waitpid (pid, &wstatus, 0) < 0)
+    {
+      if (errno != EINTR)
+        {
+          int saved_errno = errno;
+
+          fputs ("stderr=", stdout);
+          print_strescape ("Unable to wait for subprocess: ");
+          print_strescape (strerror (saved_errno));
+          printf ("\nexit_status=%d\n", EX_OSERR);
+          goto out;
+        }
+    }
+
+  copy_to_stdout (out);
+  print_escaped_file ("stderr", err);
+
+  if (WIFEXITED (wstatus))
+    {
+      printf ("exit_status=%d\n", WEXITSTATUS (wstatus));
+    }
+  else if (WIFSIGNALED (wstatus))
+    {
+      printf ("terminating_signal=%d\n", WTERMSIG (wstatus));
+
+      if (timeout > 0 && WTERMSIG (wstatus) == SIGALRM)
+        printf ("timed_out=true\n");
+    }
+
+out:
+  fputs ("end=", stdout);
+  print_strescape (name);
+  putc ('\n', stdout);
+  fflush (stdout);
+}
+
+/*
+ * parse_timeout:
+ * @s: A number of seconds, as given to --timeout
+ * @timeout_out: (out): Used to return the number of seconds
+ *
+ * Parse @s as a time limit that can be passed to alarm().
+ *
+ * Returns: true if @s is a valid time limit
+ */
+bool
+parse_timeout (const char *s,
+               unsigned int *timeout_out)
+{
+  unsigned long value;
+  char *endptr = NULL;
+
+  errno = 0;
+  value = strtoul (s, &endptr, 10);
+
+  if (errno != 0 || endptr == s || *endptr != '\0'
+      || s[0] == '-' || value > UINT_MAX)
+    return false;
+
+  *timeout_out = (unsigned int) value;
+  return true;
+}
+
+/*
+ * run_batch:
+ * @batch_path: A file containing requests, or "-" for stdin
+ * @timeout: Number of seconds to allow for each request, or 0 for no limit
+ * @func: The function implementing the helper for a single library
+ *
+ * Each request in @batch_path is a sequence of NUL-terminated fields,
+ * ended by an empty field. The first field is a name for the request,
+ * and the remaining fields are the arguments that would have been
+ * passed to the helper to inspect a single library.
+ *
+ * Returns: An exit status for the helper
+ */
+int
+run_batch (const char *batch_path,
+           unsigned int timeout,
+           InspectLibraryFunc func)
+{
+  autofclose FILE *fp = NULL;
+  autofree char *contents = NULL;
+  size_t contents_len = 0;
+  autofree char *field = NULL;
+  size_t field_size = 0;
+  ssize_t chars;
+  const char *p;
+  const char *end;
+
+  if (strcmp (batch_path, "-") == 0)
+    fp = stdin;
+  else
+    fp = fopen (batch_path, "r");
+
+  if (fp == NULL)
+    {
+      int saved_errno = errno;
+
+      fprintf (stderr, "Error reading \"%s\": %s\n",
+               batch_path, strerror (saved_errno));
+      return 1;
+    }
+
+  /* Read all the requests before we start: the subprocesses share
+   * our file descriptors, so they must not be able to disturb our
+   * position in the input */
+  while ((chars = getdelim (&field, &field_size, '\0', fp)) != -1)
+    {
+      /* argz_add() would not preserve the empty fields that end each
+       * request, so append each field including its terminator */
+      if (chars == 0 || field[chars - 1] != '\0')
+        {
+          fprintf (stderr, "Error reading \"%s\": unterminated field\n",
+                   batch_path);
+          return 1;
+        }
+
+      contents = realloc (contents, contents_len + chars);
+
+      if (contents == NULL)
+        oom ();
+
+      memcpy (contents + contents_len, field, chars);
+      contents_len += chars;
+    }
+
+  if (fp == stdin)
+    fp = NULL;
+
+  p = contents;
+  end = contents + contents_len;
+
+  while (p < end)
+    {
+      autofree char **argv = NULL;
+      const char *name = p;
+      int argc = 1;
+      const char *q;
+      int i;
+
+      if (*name == '\0')
+        {
+          /* Ignore empty requests */
+          p++;
+          continue;
+        }
+
+      for (q = p + strlen (p) + 1; q < end && *q != '\0'; q += strlen (q) + 1)
+        argc++;
+
+      if (q >= end)
+        {
+          fprintf (stderr, "Error reading \"%s\": unterminated request\n",
+                   batch_path);
+          return 1;
+        }
+
+      argv = xcalloc (argc + 1, sizeof (char *));
+      argv[0] = program_invocation_name;
+
+      for (i = 1, q = p + strlen (p) + 1; i < argc; i++, q += strlen (q) + 1)
+        argv[i] = (char *) q;
+
+      argv[argc] = NULL;
+      run_one (name, argc, argv, timeout, func);
+
+      /* Skip the empty field that ended this request */
+      p = q + 1;
+    }
+
+  return 0;
+}
@@ -29,6 +29,7 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <link.h>
+#include <stdbool.h>
 
 #include "steam-runtime-tools/libc-utils-internal.h"
 
@@ -45,3 +46,12 @@ void print_array_entry (const char *entry,
 void print_argz (const char *name,
                  const char *argz_values,
                  size_t argz_n);
+
+bool parse_timeout (const char *s,
+                    unsigned int *timeout_out);
+
+typedef int (*InspectLibraryFunc) (int argc,
+                                   char **argv);
+int run_batch (const char *batch_path,
+               unsigned int timeout,
+               InspectLibraryFunc func);
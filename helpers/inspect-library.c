@@ -28,6 +28,9 @@
  * symbols, and outputs a parsable JSON with the path, the dependencies and
  * the possible missing symbols of the requested library.
  *
+ * With --batch, it reads a list of requests instead, and inspects each
+ * of them in turn: see run_batch().
+ *
  * For a usage example see `srt_check_library_presence` in
  * `steam-runtime-tools/library.c`.
  */
@@ -67,18 +70,22 @@ clear_with_dlclose (void *pp)
 enum
 {
   OPTION_HELP = 1,
+  OPTION_BATCH,
   OPTION_DEB_SYMBOLS,
   OPTION_HIDDEN_DEPENDENCY,
   OPTION_LINE_BASED,
+  OPTION_TIMEOUT,
   OPTION_VERSION,
 };
 
 struct option long_options[] =
 {
+    { "batch", required_argument, NULL, OPTION_BATCH },
     { "hidden-dependency", required_argument, NULL, OPTION_HIDDEN_DEPENDENCY },
     { "deb-symbols", no_argument, NULL, OPTION_DEB_SYMBOLS },
     { "help", no_argument, NULL, OPTION_HELP },
     { "line-based", no_argument, NULL, OPTION_LINE_BASED },
+    { "timeout", required_argument, NULL, OPTION_TIMEOUT },
     { "version", no_argument, NULL, OPTION_VERSION },
     { NULL, 0, NULL, 0 }
 };
@@ -100,6 +107,8 @@ usage (int code)
 
   fprintf (fp, "Usage: %s [OPTIONS] SONAME [SYMBOLS_FILENAME]\n",
            program_invocation_short_name);
+  fprintf (fp, "       %s --batch=REQUESTS [--timeout=SECONDS]\n",
+           program_invocation_short_name);
   exit (code);
 }
 
@@ -138,10 +147,14 @@ find_tag_value (const ElfW(Dyn) *dyn,
   return (size_t) -1;
 }
 
-int
-main (int argc,
-      char **argv)
+static bool in_batch = false;
+
+static int
+inspect_library (int argc,
+                 char **argv)
 {
+  const char *batch_path = NULL;
+  unsigned int timeout = 0;
   const char *soname;
   const char *version;
   const char *symbol;
@@ -166,6 +179,20 @@ main (int argc,
     {
       switch (opt)
         {
+          case OPTION_BATCH:
+            /* Requests in a batch cannot themselves be batches */
+            if (in_batch)
+              usage (1);
+
+            batch_path = optarg;
+            break;
+
+          case OPTION_TIMEOUT:
+            if (!parse_timeout (optarg, &timeout))
+              usage (1);
+
+            break;
+
           case OPTION_HIDDEN_DEPENDENCY:
             argz_add_or_die (&hidden_deps, &hidden_deps_len, optarg);
             break;
@@ -200,6 +227,15 @@ main (int argc,
         }
     }
 
+  if (batch_path != NULL)
+    {
+      if (argc != optind)
+        usage (1);
+
+      in_batch = true;
+      return run_batch (batch_path, timeout, inspect_library);
+    }
+
   if (argc < optind + 1 || argc > optind + 2)
     {
       usage (1);
@@ -400,6 +436,13 @@ main (int argc,
   return 0;
 }
 
+int
+main (int argc,
+      char **argv)
+{
+  return inspect_library (argc, argv);
+}
+
 static bool
 has_symbol (void *handle,
             const char *symbol)
@@ -166,9 +166,21 @@ typedef struct
   gint  mode;
 } ExportedPath;
 
+/* A node in a tree of path components, so that we can find all the
+ * exported ancestors of a path in O(depth) rather than O(exports) */
+typedef struct _ExportsTrie ExportsTrie;
+struct _ExportsTrie
+{
+  /* (nullable) (element-type utf8 ExportsTrie) */
+  GHashTable  *children;
+  /* (nullable) (not owned): Owned by FlatpakExports.hash */
+  ExportedPath *ep;
+};
+
 struct _FlatpakExports
 {
   GHashTable           *hash;
+  ExportsTrie          *trie;
   FlatpakFilesystemMode host_etc;
   FlatpakFilesystemMode host_os;
   int                   host_fd;
@@ -300,12 +312,57 @@ exported_path_free (ExportedPath *exported_path)
   g_free (exported_path);
 }
 
+static void
+exports_trie_free (gpointer p)
+{
+  ExportsTrie *node = p;
+
+  g_clear_pointer (&node->children, g_hash_table_unref);
+  g_free (node);
+}
+
+/* Return the node for @path, creating it and its ancestors if necessary.
+ * Like flatpak_has_path_prefix(), consecutive slashes are ignored. */
+static ExportsTrie *
+exports_trie_ensure (ExportsTrie *root,
+                     const char  *path)
+{
+  g_autofree char *copy = g_strdup (path);
+  ExportsTrie *node = root;
+  char *saveptr = NULL;
+  char *component;
+
+  for (component = strtok_r (copy, "/", &saveptr);
+       component != NULL;
+       component = strtok_r (NULL, "/", &saveptr))
+    {
+      ExportsTrie *child = NULL;
+
+      if (node->children == NULL)
+        node->children = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                g_free, exports_trie_free);
+      else
+        child = g_hash_table_lookup (node->children, component);
+
+      if (child == NULL)
+        {
+          child = g_new0 (ExportsTrie, 1);
+          g_hash_table_insert (node->children, g_strdup (component), child);
+        }
+
+      node = child;
+    }
+
+  return node;
+}
+
 FlatpakExports *
 flatpak_exports_new (void)
 {
   FlatpakExports *exports = g_new0 (FlatpakExports, 1);
 
   exports->hash = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, (GFreeFunc) exported_path_free);
+  exports->trie = g_new0 (ExportsTrie, 1);
   exports->host_fd = -1;
   return exports;
 }
@@ -314,6 +371,7 @@ void
 flatpak_exports_free (FlatpakExports *exports)
 {
   glnx_close_fd (&exports->host_fd);
+  g_clear_pointer (&exports->trie, exports_trie_free);
   g_hash_table_destroy (exports->hash);
   g_free (exports);
 }
@@ -321,63 +379,65 @@ flatpak_exports_free (FlatpakExports *exports)
 /* Returns TRUE if the location of this export
    is not visible due to parents being exported */
 static gboolean
-path_parent_is_mapped (const char **keys,
-                       guint        n_keys,
-                       GHashTable  *hash_table,
+path_parent_is_mapped (ExportsTrie *root,
                        const char  *path)
 {
-  guint i;
+  g_autofree char *copy = g_strdup (path);
+  ExportsTrie *node = root;
+  char *saveptr = NULL;
+  char *component;
   gboolean is_mapped = FALSE;
 
-  /* The keys are sorted so shorter (i.e. parents) are first */
-  for (i = 0; i < n_keys; i++)
+  /* Visit each strict ancestor of path, starting from the root */
+  for (component = strtok_r (copy, "/", &saveptr);
+       component != NULL && node != NULL;
+       component = strtok_r (NULL, "/", &saveptr))
     {
-      const char *mounted_path = keys[i];
-      ExportedPath *ep = g_hash_table_lookup (hash_table, mounted_path);
-
-      g_assert (is_export_mode (ep->mode));
+      ExportedPath *ep = node->ep;
 
-      if (flatpak_has_path_prefix (path, mounted_path) &&
-          (strcmp (path, mounted_path) != 0))
+      /* FAKE_MODE_DIR has same mapped value as parent */
+      if (ep != NULL && ep->mode != FAKE_MODE_DIR)
         {
-          /* FAKE_MODE_DIR has same mapped value as parent */
-          if (ep->mode == FAKE_MODE_DIR)
-            continue;
-
+          g_assert (is_export_mode (ep->mode));
           is_mapped = ep->mode != FAKE_MODE_TMPFS;
         }
+
+      if (node->children == NULL)
+        break;
+
+      node = g_hash_table_lookup (node->children, component);
     }
 
   return is_mapped;
 }
 
 static gboolean
-path_is_mapped (const char **keys,
-                guint        n_keys,
-                GHashTable  *hash_table,
+path_is_mapped (ExportsTrie *root,
                 const char  *path,
                 gboolean    *is_readonly_out)
 {
-  guint i;
+  g_autofree char *copy = g_strdup (path);
+  ExportsTrie *node = root;
+  char *saveptr = NULL;
+  char *component;
   gboolean is_mapped = FALSE;
   gboolean is_readonly = FALSE;
 
-  /* The keys are sorted so shorter (i.e. parents) are first */
-  for (i = 0; i < n_keys; i++)
-    {
-      const char *mounted_path = keys[i];
-      ExportedPath *ep = g_hash_table_lookup (hash_table, mounted_path);
+  component = strtok_r (copy, "/", &saveptr);
 
-      g_assert (is_export_mode (ep->mode));
+  /* Visit path and each of its ancestors, starting from the root */
+  while (node != NULL)
+    {
+      ExportedPath *ep = node->ep;
 
-      if (flatpak_has_path_prefix (path, mounted_path))
+      /* FAKE_MODE_DIR has same mapped value as parent */
+      if (ep != NULL && ep->mode != FAKE_MODE_DIR)
         {
-          /* FAKE_MODE_DIR has same mapped value as parent */
-          if (ep->mode == FAKE_MODE_DIR)
-            continue;
+          g_assert (is_export_mode (ep->mode));
 
+          /* A symlink only maps itself, not its descendants */
           if (ep->mode == FAKE_MODE_SYMLINK)
-            is_mapped = strcmp (path, mounted_path) == 0;
+            is_mapped = (component == NULL);
           else
             is_mapped = ep->mode != FAKE_MODE_TMPFS;
 
@@ -386,6 +446,12 @@ path_is_mapped (const char **keys,
           else
             is_readonly = FALSE;
         }
+
+      if (component == NULL || node->children == NULL)
+        break;
+
+      node = g_hash_table_lookup (node->children, component);
+      component = strtok_r (NULL, "/", &saveptr);
     }
 
   *is_readonly_out = is_readonly;
@@ -450,8 +516,6 @@ void
 flatpak_exports_append_bwrap_args (FlatpakExports *exports,
                                    FlatpakBwrap   *bwrap)
 {
-  guint n_keys;
-  g_autofree const char **keys = (const char **) g_hash_table_get_keys_as_array (exports->hash, &n_keys);
   g_autoptr(GList) eps = NULL;
   GList *l;
   struct stat buf;
@@ -459,8 +523,6 @@ flatpak_exports_append_bwrap_args (FlatpakExports *exports,
   eps = g_hash_table_get_values (exports->hash);
   eps = g_list_sort (eps, (GCompareFunc) compare_eps);
 
-  qsort (keys, n_keys, sizeof (char *), flatpak_strcmp0_ptr);
-
   g_debug ("Converting FlatpakExports to bwrap arguments...");
 
   for (l = eps; l != NULL; l = l->next)
@@ -474,7 +536,7 @@ flatpak_exports_append_bwrap_args (FlatpakExports *exports,
         {
           g_debug ("\"%s\" is meant to be a symlink", path);
 
-          if (path_parent_is_mapped (keys, n_keys, exports->hash, path))
+          if (path_parent_is_mapped (exports->trie, path))
             {
               g_debug ("Not creating \"%s\" as symlink because its parent is "
                        "already mapped", path);
@@ -507,7 +569,7 @@ flatpak_exports_append_bwrap_args (FlatpakExports *exports,
              is a pre-existing dir we can mount the path on. */
           if (path_is_dir (exports, path))
             {
-              if (!path_parent_is_mapped (keys, n_keys, exports->hash, path))
+              if (!path_parent_is_mapped (exports->trie, path))
                 /* If the parent is not mapped, it will be a tmpfs, no need to mount another one */
                 {
                   g_debug ("Parent of \"%s\" is not mapped, creating empty directory", path);
@@ -672,8 +734,6 @@ FlatpakFilesystemMode
 flatpak_exports_path_get_mode (FlatpakExports *exports,
                                const char     *path)
 {
-  guint n_keys;
-  g_autofree const char **keys = (const char **) g_hash_table_get_keys_as_array (exports->hash, &n_keys);
   g_autofree char *canonical = NULL;
   gboolean is_readonly = FALSE;
   g_auto(GStrv) parts = NULL;
@@ -681,8 +741,6 @@ flatpak_exports_path_get_mode (FlatpakExports *exports,
   g_autoptr(GString) path_builder = g_string_new ("");
   struct stat st;
 
-  qsort (keys, n_keys, sizeof (char *), flatpak_strcmp0_ptr);
-
   /* Syntactic canonicalization only, no need to use host_fd */
   path = canonical = flatpak_canonicalize_filename (path);
 
@@ -699,7 +757,7 @@ flatpak_exports_path_get_mode (FlatpakExports *exports,
       g_string_append (path_builder, "/");
       g_string_append (path_builder, parts[i]);
 
-      if (path_is_mapped (keys, n_keys, exports->hash, path_builder->str, &is_readonly))
+      if (path_is_mapped (exports->trie, path_builder->str, &is_readonly))
         {
           g_autoptr(GError) stat_error = NULL;
 
@@ -810,6 +868,7 @@ do_export_path (FlatpakExports *exports,
     }
 
   g_hash_table_replace (exports->hash, ep->path, ep);
+  exports_trie_ensure (exports->trie, ep->path)->ep = ep;
 }
 
 /* AUTOFS mounts are tricky, as using them as a source in a bind mount
@@ -30,6 +30,7 @@ enum {
   PROP_IN_CURRENT_NS,
   PROP_PATH_IN_CONTAINER_NS,
   PROP_USE_SRT_HELPERS,
+  PROP_DRIVER_CACHE_DIR,
   N_PROPERTIES
 };
 
@@ -64,6 +65,10 @@ pv_graphics_provider_get_property (GObject *object,
         g_value_set_boolean (value, self->use_srt_helpers);
         break;
 
+      case PROP_DRIVER_CACHE_DIR:
+        g_value_set_string (value, self->driver_cache_dir);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -96,6 +101,12 @@ pv_graphics_provider_set_property (GObject *object,
         self->use_srt_helpers = g_value_get_boolean (value);
         break;
 
+      case PROP_DRIVER_CACHE_DIR:
+        /* Construct-only */
+        g_return_if_fail (self->driver_cache_dir == NULL);
+        self->driver_cache_dir = g_value_dup_string (value);
+        break;
+
       default:
         G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
     }
@@ -134,6 +145,7 @@ pv_graphics_provider_finalize (GObject *object)
 
   g_free (self->path_in_host_ns);
   g_free (self->path_in_container_ns);
+  g_free (self->driver_cache_dir);
 
   G_OBJECT_CLASS (pv_graphics_provider_parent_class)->finalize (object);
 }
@@ -173,6 +185,14 @@ pv_graphics_provider_class_init (PvGraphicsProviderClass *cls)
                           G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
                           G_PARAM_STATIC_STRINGS);
 
+  properties[PROP_DRIVER_CACHE_DIR] =
+    g_param_spec_string ("driver-cache-dir", "Driver cache directory",
+                         ("Directory in which to cache the DRI, VA-API and "
+                          "VDPAU drivers that were found, or NULL"),
+                         NULL,
+                         (G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+                          G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_properties (object_class, N_PROPERTIES, properties);
 }
 
@@ -237,6 +257,7 @@ PvGraphicsProvider *
 pv_graphics_provider_new (const char *path_in_current_ns,
                           const char *path_in_container_ns,
                           gboolean use_srt_helpers,
+                          const char *driver_cache_dir,
                           GError **error)
 {
   g_autoptr(SrtSysroot) sysroot = NULL;
@@ -257,6 +278,7 @@ pv_graphics_provider_new (const char *path_in_current_ns,
                        "in-current-ns", sysroot,
                        "path-in-container-ns", path_in_container_ns,
                        "use-srt-helpers", use_srt_helpers,
+                       "driver-cache-dir", driver_cache_dir,
                        NULL);
 }
 
@@ -278,5 +300,6 @@ pv_graphics_provider_create_system_info (PvGraphicsProvider *self)
   system_info = srt_system_info_new (NULL);
   _srt_system_info_set_sysroot (system_info, self->in_current_ns);
   _srt_system_info_set_check_flags (system_info, flags);
+  _srt_system_info_set_driver_cache_dir (system_info, self->driver_cache_dir);
   return g_steal_pointer (&system_info);
 }
@@ -41,6 +41,7 @@ struct _PvGraphicsProvider
   SrtSysroot *in_current_ns;
   gchar *path_in_container_ns;
   gchar *path_in_host_ns;
+  gchar *driver_cache_dir;
   gboolean use_srt_helpers;
 };
 
@@ -60,6 +61,7 @@ GType pv_graphics_provider_get_type (void);
 PvGraphicsProvider *pv_graphics_provider_new (const char *path_in_current_ns,
                                               const char *path_in_container_ns,
                                               gboolean use_srt_helpers,
+                                              const char *driver_cache_dir,
                                               GError **error);
 
 gchar *pv_graphics_provider_search_in_path_and_bin (PvGraphicsProvider *self,
@@ -24,7 +24,7 @@
 
 #include "mtree.h"
 
-#include <ftw.h>
+#include <fcntl.h>
 
 #include "steam-runtime-tools/profiling-internal.h"
 #include "steam-runtime-tools/resolve-in-sysroot-internal.h"
@@ -375,6 +375,23 @@ pv_mtree_entry_parse (const char *line,
   return TRUE;
 }
 
+/*
+ * @warned: (inout): Initially %FALSE, set to %TRUE when a warning has
+ *  been emitted
+ *
+ * Return the log level for a message that should be a warning the
+ * first time, and demoted to INFO thereafter. This is safe to call
+ * from several threads at once.
+ */
+static GLogLevelFlags
+warn_once (gint *warned)
+{
+  if (g_atomic_int_compare_and_exchange (warned, FALSE, TRUE))
+    return G_LOG_LEVEL_WARNING;
+
+  return G_LOG_LEVEL_INFO;
+}
+
 static gboolean
 maybe_chmod (const PvMtreeEntry *entry,
              int parent_fd,
@@ -382,8 +399,8 @@ maybe_chmod (const PvMtreeEntry *entry,
              int fd,
              const char *sysroot,
              PvMtreeApplyFlags flags,
-             GLogLevelFlags *chmod_plusx_warning_level,
-             GLogLevelFlags *chmod_minusx_warning_level,
+             gint *chmod_plusx_warned,
+             gint *chmod_minusx_warned,
              GError **error)
 {
   g_autofree gchar *permissions = NULL;
@@ -425,12 +442,11 @@ maybe_chmod (const PvMtreeEntry *entry,
           /* We want it to be executable */
           if (faccessat (parent_fd, base, R_OK|X_OK, 0) == 0)
             {
-              g_log (G_LOG_DOMAIN, *chmod_plusx_warning_level,
+              g_log (G_LOG_DOMAIN, warn_once (chmod_plusx_warned),
                      "Cannot chmod directory/executable \"%s\" in \"%s\" "
                      "from %s to 0%o (%s): assuming R_OK|X_OK is close enough",
                      entry->name, sysroot,
                      permissions, adjusted_mode, g_strerror (saved_errno));
-              *chmod_plusx_warning_level = G_LOG_LEVEL_INFO;
               return TRUE;
             }
         }
@@ -441,12 +457,11 @@ maybe_chmod (const PvMtreeEntry *entry,
            * NTFS or FAT often will be) */
           if (faccessat (parent_fd, base, R_OK, 0) == 0)
             {
-              g_log (G_LOG_DOMAIN, *chmod_minusx_warning_level,
+              g_log (G_LOG_DOMAIN, warn_once (chmod_minusx_warned),
                      "Cannot chmod non-executable file \"%s\" in \"%s\" "
                      "from %s to 0%o (%s): assuming R_OK is close enough",
                      entry->name, sysroot,
                      permissions, adjusted_mode, g_strerror (saved_errno));
-              *chmod_minusx_warning_level = G_LOG_LEVEL_INFO;
               return TRUE;
             }
         }
@@ -475,13 +490,13 @@ typedef void (*PvMtreeForeachErrorFunc) (PvMtreeEntry *entry,
                                          void *user_data);
 
 static gboolean
-pv_mtree_foreach (const char *mtree,
-                  PvMtreeApplyFlags flags,
-                  PvMtreeForeachFunc callback,
-                  void *user_data,
-                  PvMtreeForeachErrorFunc on_error_cb,
-                  void *on_error_data,
-                  GError **error)
+pv_mtree_foreach_text (const char *mtree,
+                       PvMtreeApplyFlags flags,
+                       PvMtreeForeachFunc callback,
+                       void *user_data,
+                       PvMtreeForeachErrorFunc on_error_cb,
+                       void *on_error_data,
+                       GError **error)
 {
   glnx_autofd int mtree_fd = -1;
   g_autoptr(GInputStream) istream = NULL;
@@ -566,44 +581,780 @@ pv_mtree_foreach (const char *mtree,
   return TRUE;
 }
 
+/*
+ * Binary index format, written by pv_mtree_write_index().
+ * All integers are little-endian.
+ *
+ * The file starts with a PvMtreeIndexHeader, followed by an array of
+ * @n_entries fixed-size PvMtreeIndexEntry records, followed by a table
+ * of NUL-terminated strings. Strings are stored after g_strcompress(),
+ * so they can be used directly as the members of a PvMtreeEntry.
+ *
+ * The header records the size and modification time of the manifest
+ * from which the index was generated. The index is only used if the
+ * manifest still has exactly that size and modification time, so
+ * replacing the manifest with an older copy (for example with `cp -p`
+ * or by unpacking an archive) invalidates the index.
+ */
+#define PV_MTREE_INDEX_MAGIC "PVMTREE\x01"
+#define PV_MTREE_INDEX_VERSION 2
+#define PV_MTREE_INDEX_NO_STRING G_MAXUINT32
+
+typedef struct
+{
+  char magic[8];
+  guint32 version;
+  guint32 entry_size;
+  guint64 n_entries;
+  guint64 entries_offset;
+  guint64 strings_offset;
+  guint64 strings_size;
+  guint64 mtree_size;
+  gint64 mtree_mtime_sec;
+  guint32 mtree_mtime_nsec;
+  guint32 reserved;
+} PvMtreeIndexHeader;
+
+typedef struct
+{
+  /* Offsets into the string table, or PV_MTREE_INDEX_NO_STRING */
+  guint32 name;
+  guint32 contents;
+  guint32 link;
+  guint32 sha256;
+  gint64 size;
+  gint64 mtime_usec;
+  gint32 mode;
+  guint8 kind;
+  guint8 entry_flags;
+  guint16 reserved;
+} PvMtreeIndexEntry;
+
+G_STATIC_ASSERT (sizeof (PvMtreeIndexHeader) == 72);
+G_STATIC_ASSERT (sizeof (PvMtreeIndexEntry) == 40);
+
+/*
+ * pv_mtree_get_index_path:
+ * @mtree: (type filename): Path to a mtree(5) manifest
+ *
+ * Return the path to the binary index that would be used in preference
+ * to @mtree if it exists: for example `usr-mtree.txt.gz` is indexed by
+ * `usr-mtree.bin`.
+ *
+ * Returns: (transfer full) (type filename): A path
+ */
+static const char * const index_replaces_suffixes[] = { ".txt.gz", ".txt", ".gz" };
+
+gchar *
+pv_mtree_get_index_path (const char *mtree)
+{
+  gsize len = strlen (mtree);
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (index_replaces_suffixes); i++)
+    {
+      const char *suffix = index_replaces_suffixes[i];
+
+      if (g_str_has_suffix (mtree, suffix))
+        return g_strdup_printf ("%.*s.bin",
+                                (int) (len - strlen (suffix)), mtree);
+    }
+
+  return g_strconcat (mtree, ".bin", NULL);
+}
+
+static const char *
+pv_mtree_index_get_string (const char *strings,
+                           guint64 strings_size,
+                           guint32 offset_le,
+                           gboolean *valid)
+{
+  guint32 offset = GUINT32_FROM_LE (offset_le);
+
+  if (offset == PV_MTREE_INDEX_NO_STRING)
+    return NULL;
+
+  if (offset >= strings_size)
+    {
+      *valid = FALSE;
+      return NULL;
+    }
+
+  return strings + offset;
+}
+
+/*
+ * Fill in @entry with strings borrowed from the index.
+ * It must not be freed with pv_mtree_entry_clear().
+ */
+static gboolean
+pv_mtree_index_entry_init (PvMtreeEntry *entry,
+                           const PvMtreeIndexEntry *record,
+                           const char *strings,
+                           guint64 strings_size,
+                           GError **error)
+{
+  gboolean valid = TRUE;
+
+  entry->name = (gchar *) pv_mtree_index_get_string (strings, strings_size,
+                                                     record->name, &valid);
+  entry->contents = (gchar *) pv_mtree_index_get_string (strings, strings_size,
+                                                         record->contents,
+                                                         &valid);
+  entry->link = (gchar *) pv_mtree_index_get_string (strings, strings_size,
+                                                     record->link, &valid);
+  entry->sha256 = (gchar *) pv_mtree_index_get_string (strings, strings_size,
+                                                       record->sha256, &valid);
+  entry->size = GINT64_FROM_LE (record->size);
+  entry->mtime_usec = GINT64_FROM_LE (record->mtime_usec);
+  entry->mode = GINT32_FROM_LE (record->mode);
+  entry->kind = record->kind;
+  entry->entry_flags = record->entry_flags;
+
+  if (!valid)
+    return glnx_throw (error, "String offset out of range");
+
+  if (entry->name == NULL)
+    return glnx_throw (error, "Entry has no name");
+
+  if ((entry->link != NULL) != (entry->kind == PV_MTREE_ENTRY_KIND_LINK))
+    return glnx_throw (error, "Symlink target inconsistent with entry type");
+
+  return TRUE;
+}
+
+/*
+ * Map @index into memory if it is present, valid and was generated from
+ * the current version of @mtree.
+ *
+ * Returns: (transfer full) (nullable): The mapped index, or %NULL
+ *  if @mtree should be read instead
+ */
+static GMappedFile *
+pv_mtree_open_index (const char *mtree,
+                     const char *index,
+                     const PvMtreeIndexHeader **header_out)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const PvMtreeIndexHeader *header;
+  struct stat mtree_stat;
+  struct stat index_stat;
+  const char *contents;
+  gsize len;
+  guint64 entries_offset;
+  guint64 n_entries;
+  guint64 strings_offset;
+  guint64 strings_size;
+
+  if (stat (index, &index_stat) != 0)
+    return NULL;
+
+  mapped = g_mapped_file_new (index, FALSE, &local_error);
+
+  if (mapped == NULL)
+    {
+      g_warning ("Unable to map \"%s\" into memory: %s",
+                 index, local_error->message);
+      return NULL;
+    }
+
+  contents = g_mapped_file_get_contents (mapped);
+  len = g_mapped_file_get_length (mapped);
+  header = (const PvMtreeIndexHeader *) contents;
+
+  if (len < sizeof (PvMtreeIndexHeader)
+      || memcmp (header->magic, PV_MTREE_INDEX_MAGIC,
+                 sizeof (header->magic)) != 0)
+    {
+      g_warning ("\"%s\" is not a pressure-vessel mtree index", index);
+      return NULL;
+    }
+
+  if (GUINT32_FROM_LE (header->version) != PV_MTREE_INDEX_VERSION
+      || GUINT32_FROM_LE (header->entry_size) != sizeof (PvMtreeIndexEntry))
+    {
+      g_warning ("\"%s\" has unsupported version %u",
+                 index, GUINT32_FROM_LE (header->version));
+      return NULL;
+    }
+
+  n_entries = GUINT64_FROM_LE (header->n_entries);
+  entries_offset = GUINT64_FROM_LE (header->entries_offset);
+  strings_offset = GUINT64_FROM_LE (header->strings_offset);
+  strings_size = GUINT64_FROM_LE (header->strings_size);
+
+  if (entries_offset % 8 != 0
+      || entries_offset > len
+      || n_entries > (len - entries_offset) / sizeof (PvMtreeIndexEntry)
+      || strings_offset > len
+      || strings_size > len - strings_offset
+      || strings_size == 0
+      || contents[strings_offset + strings_size - 1] != '\0')
+    {
+      g_warning ("\"%s\" is truncated or corrupt", index);
+      return NULL;
+    }
+
+  /* If we can't tell whether the index is up to date, don't trust it:
+   * reading @mtree will either work or report why it can't */
+  if (stat (mtree, &mtree_stat) != 0)
+    {
+      g_info ("Ignoring \"%s\" because \"%s\" cannot be checked: %s",
+              index, mtree, g_strerror (errno));
+      return NULL;
+    }
+
+  if (GUINT64_FROM_LE (header->mtree_size) != (guint64) mtree_stat.st_size
+      || GINT64_FROM_LE (header->mtree_mtime_sec) != mtree_stat.st_mtim.tv_sec
+      || GUINT32_FROM_LE (header->mtree_mtime_nsec) != mtree_stat.st_mtim.tv_nsec)
+    {
+      g_info ("Ignoring \"%s\" because it was not generated from the "
+              "current version of \"%s\"",
+              index, mtree);
+      return NULL;
+    }
+
+  *header_out = header;
+  return g_steal_pointer (&mapped);
+}
+
+static gboolean
+pv_mtree_foreach_index (const char *index,
+                        GMappedFile *mapped,
+                        const PvMtreeIndexHeader *header,
+                        PvMtreeApplyFlags flags,
+                        PvMtreeForeachFunc callback,
+                        void *user_data,
+                        PvMtreeForeachErrorFunc on_error_cb,
+                        void *on_error_data,
+                        GError **error)
+{
+  const char *contents = g_mapped_file_get_contents (mapped);
+  const PvMtreeIndexEntry *records;
+  const char *strings;
+  guint64 n_entries;
+  guint64 strings_size;
+  guint64 i;
+
+  n_entries = GUINT64_FROM_LE (header->n_entries);
+  records = (const PvMtreeIndexEntry *) (contents + GUINT64_FROM_LE (header->entries_offset));
+  strings = contents + GUINT64_FROM_LE (header->strings_offset);
+  strings_size = GUINT64_FROM_LE (header->strings_size);
+
+  for (i = 0; i < n_entries; i++)
+    {
+      g_autoptr(GError) local_error = NULL;
+      PvMtreeEntry entry = PV_MTREE_ENTRY_BLANK;
+      /* For diagnostic messages, the entry number takes the place of
+       * the line number */
+      guint line_number = i + 1;
+
+      if (!pv_mtree_index_entry_init (&entry, &records[i],
+                                      strings, strings_size, error))
+        return glnx_prefix_error (error, "%s: entry %u", index, line_number);
+
+      trace ("mtree entry: %s", entry.name);
+
+      if (!callback (&entry, flags, index, line_number, user_data, &local_error))
+        {
+          if (on_error_cb != NULL)
+            {
+              on_error_cb (&entry, flags, index, line_number, local_error, on_error_data);
+              g_clear_error (&local_error);
+            }
+          else
+            {
+              g_propagate_error (error, g_steal_pointer (&local_error));
+              return FALSE;
+            }
+        }
+    }
+
+  return TRUE;
+}
+
+/*
+ * Call @callback for each entry in @mtree, or in its binary index
+ * if there is an index generated from the current version of @mtree
+ * (see pv_mtree_get_index_path()).
+ *
+ * The entry passed to @callback is only valid until it returns,
+ * and must not be modified or cleared.
+ */
+static gboolean
+pv_mtree_foreach (const char *mtree,
+                  PvMtreeApplyFlags flags,
+                  PvMtreeForeachFunc callback,
+                  void *user_data,
+                  PvMtreeForeachErrorFunc on_error_cb,
+                  void *on_error_data,
+                  GError **error)
+{
+  g_autoptr(GMappedFile) mapped = NULL;
+  g_autofree gchar *index = NULL;
+  const PvMtreeIndexHeader *header = NULL;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail (mtree != NULL, FALSE);
+  g_return_val_if_fail (callback != NULL, FALSE);
+
+  index = pv_mtree_get_index_path (mtree);
+  mapped = pv_mtree_open_index (mtree, index, &header);
+
+  if (mapped != NULL)
+    {
+      g_debug ("Reading \"%s\" instead of \"%s\"", index, mtree);
+      return pv_mtree_foreach_index (index, mapped, header, flags,
+                                     callback, user_data,
+                                     on_error_cb, on_error_data,
+                                     error);
+    }
+
+  return pv_mtree_foreach_text (mtree, flags,
+                                callback, user_data,
+                                on_error_cb, on_error_data,
+                                error);
+}
+
+typedef struct
+{
+  GArray *entries;
+  GString *strings;
+  /* (element-type utf8 guint32): string => offset in @strings */
+  GHashTable *offsets;
+} WriteIndexState;
+
+static gboolean
+write_index_add_string (WriteIndexState *state,
+                        const char *str,
+                        guint32 *offset_out,
+                        GError **error)
+{
+  gpointer value;
+
+  if (str == NULL)
+    {
+      *offset_out = GUINT32_TO_LE (PV_MTREE_INDEX_NO_STRING);
+      return TRUE;
+    }
+
+  if (g_hash_table_lookup_extended (state->offsets, str, NULL, &value))
+    {
+      *offset_out = GUINT32_TO_LE (GPOINTER_TO_UINT (value));
+      return TRUE;
+    }
+
+  if (state->strings->len >= PV_MTREE_INDEX_NO_STRING - strlen (str) - 1)
+    return glnx_throw (error, "Too much text to index");
+
+  *offset_out = GUINT32_TO_LE ((guint32) state->strings->len);
+  g_hash_table_replace (state->offsets, g_strdup (str),
+                        GUINT_TO_POINTER (state->strings->len));
+  /* Include the trailing \0 */
+  g_string_append_len (state->strings, str, strlen (str) + 1);
+  return TRUE;
+}
+
+static gboolean
+pv_mtree_foreach_write_index_cb (PvMtreeEntry *entry,
+                                 PvMtreeApplyFlags flags,
+                                 const char *mtree,
+                                 guint line_number,
+                                 void *user_data,
+                                 GError **error)
+{
+  WriteIndexState *state = user_data;
+  PvMtreeIndexEntry record = {};
+
+  if (!write_index_add_string (state, entry->name, &record.name, error)
+      || !write_index_add_string (state, entry->contents, &record.contents, error)
+      || !write_index_add_string (state, entry->link, &record.link, error)
+      || !write_index_add_string (state, entry->sha256, &record.sha256, error))
+    return glnx_prefix_error (error, "%s:%u", mtree, line_number);
+
+  record.size = GINT64_TO_LE (entry->size);
+  record.mtime_usec = GINT64_TO_LE (entry->mtime_usec);
+  record.mode = GINT32_TO_LE (entry->mode);
+  record.kind = entry->kind;
+  record.entry_flags = entry->entry_flags;
+  g_array_append_val (state->entries, record);
+  return TRUE;
+}
+
+/*
+ * pv_mtree_write_index:
+ * @mtree: (type filename): Path to a mtree(5) manifest
+ * @index: (type filename) (nullable): Path to the binary index to write,
+ *  or %NULL to use pv_mtree_get_index_path()
+ * @flags: Flags affecting how @mtree is read
+ *
+ * Convert @mtree into a binary index that can be mapped into memory
+ * and iterated over without parsing or allocation. pv_mtree_apply()
+ * and pv_mtree_verify() will use it in preference to @mtree if it
+ * is at the path given by pv_mtree_get_index_path() and @mtree still
+ * has the size and modification time that it had when the index
+ * was written.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+pv_mtree_write_index (const char *mtree,
+                      const char *index,
+                      PvMtreeApplyFlags flags,
+                      GError **error)
+{
+  g_autoptr(GArray) entries = NULL;
+  g_autoptr(GByteArray) bytes = NULL;
+  g_autoptr(GHashTable) offsets = NULL;
+  g_autoptr(GString) strings = NULL;
+  g_autofree gchar *default_index = NULL;
+  PvMtreeIndexHeader header = {};
+  WriteIndexState state = {};
+  struct stat mtree_stat;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail (mtree != NULL, FALSE);
+
+  if (index == NULL)
+    {
+      default_index = pv_mtree_get_index_path (mtree);
+      index = default_index;
+    }
+
+  /* Do this before reading it: if it changes while we are reading it,
+   * the index will be considered to be out of date */
+  if (stat (mtree, &mtree_stat) != 0)
+    return glnx_throw_errno_prefix (error, "Unable to get file information for \"%s\"",
+                                    mtree);
+
+  entries = g_array_new (FALSE, FALSE, sizeof (PvMtreeIndexEntry));
+  strings = g_string_new ("");
+  offsets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  state.entries = entries;
+  state.strings = strings;
+  state.offsets = offsets;
+
+  if (!pv_mtree_foreach_text (mtree, flags,
+                              pv_mtree_foreach_write_index_cb, &state,
+                              NULL, NULL,
+                              error))
+    return FALSE;
+
+  /* Make sure the string table is never empty, so that the reader can
+   * check that it ends with \0 */
+  g_string_append_c (strings, '\0');
+
+  memcpy (header.magic, PV_MTREE_INDEX_MAGIC, sizeof (header.magic));
+  header.version = GUINT32_TO_LE (PV_MTREE_INDEX_VERSION);
+  header.entry_size = GUINT32_TO_LE (sizeof (PvMtreeIndexEntry));
+  header.n_entries = GUINT64_TO_LE (entries->len);
+  header.entries_offset = GUINT64_TO_LE (sizeof (header));
+  header.strings_offset = GUINT64_TO_LE (sizeof (header)
+                                         + (guint64) entries->len
+                                           * sizeof (PvMtreeIndexEntry));
+  header.strings_size = GUINT64_TO_LE (strings->len);
+  header.mtree_size = GUINT64_TO_LE (mtree_stat.st_size);
+  header.mtree_mtime_sec = GINT64_TO_LE (mtree_stat.st_mtim.tv_sec);
+  header.mtree_mtime_nsec = GUINT32_TO_LE (mtree_stat.st_mtim.tv_nsec);
+
+  bytes = g_byte_array_new ();
+  g_byte_array_append (bytes, (const guint8 *) &header, sizeof (header));
+  g_byte_array_append (bytes, (const guint8 *) entries->data,
+                       entries->len * sizeof (PvMtreeIndexEntry));
+  g_byte_array_append (bytes, (const guint8 *) strings->str, strings->len);
+
+  if (!glnx_file_replace_contents_at (AT_FDCWD, index,
+                                      bytes->data, bytes->len,
+                                      GLNX_FILE_REPLACE_NODATASYNC,
+                                      NULL, error))
+    return glnx_prefix_error (error, "Unable to write \"%s\"", index);
+
+  g_info ("Wrote %u entries from \"%s\" to \"%s\"",
+          entries->len, mtree, index);
+  return TRUE;
+}
+
+/*
+ * A directory file descriptor that can be shared between threads.
+ * It is closed when the last reference is released.
+ */
+typedef int PvDirFd;
+
+static void
+clear_fd (void *p)
+{
+  glnx_close_fd (p);
+}
+
+static PvDirFd *
+pv_dir_fd_new_take (int *fdp)
+{
+  PvDirFd *self = g_atomic_rc_box_new (PvDirFd);
+
+  *self = g_steal_fd (fdp);
+  return self;
+}
+
+static PvDirFd *
+pv_dir_fd_ref (PvDirFd *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+static void
+pv_dir_fd_unref (void *self)
+{
+  g_atomic_rc_box_release_full (self, clear_fd);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (PvDirFd, pv_dir_fd_unref)
+
+typedef struct
+{
+  GList link;
+  gchar *path;
+  PvDirFd *fd;
+} DirCacheEntry;
+
+static void
+dir_cache_entry_free (void *p)
+{
+  DirCacheEntry *self = p;
+
+  g_free (self->path);
+  g_clear_pointer (&self->fd, pv_dir_fd_unref);
+  g_free (self);
+}
+
+/*
+ * A bounded cache of directories below a sysroot, indexed by their
+ * path relative to the sysroot, as written in the mtree manifest
+ * (for example `./usr/lib`). Only used from the thread that is reading
+ * the manifest.
+ */
+typedef struct
+{
+  /* (element-type filename DirCacheEntry) */
+  GHashTable *by_path;
+  /* (element-type DirCacheEntry): most recently used at the head */
+  GQueue lru;
+  PvDirFd *root;
+  int sysroot_fd;
+} DirCache;
+
+/* Manifests are sorted so that each directory's contents are contiguous,
+ * so we only need to remember a few levels of recently-used directories.
+ * This needs to stay well below RLIMIT_NOFILE. */
+#define DIR_CACHE_MAX_SIZE 128
+
+static gboolean
+dir_cache_init (DirCache *self,
+                int sysroot_fd,
+                GError **error)
+{
+  glnx_autofd int fd = -1;
+
+  fd = TEMP_FAILURE_RETRY (fcntl (sysroot_fd, F_DUPFD_CLOEXEC, 0));
+
+  if (fd < 0)
+    return glnx_throw_errno_prefix (error, "Unable to duplicate fd %d",
+                                    sysroot_fd);
+
+  self->by_path = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                         NULL, dir_cache_entry_free);
+  g_queue_init (&self->lru);
+  self->root = pv_dir_fd_new_take (&fd);
+  self->sysroot_fd = sysroot_fd;
+  return TRUE;
+}
+
+static void
+dir_cache_clear (DirCache *self)
+{
+  g_queue_init (&self->lru);
+  g_clear_pointer (&self->by_path, g_hash_table_unref);
+  g_clear_pointer (&self->root, pv_dir_fd_unref);
+  self->sysroot_fd = -1;
+}
+
+static void
+dir_cache_insert (DirCache *self,
+                  const char *path,
+                  PvDirFd *fd)
+{
+  DirCacheEntry *entry;
+
+  entry = g_hash_table_lookup (self->by_path, path);
+
+  if (entry != NULL)
+    {
+      g_queue_unlink (&self->lru, &entry->link);
+      g_hash_table_remove (self->by_path, path);
+    }
+
+  while (self->lru.length >= DIR_CACHE_MAX_SIZE)
+    {
+      GList *oldest = g_queue_pop_tail_link (&self->lru);
+
+      entry = oldest->data;
+      g_hash_table_remove (self->by_path, entry->path);
+    }
+
+  entry = g_new0 (DirCacheEntry, 1);
+  entry->path = g_strdup (path);
+  entry->fd = pv_dir_fd_ref (fd);
+  entry->link.data = entry;
+  g_queue_push_head_link (&self->lru, &entry->link);
+  g_hash_table_replace (self->by_path, entry->path, entry);
+}
+
+/*
+ * @path: A directory path relative to the sysroot, for example `./usr/lib`
+ *
+ * Return a directory fd for @path, creating it and its ancestors
+ * as if via _srt_resolve_in_sysroot() with %SRT_RESOLVE_FLAGS_MKDIR_P
+ * if necessary.
+ *
+ * In the common case where the parent is cached and @path is a
+ * real directory, this is a single openat(). Symbolic links and
+ * anything else unusual are delegated to _srt_resolve_in_sysroot().
+ *
+ * Returns: (transfer full): A new reference to the directory fd
+ */
+static PvDirFd *
+dir_cache_get (DirCache *self,
+               const char *path,
+               GError **error)
+{
+  g_autoptr(PvDirFd) parent_fd = NULL;
+  g_autofree gchar *parent = NULL;
+  glnx_autofd int fd = -1;
+  DirCacheEntry *entry;
+  PvDirFd *ret;
+  const char *base;
+
+  if (path[0] == '\0' || strcmp (path, ".") == 0)
+    return pv_dir_fd_ref (self->root);
+
+  entry = g_hash_table_lookup (self->by_path, path);
+
+  if (entry != NULL)
+    {
+      g_queue_unlink (&self->lru, &entry->link);
+      g_queue_push_head_link (&self->lru, &entry->link);
+      return pv_dir_fd_ref (entry->fd);
+    }
+
+  parent = g_path_get_dirname (path);
+  base = glnx_basename (path);
+
+  if (strcmp (parent, path) != 0
+      && strcmp (base, ".") != 0
+      && strcmp (base, "..") != 0)
+    parent_fd = dir_cache_get (self, parent, NULL);
+
+  if (parent_fd != NULL)
+    {
+      const int open_flags = O_CLOEXEC | O_NOFOLLOW | O_PATH | O_DIRECTORY;
+
+      fd = TEMP_FAILURE_RETRY (openat (*parent_fd, base, open_flags));
+
+      if (fd < 0 && errno == ENOENT
+          && TEMP_FAILURE_RETRY (mkdirat (*parent_fd, base, 0700)) == 0)
+        {
+          g_debug ("Created \"%s\" in /proc/self/fd/%d", path, self->sysroot_fd);
+          fd = TEMP_FAILURE_RETRY (openat (*parent_fd, base, open_flags));
+        }
+    }
+
+  /* If it's a symlink, or we couldn't open it for some other reason,
+   * do it the slow way, which will also give us a better error message */
+  if (fd < 0)
+    {
+      fd = _srt_resolve_in_sysroot (self->sysroot_fd, path,
+                                    SRT_RESOLVE_FLAGS_MKDIR_P,
+                                    NULL, error);
+
+      if (fd < 0)
+        return NULL;
+    }
+
+  ret = pv_dir_fd_new_take (&fd);
+  dir_cache_insert (self, path, ret);
+  return ret;
+}
+
+/* Upper bound on the number of regular files queued for worker threads,
+ * to limit how many directory fds can be held open by pending tasks */
+#define APPLY_MAX_IN_FLIGHT 256
+/* Most of the time is spent in the kernel, creating hard links and
+ * setting metadata, so more threads than this don't help much */
+#define APPLY_MAX_THREADS 8
+
 typedef struct
 {
   const char *sysroot;
   int sysroot_fd;
   const char *source_files;
   int source_files_fd;
-  GLogLevelFlags chmod_plusx_warning_level;
-  GLogLevelFlags chmod_minusx_warning_level;
-  GLogLevelFlags set_mtime_warning_level;
+  DirCache dirs;
+  /* Only used with PV_MTREE_APPLY_FLAGS_PARALLEL */
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  /* Protected by @lock */
+  guint in_flight;
+  /* Protected by @lock */
+  GError *error;
+  guint64 n_entries;
+  /* Accessed atomically: see warn_once() */
+  gint chmod_plusx_warned;
+  gint chmod_minusx_warned;
+  gint set_mtime_warned;
+  gint hard_link_warned;
 } ForeachApplyState;
 
+/*
+ * A regular file to be populated by a worker thread.
+ */
+typedef struct
+{
+  PvMtreeEntry entry;
+  PvDirFd *parent_fd;
+  PvMtreeApplyFlags flags;
+  const char *mtree;
+  guint line_number;
+} ApplyTask;
+
+static void
+apply_task_free (ApplyTask *self)
+{
+  pv_mtree_entry_clear (&self->entry);
+  g_clear_pointer (&self->parent_fd, pv_dir_fd_unref);
+  g_free (self);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (ApplyTask, apply_task_free)
+
+/*
+ * Make @entry, which is @base in @parent_fd, conform to the manifest.
+ * This can be called from a worker thread if @entry is a regular file.
+ */
 static gboolean
-pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
-                           PvMtreeApplyFlags flags,
-                           const char *mtree,
-                           guint line_number,
-                           void *user_data,
-                           GError **error)
+pv_mtree_apply_entry (ForeachApplyState *state,
+                      const PvMtreeEntry *entry,
+                      int parent_fd,
+                      PvMtreeApplyFlags flags,
+                      const char *mtree,
+                      guint line_number,
+                      GError **error)
 {
-  ForeachApplyState *state = user_data;
-  g_autofree gchar *parent = NULL;
   const char *base;
-  glnx_autofd int parent_fd = -1;
   glnx_autofd int fd = -1;
 
-  parent = g_path_get_dirname (entry->name);
   base = glnx_basename (entry->name);
 
-  trace ("Creating %s in %s", parent, state->sysroot);
-  parent_fd = _srt_resolve_in_sysroot (state->sysroot_fd, parent,
-                                       SRT_RESOLVE_FLAGS_MKDIR_P,
-                                       NULL, error);
-
-  if (parent_fd < 0)
-    return glnx_prefix_error (error,
-                              "Unable to create parent directory for \"%s\" in \"%s\"",
-                              entry->name, state->sysroot);
-
   switch (entry->kind)
     {
       case PV_MTREE_ENTRY_KIND_FILE:
@@ -661,7 +1412,9 @@ pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
                                             entry->name, state->source_files,
                                             source, state->sysroot);
 
-                if ((flags & PV_MTREE_APPLY_FLAGS_EXPECT_HARD_LINKS) != 0)
+                /* Only warn once per tree copied */
+                if ((flags & PV_MTREE_APPLY_FLAGS_EXPECT_HARD_LINKS) != 0
+                    && warn_once (&state->hard_link_warned) == G_LOG_LEVEL_WARNING)
                   {
                     g_warning ("Unable to create hard link \"%s/%s\" to "
                                "\"%s/%s\": %s",
@@ -673,8 +1426,6 @@ pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
                                "should both be on the same "
                                "fully-featured Linux filesystem.",
                                state->source_files, state->sysroot);
-                    /* Only warn once per tree copied */
-                    flags &= ~PV_MTREE_APPLY_FLAGS_EXPECT_HARD_LINKS;
                   }
               }
           }
@@ -733,8 +1484,8 @@ pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
 
   if (fd >= 0 &&
       !maybe_chmod (entry, parent_fd, base, fd, state->sysroot, flags,
-                    &state->chmod_plusx_warning_level,
-                    &state->chmod_minusx_warning_level,
+                    &state->chmod_plusx_warned,
+                    &state->chmod_minusx_warned,
                     error))
     return FALSE;
 
@@ -753,15 +1504,119 @@ pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
       };
 
       if (futimens (fd, times) != 0)
+        g_log (G_LOG_DOMAIN, warn_once (&state->set_mtime_warned),
+               "Unable to set mtime of \"%s\" in \"%s\": %s",
+               entry->name, state->sysroot, g_strerror (errno));
+    }
+
+  return TRUE;
+}
+
+/*
+ * GFunc for state->pool: populate one regular file.
+ */
+static void
+pv_mtree_apply_worker (gpointer data,
+                       gpointer user_data)
+{
+  g_autoptr(ApplyTask) task = data;
+  g_autoptr(GError) local_error = NULL;
+  ForeachApplyState *state = user_data;
+  gboolean failed;
+
+  g_mutex_lock (&state->lock);
+  failed = (state->error != NULL);
+  g_mutex_unlock (&state->lock);
+
+  /* If another thread already failed, there's no point in continuing */
+  if (!failed
+      && !pv_mtree_apply_entry (state, &task->entry, *task->parent_fd,
+                                task->flags, task->mtree, task->line_number,
+                                &local_error))
+    {
+      g_mutex_lock (&state->lock);
+
+      if (state->error == NULL)
+        state->error = g_steal_pointer (&local_error);
+
+      g_mutex_unlock (&state->lock);
+    }
+
+  g_clear_pointer (&task, apply_task_free);
+
+  g_mutex_lock (&state->lock);
+  state->in_flight--;
+  g_cond_signal (&state->cond);
+  g_mutex_unlock (&state->lock);
+}
+
+static gboolean
+pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
+                           PvMtreeApplyFlags flags,
+                           const char *mtree,
+                           guint line_number,
+                           void *user_data,
+                           GError **error)
+{
+  ForeachApplyState *state = user_data;
+  g_autofree gchar *parent = NULL;
+  g_autoptr(PvDirFd) parent_fd = NULL;
+
+  state->n_entries++;
+  parent = g_path_get_dirname (entry->name);
+
+  trace ("Creating %s in %s", parent, state->sysroot);
+  parent_fd = dir_cache_get (&state->dirs, parent, error);
+
+  if (parent_fd == NULL)
+    return glnx_prefix_error (error,
+                              "Unable to create parent directory for \"%s\" in \"%s\"",
+                              entry->name, state->sysroot);
+
+  /* Directories and symlinks are created in manifest order, so that
+   * they exist before anything inside them is created; only regular
+   * files can be populated in parallel. */
+  if (state->pool != NULL && entry->kind == PV_MTREE_ENTRY_KIND_FILE)
+    {
+      ApplyTask *task;
+
+      g_mutex_lock (&state->lock);
+
+      while (state->in_flight >= APPLY_MAX_IN_FLIGHT && state->error == NULL)
+        g_cond_wait (&state->cond, &state->lock);
+
+      if (state->error != NULL)
         {
-          g_log (G_LOG_DOMAIN, state->set_mtime_warning_level,
-                 "Unable to set mtime of \"%s\" in \"%s\": %s",
-                 entry->name, state->sysroot, g_strerror (errno));
-          state->set_mtime_warning_level = G_LOG_LEVEL_INFO;
+          /* pv_mtree_apply() will report state->error instead */
+          g_mutex_unlock (&state->lock);
+          g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                               "Cancelled after an earlier error");
+          return FALSE;
         }
+
+      state->in_flight++;
+      g_mutex_unlock (&state->lock);
+
+      task = g_new0 (ApplyTask, 1);
+      /* The entry might be borrowed from a memory-mapped index, which
+       * will be unmapped before the task runs, so take a copy */
+      task->entry = *entry;
+      task->entry.name = g_strdup (entry->name);
+      task->entry.contents = g_strdup (entry->contents);
+      task->entry.link = g_strdup (entry->link);
+      task->entry.sha256 = g_strdup (entry->sha256);
+      task->parent_fd = g_steal_pointer (&parent_fd);
+      task->flags = flags;
+      task->mtree = mtree;
+      task->line_number = line_number;
+
+      /* This can't fail, because the pool is not exclusive */
+      g_thread_pool_push (state->pool, task, NULL);
+      return TRUE;
     }
 
-  return TRUE;
+  return pv_mtree_apply_entry (state, entry, *parent_fd, flags,
+                               mtree, line_number, error);
 }
 
 /*
@@ -818,6 +1673,10 @@ pv_mtree_foreach_apply_cb (PvMtreeEntry *entry,
  * modification time of a source file in @source_files might be modified
  * to conform to the @mtree.
  *
+ * If @flags contains %PV_MTREE_APPLY_FLAGS_PARALLEL, regular files are
+ * populated by a pool of worker threads, while directories and symbolic
+ * links are still created in the order they appear in @mtree.
+ *
  * Returns: %TRUE on success
  */
 gboolean
@@ -829,20 +1688,20 @@ pv_mtree_apply (const char *mtree,
                 GError **error)
 {
   g_autoptr(SrtProfilingTimer) timer = NULL;
+  g_autoptr(GError) local_error = NULL;
   glnx_autofd int source_files_fd = -1;
   /* We only emit a warning for the first file we were unable to chmod +x,
    * and the first file we were unable to chmod -x, per mtree applied;
-   * the second and subsequent file in each class are demoted to INFO. */
+   * the second and subsequent file in each class are demoted to INFO.
+   * The *_warned fields start as FALSE to represent this. */
   ForeachApplyState state =
   {
     .sysroot = sysroot,
     .sysroot_fd = sysroot_fd,
     .source_files = source_files,
     .source_files_fd = -1,
-    .chmod_plusx_warning_level = G_LOG_LEVEL_WARNING,
-    .chmod_minusx_warning_level = G_LOG_LEVEL_WARNING,
-    .set_mtime_warning_level = G_LOG_LEVEL_WARNING,
   };
+  gboolean ret;
 
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
   g_return_val_if_fail (mtree != NULL, FALSE);
@@ -857,15 +1716,274 @@ pv_mtree_apply (const char *mtree,
                            error))
         return FALSE;
 
-      state.source_files_fd = source_files_fd;
+      state.source_files_fd = source_files_fd;
+    }
+
+  if (!dir_cache_init (&state.dirs, sysroot_fd, error))
+    return FALSE;
+
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
+
+  if (flags & PV_MTREE_APPLY_FLAGS_PARALLEL)
+    {
+      guint n_threads = CLAMP (g_get_num_processors (), 1, APPLY_MAX_THREADS);
+
+      /* Not exclusive, so this cannot fail */
+      state.pool = g_thread_pool_new (pv_mtree_apply_worker, &state,
+                                      n_threads, FALSE, NULL);
+      g_info ("Applying \"%s\" to \"%s\" with %u threads...",
+              mtree, sysroot, n_threads);
+    }
+  else
+    {
+      g_info ("Applying \"%s\" to \"%s\"...", mtree, sysroot);
+    }
+
+  ret = pv_mtree_foreach (mtree, flags,
+                          pv_mtree_foreach_apply_cb, &state,
+                          NULL, NULL,
+                          &local_error);
+
+  /* Wait for all queued files to be finished */
+  if (state.pool != NULL)
+    g_thread_pool_free (g_steal_pointer (&state.pool), FALSE, TRUE);
+
+  /* An error from a worker thread takes precedence, because it's the
+   * reason why the main thread was cancelled */
+  if (state.error != NULL)
+    {
+      g_clear_error (&local_error);
+      local_error = g_steal_pointer (&state.error);
+      ret = FALSE;
+    }
+
+  _srt_profiling_rate (timer, state.n_entries, "entries");
+
+  dir_cache_clear (&state.dirs);
+  g_cond_clear (&state.cond);
+  g_mutex_clear (&state.lock);
+
+  if (!ret)
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
+/* Each task holds a file descriptor open */
+#define VERIFY_MAX_IN_FLIGHT 64
+/* Hashing is CPU-bound, so unlike applying, more threads help until we
+ * are limited by I/O */
+#define VERIFY_MAX_THREADS 16
+#define VERIFY_READ_BUFFER_SIZE (256 * 1024)
+
+#define VERIFY_CACHE_HEADER "# pv-verify cache v1\n"
+
+/*
+ * A regular file that was found to have the expected contents by
+ * a previous pv_mtree_verify(). If its inode has not been modified
+ * since then, we don't need to hash it again.
+ */
+typedef struct
+{
+  guint64 dev;
+  guint64 ino;
+  goffset size;
+  gint64 mtime_nsec;
+  gint64 ctime_nsec;
+  char sha256[65];
+  /* TRUE if the file was seen during this run: entries that were not
+   * seen are not saved again */
+  gboolean seen;
+} VerifyCacheEntry;
+
+static void
+verify_cache_entry_init (VerifyCacheEntry *self,
+                         const struct stat *stat_buf)
+{
+  self->dev = stat_buf->st_dev;
+  self->ino = stat_buf->st_ino;
+  self->size = stat_buf->st_size;
+  self->mtime_nsec = (stat_buf->st_mtim.tv_sec * G_GINT64_CONSTANT (1000000000)
+                      + stat_buf->st_mtim.tv_nsec);
+  self->ctime_nsec = (stat_buf->st_ctim.tv_sec * G_GINT64_CONSTANT (1000000000)
+                      + stat_buf->st_ctim.tv_nsec);
+}
+
+static guint
+verify_cache_entry_hash (gconstpointer p)
+{
+  const VerifyCacheEntry *self = p;
+
+  return (guint) (self->ino ^ (self->ino >> 32) ^ self->dev);
+}
+
+static gboolean
+verify_cache_entry_equal (gconstpointer a,
+                          gconstpointer b)
+{
+  const VerifyCacheEntry *one = a;
+  const VerifyCacheEntry *two = b;
+
+  return one->dev == two->dev && one->ino == two->ino;
+}
+
+/*
+ * A map from device and inode to VerifyCacheEntry, loaded from and
+ * saved to the file given as pv_mtree_verify()'s @cache argument.
+ */
+typedef struct
+{
+  /* (element-type VerifyCacheEntry VerifyCacheEntry) */
+  GHashTable *entries;
+  gboolean dirty;
+} VerifyCache;
+
+static void
+verify_cache_init (VerifyCache *self)
+{
+  self->entries = g_hash_table_new_full (verify_cache_entry_hash,
+                                         verify_cache_entry_equal,
+                                         g_free, NULL);
+  self->dirty = FALSE;
+}
+
+static void
+verify_cache_clear (VerifyCache *self)
+{
+  g_clear_pointer (&self->entries, g_hash_table_unref);
+}
+
+/*
+ * Load @path into @self. Failure is not fatal: it just means we
+ * will need to hash everything again.
+ */
+static void
+verify_cache_load (VerifyCache *self,
+                   const char *path)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autofree gchar *contents = NULL;
+  char *line;
+  char *next;
+
+  if (!g_file_get_contents (path, &contents, NULL, &local_error))
+    {
+      if (g_error_matches (local_error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+        g_debug ("%s", local_error->message);
+      else
+        g_warning ("Unable to load verification cache: %s",
+                   local_error->message);
+
+      return;
+    }
+
+  if (!g_str_has_prefix (contents, VERIFY_CACHE_HEADER))
+    {
+      g_info ("Ignoring \"%s\": not a verification cache in a known format",
+              path);
+      return;
+    }
+
+  for (line = contents + strlen (VERIFY_CACHE_HEADER);
+       *line != '\0';
+       line = next)
+    {
+      g_autofree VerifyCacheEntry *entry = g_new0 (VerifyCacheEntry, 1);
+      char *end;
+
+      next = strchr (line, '\n');
+
+      if (next != NULL)
+        *next++ = '\0';
+      else
+        next = line + strlen (line);
+
+      entry->dev = g_ascii_strtoull (line, &end, 10);
+
+      if (*end != ' ')
+        continue;
+
+      entry->ino = g_ascii_strtoull (end + 1, &end, 10);
+
+      if (*end != ' ')
+        continue;
+
+      entry->size = g_ascii_strtoll (end + 1, &end, 10);
+
+      if (*end != ' ')
+        continue;
+
+      entry->mtime_nsec = g_ascii_strtoll (end + 1, &end, 10);
+
+      if (*end != ' ')
+        continue;
+
+      entry->ctime_nsec = g_ascii_strtoll (end + 1, &end, 10);
+
+      if (*end != ' ' || strlen (end + 1) != sizeof (entry->sha256) - 1)
+        continue;
+
+      memcpy (entry->sha256, end + 1, sizeof (entry->sha256));
+      g_hash_table_replace (self->entries, entry, entry);
+      entry = NULL;
+    }
+
+  g_debug ("Loaded %u entries from verification cache \"%s\"",
+           g_hash_table_size (self->entries), path);
+}
+
+/*
+ * Save the entries in @self that were seen during this run to @path.
+ */
+static void
+verify_cache_save (VerifyCache *self,
+                   const char *path)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(GString) contents = g_string_new (VERIFY_CACHE_HEADER);
+  GHashTableIter iter;
+  gpointer k;
+
+  g_hash_table_iter_init (&iter, self->entries);
+
+  while (g_hash_table_iter_next (&iter, &k, NULL))
+    {
+      const VerifyCacheEntry *entry = k;
+
+      if (!entry->seen)
+        {
+          self->dirty = TRUE;
+          continue;
+        }
+
+      g_string_append_printf (contents,
+                              "%" G_GUINT64_FORMAT
+                              " %" G_GUINT64_FORMAT
+                              " %" G_GINT64_FORMAT
+                              " %" G_GINT64_FORMAT
+                              " %" G_GINT64_FORMAT
+                              " %s\n",
+                              entry->dev, entry->ino, (gint64) entry->size,
+                              entry->mtime_nsec, entry->ctime_nsec,
+                              entry->sha256);
     }
 
-  g_info ("Applying \"%s\" to \"%s\"...", mtree, sysroot);
+  if (!self->dirty)
+    return;
 
-  return pv_mtree_foreach (mtree, flags,
-                           pv_mtree_foreach_apply_cb, &state,
-                           NULL, NULL,
-                           error);
+  if (!glnx_file_replace_contents_at (AT_FDCWD, path,
+                                      (const guint8 *) contents->str,
+                                      contents->len,
+                                      GLNX_FILE_REPLACE_NODATASYNC,
+                                      NULL, &local_error))
+    g_warning ("Unable to save verification cache \"%s\": %s",
+               path, local_error->message);
+  else
+    g_debug ("Saved verification cache \"%s\"", path);
 }
 
 typedef struct
@@ -874,9 +1992,184 @@ typedef struct
   GPtrArray *runtimes;
   const char *sysroot;
   int sysroot_fd;
+  /* Set of paths relative to @sysroot of the binary indexes that might
+   * be present without being listed: the index of the manifest being
+   * verified, and the index of each runtime manifest that we check */
+  GHashTable *indexes;
   gboolean failed;
+  /* Only used with PV_MTREE_APPLY_FLAGS_PARALLEL */
+  GThreadPool *pool;
+  /* Protects everything below, and @failed while @pool is active */
+  GMutex *lock;
+  GCond *cond;
+  guint in_flight;
+  VerifyCache *cache;
+  PvMtreeVerifyStats *stats;
 } ForeachVerifyState;
 
+/*
+ * A regular file to be hashed, possibly by a worker thread.
+ */
+typedef struct
+{
+  VerifyCacheEntry key;
+  gchar *name;
+  gchar *sha256;
+  int fd;
+} VerifyTask;
+
+static void
+verify_task_free (VerifyTask *self)
+{
+  glnx_close_fd (&self->fd);
+  g_free (self->name);
+  g_free (self->sha256);
+  g_free (self);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (VerifyTask, verify_task_free)
+
+static gboolean
+pv_mtree_verify_contents (ForeachVerifyState *state,
+                          VerifyTask *task,
+                          GError **error)
+{
+  g_autoptr(GChecksum) hasher = g_checksum_new (G_CHECKSUM_SHA256);
+  g_autofree char *buf = g_malloc (VERIFY_READ_BUFFER_SIZE);
+  VerifyCacheEntry *entry;
+  ssize_t n = 0;
+
+  posix_fadvise (task->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+  do
+    {
+      n = TEMP_FAILURE_RETRY (read (task->fd, buf, VERIFY_READ_BUFFER_SIZE));
+
+      if (n < 0)
+        return glnx_throw_errno_prefix (error,
+                                        "Unable to read \"%s\" in \"%s\"",
+                                        task->name, state->sysroot);
+
+      if (n > 0)
+        g_checksum_update (hasher, (void *) buf, n);
+    }
+  while (n > 0);
+
+  g_mutex_lock (state->lock);
+  state->stats->bytes_hashed += task->key.size;
+  state->stats->files_hashed++;
+  g_mutex_unlock (state->lock);
+
+  if (!g_str_equal (g_checksum_get_string (hasher), task->sha256))
+    return glnx_throw (error,
+                       "\"%s\" in \"%s\" did not have expected contents",
+                       task->name, state->sysroot);
+
+  if (state->cache != NULL)
+    {
+      entry = g_memdup2 (&task->key, sizeof (task->key));
+      g_strlcpy (entry->sha256, task->sha256, sizeof (entry->sha256));
+      entry->seen = TRUE;
+
+      g_mutex_lock (state->lock);
+      g_hash_table_replace (state->cache->entries, entry, entry);
+      state->cache->dirty = TRUE;
+      g_mutex_unlock (state->lock);
+    }
+
+  return TRUE;
+}
+
+/*
+ * GFunc for state->pool: hash one regular file.
+ */
+static void
+pv_mtree_verify_worker (gpointer data,
+                        gpointer user_data)
+{
+  g_autoptr(VerifyTask) task = data;
+  g_autoptr(GError) local_error = NULL;
+  ForeachVerifyState *state = user_data;
+
+  if (!pv_mtree_verify_contents (state, task, &local_error))
+    {
+      g_warning ("%s", local_error->message);
+      g_mutex_lock (state->lock);
+      state->failed = TRUE;
+      g_mutex_unlock (state->lock);
+    }
+
+  g_clear_pointer (&task, verify_task_free);
+
+  g_mutex_lock (state->lock);
+  state->in_flight--;
+  g_cond_signal (state->cond);
+  g_mutex_unlock (state->lock);
+}
+
+/*
+ * Check that @fd has contents @sha256, either by looking it up in
+ * the cache, by queueing it to be hashed by a worker thread, or by
+ * hashing it immediately.
+ */
+static gboolean
+pv_mtree_verify_check_sha256 (ForeachVerifyState *state,
+                              int *fd,
+                              const struct stat *stat_buf,
+                              const char *name,
+                              const char *sha256,
+                              GError **error)
+{
+  g_autoptr(VerifyTask) task = g_new0 (VerifyTask, 1);
+
+  verify_cache_entry_init (&task->key, stat_buf);
+
+  if (state->cache != NULL)
+    {
+      VerifyCacheEntry *cached;
+
+      g_mutex_lock (state->lock);
+      cached = g_hash_table_lookup (state->cache->entries, &task->key);
+
+      if (cached != NULL
+          && cached->size == task->key.size
+          && cached->mtime_nsec == task->key.mtime_nsec
+          && cached->ctime_nsec == task->key.ctime_nsec
+          && g_str_equal (cached->sha256, sha256))
+        {
+          trace ("\"%s\" is unchanged since it was last verified", name);
+          cached->seen = TRUE;
+          state->stats->bytes_skipped += task->key.size;
+          state->stats->files_skipped++;
+          g_mutex_unlock (state->lock);
+          return TRUE;
+        }
+
+      g_mutex_unlock (state->lock);
+    }
+
+  task->fd = g_steal_fd (fd);
+  task->name = g_strdup (name);
+  task->sha256 = g_strdup (sha256);
+
+  if (state->pool != NULL)
+    {
+      g_mutex_lock (state->lock);
+
+      while (state->in_flight >= VERIFY_MAX_IN_FLIGHT)
+        g_cond_wait (state->cond, state->lock);
+
+      state->in_flight++;
+      g_mutex_unlock (state->lock);
+
+      /* This can't fail, because the pool is not exclusive */
+      g_thread_pool_push (state->pool, g_steal_pointer (&task), NULL);
+      return TRUE;
+    }
+
+  return pv_mtree_verify_contents (state, task, error);
+}
+
 static gboolean
 pv_mtree_foreach_verify_cb (PvMtreeEntry *entry,
                             PvMtreeApplyFlags flags,
@@ -1060,32 +2353,6 @@ pv_mtree_foreach_verify_cb (PvMtreeEntry *entry,
                              name, state->sysroot, entry->size,
                              (gint64) stat_buf.st_size);
 
-        if (entry->sha256 != NULL)
-          {
-            g_autoptr(GChecksum) hasher = g_checksum_new (G_CHECKSUM_SHA256);
-            char buf[4096];
-            ssize_t n = 0;
-
-            do
-              {
-                n = TEMP_FAILURE_RETRY (read (fd, buf, sizeof (buf)));
-
-                if (n < 0)
-                  return glnx_throw_errno_prefix (error,
-                                                  "Unable to read \"%s\" in \"%s\"",
-                                                  name, state->sysroot);
-
-                if (n > 0)
-                  g_checksum_update (hasher, (void *) buf, n);
-              }
-            while (n > 0);
-
-            if (!g_str_equal (g_checksum_get_string (hasher), entry->sha256))
-              return glnx_throw (error,
-                                 "\"%s\" in \"%s\" did not have expected contents",
-                                 name, state->sysroot);
-          }
-
         break;
 
       case PV_MTREE_ENTRY_KIND_DIR:
@@ -1116,7 +2383,15 @@ pv_mtree_foreach_verify_cb (PvMtreeEntry *entry,
 
   if (!(flags & PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME)
       && g_str_equal (base, "usr-mtree.txt.gz"))
-    g_ptr_array_add (state->runtimes, g_strdup (parent));
+    {
+      g_ptr_array_add (state->runtimes, g_strdup (parent));
+      g_hash_table_add (state->indexes, pv_mtree_get_index_path (name));
+    }
+
+  /* Do this last, because it might take ownership of @fd */
+  if (entry->kind == PV_MTREE_ENTRY_KIND_FILE && entry->sha256 != NULL)
+    return pv_mtree_verify_check_sha256 (state, &fd, &stat_buf,
+                                         name, entry->sha256, error);
 
   return TRUE;
 }
@@ -1132,190 +2407,239 @@ pv_mtree_foreach_verify_error_cb (PvMtreeEntry *entry,
   ForeachVerifyState *state = user_data;
 
   g_warning ("%s", error->message);
+  g_mutex_lock (state->lock);
   state->failed = TRUE;
+  g_mutex_unlock (state->lock);
 }
 
-/* nftw() doesn't have a user_data argument so we need to use a global variable */
-static ForeachVerifyState verify_state =
+/*
+ * Return %TRUE if @suffix is a binary index written by
+ * pv_mtree_write_index(), either for the manifest being verified or
+ * for a runtime's `usr-mtree.txt.gz` that we checked. These are
+ * generated locally, so they are not expected to be listed in the
+ * manifest. Anything else is treated as an unexpected file, even if
+ * its name ends with `.bin`.
+ *
+ * @dfd and @path locate the same file as @suffix, as for openat().
+ */
+static gboolean
+pv_mtree_verify_is_index (ForeachVerifyState *state,
+                          const char *suffix,
+                          int dfd,
+                          const char *path)
 {
-  .sysroot = NULL,
-  .sysroot_fd = -1,
-  .names = NULL,
-  .failed = FALSE
-};
-
-static int
-pv_mtree_verify_nftw_cb (const char *fpath,
-                         const struct stat *sb,
-                         int typeflag,
-                         struct FTW *ftwbuf)
+  char magic[sizeof (PV_MTREE_INDEX_MAGIC) - 1];
+  glnx_autofd int fd = -1;
+
+  if (!g_hash_table_contains (state->indexes, suffix))
+    return FALSE;
+
+  fd = openat (dfd, path, O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NOFOLLOW);
+
+  if (fd < 0)
+    return FALSE;
+
+  return (glnx_loop_read (fd, magic, sizeof (magic)) == sizeof (magic)
+          && memcmp (magic, PV_MTREE_INDEX_MAGIC, sizeof (magic)) == 0);
+}
+
+/*
+ * Check that every member of the directory @path relative to @dfd,
+ * which is @prefix relative to the sysroot (or "" for the sysroot
+ * itself), is listed in the manifest, and recurse into subdirectories.
+ * Anything unexpected is logged and sets @state's failed flag.
+ */
+static gboolean
+pv_mtree_verify_walk (ForeachVerifyState *state,
+                      int dfd,
+                      const char *path,
+                      const char *prefix,
+                      GError **error)
 {
-  ForeachVerifyState *state = &verify_state;
-  size_t len;
-  const char *suffix;
-  gpointer value;
+  g_auto(GLnxDirFdIterator) iter = { FALSE };
+
+  if (!glnx_dirfd_iterator_init_at (dfd, path, FALSE, &iter, error))
+    return FALSE;
 
-  if (!g_str_has_prefix (fpath, state->sysroot))
+  while (TRUE)
     {
-      g_critical ("\"%s\" should have started with \"%s\"",
-                  fpath, state->sysroot);
-      state->failed = TRUE;
-      return FTW_CONTINUE;
-    }
+      g_autofree gchar *suffix = NULL;
+      struct dirent *dent;
+      gpointer value;
 
-  len = strlen (state->sysroot);
+      if (!glnx_dirfd_iterator_next_dent_ensure_dtype (&iter, &dent, NULL, error))
+        return glnx_prefix_error (error, "Unable to list \"%s/%s\"",
+                                  state->sysroot, prefix);
 
-  if (fpath[len] == '\0')
-    return FTW_CONTINUE;
+      if (dent == NULL)
+        break;
 
-  g_return_val_if_fail (fpath[len] == '/', 1);
-  suffix = &fpath[len + 1];
+      /* If sysroot was /path/to/source and this is
+       * /path/to/source/foo/bar, then suffix is foo/bar. */
+      if (prefix[0] == '\0')
+        suffix = g_strdup (dent->d_name);
+      else
+        suffix = g_build_filename (prefix, dent->d_name, NULL);
 
-  while (suffix[0] == '/')
-    suffix++;
+      if (g_hash_table_lookup_extended (state->names, suffix, NULL, &value))
+        {
+          PvMtreeEntryFlags entry_flags = GPOINTER_TO_INT (value);
+          g_autoptr(GError) local_error = NULL;
 
-  /* If sysroot was /path/to/source and fpath was /path/to/source/foo/bar,
-   * then suffix is now foo/bar. */
+          trace ("Found \"%s\" in real directory hierarchy", suffix);
 
-  if (g_hash_table_lookup_extended (state->names, suffix, NULL, &value))
-    {
-      PvMtreeEntryFlags entry_flags = GPOINTER_TO_INT (value);
+          if (dent->d_type != DT_DIR)
+            continue;
 
-      trace ("Found \"%s\" in real directory hierarchy", suffix);
+          if (entry_flags & PV_MTREE_ENTRY_FLAGS_IGNORE_BELOW)
+            {
+              trace ("Ignoring contents of \"%s\" due to ignore flag", suffix);
+              continue;
+            }
 
-      if (typeflag == FTW_D
-          && (entry_flags & PV_MTREE_ENTRY_FLAGS_IGNORE_BELOW))
+          if (!pv_mtree_verify_walk (state, iter.fd, dent->d_name, suffix,
+                                     &local_error))
+            {
+              /* If we can't read a directory, we can't check its
+               * contents, but anything wrong with the directory itself
+               * was already reported */
+              trace ("%s", local_error->message);
+            }
+        }
+      else if (dent->d_type == DT_REG
+               && pv_mtree_verify_is_index (state, suffix, iter.fd, dent->d_name))
         {
-          trace ("Ignoring contents of \"%s\" due to ignore flag", suffix);
-          return FTW_SKIP_SUBTREE;
+          trace ("Ignoring binary index \"%s\"", suffix);
         }
-    }
-  else
-    {
-      const char *label;
-
-      switch (typeflag)
+      else
         {
-          case FTW_D:
-          case FTW_DP:
-          case FTW_DNR:
-            label = "directory";
-            break;
+          const char *label;
 
-          case FTW_F:
-            label = "regular file";
-            break;
+          switch (dent->d_type)
+            {
+              case DT_DIR:
+                label = "directory";
+                break;
 
-          case FTW_SL:
-          case FTW_SLN:
-            label = "symbolic link";
-            break;
+              case DT_REG:
+                label = "regular file";
+                break;
 
-          case FTW_NS:
-          default:
-            label = "filesystem object";
-            break;
-        }
+              case DT_LNK:
+                label = "symbolic link";
+                break;
 
-      g_warning ("%s \"%s\" in \"%s\" not found in manifest",
-                 label, suffix, state->sysroot);
-      state->failed = TRUE;
+              default:
+                label = "filesystem object";
+                break;
+            }
 
-      if (typeflag == FTW_D)
-        return FTW_SKIP_SUBTREE;
+          g_warning ("%s \"%s\" in \"%s\" not found in manifest",
+                     label, suffix, state->sysroot);
+          state->failed = TRUE;
+        }
     }
 
-  return FTW_CONTINUE;
+  return TRUE;
 }
 
-/*
- * pv_mtree_verify:
- * @mtree: (type filename): Path to a mtree(5) manifest
- * @sysroot: (type filename): A directory
- * @sysroot_fd: A fd opened on @sysroot
- * @source_files: (optional): A directory from which files will be
- *  hard-linked or copied when populating @sysroot. The `content`
- *  or filename in @mtree is taken to be relative to @source_files.
- * @flags: Flags affecting how this is done
- *
- * Check that the container root filesystem @sysroot conforms to @mtree.
- *
- * @mtree must contain a subset of BSD mtree(5) syntax,
- * as for pv_mtree_apply().
- *
- * For regular files, we check the type, size and sha256, and if the mode
- * has any executable bits set, we check that the file is executable.
- * Other modes and the modification time are not currently checked.
- * Other checksums are not currently supported.
- *
- * For directories, we check the type and that the directory is executable.
- *
- * For symbolic links, we check the type and target.
- *
- * Other file types are not currently supported.
- *
- * The `ignore` and `optional` flags are also supported.
- *
- * If a directory contains both `files` and `usr-mtree.txt.gz`,
- * we verify that `files` contains all of the content necessary to
- * reconstitute the tree described by `usr-mtree.txt.gz`.
- *
- * Returns: %TRUE on success
- */
-gboolean
-pv_mtree_verify (const char *mtree,
-                 const char *sysroot,
-                 int sysroot_fd,
-                 PvMtreeApplyFlags flags,
-                 GError **error)
+static gboolean
+pv_mtree_verify_internal (const char *mtree,
+                          const char *sysroot,
+                          int sysroot_fd,
+                          PvMtreeApplyFlags flags,
+                          VerifyCache *cache,
+                          PvMtreeVerifyStats *stats,
+                          GError **error)
 {
   g_autoptr(SrtProfilingTimer) timer = NULL;
   g_autoptr(GError) local_error = NULL;
   g_autoptr(GHashTable) names = NULL;
+  g_autoptr(GHashTable) indexes = NULL;
   g_autoptr(GPtrArray) runtimes = NULL;
   g_autofree gchar *canonicalized_sysroot = NULL;
+  g_autofree gchar *canonicalized_index = NULL;
+  g_autofree gchar *index = NULL;
+  ForeachVerifyState state = {};
+  GMutex lock;
+  GCond cond;
   int res = -1;
   gsize i;
 
-  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-  g_return_val_if_fail (mtree != NULL, FALSE);
-  g_return_val_if_fail (sysroot != NULL, FALSE);
-  g_return_val_if_fail (sysroot_fd >= 0, FALSE);
-  /* Can't run concurrently */
-  g_return_val_if_fail (verify_state.sysroot == NULL, FALSE);
-
   timer = _srt_profiling_start ("Verify %s against %s", sysroot, mtree);
-  g_info ("Verifying \"%s\" against \"%s\"...", sysroot, mtree);
 
   names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  indexes = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
   if (!(flags & PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME))
     runtimes = g_ptr_array_new_full (1, g_free);
 
+  g_mutex_init (&lock);
+  g_cond_init (&cond);
+
   canonicalized_sysroot = flatpak_canonicalize_filename (sysroot);
-  verify_state.sysroot = canonicalized_sysroot;
-  verify_state.sysroot_fd = sysroot_fd;
-  verify_state.names = names;
-  verify_state.runtimes = runtimes;
-  verify_state.failed = FALSE;
+  index = pv_mtree_get_index_path (mtree);
+  canonicalized_index = flatpak_canonicalize_filename (index);
+
+  if (g_str_has_prefix (canonicalized_index, canonicalized_sysroot)
+      && canonicalized_index[strlen (canonicalized_sysroot)] == '/')
+    {
+      const char *own_index = &canonicalized_index[strlen (canonicalized_sysroot)];
+
+      while (own_index[0] == '/')
+        own_index++;
+
+      g_hash_table_add (indexes, g_strdup (own_index));
+    }
+
+  state.sysroot = canonicalized_sysroot;
+  state.sysroot_fd = sysroot_fd;
+  state.indexes = indexes;
+  state.names = names;
+  state.runtimes = runtimes;
+  state.failed = FALSE;
+  state.lock = &lock;
+  state.cond = &cond;
+  state.in_flight = 0;
+  state.cache = cache;
+  state.stats = stats;
+
+  if (flags & PV_MTREE_APPLY_FLAGS_PARALLEL)
+    {
+      guint n_threads = CLAMP (g_get_num_processors (), 1, VERIFY_MAX_THREADS);
+
+      /* Not exclusive, so this cannot fail */
+      state.pool = g_thread_pool_new (pv_mtree_verify_worker, &state,
+                                      n_threads, FALSE, NULL);
+      g_info ("Verifying \"%s\" against \"%s\" with %u threads...",
+              sysroot, mtree, n_threads);
+    }
+  else
+    {
+      g_info ("Verifying \"%s\" against \"%s\"...", sysroot, mtree);
+    }
 
   if (pv_mtree_foreach (mtree, flags,
-                        pv_mtree_foreach_verify_cb, &verify_state,
-                        pv_mtree_foreach_verify_error_cb, &verify_state,
+                        pv_mtree_foreach_verify_cb, &state,
+                        pv_mtree_foreach_verify_error_cb, &state,
                         &local_error))
     {
-      res = nftw (verify_state.sysroot, pv_mtree_verify_nftw_cb, 100,
-                  FTW_PHYS | FTW_ACTIONRETVAL);
+      /* Wait for all queued files to be hashed */
+      if (state.pool != NULL)
+        g_thread_pool_free (g_steal_pointer (&state.pool), FALSE, TRUE);
+
+      if (pv_mtree_verify_walk (&state, sysroot_fd, ".", "", &local_error))
+        res = 0;
 
-      if (verify_state.failed)
+      if (state.failed)
         res = -1;
     }
 
-  verify_state.sysroot = NULL;
-  verify_state.sysroot_fd = -1;
-  verify_state.names = NULL;
-  verify_state.runtimes = NULL;
-  verify_state.failed = FALSE;
+  if (state.pool != NULL)
+    g_thread_pool_free (g_steal_pointer (&state.pool), FALSE, TRUE);
+
+  g_cond_clear (&cond);
+  g_mutex_clear (&lock);
 
   if (runtimes != NULL)
     {
@@ -1336,9 +2660,11 @@ pv_mtree_verify (const char *mtree,
                                                 NULL, &runtime_error);
 
           if (runtime_fd < 0
-              || !pv_mtree_verify (runtime_mtree, runtime_files, runtime_fd,
-                                   flags | PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME,
-                                   &runtime_error))
+              || !pv_mtree_verify_internal (runtime_mtree, runtime_files,
+                                            runtime_fd,
+                                            flags | PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME,
+                                            cache, stats,
+                                            &runtime_error))
             {
               g_assert (runtime_error != NULL);
               g_warning ("%s", runtime_error->message);
@@ -1363,6 +2689,96 @@ pv_mtree_verify (const char *mtree,
   return TRUE;
 }
 
+/*
+ * pv_mtree_verify:
+ * @mtree: (type filename): Path to a mtree(5) manifest
+ * @sysroot: (type filename): A directory
+ * @sysroot_fd: A fd opened on @sysroot
+ * @cache: (type filename) (nullable): A file in which to remember
+ *  which regular files were successfully verified, or %NULL
+ * @flags: Flags affecting how this is done
+ * @stats_out: (out caller-allocates) (optional): Used to return how much
+ *  data was hashed or skipped
+ *
+ * Check that the container root filesystem @sysroot conforms to @mtree.
+ *
+ * @mtree must contain a subset of BSD mtree(5) syntax,
+ * as for pv_mtree_apply().
+ *
+ * For regular files, we check the type, size and sha256, and if the mode
+ * has any executable bits set, we check that the file is executable.
+ * Other modes and the modification time are not currently checked.
+ * Other checksums are not currently supported.
+ *
+ * For directories, we check the type and that the directory is executable.
+ *
+ * For symbolic links, we check the type and target.
+ *
+ * Other file types are not currently supported.
+ *
+ * The `ignore` and `optional` flags are also supported.
+ *
+ * Binary indexes written by pv_mtree_write_index() for @mtree, or for
+ * a manifest listed in @mtree, are not expected to be listed in @mtree
+ * and are ignored.
+ *
+ * If a directory contains both `files` and `usr-mtree.txt.gz`,
+ * we verify that `files` contains all of the content necessary to
+ * reconstitute the tree described by `usr-mtree.txt.gz`.
+ *
+ * If @flags contains %PV_MTREE_APPLY_FLAGS_PARALLEL, regular files are
+ * hashed by a pool of worker threads.
+ *
+ * If @cache is non-%NULL, regular files whose device, inode, size,
+ * modification time and change time are the same as when they were
+ * last successfully verified with the same @cache are assumed to still
+ * have the same contents, and are not hashed again. @cache is updated
+ * to describe the files that were verified.
+ *
+ * Returns: %TRUE on success
+ */
+gboolean
+pv_mtree_verify (const char *mtree,
+                 const char *sysroot,
+                 int sysroot_fd,
+                 const char *cache,
+                 PvMtreeApplyFlags flags,
+                 PvMtreeVerifyStats *stats_out,
+                 GError **error)
+{
+  PvMtreeVerifyStats stats = {};
+  VerifyCache verify_cache = {};
+  gboolean ret;
+
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail (mtree != NULL, FALSE);
+  g_return_val_if_fail (sysroot != NULL, FALSE);
+  g_return_val_if_fail (sysroot_fd >= 0, FALSE);
+
+  if (cache != NULL)
+    {
+      verify_cache_init (&verify_cache);
+      verify_cache_load (&verify_cache, cache);
+    }
+
+  ret = pv_mtree_verify_internal (mtree, sysroot, sysroot_fd, flags,
+                                  cache != NULL ? &verify_cache : NULL,
+                                  &stats, error);
+
+  /* Even if verification failed, the files that we did successfully
+   * hash are worth remembering */
+  if (cache != NULL)
+    {
+      verify_cache_save (&verify_cache, cache);
+      verify_cache_clear (&verify_cache);
+    }
+
+  if (stats_out != NULL)
+    *stats_out = stats;
+
+  return ret;
+}
+
 /*
  * Free the contents of @entry, but not @entry itself.
  */
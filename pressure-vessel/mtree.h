@@ -40,6 +40,9 @@
  *  to NTFS or FAT)
  * @PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME: When verifying, don't check for
  *  existence of files that can be created from the manifest
+ * @PV_MTREE_APPLY_FLAGS_PARALLEL: When applying, populate regular files
+ *  from a pool of worker threads; when verifying, hash regular files
+ *  in a pool of worker threads
  * @PV_MTREE_APPLY_FLAGS_NONE: None of the above
  *
  * Flags altering how a mtree manifest is applied to a directory tree.
@@ -50,6 +53,7 @@ typedef enum
   PV_MTREE_APPLY_FLAGS_EXPECT_HARD_LINKS = (1 << 1),
   PV_MTREE_APPLY_FLAGS_CHMOD_MAY_FAIL = (1 << 2),
   PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME = (1 << 3),
+  PV_MTREE_APPLY_FLAGS_PARALLEL = (1 << 4),
   PV_MTREE_APPLY_FLAGS_NONE = 0
 } PvMtreeApplyFlags;
 
@@ -119,8 +123,32 @@ gboolean pv_mtree_apply (const char *mtree,
                          const char *source_files,
                          PvMtreeApplyFlags flags,
                          GError **error);
+/*
+ * PvMtreeVerifyStats:
+ * @bytes_hashed: Total size of regular files that were hashed
+ * @bytes_skipped: Total size of regular files that were not hashed,
+ *  because they were unchanged since they were last verified
+ * @files_hashed: Number of regular files that were hashed
+ * @files_skipped: Number of regular files that were not hashed
+ */
+typedef struct
+{
+  guint64 bytes_hashed;
+  guint64 bytes_skipped;
+  guint64 files_hashed;
+  guint64 files_skipped;
+} PvMtreeVerifyStats;
+
 gboolean pv_mtree_verify (const char *mtree,
                           const char *sysroot,
                           int sysroot_fd,
+                          const char *cache,
                           PvMtreeApplyFlags flags,
+                          PvMtreeVerifyStats *stats_out,
                           GError **error);
+
+gchar *pv_mtree_get_index_path (const char *mtree);
+gboolean pv_mtree_write_index (const char *mtree,
+                               const char *index,
+                               PvMtreeApplyFlags flags,
+                               GError **error);
@@ -20,6 +20,8 @@
 #include "runtime.h"
 
 #include <sysexits.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 
 #include <gio/gio.h>
 
@@ -84,6 +86,24 @@
  */
 #define PV_ADVERB_WITHOUT_MUTABLE_SYSROOT PV_FROM_HOST_WITHOUT_MUTABLE_SYSROOT "/" PKGLIBEXECDIR "/pv-adverb"
 
+/*
+ * Prefix for the names of cached prepared runtimes in the variable
+ * directory, which are followed by a hex-encoded key
+ */
+#define PV_PREPARED_PREFIX "prepared-"
+/*
+ * Keyfile at the top level of a prepared runtime, written when setup
+ * has finished, recording what we need to reuse it
+ */
+#define PV_PREPARED_STATE "prepared.keyfile"
+#define PV_PREPARED_GROUP "Prepared"
+#define PV_PREPARED_ENV_GROUP "Environment"
+/*
+ * Maximum number of complete prepared runtimes to keep during
+ * garbage-collection, most recently used first
+ */
+#define PV_PREPARED_MAX_KEEP 4
+
 typedef struct
 {
   GCancellable *cancellable;
@@ -91,6 +111,26 @@ typedef struct
   SrtSystemInfo *system_info;
 } EnumerationThread;
 
+/*
+ * CaptureHelper:
+ * @pid: The process ID of capsule-capture-libs --batch, or 0 if not running
+ * @socket_fd: Our end of a socket connected to its stdin and stdout
+ * @overrides_fd_in_helper: The number of a file descriptor pointing to
+ *  the overrides directory in the helper process. It is not open in our
+ *  own process.
+ *
+ * A long-running capsule-capture-libs for one architecture, which
+ * receives all capture requests for that architecture, so that it only
+ * needs to load the ld.so.cache and library knowledge once.
+ * It must only be used by one thread at a time.
+ */
+typedef struct
+{
+  GPid pid;
+  int socket_fd;
+  int overrides_fd_in_helper;
+} CaptureHelper;
+
 /*
  * PvRuntime:
  *
@@ -112,6 +152,8 @@ struct _PvRuntime
   gchar *libcapsule_knowledge;  /* relative to runtime_files */
   gchar *runtime_abi_json;
   gchar *variable_dir;
+  gchar *prepared_key;          /* key for a cached prepared copy, or NULL */
+  GKeyFile *prepared;           /* non-NULL if reusing a prepared copy */
   SrtSysroot *mutable_sysroot;
   SrtSysroot *real_root;
   SrtSysroot *host_root;
@@ -133,6 +175,7 @@ struct _PvRuntime
   EnumerationThread *arch_host_threads;
 #endif
   EnumerationThread *arch_threads;
+  CaptureHelper capture_helpers[PV_N_SUPPORTED_ARCHITECTURES];
   SrtDirentCompareFunc arbitrary_dirent_order;
   GCompareFunc arbitrary_str_order;
 
@@ -742,6 +785,15 @@ static void pv_runtime_set_search_paths (PvRuntime *self,
 static void
 pv_runtime_init (PvRuntime *self)
 {
+  gsize i;
+
+  for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
+    {
+      self->capture_helpers[i].pid = 0;
+      self->capture_helpers[i].socket_fd = -1;
+      self->capture_helpers[i].overrides_fd_in_helper = -1;
+    }
+
   self->any_libc_from_provider = FALSE;
   self->all_libc_from_provider = FALSE;
   self->overrides_fd = -1;
@@ -959,13 +1011,49 @@ pv_runtime_maybe_garbage_collect_subdir (const char *description,
     }
 }
 
+typedef struct
+{
+  gchar *name;
+  /* Last time it was used, or -1 if setup was never completed */
+  gint64 last_used;
+} PreparedRuntime;
+
+static void
+prepared_runtime_free (gpointer p)
+{
+  PreparedRuntime *self = p;
+
+  g_free (self->name);
+  g_free (self);
+}
+
+/* Most recently used first */
+static int
+prepared_runtime_compare (gconstpointer a,
+                          gconstpointer b)
+{
+  const PreparedRuntime *left = *(const PreparedRuntime * const *) a;
+  const PreparedRuntime *right = *(const PreparedRuntime * const *) b;
+
+  if (left->last_used > right->last_used)
+    return -1;
+
+  if (left->last_used < right->last_used)
+    return 1;
+
+  return strcmp (left->name, right->name);
+}
+
 static gboolean
 pv_runtime_garbage_collect (PvRuntime *self,
                             SrtFileLock *variable_dir_lock,
                             GError **error)
 {
   g_auto(SrtDirIter) iter = SRT_DIR_ITER_CLEARED;
+  g_autoptr(GPtrArray) prepared = NULL;
   G_GNUC_UNUSED g_autoptr(SrtProfilingTimer) timer = NULL;
+  guint n_kept = 0;
+  guint i;
 
   g_return_val_if_fail (PV_IS_RUNTIME (self), FALSE);
   g_return_val_if_fail (self->variable_dir != NULL, FALSE);
@@ -984,6 +1072,8 @@ pv_runtime_garbage_collect (PvRuntime *self,
                               error))
     return FALSE;
 
+  prepared = g_ptr_array_new_with_free_func (prepared_runtime_free);
+
   while (TRUE)
     {
       struct dirent *dent;
@@ -1012,9 +1102,32 @@ pv_runtime_garbage_collect (PvRuntime *self,
             continue;
         }
 
+      if (g_str_has_prefix (dent->d_name, PV_PREPARED_PREFIX))
+        {
+          PreparedRuntime *p = g_new0 (PreparedRuntime, 1);
+          g_autofree gchar *state = g_build_filename (dent->d_name,
+                                                      PV_PREPARED_STATE,
+                                                      NULL);
+          struct stat stat_buf;
+
+          p->name = g_strdup (dent->d_name);
+
+          /* We touch the state file every time we reuse a prepared
+           * runtime, so its mtime is the last time it was used */
+          if (fstatat (self->variable_dir_fd, state, &stat_buf,
+                       AT_SYMLINK_NOFOLLOW) == 0)
+            p->last_used = (stat_buf.st_mtim.tv_sec * G_USEC_PER_SEC
+                            + stat_buf.st_mtim.tv_nsec / 1000);
+          else
+            p->last_used = -1;
+
+          g_ptr_array_add (prepared, p);
+          continue;
+        }
+
       if (!g_str_has_prefix (dent->d_name, "tmp-"))
         {
-          g_debug ("Ignoring %s/%s: not tmp-*",
+          g_debug ("Ignoring %s/%s: not tmp-* or " PV_PREPARED_PREFIX "*",
                    self->variable_dir, dent->d_name);
           continue;
         }
@@ -1025,6 +1138,28 @@ pv_runtime_garbage_collect (PvRuntime *self,
                                                dent->d_name);
     }
 
+  /* Keep the most recently used prepared runtimes, and treat the rest
+   * (including any that were never finished) like temporary runtimes */
+  g_ptr_array_sort (prepared, prepared_runtime_compare);
+
+  for (i = 0; i < prepared->len; i++)
+    {
+      const PreparedRuntime *p = g_ptr_array_index (prepared, i);
+
+      if (p->last_used >= 0 && n_kept < PV_PREPARED_MAX_KEEP)
+        {
+          g_debug ("Not deleting \"%s/%s\": recently used",
+                   self->variable_dir, p->name);
+          n_kept++;
+          continue;
+        }
+
+      pv_runtime_maybe_garbage_collect_subdir ("prepared runtime",
+                                               self->variable_dir,
+                                               self->variable_dir_fd,
+                                               p->name);
+    }
+
   return TRUE;
 }
 
@@ -1074,12 +1209,35 @@ pv_runtime_create_copy (PvRuntime *self,
 
   timer = _srt_profiling_start ("Temporary runtime copy");
 
-  temp_dir = g_build_filename (self->variable_dir, "tmp-XXXXXX", NULL);
+  if (self->prepared_key != NULL)
+    {
+      g_autofree gchar *name = g_strconcat (PV_PREPARED_PREFIX,
+                                            self->prepared_key, NULL);
 
-  if (g_mkdtemp (temp_dir) == NULL)
-    return glnx_throw_errno_prefix (error,
-                                    "Cannot create temporary directory \"%s\"",
-                                    temp_dir);
+      if (TEMP_FAILURE_RETRY (mkdirat (self->variable_dir_fd, name, 0700)) == 0)
+        {
+          temp_dir = g_build_filename (self->variable_dir, name, NULL);
+        }
+      else
+        {
+          /* Most likely another process is setting up the same prepared
+           * runtime right now, or an earlier attempt failed and has not
+           * been garbage-collected yet. Either way, don't cache ours. */
+          g_info ("Unable to create \"%s/%s\", not caching this runtime: %s",
+                  self->variable_dir, name, g_strerror (errno));
+          g_clear_pointer (&self->prepared_key, g_free);
+        }
+    }
+
+  if (temp_dir == NULL)
+    {
+      temp_dir = g_build_filename (self->variable_dir, "tmp-XXXXXX", NULL);
+
+      if (g_mkdtemp (temp_dir) == NULL)
+        return glnx_throw_errno_prefix (error,
+                                        "Cannot create temporary directory \"%s\"",
+                                        temp_dir);
+    }
 
   g_debug ("Using temporary mutable sysroot: \"%s\"", temp_dir);
   dest_usr = g_build_filename (temp_dir, "usr", NULL);
@@ -1123,7 +1281,8 @@ pv_runtime_create_copy (PvRuntime *self,
                                self->source_files,
                                (mtree_flags
                                 | PV_MTREE_APPLY_FLAGS_CHMOD_MAY_FAIL
-                                | PV_MTREE_APPLY_FLAGS_EXPECT_HARD_LINKS),
+                                | PV_MTREE_APPLY_FLAGS_EXPECT_HARD_LINKS
+                                | PV_MTREE_APPLY_FLAGS_PARALLEL),
                                error))
             return FALSE;
         }
@@ -1180,9 +1339,36 @@ pv_runtime_create_copy (PvRuntime *self,
    * runtime's /usr to Flatpak, which normally takes out a lock on
    * /usr/.ref (obviously this will only work if the runtime happens
    * to be merged-/usr). */
-  copy_lock = srt_file_lock_new (temp_dir_fd, "usr/.ref",
-                                 SRT_FILE_LOCK_FLAGS_CREATE,
-                                 error);
+  if (self->prepared_key != NULL)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      /* A prepared runtime is modified by each launch that uses it,
+       * so it must only be used by one launch at a time: take an
+       * exclusive lock, which pv_runtime_reuse_prepared_copy() will
+       * respect. It must be an OFD lock so that it can be passed to
+       * the container without a gap during which it is not held. */
+      copy_lock = srt_file_lock_new (temp_dir_fd, "usr/.ref",
+                                     (SRT_FILE_LOCK_FLAGS_CREATE
+                                      | SRT_FILE_LOCK_FLAGS_EXCLUSIVE
+                                      | SRT_FILE_LOCK_FLAGS_REQUIRE_OFD),
+                                     &local_error);
+
+      if (copy_lock == NULL)
+        {
+          /* It will not be marked as complete, so it will never be
+           * reused, and garbage-collection will delete it */
+          g_info ("Unable to lock \"%s/.ref\" exclusively, not caching "
+                  "this runtime: %s",
+                  dest_usr, local_error->message);
+          g_clear_pointer (&self->prepared_key, g_free);
+        }
+    }
+
+  if (copy_lock == NULL)
+    copy_lock = srt_file_lock_new (temp_dir_fd, "usr/.ref",
+                                   SRT_FILE_LOCK_FLAGS_CREATE,
+                                   error);
 
   if (copy_lock == NULL)
     return glnx_prefix_error (error,
@@ -1240,14 +1426,598 @@ pv_runtime_create_copy (PvRuntime *self,
         }
     }
 
-  /* Hand over from holding a lock on the source to just holding a lock
-   * on the copy. We'll release source_lock when we leave this scope */
-  source_lock = g_steal_pointer (&self->runtime_lock);
-  self->runtime_lock = g_steal_pointer (&copy_lock);
-  self->mutable_sysroot = _srt_sysroot_new_take (g_steal_pointer (&temp_dir),
-                                                 g_steal_fd (&temp_dir_fd));
+  /* Hand over from holding a lock on the source to just holding a lock
+   * on the copy. We'll release source_lock when we leave this scope */
+  source_lock = g_steal_pointer (&self->runtime_lock);
+  self->runtime_lock = g_steal_pointer (&copy_lock);
+  self->mutable_sysroot = _srt_sysroot_new_take (g_steal_pointer (&temp_dir),
+                                                 g_steal_fd (&temp_dir_fd));
+
+  return TRUE;
+}
+
+/*
+ * Environment variables that can affect which libraries, drivers and
+ * manifests pv_runtime_use_provider_graphics_stack() puts into the
+ * runtime. Changing any of these invalidates prepared runtimes.
+ *
+ * This is deliberately an explicit list rather than a set of prefixes,
+ * because variables like XDG_SESSION_ID or PRESSURE_VESSEL_TRACE_FILE
+ * change on every launch and would prevent any reuse.
+ * pressure-vessel's own options are covered by the runtime flags,
+ * source and graphics provider instead.
+ */
+static const char * const prepared_key_env_vars[] =
+{
+  "HOME",
+  "LD_LIBRARY_PATH",
+  "LIBGL_DRIVERS_PATH",
+  "LIBVA_DRIVERS_PATH",
+  "VDPAU_DRIVER_PATH",
+  "VK_ADD_DRIVER_FILES",
+  "VK_ADD_LAYER_PATH",
+  "VK_DRIVER_FILES",
+  "VK_ICD_FILENAMES",
+  "VK_LAYER_PATH",
+  "XDG_CONFIG_DIRS",
+  "XDG_CONFIG_HOME",
+  "XDG_DATA_DIRS",
+  "XDG_DATA_HOME",
+  "XR_API_LAYER_PATH",
+  "XR_RUNTIME_JSON",
+  "XR_RUNTIME_PATH",
+  "__EGL_EXTERNAL_PLATFORM_CONFIG_DIRS",
+  "__EGL_EXTERNAL_PLATFORM_CONFIG_FILENAMES",
+  "__EGL_VENDOR_LIBRARY_DIRS",
+  "__EGL_VENDOR_LIBRARY_FILENAMES",
+};
+
+/*
+ * Environment variables that pv_runtime_use_provider_graphics_stack()
+ * can set or unset, which are recorded in a prepared runtime so that
+ * they can be replayed when it is reused.
+ */
+static const char * const prepared_env_vars[] =
+{
+  "LIBGL_DRIVERS_PATH",
+  "LIBVA_DRIVERS_PATH",
+  "VDPAU_DRIVER_PATH",
+  "VK_ADD_DRIVER_FILES",
+  "VK_DRIVER_FILES",
+  "VK_ICD_FILENAMES",
+  "VK_LAYER_PATH",
+  "XDG_CONFIG_DIRS",
+  "XDG_DATA_DIRS",
+  "XR_RUNTIME_PATH",
+  "__EGL_EXTERNAL_PLATFORM_CONFIG_DIRS",
+  "__EGL_EXTERNAL_PLATFORM_CONFIG_FILENAMES",
+  "__EGL_VENDOR_LIBRARY_DIRS",
+  "__EGL_VENDOR_LIBRARY_FILENAMES",
+};
+
+/*
+ * Paths in the graphics provider whose identity is included in the key
+ * for a prepared runtime. Installing, removing or upgrading a library or
+ * driver with a package manager creates or renames a file, which changes
+ * the modification time of the directory containing it, and running
+ * ldconfig replaces ld.so.cache.
+ *
+ * This does not detect a library being overwritten in-place without
+ * changing its directory, or changes to libraries in directories that
+ * are not listed here or in LD_LIBRARY_PATH (for example a directory
+ * listed in ld.so.conf.d): running ldconfig after such a change is
+ * enough to invalidate prepared runtimes, because it replaces
+ * ld.so.cache.
+ */
+static const char * const prepared_key_provider_paths[] =
+{
+  "etc/drirc",
+  "etc/egl/egl_external_platform.d",
+  "etc/glvnd/egl_vendor.d",
+  "etc/ld.so.cache",
+  "etc/ld.so.conf",
+  "etc/ld.so.conf.d",
+  "etc/vulkan/icd.d",
+  "etc/vulkan/explicit_layer.d",
+  "etc/vulkan/implicit_layer.d",
+  "lib",
+  "lib32",
+  "lib64",
+  "usr/lib",
+  "usr/lib32",
+  "usr/lib64",
+  "usr/lib/locale",
+  "usr/share/drirc.d",
+  "usr/share/egl/egl_external_platform.d",
+  "usr/share/glvnd/egl_vendor.d",
+  "usr/share/vulkan/explicit_layer.d",
+  "usr/share/vulkan/icd.d",
+  "usr/share/vulkan/implicit_layer.d",
+};
+
+/* Subdirectories of the provider's usr/lib/${tuple} */
+static const char * const prepared_key_provider_arch_subdirs[] =
+{
+  "dri",
+  "gconv",
+  "vdpau",
+};
+
+static void
+prepared_key_add_stat (GChecksum *hasher,
+                       const char *label,
+                       const struct stat *stat_buf)
+{
+  g_autofree gchar *line = NULL;
+
+  if (stat_buf != NULL)
+    line = g_strdup_printf ("%s\t%" G_GUINT64_FORMAT ":%" G_GUINT64_FORMAT
+                            "\t%" G_GINT64_FORMAT
+                            "\t%" G_GINT64_FORMAT ".%09ld"
+                            "\t%" G_GINT64_FORMAT ".%09ld\n",
+                            label,
+                            (guint64) stat_buf->st_dev,
+                            (guint64) stat_buf->st_ino,
+                            (gint64) stat_buf->st_size,
+                            (gint64) stat_buf->st_mtim.tv_sec,
+                            (long) stat_buf->st_mtim.tv_nsec,
+                            (gint64) stat_buf->st_ctim.tv_sec,
+                            (long) stat_buf->st_ctim.tv_nsec);
+  else
+    line = g_strdup_printf ("%s\t-\n", label);
+
+  g_checksum_update (hasher, (const guchar *) line, -1);
+}
+
+/*
+ * Add the identity of @path in @sysroot to @hasher, so that the key
+ * changes if it is replaced or modified.
+ */
+static void
+prepared_key_add_sysroot_path (GChecksum *hasher,
+                               SrtSysroot *sysroot,
+                               const char *path)
+{
+  glnx_autofd int fd = -1;
+  struct stat stat_buf;
+
+  fd = _srt_sysroot_open (sysroot, path, SRT_RESOLVE_FLAGS_NONE, NULL, NULL);
+
+  if (fd >= 0 && fstat (fd, &stat_buf) == 0)
+    prepared_key_add_stat (hasher, path, &stat_buf);
+  else
+    prepared_key_add_stat (hasher, path, NULL);
+}
+
+static void
+prepared_key_add_path (GChecksum *hasher,
+                       const char *path)
+{
+  struct stat stat_buf;
+
+  if (stat (path, &stat_buf) == 0)
+    prepared_key_add_stat (hasher, path, &stat_buf);
+  else
+    prepared_key_add_stat (hasher, path, NULL);
+}
+
+static void
+prepared_key_add_string (GChecksum *hasher,
+                         const char *label,
+                         const char *value)
+{
+  g_autofree gchar *line = NULL;
+
+  if (value != NULL)
+    line = g_strdup_printf ("%s=%s\n", label, value);
+  else
+    line = g_strdup_printf ("%s unset\n", label);
+
+  /* Include the terminating \0 so that values containing newlines
+   * can't collide with a different sequence of values */
+  g_checksum_update (hasher, (const guchar *) line, strlen (line) + 1);
+}
+
+static gboolean
+prepared_key_add_file_contents (GChecksum *hasher,
+                                const char *path,
+                                GError **error)
+{
+  g_autofree guchar *buf = g_malloc (65536);
+  glnx_autofd int fd = -1;
+
+  if (!glnx_openat_rdonly (AT_FDCWD, path, TRUE, &fd, error))
+    return FALSE;
+
+  while (TRUE)
+    {
+      ssize_t n = TEMP_FAILURE_RETRY (read (fd, buf, 65536));
+
+      if (n < 0)
+        return glnx_throw_errno_prefix (error, "Unable to read \"%s\"", path);
+
+      if (n == 0)
+        break;
+
+      g_checksum_update (hasher, buf, n);
+    }
+
+  return TRUE;
+}
+
+/*
+ * pv_runtime_compute_prepared_key:
+ * @self: The runtime
+ * @usr_mtree: (nullable): The runtime's /usr manifest, if any
+ *
+ * Compute a key for a fully set up copy of the runtime, which changes
+ * whenever anything that could affect the result of setting it up
+ * changes: the runtime itself, the libraries and drivers in the graphics
+ * provider, the flags, the architectures, the environment variables
+ * listed in prepared_key_env_vars and pressure-vessel itself.
+ *
+ * Libraries and drivers are detected by the identity of the directories
+ * that contain them and of ld.so.cache, as described for
+ * prepared_key_provider_paths, and not by their contents.
+ *
+ * Returns: (transfer full): A hex-encoded key, or %NULL if this
+ *  runtime cannot be cached
+ */
+static gchar *
+pv_runtime_compute_prepared_key (PvRuntime *self,
+                                 const char *usr_mtree)
+{
+  g_autoptr(GChecksum) hasher = g_checksum_new (G_CHECKSUM_SHA256);
+  g_autoptr(GError) local_error = NULL;
+  g_auto(GStrv) library_path = NULL;
+  const char *value;
+  g_autofree gchar *adverb = NULL;
+  g_autofree gchar *flags = NULL;
+  G_GNUC_UNUSED g_autoptr(SrtProfilingTimer) timer = NULL;
+  gsize i, j;
+
+  g_return_val_if_fail (PV_IS_RUNTIME (self), NULL);
+  g_return_val_if_fail (self->provider != NULL, NULL);
+
+  timer = _srt_profiling_start ("Computing key for prepared runtime");
+
+  /* Bump this if the layout of prepared runtimes changes */
+  prepared_key_add_string (hasher, "format", "2");
+
+  prepared_key_add_string (hasher, "version", VERSION);
+  prepared_key_add_string (hasher, "prefix", self->pv_prefix);
+  adverb = g_build_filename (self->helpers_path, "pv-adverb", NULL);
+  prepared_key_add_path (hasher, adverb);
+
+  prepared_key_add_string (hasher, "source", self->source_files);
+
+  if (usr_mtree != NULL)
+    {
+      prepared_key_add_string (hasher, "mtree", usr_mtree);
+
+      if (!prepared_key_add_file_contents (hasher, usr_mtree, &local_error))
+        {
+          g_info ("Not caching prepared runtime: %s", local_error->message);
+          return NULL;
+        }
+    }
+  else
+    {
+      /* Without a manifest, we can only assume that a runtime is
+       * replaced rather than being modified in-place */
+      prepared_key_add_path (hasher, self->source);
+      prepared_key_add_path (hasher, self->source_files);
+    }
+
+  /* Flags that don't affect the result are excluded */
+  flags = g_strdup_printf ("0x%x 0x%x",
+                           (unsigned) (self->flags
+                                       & ~(PV_RUNTIME_FLAGS_GC_RUNTIMES
+                                           | PV_RUNTIME_FLAGS_VERBOSE)),
+                           (unsigned) self->workarounds);
+  prepared_key_add_string (hasher, "flags", flags);
+
+  for (i = 0; pv_multiarch_tuples[i] != NULL; i++)
+    prepared_key_add_string (hasher, "arch", pv_multiarch_tuples[i]);
+
+  prepared_key_add_string (hasher, "provider",
+                           self->provider->in_current_ns->path);
+  prepared_key_add_string (hasher, "provider in container",
+                           self->provider->path_in_container_ns);
+
+  for (i = 0; i < G_N_ELEMENTS (prepared_key_provider_paths); i++)
+    prepared_key_add_sysroot_path (hasher, self->provider->in_current_ns,
+                                   prepared_key_provider_paths[i]);
+
+  for (i = 0; pv_multiarch_tuples[i] != NULL; i++)
+    {
+      g_autofree gchar *lib = g_build_filename ("lib", pv_multiarch_tuples[i],
+                                                NULL);
+      g_autofree gchar *usr_lib = g_build_filename ("usr", "lib",
+                                                    pv_multiarch_tuples[i],
+                                                    NULL);
+
+      prepared_key_add_sysroot_path (hasher, self->provider->in_current_ns,
+                                     lib);
+      prepared_key_add_sysroot_path (hasher, self->provider->in_current_ns,
+                                     usr_lib);
+
+      for (j = 0; j < G_N_ELEMENTS (prepared_key_provider_arch_subdirs); j++)
+        {
+          g_autofree gchar *path = NULL;
+
+          path = g_build_filename (usr_lib,
+                                   prepared_key_provider_arch_subdirs[j],
+                                   NULL);
+          prepared_key_add_sysroot_path (hasher, self->provider->in_current_ns,
+                                         path);
+        }
+    }
+
+  for (i = 0; i < G_N_ELEMENTS (prepared_key_env_vars); i++)
+    prepared_key_add_string (hasher, prepared_key_env_vars[i],
+                             g_environ_getenv (self->original_environ,
+                                               prepared_key_env_vars[i]));
+
+  /* Libraries found via LD_LIBRARY_PATH are captured in preference to
+   * the ones in ld.so.cache, so treat those directories like the
+   * provider's library directories */
+  value = g_environ_getenv (self->original_environ, "LD_LIBRARY_PATH");
+
+  if (value != NULL)
+    library_path = g_strsplit (value, ":", -1);
+
+  for (i = 0; library_path != NULL && library_path[i] != NULL; i++)
+    {
+      if (library_path[i][0] != '\0')
+        prepared_key_add_path (hasher, library_path[i]);
+    }
+
+  return g_strdup (g_checksum_get_string (hasher));
+}
+
+/*
+ * pv_runtime_reuse_prepared_copy:
+ * @self: The runtime
+ * @variable_dir_lock: A lock on the variable directory
+ *
+ * If there is a complete prepared runtime matching self->prepared_key,
+ * lock it and use it as the mutable sysroot.
+ *
+ * Returns: %TRUE if a prepared runtime is being reused
+ */
+static gboolean
+pv_runtime_reuse_prepared_copy (PvRuntime *self,
+                                SrtFileLock *variable_dir_lock)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(GKeyFile) state = NULL;
+  g_autoptr(SrtFileLock) copy_lock = NULL;
+  G_GNUC_UNUSED g_autoptr(SrtFileLock) source_lock = NULL;
+  g_autofree gchar *name = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *key = NULL;
+  glnx_autofd int dir_fd = -1;
+  gsize len;
+
+  g_return_val_if_fail (PV_IS_RUNTIME (self), FALSE);
+  g_return_val_if_fail (self->variable_dir_fd >= 0, FALSE);
+  g_return_val_if_fail (self->prepared_key != NULL, FALSE);
+  g_return_val_if_fail (self->mutable_sysroot == NULL, FALSE);
+  /* We don't actually *use* this: it just acts as an assertion that
+   * we are holding the lock on the parent directory. */
+  g_return_val_if_fail (variable_dir_lock != NULL, FALSE);
+
+  name = g_strconcat (PV_PREPARED_PREFIX, self->prepared_key, NULL);
+  path = g_build_filename (self->variable_dir, name, NULL);
+
+  if (!glnx_opendirat (self->variable_dir_fd, name, FALSE, &dir_fd,
+                       &local_error))
+    {
+      g_debug ("No prepared runtime \"%s\": %s", path, local_error->message);
+      return FALSE;
+    }
+
+  contents = glnx_file_get_contents_utf8_at (dir_fd, PV_PREPARED_STATE,
+                                             &len, NULL, &local_error);
+
+  if (contents == NULL)
+    {
+      /* Either it is still being set up by another process, or setup
+       * failed; either way, we can't use it */
+      g_info ("Not reusing incomplete prepared runtime \"%s\": %s",
+              path, local_error->message);
+      return FALSE;
+    }
+
+  state = g_key_file_new ();
+
+  if (!g_key_file_load_from_data (state, contents, len, G_KEY_FILE_NONE,
+                                  &local_error))
+    {
+      g_warning ("Not reusing prepared runtime \"%s\": %s",
+                 path, local_error->message);
+      return FALSE;
+    }
+
+  key = g_key_file_get_string (state, PV_PREPARED_GROUP, "Key", NULL);
+
+  if (g_strcmp0 (key, self->prepared_key) != 0)
+    {
+      g_warning ("Not reusing prepared runtime \"%s\": key mismatch", path);
+      return FALSE;
+    }
+
+  /* Take the same exclusive lock as pv_runtime_create_copy(), without
+   * waiting. This prevents garbage-collection from deleting it while
+   * it's in use, and prevents concurrent launches from modifying it
+   * while we are using it: if another launch is using it, we make
+   * a new temporary copy instead. */
+  copy_lock = srt_file_lock_new (dir_fd, "usr/.ref",
+                                 (SRT_FILE_LOCK_FLAGS_CREATE
+                                  | SRT_FILE_LOCK_FLAGS_EXCLUSIVE
+                                  | SRT_FILE_LOCK_FLAGS_REQUIRE_OFD),
+                                 &local_error);
+
+  if (copy_lock == NULL)
+    {
+      g_info ("Not reusing prepared runtime \"%s\", probably in use "
+              "by another launch: %s",
+              path, local_error->message);
+      return FALSE;
+    }
+
+  /* Record that it was recently used, for garbage-collection */
+  if (TEMP_FAILURE_RETRY (utimensat (dir_fd, PV_PREPARED_STATE, NULL, 0)) != 0)
+    g_debug ("Unable to update timestamp of \"%s/%s\": %s",
+             path, PV_PREPARED_STATE, g_strerror (errno));
+
+  g_info ("Reusing prepared runtime \"%s\"", path);
+
+  /* Hand over from holding a lock on the source to just holding a lock
+   * on the copy, as in pv_runtime_create_copy() */
+  source_lock = g_steal_pointer (&self->runtime_lock);
+  self->runtime_lock = g_steal_pointer (&copy_lock);
+  self->mutable_sysroot = _srt_sysroot_new_take (g_steal_pointer (&path),
+                                                 g_steal_fd (&dir_fd));
+  self->prepared = g_steal_pointer (&state);
+  return TRUE;
+}
+
+/*
+ * Return how @var is set in @container_env, in the form stored in
+ * prepared.keyfile: "=VALUE" if set, "!" if unset, or "" if
+ * @container_env does not affect it.
+ */
+static gchar *
+prepared_env_encode (SrtEnvOverlay *container_env,
+                     const char *var)
+{
+  const char *value;
+
+  if (!_srt_env_overlay_contains (container_env, var))
+    return g_strdup ("");
+
+  value = _srt_env_overlay_get (container_env, var);
+
+  /* Distinguish between unset and set to the empty string */
+  if (value == NULL)
+    return g_strdup ("!");
+
+  return g_strconcat ("=", value, NULL);
+}
+
+/*
+ * Return how each of prepared_env_vars[] is set in @container_env,
+ * in the same order.
+ */
+static GStrv
+prepared_env_snapshot (SrtEnvOverlay *container_env)
+{
+  GStrv snapshot = g_new0 (gchar *, G_N_ELEMENTS (prepared_env_vars) + 1);
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (prepared_env_vars); i++)
+    snapshot[i] = prepared_env_encode (container_env, prepared_env_vars[i]);
+
+  return snapshot;
+}
+
+/*
+ * Record the changes between @before (as returned by
+ * prepared_env_snapshot()) and @container_env in @state.
+ */
+static void
+prepared_env_record (GKeyFile *state,
+                     gchar **before,
+                     SrtEnvOverlay *container_env)
+{
+  gsize i;
+
+  for (i = 0; i < G_N_ELEMENTS (prepared_env_vars); i++)
+    {
+      g_autofree gchar *after = prepared_env_encode (container_env,
+                                                     prepared_env_vars[i]);
+
+      if (after[0] != '\0' && strcmp (before[i], after) != 0)
+        g_key_file_set_string (state, PV_PREPARED_ENV_GROUP,
+                               prepared_env_vars[i], after);
+    }
+}
+
+/*
+ * Mark the mutable sysroot as a complete prepared runtime that can
+ * be reused by pv_runtime_reuse_prepared_copy().
+ */
+static gboolean
+pv_runtime_save_prepared (PvRuntime *self,
+                          GKeyFile *state,
+                          GError **error)
+{
+  g_autofree gchar *data = NULL;
+  gsize len;
+
+  g_return_val_if_fail (PV_IS_RUNTIME (self), FALSE);
+  g_return_val_if_fail (self->mutable_sysroot != NULL, FALSE);
+  g_return_val_if_fail (self->prepared_key != NULL, FALSE);
+
+  g_key_file_set_string (state, PV_PREPARED_GROUP, "Key",
+                         self->prepared_key);
+  g_key_file_set_boolean (state, PV_PREPARED_GROUP, "AnyVdpauDrivers",
+                          self->any_vdpau_drivers);
+  data = g_key_file_to_data (state, &len, NULL);
+
+  if (!glnx_file_replace_contents_at (self->mutable_sysroot->fd,
+                                      PV_PREPARED_STATE,
+                                      (const guint8 *) data, len,
+                                      GLNX_FILE_REPLACE_NODATASYNC,
+                                      NULL, error))
+    return glnx_prefix_error (error,
+                              "Unable to write \"%s/" PV_PREPARED_STATE "\"",
+                              self->mutable_sysroot->path);
+
+  g_info ("Saved prepared runtime \"%s\" for reuse",
+          self->mutable_sysroot->path);
+  return TRUE;
+}
+
+/*
+ * Instead of pv_runtime_use_provider_graphics_stack(), replay the
+ * results that were recorded in a prepared runtime.
+ */
+static void
+pv_runtime_replay_prepared (PvRuntime *self,
+                            SrtEnvOverlay *container_env)
+{
+  g_auto(GStrv) keys = NULL;
+  gsize i;
+
+  g_return_if_fail (PV_IS_RUNTIME (self));
+  g_return_if_fail (self->prepared != NULL);
 
-  return TRUE;
+  self->any_vdpau_drivers = g_key_file_get_boolean (self->prepared,
+                                                    PV_PREPARED_GROUP,
+                                                    "AnyVdpauDrivers",
+                                                    NULL);
+  keys = g_key_file_get_keys (self->prepared, PV_PREPARED_ENV_GROUP,
+                              NULL, NULL);
+
+  for (i = 0; keys != NULL && keys[i] != NULL; i++)
+    {
+      g_autofree gchar *value = NULL;
+
+      value = g_key_file_get_string (self->prepared, PV_PREPARED_ENV_GROUP,
+                                     keys[i], NULL);
+
+      if (g_strcmp0 (value, "!") == 0)
+        _srt_env_overlay_set (container_env, keys[i], NULL);
+      else if (value != NULL && value[0] == '=')
+        _srt_env_overlay_set (container_env, keys[i], value + 1);
+      else
+        g_warning ("Ignoring invalid environment entry \"%s\" in \"%s/%s\"",
+                   keys[i], self->mutable_sysroot->path, PV_PREPARED_STATE);
+    }
 }
 
 typedef struct
@@ -1313,6 +2083,7 @@ enumerate_arch (gpointer data)
       drivers = srt_system_info_list_vdpau_drivers (system_info,
                                                     inputs->details->tuple,
                                                     SRT_DRIVER_FLAGS_NONE);
+      _srt_profiling_rate (part_timer, g_list_length (drivers), "drivers");
     }
 
   if (g_cancellable_is_cancelled (inputs->cancellable))
@@ -1328,6 +2099,7 @@ enumerate_arch (gpointer data)
       drivers = srt_system_info_list_dri_drivers (system_info,
                                                   inputs->details->tuple,
                                                   SRT_DRIVER_FLAGS_NONE);
+      _srt_profiling_rate (part_timer, g_list_length (drivers), "drivers");
     }
 
   if (g_cancellable_is_cancelled (inputs->cancellable))
@@ -1343,6 +2115,7 @@ enumerate_arch (gpointer data)
       drivers = srt_system_info_list_va_api_drivers (system_info,
                                                      inputs->details->tuple,
                                                      SRT_DRIVER_FLAGS_NONE);
+      _srt_profiling_rate (part_timer, g_list_length (drivers), "drivers");
     }
 
   if (g_cancellable_is_cancelled (inputs->cancellable))
@@ -1372,6 +2145,7 @@ cache_indep_graphics_stack (SrtSystemInfo *system_info,
       G_GNUC_UNUSED g_autoptr(SrtObjectList) drivers = NULL;
 
       drivers = srt_system_info_list_egl_icds (system_info, multiarch_tuples);
+      _srt_profiling_rate (part_timer, g_list_length (drivers), "drivers");
     }
 
   if (g_cancellable_is_cancelled (cancellable))
@@ -1384,6 +2158,7 @@ cache_indep_graphics_stack (SrtSystemInfo *system_info,
       G_GNUC_UNUSED g_autoptr(SrtObjectList) drivers = NULL;
 
       drivers = srt_system_info_list_egl_external_platforms (system_info, multiarch_tuples);
+      _srt_profiling_rate (part_timer, g_list_length (drivers), "drivers");
     }
 
   if (g_cancellable_is_cancelled (cancellable))
@@ -1396,6 +2171,7 @@ cache_indep_graphics_stack (SrtSystemInfo *system_info,
       G_GNUC_UNUSED g_autoptr(SrtObjectList) drivers = NULL;
 
       drivers = srt_system_info_list_vulkan_icds (system_info, multiarch_tuples);
+      _srt_profiling_rate (part_timer, g_list_length (drivers), "drivers");
     }
 
   if (g_cancellable_is_cancelled (cancellable))
@@ -1405,11 +2181,15 @@ cache_indep_graphics_stack (SrtSystemInfo *system_info,
     {
       G_GNUC_UNUSED g_autoptr(SrtProfilingTimer) part_timer =
         _srt_profiling_start ("Enumerating Vulkan layers in thread");
-      G_GNUC_UNUSED g_autoptr(SrtObjectList) exp_layers = NULL;
-      G_GNUC_UNUSED g_autoptr(SrtObjectList) imp_layers = NULL;
+      g_autoptr(SrtObjectList) exp_layers = NULL;
+      g_autoptr(SrtObjectList) imp_layers = NULL;
 
       exp_layers = srt_system_info_list_explicit_vulkan_layers (system_info);
       imp_layers = srt_system_info_list_implicit_vulkan_layers (system_info);
+      _srt_profiling_counter ("Explicit Vulkan layers",
+                              g_list_length (exp_layers));
+      _srt_profiling_counter ("Implicit Vulkan layers",
+                              g_list_length (imp_layers));
     }
 }
 
@@ -1475,6 +2255,47 @@ enumeration_threads_clear (EnumerationThread **arr,
   g_free (threads);
 }
 
+static void
+capture_helper_stop (CaptureHelper *self)
+{
+  g_autoptr(GError) local_error = NULL;
+  int wait_status;
+
+  /* The helper exits when it reaches EOF on its stdin */
+  glnx_close_fd (&self->socket_fd);
+  self->overrides_fd_in_helper = -1;
+
+  if (self->pid <= 0)
+    return;
+
+  while (waitpid (self->pid, &wait_status, 0) < 0)
+    {
+      if (errno != EINTR)
+        {
+          g_warning ("Unable to wait for capsule-capture-libs: %s",
+                     g_strerror (errno));
+          goto out;
+        }
+    }
+
+  if (!g_spawn_check_wait_status (wait_status, &local_error))
+    g_warning ("capsule-capture-libs --batch failed: %s",
+               local_error->message);
+
+out:
+  g_spawn_close_pid (self->pid);
+  self->pid = 0;
+}
+
+static void
+pv_runtime_stop_capture_helpers (PvRuntime *self)
+{
+  gsize i;
+
+  for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
+    capture_helper_stop (&self->capture_helpers[i]);
+}
+
 /* Must be called in main thread */
 static void
 enumeration_thread_start_arch (EnumerationThread *self,
@@ -1600,7 +2421,8 @@ pv_runtime_initable_init (GInitable *initable,
    *
    * The manifest compresses well (about 3:1 if sha256sums are included)
    * so try to read a compressed version first, falling back to
-   * uncompressed. */
+   * uncompressed. If there is an up-to-date usr-mtree.bin alongside,
+   * pv_mtree_apply() will read that instead. */
   usr_mtree = g_build_filename (self->source, "usr-mtree.txt.gz", NULL);
 
   if (g_file_test (usr_mtree, G_FILE_TEST_IS_REGULAR))
@@ -1719,8 +2541,23 @@ pv_runtime_initable_init (GInitable *initable,
       if (mutable_lock == NULL)
         return FALSE;
 
-      if (!pv_runtime_create_copy (self, mutable_lock, usr_mtree,
-                                   mtree_flags, error))
+      /* Prepared runtimes are only useful if there is a graphics stack
+       * to set up, and we don't support them for the more unusual
+       * code paths that write to the runtime after setup. */
+      if ((self->flags & PV_RUNTIME_FLAGS_CACHE_PREPARED)
+          && self->provider != NULL
+          && !self->is_flatpak_env
+          && !(self->flags & (PV_RUNTIME_FLAGS_FLATPAK_SUBSANDBOX
+                              | PV_RUNTIME_FLAGS_INTERPRETER_ROOT)))
+        self->prepared_key = pv_runtime_compute_prepared_key (self, usr_mtree);
+
+      if (self->prepared_key != NULL)
+        g_debug ("Key for prepared runtime: %s", self->prepared_key);
+
+      if ((self->prepared_key == NULL
+           || !pv_runtime_reuse_prepared_copy (self, mutable_lock))
+          && !pv_runtime_create_copy (self, mutable_lock, usr_mtree,
+                                      mtree_flags, error))
         return FALSE;
     }
 
@@ -1866,6 +2703,8 @@ pv_runtime_cleanup (PvRuntime *self)
 
   g_return_if_fail (PV_IS_RUNTIME (self));
 
+  pv_runtime_stop_capture_helpers (self);
+
   if (self->tmpdir != NULL &&
       !glnx_shutil_rm_rf_at (-1, self->tmpdir, NULL, &local_error))
     {
@@ -1924,6 +2763,8 @@ pv_runtime_finalize (GObject *object)
   g_free (self->source_files);
   g_free (self->variable_dir);
   glnx_close_fd (&self->variable_dir_fd);
+  g_free (self->prepared_key);
+  g_clear_pointer (&self->prepared, g_key_file_unref);
 
   G_OBJECT_CLASS (pv_runtime_parent_class)->finalize (object);
 }
@@ -2383,7 +3224,11 @@ pv_runtime_get_capsule_capture_libs (PvRuntime *self,
                          self->provider->path_in_container_ns,
                          "/lib", NULL);
 
-  runtime_files_fd = dup (self->runtime_files_fd);
+  /* Close-on-exec here, so that other subprocesses launched in parallel
+   * don't inherit it: it is made inheritable in the child by
+   * flatpak_bwrap_child_setup() */
+  runtime_files_fd = TEMP_FAILURE_RETRY (fcntl (self->runtime_files_fd,
+                                                F_DUPFD_CLOEXEC, 3));
 
   if (runtime_files_fd < 0)
     return glnx_null_throw_errno_prefix (error,
@@ -2424,6 +3269,176 @@ pv_runtime_get_capsule_capture_libs (PvRuntime *self,
   return g_steal_pointer (&ret);
 }
 
+/*
+ * capture_helper_start:
+ * @self: (out caller-allocates): The helper
+ *
+ * Start a capsule-capture-libs --batch process for @arch.
+ * The caller is responsible for calling capture_helper_stop().
+ */
+static gboolean
+capture_helper_start (CaptureHelper *self,
+                      PvRuntime *runtime,
+                      RuntimeArchitecture *arch,
+                      GError **error)
+{
+  g_autoptr(FlatpakBwrap) bwrap = NULL;
+  glnx_autofd int overrides_fd = -1;
+  glnx_autofd int parent_socket = -1;
+  glnx_autofd int child_stdin = -1;
+  glnx_autofd int child_stdout = -1;
+  int overrides_fd_in_helper;
+  int sockets[2];
+
+  g_return_val_if_fail (self->pid == 0, FALSE);
+  g_return_val_if_fail (self->socket_fd < 0, FALSE);
+
+  bwrap = pv_runtime_get_capsule_capture_libs (runtime, arch, error);
+
+  if (bwrap == NULL)
+    return FALSE;
+
+  /* The helper inherits this with the same number via @bwrap, and can
+   * be given paths relative to it. We close our copy as soon as the
+   * helper has been started. */
+  overrides_fd = TEMP_FAILURE_RETRY (fcntl (runtime->overrides_fd,
+                                            F_DUPFD_CLOEXEC, 3));
+
+  if (overrides_fd < 0)
+    return glnx_throw_errno_prefix (error,
+                                    "Unable to duplicate file descriptor "
+                                    "%d for overrides \"%s\"",
+                                    runtime->overrides_fd, runtime->overrides);
+
+  /* Use a socket rather than a pair of pipes so that we can use
+   * MSG_NOSIGNAL, and not be killed by SIGPIPE if the helper crashes */
+  if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sockets) < 0)
+    return glnx_throw_errno_prefix (error, "socketpair");
+
+  parent_socket = sockets[0];
+  child_stdin = sockets[1];
+  child_stdout = fcntl (child_stdin, F_DUPFD_CLOEXEC, 3);
+
+  if (child_stdout < 0)
+    return glnx_throw_errno_prefix (error, "Unable to duplicate socket");
+
+  overrides_fd_in_helper = overrides_fd;
+  flatpak_bwrap_add_fd (bwrap, g_steal_fd (&overrides_fd));
+  flatpak_bwrap_add_arg (bwrap, "--batch");
+  flatpak_bwrap_finish (bwrap);
+
+  g_debug ("Starting %s --batch...", arch->capsule_capture_libs_basename);
+
+  /* The file descriptors in @bwrap are close-on-exec in our process,
+   * so that helpers for other architectures don't inherit them;
+   * the child setup makes them inheritable by this helper only.
+   * We use LEAVE_DESCRIPTORS_OPEN to avoid closing every fd up to
+   * the rlimit, as in pv_run_sync(). */
+  if (!g_spawn_async_with_fds (NULL,
+                               (char **) bwrap->argv->pdata,
+                               bwrap->envp,
+                               (G_SPAWN_SEARCH_PATH |
+                                G_SPAWN_DO_NOT_REAP_CHILD |
+                                G_SPAWN_LEAVE_DESCRIPTORS_OPEN),
+                               flatpak_bwrap_child_setup_inherit_fds_cb,
+                               bwrap->fds,
+                               &self->pid,
+                               child_stdin,
+                               child_stdout,
+                               -1,
+                               error))
+    {
+      self->pid = 0;
+      return FALSE;
+    }
+
+  self->socket_fd = g_steal_fd (&parent_socket);
+  self->overrides_fd_in_helper = overrides_fd_in_helper;
+  return TRUE;
+}
+
+/*
+ * capture_helper_request:
+ * @destination: Where to capture the libraries, as seen by the helper
+ * @patterns: (array length=n_patterns): Patterns for capsule-capture-libs
+ *
+ * Ask the helper to capture @patterns into @destination, and wait
+ * for it to finish.
+ */
+static gboolean
+capture_helper_request (CaptureHelper *self,
+                        const char *destination,
+                        const char * const *patterns,
+                        gsize n_patterns,
+                        GError **error)
+{
+  g_autoptr(GString) request = g_string_new ("");
+  g_autoptr(GString) reply = g_string_new ("");
+  const char *message;
+  gsize sent = 0;
+  gsize i;
+
+  g_return_val_if_fail (self->socket_fd >= 0, FALSE);
+
+  /* Each field is terminated by \0, and the request is terminated
+   * by an empty field */
+  g_string_append_len (request, destination, strlen (destination) + 1);
+
+  for (i = 0; i < n_patterns; i++)
+    g_string_append_len (request, patterns[i], strlen (patterns[i]) + 1);
+
+  g_string_append_c (request, '\0');
+
+  while (sent < request->len)
+    {
+      ssize_t n = send (self->socket_fd, request->str + sent,
+                        request->len - sent, MSG_NOSIGNAL);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0)
+        return glnx_throw_errno_prefix (error,
+                                        "Unable to send request to "
+                                        "capsule-capture-libs");
+
+      sent += n;
+    }
+
+  while (TRUE)
+    {
+      char c;
+      ssize_t n = read (self->socket_fd, &c, 1);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+
+      if (n < 0)
+        return glnx_throw_errno_prefix (error,
+                                        "Unable to read reply from "
+                                        "capsule-capture-libs");
+
+      if (n == 0)
+        return glnx_throw (error, "capsule-capture-libs exited unexpectedly");
+
+      if (c == '\n')
+        break;
+
+      g_string_append_c (reply, c);
+    }
+
+  if (g_str_equal (reply->str, "ok"))
+    return TRUE;
+
+  /* "error CODE MESSAGE" */
+  if (g_str_has_prefix (reply->str, "error ")
+      && (message = strchr (reply->str + strlen ("error "), ' ')) != NULL)
+    return glnx_throw (error, "%s", message + 1);
+
+  return glnx_throw (error, "Unexpected reply from capsule-capture-libs: %s",
+                     reply->str);
+}
+
 static gboolean pv_runtime_capture_libraries (PvRuntime *self,
                                               RuntimeArchitecture *arch,
                                               const char *destination,
@@ -2589,6 +3604,10 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC (IcdDetails, icd_details_free)
  * Use capsule-capture-libs to capture libraries for architecture @arch
  * matching @patterns, creating symlinks in @destination.
  *
+ * The first call for each architecture starts a capsule-capture-libs
+ * process in batch mode, which is reused for subsequent calls until
+ * pv_runtime_stop_capture_helpers().
+ *
  * Returns: %TRUE on success
  */
 static gboolean
@@ -2600,9 +3619,9 @@ pv_runtime_capture_libraries (PvRuntime *self,
                               gsize n_patterns,
                               GError **error)
 {
-  g_autoptr(FlatpakBwrap) temp_bwrap = NULL;
   G_GNUC_UNUSED g_autoptr(SrtProfilingTimer) timer = NULL;
-  gsize i;
+  g_autofree gchar *dest = NULL;
+  CaptureHelper *helper;
 
   g_return_val_if_fail (self->provider != NULL, FALSE);
   g_return_val_if_fail (runtime_architecture_check_valid (arch), FALSE);
@@ -2616,41 +3635,19 @@ pv_runtime_capture_libraries (PvRuntime *self,
   if (!pv_runtime_provide_container_access (self, error))
     return FALSE;
 
-  temp_bwrap = pv_runtime_get_capsule_capture_libs (self, arch, error);
+  helper = &self->capture_helpers[arch->multiarch_index];
 
-  if (temp_bwrap == NULL)
+  if (helper->pid == 0
+      && !capture_helper_start (helper, self, arch, error))
     return FALSE;
 
-  flatpak_bwrap_add_arg (temp_bwrap, "--dest");
-
   if (g_path_is_absolute (destination))
-    {
-      flatpak_bwrap_add_arg (temp_bwrap, destination);
-    }
+    dest = g_strdup (destination);
   else
-    {
-      int fd = dup (self->overrides_fd);
-
-      if (fd < 0)
-        return glnx_throw_errno_prefix (error,
-                                        "Unable to duplicate file descriptor "
-                                        "%d for overrides \"%s\"",
-                                        fd, self->overrides);
-
-      flatpak_bwrap_add_arg_printf (temp_bwrap, "/proc/self/fd/%d/%s",
-                                    fd, destination);
-      flatpak_bwrap_add_fd (temp_bwrap, g_steal_fd (&fd));
-    }
-
-  for (i = 0; i < n_patterns; i++)
-    flatpak_bwrap_add_arg (temp_bwrap, patterns[i]);
+    dest = g_strdup_printf ("/proc/self/fd/%d/%s",
+                            helper->overrides_fd_in_helper, destination);
 
-  flatpak_bwrap_finish (temp_bwrap);
-
-  if (!pv_bwrap_run_sync (temp_bwrap, NULL, error))
-    return FALSE;
-
-  return TRUE;
+  return capture_helper_request (helper, dest, patterns, n_patterns, error);
 }
 
 /*
@@ -3383,10 +4380,11 @@ bind_runtime_base (PvRuntime *self,
         g_warning ("%s", local_error->message);
 
       /* Also make a matching symbolic link on disk, to make it easier
-       * to inspect the sysroot. */
-      if (TEMP_FAILURE_RETRY (symlinkat (&self->overrides_in_container[1],
-                                         self->mutable_sysroot->fd,
-                                         "overrides")) != 0)
+       * to inspect the sysroot. A reused prepared runtime already has it. */
+      if (self->prepared == NULL
+          && TEMP_FAILURE_RETRY (symlinkat (&self->overrides_in_container[1],
+                                            self->mutable_sysroot->fd,
+                                            "overrides")) != 0)
         return glnx_throw_errno_prefix (error,
                                         "Unable to create symlink \"%s/overrides\" -> \"%s\"",
                                         self->mutable_sysroot->path,
@@ -7693,13 +8691,119 @@ check_path_entries_all_in_dir (const char *path,
 
 #define OPENXR_1_RUNTIME_OVERRIDES_PREFIX "etc/xdg"
 
+/*
+ * ArchCapture:
+ *
+ * Per-architecture state for pv_runtime_use_provider_graphics_stack().
+ * The patterns are collected in the main thread, because that involves
+ * joining the enumeration threads and updating the shared #IcdDetails.
+ * The capsule-capture-libs calls that follow only write to this
+ * architecture's subdirectory of the overrides, so they can run in a
+ * worker thread per architecture; their results are recorded here and
+ * merged into the shared state in the main thread, in architecture order.
+ */
+typedef struct
+{
+  RuntimeArchitecture arch;
+  /* (not owned) */
+  PvRuntime *runtime;
+  /* (not owned) */
+  SrtSystemInfo *system_info;
+  /* Can either be relative to the sysroot, or absolute */
+  gchar *ld_so_in_runtime;
+  GPtrArray *patterns;
+  /* Keyed by index in library_families */
+  gchar *soname_symlinks[G_N_ELEMENTS (library_families)];
+  gboolean was_captured[G_N_ELEMENTS (library_families)];
+  GThread *thread;
+  GError *error;
+  gboolean usable;
+} ArchCapture;
+
+static void
+arch_capture_clear (gpointer data)
+{
+  ArchCapture *self = data;
+  gsize j;
+
+  if (self->thread != NULL)
+    g_thread_join (g_steal_pointer (&self->thread));
+
+  runtime_architecture_clear (&self->arch);
+  g_clear_pointer (&self->ld_so_in_runtime, g_free);
+  g_clear_pointer (&self->patterns, g_ptr_array_unref);
+
+  for (j = 0; j < G_N_ELEMENTS (library_families); j++)
+    g_clear_pointer (&self->soname_symlinks[j], g_free);
+
+  g_clear_error (&self->error);
+}
+
+/*
+ * Run the capsule-capture-libs calls for one architecture.
+ * This may be called from a worker thread, so it must not alter
+ * anything in @self->runtime or in the shared graphics stack state.
+ */
+static gboolean
+arch_capture_libraries (ArchCapture *self,
+                        GError **error)
+{
+  PvRuntime *runtime = self->runtime;
+  RuntimeArchitecture *arch = &self->arch;
+  g_autoptr(GPtrArray) dirs = NULL;
+  gsize j;
+
+  /* pv_runtime_capture_libraries() would set this up lazily, but that
+   * is only safe in the main thread */
+  g_assert (runtime->container_access_adverb != NULL);
+
+  /* We always have at least one pattern, because
+   * collect_graphics_libraries_patterns() unconditionally
+   * adds some, so we don't need to conditionalize this call
+   * to capsule-capture-libs */
+  g_assert (self->patterns->len > 0);
+  g_assert (self->patterns->pdata != NULL);
+
+  if (!pv_runtime_capture_libraries (runtime, arch,
+                                     arch->libdir_relative_to_overrides,
+                                     "Main capsule-capture-libs call",
+                                     (const char * const *) self->patterns->pdata,
+                                     self->patterns->len, error))
+    return FALSE;
+
+  for (j = 0; j < G_N_ELEMENTS (library_families); j++)
+    pv_runtime_capture_relatives (runtime, arch, &library_families[j],
+                                  &self->soname_symlinks[j],
+                                  &self->was_captured[j]);
+
+  dirs = pv_multiarch_details_get_libdirs (arch->details,
+                                           PV_MULTIARCH_LIBDIRS_FLAGS_NONE);
+
+  for (j = 0; j < dirs->len; j++)
+    {
+      if (!collect_s2tc (runtime, arch, g_ptr_array_index (dirs, j), error))
+        return FALSE;
+    }
+
+  return TRUE;
+}
+
+static gpointer
+arch_capture_thread (gpointer data)
+{
+  ArchCapture *self = data;
+
+  arch_capture_libraries (self, &self->error);
+  return NULL;
+}
+
 static gboolean
 pv_runtime_use_provider_graphics_stack (PvRuntime *self,
                                         FlatpakBwrap *bwrap,
                                         SrtEnvOverlay *container_env,
                                         GError **error)
 {
-  gsize i, j;
+  gsize i;
   g_autoptr(GString) dri_path = g_string_new ("");
   g_autoptr(GString) egl_path = g_string_new ("");
   g_autoptr(GString) egl_ext_platform_path = g_string_new ("");
@@ -7730,6 +8834,7 @@ pv_runtime_use_provider_graphics_stack (PvRuntime *self,
                                                                          g_free, NULL);
   g_autoptr(GHashTable) gconv_in_provider = g_hash_table_new_full (g_str_hash, g_str_equal,
                                                                    g_free, NULL);
+  g_autoptr(GArray) captures = NULL;
   const gchar *provider = "provider";
 
   g_return_val_if_fail (PV_IS_RUNTIME (self), FALSE);
@@ -7802,47 +8907,46 @@ pv_runtime_use_provider_graphics_stack (PvRuntime *self,
 
   g_assert (pv_multiarch_tuples[PV_N_SUPPORTED_ARCHITECTURES] == NULL);
 
+  captures = g_array_new (FALSE, TRUE, sizeof (ArchCapture));
+  g_array_set_clear_func (captures, arch_capture_clear);
+  g_array_set_size (captures, PV_N_SUPPORTED_ARCHITECTURES);
+
   for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
     {
-      g_autoptr(GError) local_error = NULL;
-      g_auto (RuntimeArchitecture) arch_on_stack = { i };
-      RuntimeArchitecture *arch = &arch_on_stack;
+      ArchCapture *capture = &g_array_index (captures, ArchCapture, i);
+      RuntimeArchitecture *arch = &capture->arch;
 
-      part_timer = _srt_profiling_start ("%s libraries", pv_multiarch_tuples[i]);
+      capture->arch.multiarch_index = i;
+      capture->runtime = self;
+
+      part_timer = _srt_profiling_start ("%s graphics drivers", pv_multiarch_tuples[i]);
       g_debug ("Checking for %s libraries...", pv_multiarch_tuples[i]);
 
       if (runtime_architecture_init (arch, self))
         {
-          g_autoptr(GPtrArray) dirs = NULL;
           g_autofree gchar *this_dri_path_in_container = g_build_filename (arch->libdir_in_container,
                                                                            "dri", NULL);
-          /* Can either be relative to the sysroot, or absolute */
-          g_autofree gchar *ld_so_in_runtime = NULL;
-          g_autofree gchar *libdrm = NULL;
-          g_autofree gchar *libdrm_amdgpu = NULL;
-          g_autofree gchar *libglx_mesa = NULL;
-          g_autofree gchar *libglx_nvidia = NULL;
-          g_autoptr(GPtrArray) patterns = NULL;
-          SrtSystemInfo *arch_system_info;
+          GPtrArray *patterns;
 
-          if (!pv_runtime_get_ld_so (self, arch, &ld_so_in_runtime, error))
+          if (!pv_runtime_get_ld_so (self, arch, &capture->ld_so_in_runtime, error))
             return FALSE;
 
-          if (ld_so_in_runtime == NULL)
+          if (capture->ld_so_in_runtime == NULL)
             {
               g_info ("Container does not have %s so it cannot run "
                       "%s binaries",
                       arch->ld_so, arch->details->tuple);
+              g_clear_pointer (&part_timer, _srt_profiling_end);
               continue;
             }
 
           /* Reserve a size of 128 to avoid frequent reallocation due to the
            * expected high number of patterns that will be added to the array. */
-          patterns = g_ptr_array_new_full (128, g_free);
+          patterns = capture->patterns = g_ptr_array_new_full (128, g_free);
 
           any_architecture_works = TRUE;
           g_debug ("Container path: %s -> %s",
-                   arch->ld_so, ld_so_in_runtime);
+                   arch->ld_so, capture->ld_so_in_runtime);
 
           pv_search_path_append (dri_path, this_dri_path_in_container);
           pv_search_path_append (va_api_path, this_dri_path_in_container);
@@ -7899,148 +9003,174 @@ pv_runtime_use_provider_graphics_stack (PvRuntime *self,
             }
 
           if (self->flags & PV_RUNTIME_FLAGS_SINGLE_THREAD)
-            arch_system_info = system_info;
+            capture->system_info = system_info;
           else
-            arch_system_info = enumeration_thread_join (&self->arch_threads[i]);
+            capture->system_info = enumeration_thread_join (&self->arch_threads[i]);
 
           if ((self->flags & PV_RUNTIME_FLAGS_IMPORT_OPENXR_1_RUNTIMES)
               && !collect_openxr_1_runtime (self, arch, provider_stack->openxr_1_runtime_details,
                                             patterns, error))
             return FALSE;
 
-          if (!collect_vdpau_drivers (self, arch_system_info, arch, patterns, error))
+          if (!collect_vdpau_drivers (self, capture->system_info, arch, patterns, error))
             return FALSE;
 
-          if (!collect_dri_drivers (self, arch_system_info, arch, patterns,
+          if (!collect_dri_drivers (self, capture->system_info, arch, patterns,
                                     dri_path, error))
             return FALSE;
 
-          /* We always have at least one pattern, because
-           * collect_graphics_libraries_patterns() unconditionally
-           * adds some, so we don't need to conditionalize this call
-           * to capsule-capture-libs */
-          g_assert (patterns->len > 0);
-          g_assert (patterns->pdata != NULL);
+          capture->usable = TRUE;
+        }
 
-          if (!pv_runtime_capture_libraries (self, arch,
-                                             arch->libdir_relative_to_overrides,
-                                             "Main capsule-capture-libs call",
-                                             (const char * const *) patterns->pdata,
-                                             patterns->len, error))
-            return FALSE;
+      g_clear_pointer (&part_timer, _srt_profiling_end);
+    }
 
-          for (j = 0; j < G_N_ELEMENTS (library_families); j++)
-            {
-              g_autofree gchar *soname_symlink = NULL;
-              gboolean was_captured = FALSE;
+  /* Each architecture's capsule-capture-libs calls only write to its own
+   * lib/TUPLE subdirectory of the overrides, so we can run them
+   * concurrently. */
+  part_timer = _srt_profiling_start ("Capturing libraries");
 
-              pv_runtime_capture_relatives (self, arch, &library_families[j],
-                                            &soname_symlink, &was_captured);
+  for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
+    {
+      ArchCapture *capture = &g_array_index (captures, ArchCapture, i);
 
-              if (j == 0)
-                {
-                  /* We assume libc.so.6 is the first entry */
-                  g_assert (g_str_equal (library_families[j].soname, "libc.so.6"));
-                  self->any_libc_from_provider |= was_captured;
-                  self->all_libc_from_provider &= was_captured;
-
-                  /* If we are using the provider's glibc (likely) then
-                   * we must also use its ld.so, and ideally its
-                   * gconv modules too. */
-                  if (was_captured
-                      && !pv_runtime_collect_libc_family (self, arch,
-                                                          arch_system_info,
-                                                          bwrap,
-                                                          soname_symlink,
-                                                          ld_so_in_runtime,
-                                                          gconv_in_provider,
-                                                          error))
-                    return FALSE;
-                }
-            }
+      if (!capture->usable)
+        continue;
 
-          libdrm = g_build_filename (arch->libdir_relative_to_overrides,
-                                     "libdrm.so.2", NULL);
-          libdrm_amdgpu = g_build_filename (arch->libdir_relative_to_overrides,
-                                            "libdrm_amdgpu.so.1", NULL);
-
-          /* If we have libdrm_amdgpu.so.1 in overrides we also want to mount
-           * ${prefix}/share/libdrm from the provider. ${prefix} is derived from
-           * the absolute path of libdrm_amdgpu.so.1 */
-          if (!pv_runtime_collect_lib_symlink_data (self, arch, "libdrm",
-                                                    libdrm_amdgpu,
-                                                    PV_RUNTIME_DATA_FLAGS_NONE,
-                                                    libdrm_data_in_provider)
-              && !pv_runtime_collect_lib_symlink_data (self, arch, "libdrm",
-                                                       libdrm,
-                                                       PV_RUNTIME_DATA_FLAGS_NONE,
-                                                       libdrm_data_in_provider))
-            {
-              /* For at least a single architecture, libdrm is newer in the container */
-              all_libdrm_from_provider = FALSE;
-            }
+      if (self->flags & PV_RUNTIME_FLAGS_SINGLE_THREAD)
+        arch_capture_libraries (capture, &capture->error);
+      else
+        capture->thread = g_thread_new (capture->arch.details->tuple,
+                                        arch_capture_thread, capture);
+    }
 
-          libglx_mesa = g_build_filename (arch->libdir_relative_to_overrides,
-                                          "libGLX_mesa.so.0", NULL);
+  for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
+    {
+      ArchCapture *capture = &g_array_index (captures, ArchCapture, i);
 
-          /* If we have libGLX_mesa.so.0 in overrides we also want to mount
-           * ${prefix}/share/drirc.d from the provider. ${prefix} is derived from
-           * the absolute path of libGLX_mesa.so.0 */
-          if (!pv_runtime_collect_lib_symlink_data (self, arch, "drirc.d",
-                                                    libglx_mesa,
-                                                    PV_RUNTIME_DATA_FLAGS_NONE,
-                                                    drirc_data_in_provider))
-            {
-              /* For at least a single architecture, libGLX_mesa is newer in the container */
-              all_libglx_from_provider = FALSE;
-            }
+      if (capture->thread != NULL)
+        g_thread_join (g_steal_pointer (&capture->thread));
+    }
 
-          collect_mesa_drirc (self, arch, provider_stack->egl_icd_details,
-                              provider_stack->vulkan_icd_details, system_info,
-                              drirc_data_in_provider);
+  g_clear_pointer (&part_timer, _srt_profiling_end);
 
-          libglx_nvidia = g_build_filename (arch->libdir_relative_to_overrides,
-                                            "libGLX_nvidia.so.0", NULL);
+  for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
+    {
+      ArchCapture *capture = &g_array_index (captures, ArchCapture, i);
 
-          /* If we have libGLX_nvidia.so.0 in overrides we also want to mount
-           * /usr/share/nvidia from the provider. In this case it's
-           * /usr/share/nvidia that is the preferred path, with
-           * ${prefix}/share/nvidia as a fallback. */
-          pv_runtime_collect_lib_symlink_data (self, arch, "nvidia",
-                                               libglx_nvidia,
-                                               PV_RUNTIME_DATA_FLAGS_USR_SHARE_FIRST,
-                                               nvidia_data_in_provider);
+      if (capture->error != NULL)
+        {
+          g_propagate_error (error, g_steal_pointer (&capture->error));
+          return FALSE;
+        }
+    }
 
-          dirs = pv_multiarch_details_get_libdirs (arch->details,
-                                                   PV_MULTIARCH_LIBDIRS_FLAGS_NONE);
+  for (i = 0; i < PV_N_SUPPORTED_ARCHITECTURES; i++)
+    {
+      g_autoptr(GError) local_error = NULL;
+      ArchCapture *capture = &g_array_index (captures, ArchCapture, i);
+      RuntimeArchitecture *arch = &capture->arch;
+      g_autofree gchar *libdrm = NULL;
+      g_autofree gchar *libdrm_amdgpu = NULL;
+      g_autofree gchar *libglx_mesa = NULL;
+      g_autofree gchar *libglx_nvidia = NULL;
+
+      if (!capture->usable)
+        continue;
 
-          for (j = 0; j < dirs->len; j++)
-            {
-              if (!collect_s2tc (self, arch,
-                                 g_ptr_array_index (dirs, j),
-                                 error))
-                return FALSE;
-            }
+      part_timer = _srt_profiling_start ("%s libraries", pv_multiarch_tuples[i]);
 
-          if (!pv_runtime_create_aliases (self, arch, &local_error))
-            {
-              /* This is not a critical error, try to continue */
-              g_warning ("Unable to create library aliases: %s",
-                         local_error->message);
-              g_clear_error (&local_error);
-              continue;
-            }
+      /* We assume libc.so.6 is the first entry */
+      g_assert (g_str_equal (library_families[0].soname, "libc.so.6"));
+      self->any_libc_from_provider |= capture->was_captured[0];
+      self->all_libc_from_provider &= capture->was_captured[0];
+
+      /* If we are using the provider's glibc (likely) then
+       * we must also use its ld.so, and ideally its
+       * gconv modules too. */
+      if (capture->was_captured[0]
+          && !pv_runtime_collect_libc_family (self, arch,
+                                              capture->system_info,
+                                              bwrap,
+                                              capture->soname_symlinks[0],
+                                              capture->ld_so_in_runtime,
+                                              gconv_in_provider,
+                                              error))
+        return FALSE;
 
-          /* Make sure we do this last, so that we have really copied
-           * everything from the provider that we are going to */
-          if (self->mutable_sysroot != NULL &&
-              !pv_runtime_remove_overridden_libraries (self, arch, error))
-            return FALSE;
+      libdrm = g_build_filename (arch->libdir_relative_to_overrides,
+                                 "libdrm.so.2", NULL);
+      libdrm_amdgpu = g_build_filename (arch->libdir_relative_to_overrides,
+                                        "libdrm_amdgpu.so.1", NULL);
+
+      /* If we have libdrm_amdgpu.so.1 in overrides we also want to mount
+       * ${prefix}/share/libdrm from the provider. ${prefix} is derived from
+       * the absolute path of libdrm_amdgpu.so.1 */
+      if (!pv_runtime_collect_lib_symlink_data (self, arch, "libdrm",
+                                                libdrm_amdgpu,
+                                                PV_RUNTIME_DATA_FLAGS_NONE,
+                                                libdrm_data_in_provider)
+          && !pv_runtime_collect_lib_symlink_data (self, arch, "libdrm",
+                                                   libdrm,
+                                                   PV_RUNTIME_DATA_FLAGS_NONE,
+                                                   libdrm_data_in_provider))
+        {
+          /* For at least a single architecture, libdrm is newer in the container */
+          all_libdrm_from_provider = FALSE;
+        }
+
+      libglx_mesa = g_build_filename (arch->libdir_relative_to_overrides,
+                                      "libGLX_mesa.so.0", NULL);
+
+      /* If we have libGLX_mesa.so.0 in overrides we also want to mount
+       * ${prefix}/share/drirc.d from the provider. ${prefix} is derived from
+       * the absolute path of libGLX_mesa.so.0 */
+      if (!pv_runtime_collect_lib_symlink_data (self, arch, "drirc.d",
+                                                libglx_mesa,
+                                                PV_RUNTIME_DATA_FLAGS_NONE,
+                                                drirc_data_in_provider))
+        {
+          /* For at least a single architecture, libGLX_mesa is newer in the container */
+          all_libglx_from_provider = FALSE;
+        }
+
+      collect_mesa_drirc (self, arch, provider_stack->egl_icd_details,
+                          provider_stack->vulkan_icd_details, system_info,
+                          drirc_data_in_provider);
+
+      libglx_nvidia = g_build_filename (arch->libdir_relative_to_overrides,
+                                        "libGLX_nvidia.so.0", NULL);
+
+      /* If we have libGLX_nvidia.so.0 in overrides we also want to mount
+       * /usr/share/nvidia from the provider. In this case it's
+       * /usr/share/nvidia that is the preferred path, with
+       * ${prefix}/share/nvidia as a fallback. */
+      pv_runtime_collect_lib_symlink_data (self, arch, "nvidia",
+                                           libglx_nvidia,
+                                           PV_RUNTIME_DATA_FLAGS_USR_SHARE_FIRST,
+                                           nvidia_data_in_provider);
+
+      if (!pv_runtime_create_aliases (self, arch, &local_error))
+        {
+          /* This is not a critical error, try to continue */
+          g_warning ("Unable to create library aliases: %s",
+                     local_error->message);
+          g_clear_error (&local_error);
+          g_clear_pointer (&part_timer, _srt_profiling_end);
+          continue;
         }
 
+      /* Make sure we do this last, so that we have really copied
+       * everything from the provider that we are going to */
+      if (self->mutable_sysroot != NULL &&
+          !pv_runtime_remove_overridden_libraries (self, arch, error))
+        return FALSE;
+
       g_clear_pointer (&part_timer, _srt_profiling_end);
     }
 
+  pv_runtime_stop_capture_helpers (self);
+
   if (self->interpreter_host_provider != NULL)
     {
       g_assert (pv_multiarch_as_emulator_tuples[PV_N_SUPPORTED_ARCHITECTURES_AS_EMULATOR_HOST] == NULL);
@@ -8336,6 +9466,7 @@ pv_runtime_bind (PvRuntime *self,
                  SrtEnvOverlay *container_env,
                  GError **error)
 {
+  g_autoptr(GKeyFile) prepared_state = NULL;
   const char *value;
 
   g_return_val_if_fail (PV_IS_RUNTIME (self), FALSE);
@@ -8366,12 +9497,28 @@ pv_runtime_bind (PvRuntime *self,
         return FALSE;
     }
 
-  if (self->provider != NULL)
+  if (self->provider != NULL && self->prepared != NULL)
+    {
+      /* The graphics stack was already set up in the prepared runtime */
+      pv_runtime_replay_prepared (self, container_env);
+    }
+  else if (self->provider != NULL)
     {
+      g_auto(GStrv) env_before = NULL;
+
+      if (self->prepared_key != NULL)
+        env_before = prepared_env_snapshot (container_env);
+
       if (!pv_runtime_use_provider_graphics_stack (self, bwrap,
                                                    container_env,
                                                    error))
         return FALSE;
+
+      if (self->prepared_key != NULL)
+        {
+          prepared_state = g_key_file_new ();
+          prepared_env_record (prepared_state, env_before, container_env);
+        }
     }
 
   if (bwrap != NULL
@@ -8385,22 +9532,27 @@ pv_runtime_bind (PvRuntime *self,
       glnx_autofd int parent_dirfd = -1;
       const char *symlink_target = PV_FROM_HOST_IN_MUTABLE_SYSROOT;
 
-      parent_dirfd = _srt_resolve_in_sysroot (self->mutable_sysroot->fd,
-                                              PV_FROM_HOST_IN_MUTABLE_SYSROOT_PARENT,
-                                              SRT_RESOLVE_FLAGS_MKDIR_P,
-                                              NULL, error);
+      /* A reused prepared runtime already has an up-to-date copy,
+       * because the key includes pressure-vessel's own version */
+      if (self->prepared == NULL)
+        {
+          parent_dirfd = _srt_resolve_in_sysroot (self->mutable_sysroot->fd,
+                                                  PV_FROM_HOST_IN_MUTABLE_SYSROOT_PARENT,
+                                                  SRT_RESOLVE_FLAGS_MKDIR_P,
+                                                  NULL, error);
 
-      if (parent_dirfd < 0)
-        return FALSE;
+          if (parent_dirfd < 0)
+            return FALSE;
 
-      if (!glnx_shutil_rm_rf_at (parent_dirfd, "from-host", NULL, error))
-        return FALSE;
+          if (!glnx_shutil_rm_rf_at (parent_dirfd, "from-host", NULL, error))
+            return FALSE;
 
-      dest = glnx_fdrel_abspath (parent_dirfd, "from-host");
+          dest = glnx_fdrel_abspath (parent_dirfd, "from-host");
 
-      if (!pv_cheap_tree_copy (self->pv_prefix, dest,
-                               PV_COPY_FLAGS_CHMOD_MAY_FAIL, error))
-        return FALSE;
+          if (!pv_cheap_tree_copy (self->pv_prefix, dest,
+                                   PV_COPY_FLAGS_CHMOD_MAY_FAIL, error))
+            return FALSE;
+        }
 
       /* Because the symlink is in a directory that doesn't exist in the
        * $FEX_ROOTFS, its target needs to be resolvable without FEX's help. */
@@ -8558,6 +9710,16 @@ pv_runtime_bind (PvRuntime *self,
 
   pv_runtime_set_search_paths (self, container_env);
 
+  /* Now that the mutable sysroot has been completely set up, it can be
+   * reused next time. Failing to do so is not fatal. */
+  if (prepared_state != NULL && self->mutable_sysroot != NULL)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      if (!pv_runtime_save_prepared (self, prepared_state, &local_error))
+        g_warning ("%s", local_error->message);
+    }
+
   return TRUE;
 }
 
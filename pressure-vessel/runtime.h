@@ -53,6 +53,9 @@
  * @PV_RUNTIME_FLAGS_IMPORT_CA_CERTS: Try to import CA certificates from
  *  the host system, which is assumed to be Debian-compatible
  * @PV_RUNTIME_FLAGS_IMPORT_OPENXR_1_RUNTIMES: Include host OpenXR 1 runtimes
+ * @PV_RUNTIME_FLAGS_CACHE_PREPARED: Keep fully set up copies of the runtime
+ *  in the variable directory, and reuse them if the runtime, graphics
+ *  provider and options have not changed
  * @PV_RUNTIME_FLAGS_NONE: None of the above
  *
  * Flags affecting how we set up the runtime.
@@ -71,6 +74,7 @@ typedef enum
   PV_RUNTIME_FLAGS_DETERMINISTIC = (1 << 9),
   PV_RUNTIME_FLAGS_IMPORT_CA_CERTS = (1 << 10),
   PV_RUNTIME_FLAGS_IMPORT_OPENXR_1_RUNTIMES = (1 << 11),
+  PV_RUNTIME_FLAGS_CACHE_PREPARED = (1 << 12),
   PV_RUNTIME_FLAGS_NONE = 0
 } PvRuntimeFlags;
 
@@ -93,6 +97,7 @@ typedef enum
    | PV_RUNTIME_FLAGS_DETERMINISTIC \
    | PV_RUNTIME_FLAGS_IMPORT_CA_CERTS \
    | PV_RUNTIME_FLAGS_IMPORT_OPENXR_1_RUNTIMES \
+   | PV_RUNTIME_FLAGS_CACHE_PREPARED \
    )
 
 typedef enum
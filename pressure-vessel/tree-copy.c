@@ -22,7 +22,7 @@
 
 #include "tree-copy.h"
 
-#include <ftw.h>
+#include <sys/ioctl.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -31,6 +31,8 @@
 #include "libglnx.h"
 
 #include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/missing-internal.h"
+#include "steam-runtime-tools/profiling-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
 #include "flatpak-bwrap-private.h"
 #include "flatpak-utils-base-private.h"
@@ -44,6 +46,14 @@
 #define trace(...) do { } while (0)
 #endif
 
+/* Upper bound on the number of regular files queued for worker threads */
+#define COPY_MAX_IN_FLIGHT 256
+/* Most of the time is spent in the kernel, so more threads than this
+ * don't help much */
+#define COPY_MAX_THREADS 8
+/* Buffer size for the read()/write() fallback */
+#define COPY_BUFFER_SIZE (128 * 1024)
+
 static inline gboolean
 gets_usrmerged (const char *path)
 {
@@ -62,20 +72,180 @@ gets_usrmerged (const char *path)
   return FALSE;
 }
 
-/* nftw() doesn't have a user_data argument so we need to use a global
- * variable :-( */
-static struct
+/*
+ * CopyStrategy:
+ * @COPY_STRATEGY_HARD_LINK: link(2)
+ * @COPY_STRATEGY_REFLINK: ioctl(2) FICLONE, sharing data blocks
+ *  copy-on-write on btrfs, XFS and similar
+ * @COPY_STRATEGY_COPY_FILE_RANGE: copy_file_range(2), which can do
+ *  server-side or in-kernel copies
+ * @COPY_STRATEGY_READ_WRITE: A plain copy in user-space
+ *
+ * Ways to populate a regular file, from cheapest to most expensive.
+ */
+typedef enum
+{
+  COPY_STRATEGY_HARD_LINK = 0,
+  COPY_STRATEGY_REFLINK,
+  COPY_STRATEGY_COPY_FILE_RANGE,
+  COPY_STRATEGY_READ_WRITE,
+  N_COPY_STRATEGIES
+} CopyStrategy;
+
+static const char * const copy_strategy_names[N_COPY_STRATEGIES] =
+{
+  [COPY_STRATEGY_HARD_LINK] = "hard link",
+  [COPY_STRATEGY_REFLINK] = "reflink",
+  [COPY_STRATEGY_COPY_FILE_RANGE] = "copy_file_range",
+  [COPY_STRATEGY_READ_WRITE] = "read/write",
+};
+
+typedef struct
 {
   gchar *source_root;
   gchar *dest_root;
   PvCopyFlags flags;
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  /* Protected by @lock */
+  guint in_flight;
+  /* Protected by @lock */
   GError *error;
-} nftw_data;
+  /* Protected by @lock */
+  guint64 n_files[N_COPY_STRATEGIES];
+  /* Protected by @lock */
+  guint64 n_bytes[N_COPY_STRATEGIES];
+  /* Accessed atomically. Initially TRUE, set to FALSE if the
+   * destination filesystem turns out not to support it. */
+  gint try_reflink;
+  gint try_copy_file_range;
+  /* Accessed atomically */
+  gint hard_link_warned;
+} CopyTreeState;
+
+/*
+ * A regular file (or other non-directory, non-symlink) to be copied
+ * by a worker thread.
+ */
+typedef struct
+{
+  gchar *source;
+  gchar *dest;
+  struct stat source_stat;
+} CopyTask;
+
+static void
+copy_task_free (CopyTask *self)
+{
+  g_free (self->source);
+  g_free (self->dest);
+  g_free (self);
+}
 
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (CopyTask, copy_task_free)
+
+/*
+ * Copy the contents of @source_fd into @dest_fd, which must both be
+ * at offset 0, using the cheapest method that works.
+ */
 static gboolean
-copy_regular_file (const char *source,
+copy_file_data (CopyTreeState *state,
+                int source_fd,
+                int dest_fd,
+                CopyStrategy *strategy_out,
+                GError **error)
+{
+  g_autofree char *buf = NULL;
+
+  if (g_atomic_int_get (&state->try_reflink)
+      && (state->flags & PV_COPY_FLAGS_FAKE_PSEUDO_FILES) == 0)
+    {
+      if (ioctl (dest_fd, FICLONE, source_fd) == 0)
+        {
+          *strategy_out = COPY_STRATEGY_REFLINK;
+          return TRUE;
+        }
+
+      /* Don't try again for every file if it's fundamentally unsupported */
+      if (G_IN_SET (errno, EOPNOTSUPP, ENOTTY, EXDEV, EINVAL, ENOSYS))
+        g_atomic_int_set (&state->try_reflink, FALSE);
+    }
+
+  if (g_atomic_int_get (&state->try_copy_file_range))
+    {
+      gboolean copied_any = FALSE;
+
+      while (TRUE)
+        {
+          ssize_t n;
+
+          if (state->flags & PV_COPY_FLAGS_FAKE_PSEUDO_FILES)
+            n = 0;
+          else
+            n = copy_file_range (source_fd, NULL, dest_fd, NULL,
+                                 G_MAXSSIZE, 0);
+
+          if (n > 0)
+            {
+              copied_any = TRUE;
+              continue;
+            }
+
+          /* If nothing was copied, the source might be empty, but it
+           * might also be a pseudo-file (procfs, sysfs) or a filesystem
+           * combination for which copy_file_range() reports end-of-file
+           * immediately: let read() find out which */
+          if (n == 0 && !copied_any)
+            break;
+
+          if (n == 0)
+            {
+              *strategy_out = COPY_STRATEGY_COPY_FILE_RANGE;
+              return TRUE;
+            }
+
+          if (errno == EINTR)
+            continue;
+
+          /* If it failed part way through, we can't fall back */
+          if (copied_any
+              || !G_IN_SET (errno, ENOSYS, EXDEV, EINVAL, EOPNOTSUPP))
+            return glnx_throw_errno_prefix (error, "copy_file_range");
+
+          if (G_IN_SET (errno, ENOSYS, EXDEV))
+            g_atomic_int_set (&state->try_copy_file_range, FALSE);
+
+          break;
+        }
+    }
+
+  buf = g_malloc (COPY_BUFFER_SIZE);
+
+  while (TRUE)
+    {
+      ssize_t n = TEMP_FAILURE_RETRY (read (source_fd, buf, COPY_BUFFER_SIZE));
+
+      if (n < 0)
+        return glnx_throw_errno_prefix (error, "read");
+
+      if (n == 0)
+        break;
+
+      if (glnx_loop_write (dest_fd, buf, n) < 0)
+        return glnx_throw_errno_prefix (error, "write");
+    }
+
+  *strategy_out = COPY_STRATEGY_READ_WRITE;
+  return TRUE;
+}
+
+static gboolean
+copy_regular_file (CopyTreeState *state,
+                   const char *source,
                    const struct stat *source_stat,
                    const char *dest,
+                   CopyStrategy *strategy_out,
                    GError **error)
 {
   glnx_autofd int source_fd = -1;
@@ -99,10 +269,10 @@ copy_regular_file (const char *source,
     return glnx_throw_errno_prefix (error, "Unable to open \"%s\" for writing",
                                     temp);
 
-  if (glnx_regfile_copy_bytes (source_fd, dest_fd, (off_t) -1) < 0)
+  if (!copy_file_data (state, source_fd, dest_fd, strategy_out, error))
     {
-      glnx_throw_errno_prefix (error, "Unable to copy \"%s\" to \"%s\"",
-                               source, temp);
+      g_prefix_error (error, "Unable to copy \"%s\" to \"%s\": ",
+                      source, temp);
       goto cleanup;
     }
 
@@ -115,7 +285,7 @@ copy_regular_file (const char *source,
         required_access |= X_OK;
 
       if (saved_errno == EPERM
-          && (nftw_data.flags & PV_COPY_FLAGS_CHMOD_MAY_FAIL) != 0
+          && (state->flags & PV_COPY_FLAGS_CHMOD_MAY_FAIL) != 0
           && access (temp, required_access) == 0)
         {
           /* We don't log warnings here, because production use of
@@ -158,18 +328,22 @@ cleanup:
 }
 
 static gboolean
-link_or_copy_regular_file (const char *fpath,
+link_or_copy_regular_file (CopyTreeState *state,
+                           const char *fpath,
                            const struct stat *sb,
                            const char *dest,
                            GError **error)
 {
+  CopyStrategy strategy = COPY_STRATEGY_HARD_LINK;
   int link_errno = 0;
 
   /* Fast path: try to make a hard link. */
-  if (link (fpath, dest) == 0)
-    return TRUE;
-
-  link_errno = errno;
+  if (state->flags & PV_COPY_FLAGS_FAKE_PSEUDO_FILES)
+    link_errno = EXDEV;
+  else if (link (fpath, dest) == 0)
+    goto out;
+  else
+    link_errno = errno;
 
   /* Slow path: fall back to copying.
    *
@@ -180,12 +354,17 @@ link_or_copy_regular_file (const char *fpath,
    * in link() failing but a copy succeeding, we just try it
    * unconditionally - the worst that can happen is that this
    * fails too. */
-  if (!copy_regular_file (fpath, sb, dest, error))
+  if (!copy_regular_file (state, fpath, sb, dest, &strategy, error))
     return FALSE;
 
   /* If link() failed but copying succeeded, then we might have
-   * a problem that we need to warn about. */
-  if ((nftw_data.flags & PV_COPY_FLAGS_EXPECT_HARD_LINKS) != 0)
+   * a problem that we need to warn about. Only warn once per tree
+   * copied. A reflink is as cheap as a hard link in practice, so
+   * there's no need to warn about that. */
+  if ((state->flags & PV_COPY_FLAGS_EXPECT_HARD_LINKS) != 0
+      && strategy != COPY_STRATEGY_REFLINK
+      && g_atomic_int_compare_and_exchange (&state->hard_link_warned,
+                                            FALSE, TRUE))
     {
       g_warning ("Unable to create hard link \"%s\" to \"%s\": %s",
                  fpath, dest, g_strerror (link_errno));
@@ -193,46 +372,117 @@ link_or_copy_regular_file (const char *fpath,
                  "time and disk space.");
       g_warning ("For best results, \"%s\" and \"%s\" should both "
                  "be on the same fully-featured Linux filesystem.",
-                 nftw_data.source_root, nftw_data.dest_root);
-      /* Only warn once per tree copied */
-      nftw_data.flags &= ~PV_COPY_FLAGS_EXPECT_HARD_LINKS;
+                 state->source_root, state->dest_root);
+    }
+
+out:
+  g_mutex_lock (&state->lock);
+  state->n_files[strategy]++;
+  state->n_bytes[strategy] += sb->st_size;
+  g_mutex_unlock (&state->lock);
+  return TRUE;
+}
+
+/*
+ * GFunc for state->pool: copy one file.
+ */
+static void
+copy_tree_worker (gpointer data,
+                  gpointer user_data)
+{
+  g_autoptr(CopyTask) task = data;
+  g_autoptr(GError) local_error = NULL;
+  CopyTreeState *state = user_data;
+  gboolean failed;
+
+  g_mutex_lock (&state->lock);
+  failed = (state->error != NULL);
+  g_mutex_unlock (&state->lock);
+
+  /* If another thread already failed, there's no point in continuing */
+  if (!failed
+      && !link_or_copy_regular_file (state, task->source, &task->source_stat,
+                                     task->dest, &local_error))
+    {
+      g_mutex_lock (&state->lock);
+
+      if (state->error == NULL)
+        state->error = g_steal_pointer (&local_error);
+
+      g_mutex_unlock (&state->lock);
+    }
+
+  g_clear_pointer (&task, copy_task_free);
+
+  g_mutex_lock (&state->lock);
+  state->in_flight--;
+  g_cond_signal (&state->cond);
+  g_mutex_unlock (&state->lock);
+}
+
+/*
+ * Queue @fpath to be copied to @dest by a worker thread.
+ */
+static gboolean
+copy_tree_queue_file (CopyTreeState *state,
+                      const char *fpath,
+                      const struct stat *sb,
+                      const char *dest,
+                      GError **error)
+{
+  CopyTask *task;
+
+  g_mutex_lock (&state->lock);
+
+  while (state->in_flight >= COPY_MAX_IN_FLIGHT && state->error == NULL)
+    g_cond_wait (&state->cond, &state->lock);
+
+  if (state->error != NULL)
+    {
+      /* pv_cheap_tree_copy() will report state->error instead */
+      g_mutex_unlock (&state->lock);
+      g_set_error_literal (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                           "Cancelled after an earlier error");
+      return FALSE;
     }
 
+  state->in_flight++;
+  g_mutex_unlock (&state->lock);
+
+  task = g_new0 (CopyTask, 1);
+  task->source = g_strdup (fpath);
+  task->dest = g_strdup (dest);
+  task->source_stat = *sb;
+  /* This can't fail, because the pool is not exclusive */
+  g_thread_pool_push (state->pool, task, NULL);
   return TRUE;
 }
 
-static int
-copy_tree_helper (const char *fpath,
-                  const struct stat *sb,
-                  int typeflag,
-                  struct FTW *ftwbuf)
+static gboolean copy_tree_walk (CopyTreeState *state,
+                                const char *fpath,
+                                GError **error);
+
+/*
+ * Copy @fpath, which is below state->source_root, into state->dest_root.
+ * Directories and symbolic links are created immediately, and directories
+ * are recursed into. Other files are queued for worker threads.
+ */
+static gboolean
+copy_tree_entry (CopyTreeState *state,
+                 const char *fpath,
+                 const struct stat *sb,
+                 GError **error)
 {
   size_t len;
   const char *suffix;
   g_autofree gchar *dest = NULL;
   g_autofree gchar *target = NULL;
-  GError **error = &nftw_data.error;
   gboolean usrmerge;
 
-  g_return_val_if_fail (g_str_has_prefix (fpath, nftw_data.source_root), 1);
-
-  if (strcmp (fpath, nftw_data.source_root) == 0)
-    {
-      if (typeflag != FTW_D)
-        {
-          glnx_throw (error, "\"%s\" is not a directory", fpath);
-          return 1;
-        }
-
-      if (!glnx_shutil_mkdir_p_at (-1, nftw_data.dest_root,
-                                   _srt_stat_get_permissions (sb), NULL, error))
-        return 1;
+  g_return_val_if_fail (g_str_has_prefix (fpath, state->source_root), FALSE);
 
-      return 0;
-    }
-
-  len = strlen (nftw_data.source_root);
-  g_return_val_if_fail (fpath[len] == '/', 1);
+  len = strlen (state->source_root);
+  g_return_val_if_fail (fpath[len] == '/', FALSE);
   suffix = &fpath[len + 1];
 
   while (suffix[0] == '/')
@@ -243,201 +493,305 @@ copy_tree_helper (const char *fpath,
   /* If source_root was /path/to/source and fpath was /path/to/source/foo/bar,
    * then suffix is now foo/bar. */
 
-  if ((nftw_data.flags & PV_COPY_FLAGS_USRMERGE) != 0 &&
+  if ((state->flags & PV_COPY_FLAGS_USRMERGE) != 0 &&
       gets_usrmerged (suffix))
     {
       trace ("Transforming to \"usr/%s\" for /usr merge", suffix);
       usrmerge = TRUE;
       /* /path/to/dest/usr/foo/bar */
-      dest = g_build_filename (nftw_data.dest_root, "usr", suffix, NULL);
+      dest = g_build_filename (state->dest_root, "usr", suffix, NULL);
     }
   else
     {
       usrmerge = FALSE;
       /* /path/to/dest/foo/bar */
-      dest = g_build_filename (nftw_data.dest_root, suffix, NULL);
+      dest = g_build_filename (state->dest_root, suffix, NULL);
     }
 
-  switch (typeflag)
+  if (S_ISDIR (sb->st_mode))
     {
-      case FTW_D:
       trace ("Is a directory");
 
-        /* If merging /usr, replace /bin, /sbin, /lib* with symlinks like
-         * /bin -> usr/bin */
-        if (usrmerge && strchr (suffix, '/') == NULL)
-          {
-            /* /path/to/dest/bin or similar */
-            g_autofree gchar *in_root = g_build_filename (nftw_data.dest_root,
-                                                          suffix, NULL);
-
-            target = g_build_filename ("usr", suffix, NULL);
-
-            if (TEMP_FAILURE_RETRY (symlink (target, in_root)) != 0)
-              {
-                glnx_throw_errno_prefix (error,
-                                         "Unable to create symlink \"%s\" -> \"%s\"",
-                                         dest, target);
-                return 1;
-              }
-
-            /* Fall through to create usr/bin or similar too */
-          }
-
-        if (!glnx_shutil_mkdir_p_at (-1, dest, _srt_stat_get_permissions (sb),
-                                     NULL, error))
-          return 1;
-        break;
+      /* If merging /usr, replace /bin, /sbin, /lib* with symlinks like
+       * /bin -> usr/bin */
+      if (usrmerge && strchr (suffix, '/') == NULL)
+        {
+          /* /path/to/dest/bin or similar */
+          g_autofree gchar *in_root = g_build_filename (state->dest_root,
+                                                        suffix, NULL);
 
-      case FTW_SL:
-        target = glnx_readlinkat_malloc (-1, fpath, NULL, error);
-
-        if (target == NULL)
-          return 1;
-
-        trace ("Is a symlink to \"%s\"", target);
-
-        if (usrmerge)
-          {
-            trace ("Checking for compat symlinks into /usr");
-
-            /* Ignore absolute compat symlinks /lib/foo -> /usr/lib/foo.
-             * In this case suffix would be lib/foo. (In a Debian-based
-             * source root, Debian Policy §10.5 says this is the only
-             * form of compat symlink that should exist in this
-             * direction.) */
-            if (g_str_has_prefix (target, "/usr/") &&
-                strcmp (target + 5, suffix) == 0)
-              {
-                trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
-                       fpath, target);
-                return 0;
-              }
-
-            /* Ignore relative compat symlinks /lib/foo -> ../usr/lib/foo. */
-            if (target[0] != '/')
-              {
-                g_autofree gchar *dir = g_path_get_dirname (suffix);
-                g_autofree gchar *joined = NULL;
-                g_autofree gchar *canon = NULL;
-
-                joined = g_build_filename (dir, target, NULL);
-                trace ("Joined: \"%s\"", joined);
-                canon = g_canonicalize_filename (joined, "/");
-                trace ("Canonicalized: \"%s\"", canon);
-
-                if (g_str_has_prefix (canon, "/usr/") &&
-                    strcmp (canon + 5, suffix) == 0)
-                  {
-                    trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
-                           fpath, target);
-                    return 0;
-                  }
-              }
-          }
-
-        if ((nftw_data.flags & PV_COPY_FLAGS_USRMERGE) != 0 &&
-             g_str_has_prefix (suffix, "usr/") &&
-             gets_usrmerged (suffix + 4))
-          {
-            trace ("Checking for compat symlinks out of /usr");
-
-            /* Ignore absolute compat symlinks /usr/lib/foo -> /lib/foo.
-             * In this case suffix would be usr/lib/foo. (In a Debian-based
-             * source root, Debian Policy §10.5 says this is the only
-             * form of compat symlink that should exist in this
-             * direction.) */
-            if (strcmp (suffix + 3, target) == 0)
-              {
-                trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
-                       fpath, target);
-                return 0;
-              }
-
-            /* Ignore relative compat symlinks
-             * /usr/lib/foo -> ../../lib/foo. */
-            if (target[0] != '/')
-              {
-                g_autofree gchar *dir = g_path_get_dirname (suffix);
-                g_autofree gchar *joined = NULL;
-                g_autofree gchar *canon = NULL;
-
-                joined = g_build_filename (dir, target, NULL);
-                trace ("Joined: \"%s\"", joined);
-                canon = g_canonicalize_filename (joined, "/");
-                trace ("Canonicalized: \"%s\"", canon);
-                g_assert (canon[0] == '/');
-
-                if (strcmp (suffix + 3, canon) == 0)
-                  {
-                    trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
-                           fpath, target);
-                    return 0;
-                  }
-              }
-          }
-
-        if (TEMP_FAILURE_RETRY (symlink (target, dest)) != 0)
-          {
-            glnx_throw_errno_prefix (error,
-                                     "Unable to create symlink \"%s\" -> \"%s\"",
-                                     dest, target);
-            return 1;
-          }
-        break;
+          target = g_build_filename ("usr", suffix, NULL);
 
-      case FTW_F:
-        trace ("Is a regular file");
+          if (TEMP_FAILURE_RETRY (symlink (target, in_root)) != 0)
+            return glnx_throw_errno_prefix (error,
+                                            "Unable to create symlink \"%s\" -> \"%s\"",
+                                            dest, target);
+
+          /* Fall through to create usr/bin or similar too */
+        }
 
-        if (!link_or_copy_regular_file (fpath, sb, dest, error))
-          return 1;
+      if (!glnx_shutil_mkdir_p_at (-1, dest, _srt_stat_get_permissions (sb),
+                                   NULL, error))
+        return FALSE;
 
+      return copy_tree_walk (state, fpath, error);
+    }
+  else if (S_ISLNK (sb->st_mode))
+    {
+      target = glnx_readlinkat_malloc (-1, fpath, NULL, error);
+
+      if (target == NULL)
+        return FALSE;
+
+      trace ("Is a symlink to \"%s\"", target);
+
+      if (usrmerge)
+        {
+          trace ("Checking for compat symlinks into /usr");
+
+          /* Ignore absolute compat symlinks /lib/foo -> /usr/lib/foo.
+           * In this case suffix would be lib/foo. (In a Debian-based
+           * source root, Debian Policy §10.5 says this is the only
+           * form of compat symlink that should exist in this
+           * direction.) */
+          if (g_str_has_prefix (target, "/usr/") &&
+              strcmp (target + 5, suffix) == 0)
+            {
+              trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
+                     fpath, target);
+              return TRUE;
+            }
+
+          /* Ignore relative compat symlinks /lib/foo -> ../usr/lib/foo. */
+          if (target[0] != '/')
+            {
+              g_autofree gchar *dir = g_path_get_dirname (suffix);
+              g_autofree gchar *joined = NULL;
+              g_autofree gchar *canon = NULL;
+
+              joined = g_build_filename (dir, target, NULL);
+              trace ("Joined: \"%s\"", joined);
+              canon = g_canonicalize_filename (joined, "/");
+              trace ("Canonicalized: \"%s\"", canon);
+
+              if (g_str_has_prefix (canon, "/usr/") &&
+                  strcmp (canon + 5, suffix) == 0)
+                {
+                  trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
+                         fpath, target);
+                  return TRUE;
+                }
+            }
+        }
+
+      if ((state->flags & PV_COPY_FLAGS_USRMERGE) != 0 &&
+           g_str_has_prefix (suffix, "usr/") &&
+           gets_usrmerged (suffix + 4))
+        {
+          trace ("Checking for compat symlinks out of /usr");
+
+          /* Ignore absolute compat symlinks /usr/lib/foo -> /lib/foo.
+           * In this case suffix would be usr/lib/foo. (In a Debian-based
+           * source root, Debian Policy §10.5 says this is the only
+           * form of compat symlink that should exist in this
+           * direction.) */
+          if (strcmp (suffix + 3, target) == 0)
+            {
+              trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
+                     fpath, target);
+              return TRUE;
+            }
+
+          /* Ignore relative compat symlinks
+           * /usr/lib/foo -> ../../lib/foo. */
+          if (target[0] != '/')
+            {
+              g_autofree gchar *dir = g_path_get_dirname (suffix);
+              g_autofree gchar *joined = NULL;
+              g_autofree gchar *canon = NULL;
+
+              joined = g_build_filename (dir, target, NULL);
+              trace ("Joined: \"%s\"", joined);
+              canon = g_canonicalize_filename (joined, "/");
+              trace ("Canonicalized: \"%s\"", canon);
+              g_assert (canon[0] == '/');
+
+              if (strcmp (suffix + 3, canon) == 0)
+                {
+                  trace ("Ignoring compat symlink \"%s\" -> \"%s\"",
+                         fpath, target);
+                  return TRUE;
+                }
+            }
+        }
+
+      if (TEMP_FAILURE_RETRY (symlink (target, dest)) != 0)
+        return glnx_throw_errno_prefix (error,
+                                        "Unable to create symlink \"%s\" -> \"%s\"",
+                                        dest, target);
+
+      return TRUE;
+    }
+  else
+    {
+      /* Regular files, and anything else that nftw() would have
+       * reported as FTW_F */
+      trace ("Is a regular file");
+      return copy_tree_queue_file (state, fpath, sb, dest, error);
+    }
+}
+
+/*
+ * Copy the contents of the directory @fpath, which is either
+ * state->source_root or below it.
+ */
+static gboolean
+copy_tree_walk (CopyTreeState *state,
+                const char *fpath,
+                GError **error)
+{
+  g_auto(GLnxDirFdIterator) iter = { FALSE };
+
+  if (!glnx_dirfd_iterator_init_at (AT_FDCWD, fpath, FALSE, &iter, error))
+    return glnx_prefix_error (error, "Unable to open directory \"%s\"", fpath);
+
+  while (TRUE)
+    {
+      g_autofree gchar *child = NULL;
+      struct dirent *dent;
+      struct stat sb;
+
+      if (!glnx_dirfd_iterator_next_dent (&iter, &dent, NULL, error))
+        return glnx_prefix_error (error, "Unable to read directory \"%s\"",
+                                  fpath);
+
+      if (dent == NULL)
         break;
 
-      default:
-        glnx_throw (&nftw_data.error,
-                    "Don't know how to handle ftw type flag %d at %s",
-                    typeflag, fpath);
-        return 1;
+      child = g_build_filename (fpath, dent->d_name, NULL);
+
+      if (!glnx_fstatat (iter.fd, dent->d_name, &sb, AT_SYMLINK_NOFOLLOW,
+                         error))
+        return glnx_prefix_error (error, "Unable to get information about \"%s\"",
+                                  child);
+
+      if (!copy_tree_entry (state, child, &sb, error))
+        return FALSE;
     }
 
-  return 0;
+  return TRUE;
 }
 
+/*
+ * pv_cheap_tree_copy:
+ * @source_root: (type filename): The directory to copy from
+ * @dest_root: (type filename): The directory to copy to, which will be
+ *  created if necessary
+ * @flags: Flags affecting how this is done
+ *
+ * Copy @source_root to @dest_root as cheaply as possible.
+ *
+ * Directories and symbolic links are created in the thread that is
+ * walking @source_root. Other files are populated by a pool of worker
+ * threads, each trying a hard link, then a reflink (FICLONE), then
+ * copy_file_range(2), then falling back to a plain copy. A summary of
+ * how many files and bytes were populated by each method is logged.
+ *
+ * This function is re-entrant.
+ *
+ * Returns: %TRUE on success
+ */
 gboolean
 pv_cheap_tree_copy (const char *source_root,
                     const char *dest_root,
                     PvCopyFlags flags,
                     GError **error)
 {
-  int res;
+  g_autoptr(SrtProfilingTimer) timer = NULL;
+  g_autoptr(GError) local_error = NULL;
+  CopyTreeState state =
+  {
+    .flags = flags,
+    .try_reflink = TRUE,
+    .try_copy_file_range = TRUE,
+  };
+  struct stat sb;
+  guint n_threads;
+  guint64 n_files = 0;
+  gboolean ret = FALSE;
+  gsize i;
 
   g_return_val_if_fail (source_root != NULL, FALSE);
   g_return_val_if_fail (dest_root != NULL, FALSE);
   g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
-  /* Can't run concurrently */
-  g_return_val_if_fail (nftw_data.source_root == NULL, FALSE);
 
-  nftw_data.source_root = flatpak_canonicalize_filename (source_root);
-  nftw_data.dest_root = flatpak_canonicalize_filename (dest_root);
-  nftw_data.flags = flags;
-  nftw_data.error = NULL;
+  timer = _srt_profiling_start ("Copy %s to %s", source_root, dest_root);
+  state.source_root = flatpak_canonicalize_filename (source_root);
+  state.dest_root = flatpak_canonicalize_filename (dest_root);
+  g_mutex_init (&state.lock);
+  g_cond_init (&state.cond);
 
-  res = nftw (nftw_data.source_root, copy_tree_helper, 100, FTW_PHYS);
+  n_threads = CLAMP (g_get_num_processors (), 1, COPY_MAX_THREADS);
+  /* Not exclusive, so this cannot fail */
+  state.pool = g_thread_pool_new (copy_tree_worker, &state,
+                                  n_threads, FALSE, NULL);
 
-  if (res == -1)
+  if (lstat (state.source_root, &sb) != 0)
     {
-      g_assert (nftw_data.error == NULL);
-      glnx_throw_errno_prefix (error, "Unable to copy \"%s\" to \"%s\"",
+      glnx_throw_errno_prefix (&local_error,
+                               "Unable to copy \"%s\" to \"%s\"",
                                source_root, dest_root);
     }
-  else if (res != 0)
+  else if (!S_ISDIR (sb.st_mode))
     {
-      g_propagate_error (error, g_steal_pointer (&nftw_data.error));
+      glnx_throw (&local_error, "\"%s\" is not a directory",
+                  state.source_root);
     }
+  else if (glnx_shutil_mkdir_p_at (-1, state.dest_root,
+                                   _srt_stat_get_permissions (&sb),
+                                   NULL, &local_error))
+    {
+      ret = copy_tree_walk (&state, state.source_root, &local_error);
+    }
+
+  /* Wait for all queued files to be finished */
+  g_thread_pool_free (g_steal_pointer (&state.pool), FALSE, TRUE);
 
-  g_clear_pointer (&nftw_data.source_root, g_free);
-  g_clear_pointer (&nftw_data.dest_root, g_free);
-  g_assert (nftw_data.error == NULL);
-  return (res == 0);
+  /* An error from a worker thread takes precedence, because it's the
+   * reason why the main thread was cancelled */
+  if (state.error != NULL)
+    {
+      g_clear_error (&local_error);
+      local_error = g_steal_pointer (&state.error);
+      ret = FALSE;
+    }
+
+  for (i = 0; i < N_COPY_STRATEGIES; i++)
+    {
+      if (state.n_files[i] == 0)
+        continue;
+
+      g_info ("Copied %" G_GUINT64_FORMAT " files "
+              "(%" G_GUINT64_FORMAT " bytes) "
+              "from \"%s\" to \"%s\" by %s",
+              state.n_files[i], state.n_bytes[i],
+              state.source_root, state.dest_root,
+              copy_strategy_names[i]);
+      n_files += state.n_files[i];
+    }
+
+  _srt_profiling_rate (timer, n_files, "files");
+
+  g_clear_pointer (&state.source_root, g_free);
+  g_clear_pointer (&state.dest_root, g_free);
+  g_cond_clear (&state.cond);
+  g_mutex_clear (&state.lock);
+
+  if (!ret)
+    {
+      g_propagate_error (error, g_steal_pointer (&local_error));
+      return FALSE;
+    }
+
+  return TRUE;
 }
@@ -33,6 +33,11 @@
  *  hard links between @source_root and @dest_root.
  * @PV_COPY_FLAGS_CHMOD_MAY_FAIL: Don't fail if unable to copy file
  *  permissions from @source_root to @dest_root.
+ * @PV_COPY_FLAGS_FAKE_PSEUDO_FILES: Copy every file as though it was
+ *  a pseudo-file: behave as though hard links and reflinks are not
+ *  possible, and copy_file_range() reports end-of-file immediately,
+ *  as it can for files in procfs or sysfs. Only intended for unit
+ *  tests, so that they can exercise the read()/write() fallback.
  * @PV_RESOLVE_FLAGS_NONE: No special behaviour.
  *
  * Flags affecting how pv_cheap_tree_copy() behaves.
@@ -42,6 +47,7 @@ typedef enum
   PV_COPY_FLAGS_USRMERGE = (1 << 0),
   PV_COPY_FLAGS_EXPECT_HARD_LINKS = (1 << 1),
   PV_COPY_FLAGS_CHMOD_MAY_FAIL = (1 << 2),
+  PV_COPY_FLAGS_FAKE_PSEUDO_FILES = (1 << 3),
   PV_COPY_FLAGS_NONE = 0
 } PvCopyFlags;
 
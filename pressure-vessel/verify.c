@@ -18,14 +18,20 @@
 
 #include "mtree.h"
 
+static gchar *opt_cache = NULL;
 static gboolean opt_minimized_runtime = FALSE;
 static gchar *opt_mtree = NULL;
 static gboolean opt_quiet = FALSE;
 static gboolean opt_verbose = FALSE;
 static gboolean opt_version = FALSE;
+static gboolean opt_write_index = FALSE;
 
 static GOptionEntry options[] =
 {
+  { "cache", '\0',
+    G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME, &opt_cache,
+    "Remember which files were verified in FILE, and don't hash them "
+    "again if they are unchanged.", "FILE" },
   { "minimized-runtime", '\0',
     G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_minimized_runtime,
     "Verify a minimized runtime.", NULL },
@@ -41,6 +47,10 @@ static GOptionEntry options[] =
   { "version", '\0',
     G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_version,
     "Print version number and exit.", NULL },
+  { "write-index", '\0',
+    G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_write_index,
+    "Instead of verifying, write a binary index of the manifest "
+    "to speed up subsequent use.", NULL },
   { NULL }
 };
 
@@ -62,6 +72,9 @@ run (int argc,
   g_autofree gchar *top = NULL;
   glnx_autofd int top_fd = -1;
   PvMtreeApplyFlags flags = PV_MTREE_APPLY_FLAGS_GZIP;
+  PvMtreeVerifyStats stats = {};
+  g_autofree gchar *hashed = NULL;
+  g_autofree gchar *skipped = NULL;
 
   setlocale (LC_ALL, "");
 
@@ -142,9 +155,19 @@ run (int argc,
   if (opt_minimized_runtime)
     flags |= PV_MTREE_APPLY_FLAGS_MINIMIZED_RUNTIME;
 
-  if (!pv_mtree_verify (mtree, top, top_fd, flags, error))
+  if (opt_write_index)
+    return pv_mtree_write_index (mtree, NULL, flags, error);
+
+  if (!pv_mtree_verify (mtree, top, top_fd, opt_cache,
+                        flags | PV_MTREE_APPLY_FLAGS_PARALLEL,
+                        &stats, error))
     return FALSE;
 
+  hashed = g_format_size (stats.bytes_hashed);
+  skipped = g_format_size (stats.bytes_skipped);
+  g_message ("Hashed %s in %" G_GUINT64_FORMAT " files, "
+             "skipped %s in %" G_GUINT64_FORMAT " unchanged files",
+             hashed, stats.files_hashed, skipped, stats.files_skipped);
   return TRUE;
 }
 
@@ -168,6 +191,7 @@ main (int argc,
     ret = 1;
 
 out:
+  g_free (opt_cache);
   g_free (opt_mtree);
   return ret;
 }
@@ -48,6 +48,8 @@ pv_wrap_options_init (PvWrapOptions *self)
 
   /* Set defaults */
   self->batch = FALSE;
+  self->cache_graphics_drivers = FALSE;
+  self->cache_runtimes = FALSE;
   self->copy_runtime = FALSE;
   self->deterministic = FALSE;
   self->devel = FALSE;
@@ -621,6 +623,10 @@ pv_wrap_options_parse_environment (PvWrapOptions *self,
 
   self->batch = _srt_boolean_environment ("PRESSURE_VESSEL_BATCH",
                                           self->batch);
+  self->cache_graphics_drivers = _srt_boolean_environment ("PRESSURE_VESSEL_CACHE_GRAPHICS_DRIVERS",
+                                                           self->cache_graphics_drivers);
+  self->cache_runtimes = _srt_boolean_environment ("PRESSURE_VESSEL_CACHE_RUNTIMES",
+                                                   self->cache_runtimes);
 
   /* Process COPY_RUNTIME_INFO first so that COPY_RUNTIME and VARIABLE_DIR
    * can override it */
@@ -704,6 +710,27 @@ pv_wrap_options_parse_argv (PvWrapOptions *self,
       G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &self->batch,
       "Disable all interactivity and redirection: ignore --shell*, "
       "--terminal, --xterm, --tty. [Default: if $PRESSURE_VESSEL_BATCH]", NULL },
+    { "cache-graphics-drivers", '\0',
+      G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &self->cache_graphics_drivers,
+      "Remember which DRI, VA-API and VDPAU drivers the graphics provider "
+      "has, in --variable-dir or $XDG_CACHE_HOME, and reuse that list "
+      "when none of the directories searched have changed. "
+      "[Default if $PRESSURE_VESSEL_CACHE_GRAPHICS_DRIVERS is 1]",
+      NULL },
+    { "no-cache-graphics-drivers", '\0',
+      G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &self->cache_graphics_drivers,
+      "Search for graphics drivers every time. [Default]",
+      NULL },
+    { "cache-runtimes", '\0',
+      G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &self->cache_runtimes,
+      "If using --copy-runtime, keep fully set up copies of the runtime "
+      "in --variable-dir and reuse them when nothing relevant has changed. "
+      "[Default if $PRESSURE_VESSEL_CACHE_RUNTIMES is 1]",
+      NULL },
+    { "no-cache-runtimes", '\0',
+      G_OPTION_FLAG_REVERSE, G_OPTION_ARG_NONE, &self->cache_runtimes,
+      "Don't behave as described for --cache-runtimes. [Default]",
+      NULL },
     { "copy-runtime", '\0',
       G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &self->copy_runtime,
       "If a --runtime is used, copy it into --variable-dir and edit the "
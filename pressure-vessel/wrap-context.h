@@ -70,6 +70,8 @@ typedef struct
   Tristate share_home;
 
   gboolean batch;
+  gboolean cache_graphics_drivers;
+  gboolean cache_runtimes;
   gboolean copy_runtime;
   gboolean deterministic;
   gboolean devel;
@@ -593,6 +593,7 @@ main (int argc,
       g_autoptr(PvGraphicsProvider) interpreter_host_provider = NULL;
       PvRuntimeFlags flags = PV_RUNTIME_FLAGS_NONE;
       g_autofree gchar *runtime_resolved = NULL;
+      g_autofree gchar *driver_cache_dir = NULL;
       const char *runtime_path = NULL;
 
       if (self->options.deterministic)
@@ -604,13 +605,25 @@ main (int argc,
       if (self->options.generate_locales)
         flags |= PV_RUNTIME_FLAGS_GENERATE_LOCALES;
 
+      if (self->options.cache_graphics_drivers)
+        {
+          if (self->options.variable_dir != NULL)
+            driver_cache_dir = g_build_filename (self->options.variable_dir,
+                                                 "graphics-drivers", NULL);
+          else
+            driver_cache_dir = g_build_filename (g_get_user_cache_dir (),
+                                                 "pressure-vessel",
+                                                 "graphics-drivers", NULL);
+        }
+
       if (self->options.graphics_provider != NULL
           && self->options.graphics_provider[0] != '\0')
         {
           g_assert (graphics_provider_mount_point != NULL);
           graphics_provider = pv_graphics_provider_new (self->options.graphics_provider,
                                                         graphics_provider_mount_point,
-                                                        TRUE, error);
+                                                        TRUE, driver_cache_dir,
+                                                        error);
 
           if (graphics_provider == NULL)
             goto out;
@@ -631,6 +644,9 @@ main (int argc,
       if (self->options.copy_runtime)
         flags |= PV_RUNTIME_FLAGS_COPY_RUNTIME;
 
+      if (self->options.cache_runtimes)
+        flags |= PV_RUNTIME_FLAGS_CACHE_PREPARED;
+
       if (self->options.deterministic || self->options.single_thread)
         flags |= PV_RUNTIME_FLAGS_SINGLE_THREAD;
 
@@ -650,7 +666,9 @@ main (int argc,
                * it's using the O_NOFOLLOW flag. */
               interpreter_host_provider = pv_graphics_provider_new ("/proc/self/root/",
                                                                     "/proc/self/root/",
-                                                                    FALSE, error);
+                                                                    FALSE,
+                                                                    driver_cache_dir,
+                                                                    error);
               if (interpreter_host_provider == NULL)
                 goto out;
             }
@@ -49,6 +49,14 @@ G_GNUC_INTERNAL const SrtKnownArchitecture *_srt_architecture_get_by_tuple (cons
 
 G_GNUC_INTERNAL gboolean _srt_architecture_can_run (SrtSubprocessRunner *runner,
                                                     const char *multiarch);
+G_GNUC_INTERNAL void _srt_architecture_can_run_async (SrtSubprocessRunner *runner,
+                                                      const char *multiarch,
+                                                      GCancellable *cancellable,
+                                                      GAsyncReadyCallback callback,
+                                                      gpointer user_data);
+G_GNUC_INTERNAL gboolean _srt_architecture_can_run_finish (SrtSubprocessRunner *runner,
+                                                           GAsyncResult *result,
+                                                           GError **error);
 
 const gchar *_srt_architecture_guess_from_elf (int dfd,
                                                const char *file_path,
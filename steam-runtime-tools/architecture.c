@@ -164,6 +164,119 @@ out:
   return ret;
 }
 
+static void
+_srt_architecture_can_run_cb (GObject *source_object,
+                              GAsyncResult *result,
+                              gpointer user_data)
+{
+  SrtSubprocessRunner *runner = SRT_SUBPROCESS_RUNNER (source_object);
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+  g_autoptr(GError) error = NULL;
+  const char *multiarch = g_task_get_task_data (task);
+
+  completed = _srt_subprocess_runner_run_finish (runner, result, &error);
+
+  if (completed == NULL
+      && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+      g_debug ("Testing architecture %s: cancelled", multiarch);
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  if (completed == NULL || !_srt_completed_subprocess_check (completed, &error))
+    {
+      g_debug ("Testing architecture %s: %s", multiarch, error->message);
+      g_task_return_boolean (task, FALSE);
+      return;
+    }
+
+  g_debug ("Testing architecture %s: it works", multiarch);
+  g_task_return_boolean (task, TRUE);
+}
+
+/*
+ * _srt_architecture_can_run_async:
+ * @runner: The subprocess runner
+ * @multiarch: A multiarch tuple
+ * @cancellable: (nullable): If cancelled, the helper is not started,
+ *  or is killed if it has already started
+ * @callback: Called when the check has finished
+ * @user_data: Passed to @callback
+ *
+ * Start the same check as _srt_architecture_can_run(), using
+ * _srt_subprocess_runner_run_async() so that several architectures
+ * can be checked at the same time.
+ */
+void
+_srt_architecture_can_run_async (SrtSubprocessRunner *runner,
+                                 const char *multiarch,
+                                 GCancellable *cancellable,
+                                 GAsyncReadyCallback callback,
+                                 gpointer user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GPtrArray) argv = NULL;
+  g_autoptr(GError) error = NULL;
+  SrtHelperFlags helper_flags = SRT_HELPER_FLAGS_NONE;
+
+  g_return_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner));
+  g_return_if_fail (multiarch != NULL);
+  g_return_if_fail (_srt_check_not_setuid ());
+
+  task = g_task_new (runner, cancellable, callback, user_data);
+  g_task_set_source_tag (task, _srt_architecture_can_run_async);
+  g_task_set_task_data (task, g_strdup (multiarch), g_free);
+
+  argv = _srt_subprocess_runner_get_helper (runner, multiarch, "true",
+                                            helper_flags, &error);
+
+  if (argv == NULL)
+    {
+      g_debug ("%s", error->message);
+      g_task_return_boolean (task, FALSE);
+      return;
+    }
+
+  g_ptr_array_add (argv, NULL);
+
+  g_debug ("Testing architecture %s with %s",
+           multiarch, (const char *) g_ptr_array_index (argv, 0));
+
+  _srt_subprocess_runner_run_async (runner,
+                                    helper_flags,
+                                    (const char * const *) argv->pdata,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                    cancellable,
+                                    _srt_architecture_can_run_cb,
+                                    g_steal_pointer (&task));
+}
+
+/*
+ * _srt_architecture_can_run_finish:
+ * @runner: The subprocess runner
+ * @result: The result passed to the callback
+ * @error: Used to raise %G_IO_ERROR_CANCELLED if the check was cancelled
+ *
+ * Returns: %TRUE if we can run an executable for the architecture
+ *  passed to _srt_architecture_can_run_async(), or %FALSE with no
+ *  error set if we cannot, or %FALSE with @error set if the check
+ *  was cancelled before it could finish
+ */
+gboolean
+_srt_architecture_can_run_finish (SrtSubprocessRunner *runner,
+                                  GAsyncResult *result,
+                                  GError **error)
+{
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), FALSE);
+  g_return_val_if_fail (g_task_is_valid (result, runner), FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+
+  return g_task_propagate_boolean (G_TASK (result), error);
+}
+
 /**
  * srt_architecture_can_run_i386:
  *
@@ -90,3 +90,25 @@ GBytes *_srt_env_overlay_to_env0 (SrtEnvOverlay *self);
 gchar *_srt_env_overlay_to_shell (SrtEnvOverlay *self);
 
 GOptionGroup *_srt_env_overlay_create_option_group (SrtEnvOverlay *self);
+
+/*
+ * SrtEnvBuilder:
+ *
+ * An environment block under construction, which can set and unset
+ * variables in constant time, unlike g_environ_setenv() and
+ * g_environ_unsetenv() which scan and reallocate the whole block
+ * every time.
+ */
+typedef struct _SrtEnvBuilder SrtEnvBuilder;
+
+SrtEnvBuilder *_srt_env_builder_new (const char * const *envp);
+void _srt_env_builder_free (SrtEnvBuilder *self);
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtEnvBuilder, _srt_env_builder_free)
+void _srt_env_builder_set (SrtEnvBuilder *self,
+                           const char *var,
+                           const char *val);
+const char *_srt_env_builder_get (SrtEnvBuilder *self,
+                                  const char *var);
+void _srt_env_builder_apply_overlay (SrtEnvBuilder *self,
+                                     SrtEnvOverlay *overlay);
+GStrv _srt_env_builder_free_to_environ (SrtEnvBuilder *self);
@@ -22,6 +22,7 @@
 #include "steam-runtime-tools/utils-internal.h"
 
 #include <fnmatch.h>
+#include <string.h>
 
 SrtEnvOverlay *
 _srt_env_overlay_new (void)
@@ -503,24 +504,14 @@ GStrv
 _srt_env_overlay_apply (SrtEnvOverlay *self,
                         GStrv envp)
 {
-  g_autoptr(GList) vars = NULL;
-  const GList *iter;
+  g_autoptr(SrtEnvBuilder) builder = NULL;
 
   g_return_val_if_fail (self != NULL, envp);
 
-  vars = _srt_env_overlay_get_vars (self);
-
-  for (iter = vars; iter != NULL; iter = iter->next)
-    {
-      const char *value = g_hash_table_lookup (self->values, iter->data);
-
-      if (value != NULL)
-        envp = g_environ_setenv (envp, iter->data, value, TRUE);
-      else
-        envp = g_environ_unsetenv (envp, iter->data);
-    }
-
-  return g_steal_pointer (&envp);
+  builder = _srt_env_builder_new (_srt_const_strv (envp));
+  g_strfreev (envp);
+  _srt_env_builder_apply_overlay (builder, self);
+  return _srt_env_builder_free_to_environ (g_steal_pointer (&builder));
 }
 
 static void
@@ -709,3 +700,229 @@ _srt_env_overlay_create_option_group (SrtEnvOverlay *self)
 
   return g_steal_pointer (&group);
 }
+
+typedef struct
+{
+  /* (type filename) (owned) */
+  gchar *var;
+  /* (type filename) (owned) (nullable): %NULL if unset */
+  gchar *val;
+} SrtEnvBuilderEntry;
+
+struct _SrtEnvBuilder
+{
+  /* (element-type SrtEnvBuilderEntry), in the order they were first set */
+  GArray *entries;
+  /* Variable name (borrowed from @entries) => index into @entries + 1 */
+  GHashTable *index;
+  /* Entries in the original environment without a '=' (owned) */
+  GPtrArray *malformed;
+};
+
+static void
+srt_env_builder_entry_clear (void *p)
+{
+  SrtEnvBuilderEntry *entry = p;
+
+  g_clear_pointer (&entry->var, g_free);
+  g_clear_pointer (&entry->val, g_free);
+}
+
+static void
+_srt_env_builder_take (SrtEnvBuilder *self,
+                       gchar *var,
+                       gchar *val)
+{
+  gpointer i;
+
+  if (g_hash_table_lookup_extended (self->index, var, NULL, &i))
+    {
+      SrtEnvBuilderEntry *entry = &g_array_index (self->entries,
+                                                  SrtEnvBuilderEntry,
+                                                  GPOINTER_TO_UINT (i) - 1);
+
+      g_free (var);
+      g_free (entry->val);
+      entry->val = val;
+    }
+  else
+    {
+      SrtEnvBuilderEntry entry = { var, val };
+
+      g_array_append_val (self->entries, entry);
+      g_hash_table_insert (self->index, var,
+                           GUINT_TO_POINTER (self->entries->len));
+    }
+}
+
+/*
+ * _srt_env_builder_new:
+ * @envp: (nullable) (array zero-terminated=1): The initial environment
+ *
+ * Start building an environment block based on @envp.
+ * If @envp contains more than one value for a variable, only the first
+ * is kept, consistent with g_environ_getenv().
+ *
+ * Returns: (transfer full): A new environment builder
+ */
+SrtEnvBuilder *
+_srt_env_builder_new (const char * const *envp)
+{
+  SrtEnvBuilder *self = g_new0 (SrtEnvBuilder, 1);
+  gsize n = (envp == NULL ? 0 : g_strv_length ((gchar **) envp));
+  gsize i;
+
+  self->entries = g_array_sized_new (FALSE, FALSE,
+                                     sizeof (SrtEnvBuilderEntry), n);
+  g_array_set_clear_func (self->entries, srt_env_builder_entry_clear);
+  self->index = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < n; i++)
+    {
+      const char *eq = strchr (envp[i], '=');
+      g_autofree gchar *var = NULL;
+
+      if (eq == NULL)
+        {
+          if (self->malformed == NULL)
+            self->malformed = g_ptr_array_new_with_free_func (g_free);
+
+          g_ptr_array_add (self->malformed, g_strdup (envp[i]));
+          continue;
+        }
+
+      var = g_strndup (envp[i], eq - envp[i]);
+
+      if (!g_hash_table_contains (self->index, var))
+        _srt_env_builder_take (self, g_steal_pointer (&var),
+                               g_strdup (eq + 1));
+    }
+
+  return self;
+}
+
+void
+_srt_env_builder_free (SrtEnvBuilder *self)
+{
+  g_return_if_fail (self != NULL);
+
+  g_clear_pointer (&self->index, g_hash_table_unref);
+  g_clear_pointer (&self->entries, g_array_unref);
+  g_clear_pointer (&self->malformed, g_ptr_array_unref);
+  g_free (self);
+}
+
+/*
+ * _srt_env_builder_set:
+ * @self: An environment builder
+ * @var: (type filename): An environment variable name
+ * @val: (type filename) (nullable): A value for the environment variable,
+ *  or %NULL to unset it
+ *
+ * Equivalent to g_environ_setenv() with overwrite set to %TRUE,
+ * or g_environ_unsetenv() if @val is %NULL.
+ */
+void
+_srt_env_builder_set (SrtEnvBuilder *self,
+                      const char *var,
+                      const char *val)
+{
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (var != NULL);
+  g_return_if_fail (strchr (var, '=') == NULL);
+
+  _srt_env_builder_take (self, g_strdup (var), g_strdup (val));
+}
+
+/*
+ * _srt_env_builder_get:
+ * @self: An environment builder
+ * @var: (type filename): An environment variable name
+ *
+ * Returns: (type filename) (nullable): The value of @var, or %NULL
+ *  if it is unset
+ */
+const char *
+_srt_env_builder_get (SrtEnvBuilder *self,
+                      const char *var)
+{
+  gpointer i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (var != NULL, NULL);
+
+  if (!g_hash_table_lookup_extended (self->index, var, NULL, &i))
+    return NULL;
+
+  return g_array_index (self->entries, SrtEnvBuilderEntry,
+                        GPOINTER_TO_UINT (i) - 1).val;
+}
+
+/*
+ * _srt_env_builder_apply_overlay:
+ * @self: An environment builder
+ * @overlay: Variables to set and unset
+ *
+ * Set and unset environment variables according to the instructions
+ * in @overlay, as for _srt_env_overlay_apply().
+ */
+void
+_srt_env_builder_apply_overlay (SrtEnvBuilder *self,
+                                SrtEnvOverlay *overlay)
+{
+  g_autoptr(GList) vars = NULL;
+  const GList *iter;
+
+  g_return_if_fail (self != NULL);
+  g_return_if_fail (overlay != NULL);
+
+  /* Sorted, so that new variables are added in a predictable order */
+  vars = _srt_env_overlay_get_vars (overlay);
+
+  for (iter = vars; iter != NULL; iter = iter->next)
+    _srt_env_builder_set (self, iter->data,
+                          g_hash_table_lookup (overlay->values, iter->data));
+}
+
+/*
+ * _srt_env_builder_free_to_environ:
+ * @self: (transfer full): An environment builder
+ *
+ * Free @self and return the environment that it built. Variables that
+ * were in the initial environment are in their original order, followed
+ * by new variables in the order they were first set.
+ *
+ * Returns: (transfer full): The new environment block
+ */
+GStrv
+_srt_env_builder_free_to_environ (SrtEnvBuilder *self)
+{
+  g_autoptr(GPtrArray) ret = NULL;
+  gsize i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+
+  ret = g_ptr_array_sized_new (self->entries->len
+                               + (self->malformed == NULL ? 0 : self->malformed->len)
+                               + 1);
+
+  for (i = 0; i < self->entries->len; i++)
+    {
+      const SrtEnvBuilderEntry *entry = &g_array_index (self->entries,
+                                                        SrtEnvBuilderEntry,
+                                                        i);
+
+      if (entry->val != NULL)
+        g_ptr_array_add (ret, g_strconcat (entry->var, "=", entry->val, NULL));
+    }
+
+  if (self->malformed != NULL)
+    {
+      for (i = 0; i < self->malformed->len; i++)
+        g_ptr_array_add (ret, g_steal_pointer (&g_ptr_array_index (self->malformed, i)));
+    }
+
+  g_ptr_array_add (ret, NULL);
+  _srt_env_builder_free (self);
+  return (GStrv) g_ptr_array_free (g_steal_pointer (&ret), FALSE);
+}
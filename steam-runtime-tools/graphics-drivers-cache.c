@@ -0,0 +1,506 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+
+#include "steam-runtime-tools/graphics.h"
+#include "steam-runtime-tools/graphics-internal.h"
+#include "steam-runtime-tools/json-glib-backports-internal.h"
+#include "steam-runtime-tools/json-utils-internal.h"
+#include "steam-runtime-tools/resolve-in-sysroot-internal.h"
+#include "steam-runtime-tools/subprocess-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "libglnx.h"
+
+/*
+ * Cache of the DRI, VA-API and VDPAU drivers found by
+ * _srt_list_graphics_modules().
+ *
+ * Each cache file describes one module type for one architecture in one
+ * sysroot, and is named after a hash of everything that can change the
+ * search path: the sysroot, the architecture, the check flags and the
+ * environment variables that the loaders respect. It records the result
+ * of the search, together with a stamp (device, inode, size, mtime, ctime)
+ * for every directory that was searched, every driver that was found and
+ * a few files like ld.so.cache that affect where the loaders are found.
+ *
+ * Upgrading, installing or removing a driver package renames files into
+ * or out of at least one of those directories, or rewrites a driver in
+ * place, either of which changes a stamp and invalidates the cache entry.
+ */
+
+#define CACHE_FORMAT_VERSION 1
+
+/* Environment variables that affect any of the searches */
+static const char * const cache_environment[] =
+{
+  "LIBGL_DRIVERS_PATH",
+  "LIBVA_DRIVERS_PATH",
+  "VDPAU_DRIVER",
+  "VDPAU_DRIVER_PATH",
+  "LD_LIBRARY_PATH",
+  NULL
+};
+
+static const char * const module_members[] =
+{
+  [SRT_GRAPHICS_DRI_MODULE] = "dri_drivers",
+  [SRT_GRAPHICS_VAAPI_MODULE] = "va-api_drivers",
+  [SRT_GRAPHICS_VDPAU_MODULE] = "vdpau_drivers",
+};
+
+static gchar *
+graphics_modules_cache_key (SrtSysroot *sysroot,
+                            SrtSubprocessRunner *runner,
+                            const char *multiarch_tuple,
+                            SrtCheckFlags check_flags,
+                            SrtGraphicsModule which)
+{
+  const char * const *envp = _srt_subprocess_runner_get_environ (runner);
+  g_autoptr(GString) key = g_string_new ("");
+  gsize i;
+
+  g_string_append_printf (key, "version=%d\n", CACHE_FORMAT_VERSION);
+  g_string_append_printf (key, "sysroot=%s\n", _srt_sysroot_get_path (sysroot));
+  g_string_append_printf (key, "multiarch=%s\n", multiarch_tuple);
+  g_string_append_printf (key, "module=%s\n", module_members[which]);
+  g_string_append_printf (key, "flags=0x%x\n", check_flags);
+
+  for (i = 0; cache_environment[i] != NULL; i++)
+    {
+      const char *value = _srt_environ_getenv (envp, cache_environment[i]);
+
+      if (value == NULL)
+        g_string_append_printf (key, "unset %s\n", cache_environment[i]);
+      else
+        g_string_append_printf (key, "%s=%s\n", cache_environment[i], value);
+    }
+
+  return g_string_free (g_steal_pointer (&key), FALSE);
+}
+
+/*
+ * dependency_stamp:
+ * @sysroot: The root directory
+ * @path: A path in @sysroot
+ * @mtime_out: (out) (optional): Used to return the mtime of @path,
+ *  or 0 if it does not exist
+ *
+ * Returns: A string that changes whenever @path is replaced or modified,
+ *  or the empty string if it does not exist
+ */
+static gchar *
+dependency_stamp (SrtSysroot *sysroot,
+                  const char *path,
+                  gint64 *mtime_out)
+{
+  g_autoptr(GError) local_error = NULL;
+  glnx_autofd int fd = -1;
+  struct stat stat_buf;
+
+  if (mtime_out != NULL)
+    *mtime_out = 0;
+
+  fd = _srt_sysroot_open (sysroot, path, SRT_RESOLVE_FLAGS_NONE,
+                          NULL, &local_error);
+
+  if (fd < 0 || fstat (fd, &stat_buf) != 0)
+    return g_strdup ("");
+
+  if (mtime_out != NULL)
+    *mtime_out = stat_buf.st_mtim.tv_sec;
+
+  return g_strdup_printf ("%" G_GUINT64_FORMAT
+                          ":%" G_GUINT64_FORMAT
+                          ":%o"
+                          ":%" G_GINT64_FORMAT
+                          ":%" G_GINT64_FORMAT ".%09ld"
+                          ":%" G_GINT64_FORMAT ".%09ld",
+                          (guint64) stat_buf.st_dev,
+                          (guint64) stat_buf.st_ino,
+                          (unsigned) (stat_buf.st_mode & S_IFMT),
+                          (gint64) stat_buf.st_size,
+                          (gint64) stat_buf.st_mtim.tv_sec,
+                          (long) stat_buf.st_mtim.tv_nsec,
+                          (gint64) stat_buf.st_ctim.tv_sec,
+                          (long) stat_buf.st_ctim.tv_nsec);
+}
+
+static const char *
+graphics_module_get_library_path (SrtGraphicsModule which,
+                                  gpointer driver)
+{
+  switch (which)
+    {
+      case SRT_GRAPHICS_DRI_MODULE:
+        return srt_dri_driver_get_library_path (driver);
+
+      case SRT_GRAPHICS_VAAPI_MODULE:
+        return srt_va_api_driver_get_library_path (driver);
+
+      case SRT_GRAPHICS_VDPAU_MODULE:
+        return srt_vdpau_driver_get_library_path (driver);
+
+      case SRT_GRAPHICS_GLX_MODULE:
+      case NUM_SRT_GRAPHICS_MODULES:
+      default:
+        g_return_val_if_reached (NULL);
+    }
+}
+
+/*
+ * graphics_modules_cache_load:
+ * @cache_dir: Directory containing cache files
+ * @filename: Name of the cache file within @cache_dir
+ * @key: The expected cache key
+ * @sysroot: The root directory
+ * @which: Graphics modules to look for
+ * @modules_out: (out) (transfer full): Used to return the drivers,
+ *  in the same order as _srt_list_graphics_modules()
+ *
+ * Returns: %TRUE if the cache file is still valid
+ */
+static gboolean
+graphics_modules_cache_load (const char *cache_dir,
+                             const char *filename,
+                             const char *key,
+                             SrtSysroot *sysroot,
+                             SrtGraphicsModule which,
+                             GList **modules_out,
+                             GError **error)
+{
+  g_autoptr(JsonNode) node = NULL;
+  g_autofree gchar *contents = NULL;
+  glnx_autofd int dirfd = -1;
+  JsonObject *root;
+  JsonObject *dependencies;
+  const char *cached_key;
+  GList *members = NULL;
+  const GList *iter;
+  gboolean ret = FALSE;
+
+  if (!glnx_opendirat (AT_FDCWD, cache_dir, TRUE, &dirfd, error))
+    return FALSE;
+
+  contents = glnx_file_get_contents_utf8_at (dirfd, filename, NULL,
+                                             NULL, error);
+
+  if (contents == NULL)
+    return FALSE;
+
+  node = json_from_string (contents, error);
+
+  if (node == NULL)
+    return FALSE;
+
+  if (!JSON_NODE_HOLDS_OBJECT (node))
+    return glnx_throw (error, "Expected to find a JSON object");
+
+  root = json_node_get_object (node);
+  cached_key = json_object_get_string_member_with_default (root, "key", NULL);
+
+  if (g_strcmp0 (cached_key, key) != 0)
+    return glnx_throw (error, "Cache key does not match");
+
+  if (!json_object_has_member (root, "dependencies"))
+    return glnx_throw (error, "Cache file has no dependencies");
+
+  dependencies = json_object_get_object_member (root, "dependencies");
+
+  if (dependencies == NULL)
+    return glnx_throw (error, "Cache file has no dependencies");
+
+  members = json_object_get_members (dependencies);
+
+  for (iter = members; iter != NULL; iter = iter->next)
+    {
+      const char *path = iter->data;
+      const char *expected;
+      g_autofree gchar *stamp = NULL;
+
+      expected = json_object_get_string_member_with_default (dependencies,
+                                                             path, NULL);
+      stamp = dependency_stamp (sysroot, path, NULL);
+
+      if (g_strcmp0 (expected, stamp) != 0)
+        {
+          glnx_throw (error, "\"%s\" has changed", path);
+          goto out;
+        }
+    }
+
+  switch (which)
+    {
+      case SRT_GRAPHICS_DRI_MODULE:
+        *modules_out = _srt_dri_driver_get_from_report (root);
+        break;
+
+      case SRT_GRAPHICS_VAAPI_MODULE:
+        *modules_out = _srt_va_api_driver_get_from_report (root);
+        break;
+
+      case SRT_GRAPHICS_VDPAU_MODULE:
+        *modules_out = _srt_vdpau_driver_get_from_report (root);
+        break;
+
+      case SRT_GRAPHICS_GLX_MODULE:
+      case NUM_SRT_GRAPHICS_MODULES:
+      default:
+        g_return_val_if_reached (FALSE);
+    }
+
+  ret = TRUE;
+
+out:
+  g_list_free (members);
+  return ret;
+}
+
+static void
+graphics_modules_cache_add_driver (JsonBuilder *builder,
+                                   SrtGraphicsModule which,
+                                   gpointer driver)
+{
+  gboolean is_extra = FALSE;
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "library_path");
+  json_builder_add_string_value (builder,
+                                 graphics_module_get_library_path (which, driver));
+
+  switch (which)
+    {
+      case SRT_GRAPHICS_DRI_MODULE:
+        is_extra = srt_dri_driver_is_extra (driver);
+        break;
+
+      case SRT_GRAPHICS_VAAPI_MODULE:
+        {
+          SrtVaApiVersion version = srt_va_api_driver_get_version (driver);
+
+          if (version != SRT_VA_API_VERSION_UNKNOWN)
+            {
+              json_builder_set_member_name (builder, "version");
+              json_builder_add_string_value (builder,
+                                             srt_enum_value_to_nick (SRT_TYPE_VA_API_VERSION,
+                                                                     version));
+            }
+
+          is_extra = srt_va_api_driver_is_extra (driver);
+        }
+        break;
+
+      case SRT_GRAPHICS_VDPAU_MODULE:
+        if (srt_vdpau_driver_get_library_link (driver) != NULL)
+          {
+            json_builder_set_member_name (builder, "library_link");
+            json_builder_add_string_value (builder,
+                                           srt_vdpau_driver_get_library_link (driver));
+          }
+
+        is_extra = srt_vdpau_driver_is_extra (driver);
+        break;
+
+      case SRT_GRAPHICS_GLX_MODULE:
+      case NUM_SRT_GRAPHICS_MODULES:
+      default:
+        g_return_if_reached ();
+    }
+
+  json_builder_set_member_name (builder, "is_extra");
+  json_builder_add_boolean_value (builder, is_extra);
+  json_builder_end_object (builder);
+}
+
+/*
+ * graphics_modules_cache_save:
+ * @cache_dir: Directory containing cache files, created if necessary
+ * @filename: Name of the cache file within @cache_dir
+ * @key: The cache key
+ * @sysroot: The root directory
+ * @which: Graphics modules that were searched for
+ * @dependencies: (element-type filename): Paths in @sysroot that
+ *  affected @modules
+ * @modules: The drivers that were found
+ * @started: Wall-clock time at which the search started, in microseconds
+ *
+ * Returns: %TRUE if the cache file was written, or if it was
+ *  deliberately not written
+ */
+static gboolean
+graphics_modules_cache_save (const char *cache_dir,
+                             const char *filename,
+                             const char *key,
+                             SrtSysroot *sysroot,
+                             SrtGraphicsModule which,
+                             GHashTable *dependencies,
+                             const GList *modules,
+                             gint64 started,
+                             GError **error)
+{
+  g_autoptr(JsonBuilder) builder = json_builder_new ();
+  g_autoptr(JsonGenerator) generator = NULL;
+  g_autoptr(JsonNode) root = NULL;
+  g_autofree gchar *text = NULL;
+  g_autofree const char **paths = NULL;
+  glnx_autofd int dirfd = -1;
+  const GList *iter;
+  gsize i;
+
+  for (iter = modules; iter != NULL; iter = iter->next)
+    g_hash_table_add (dependencies,
+                      g_strdup (graphics_module_get_library_path (which,
+                                                                  iter->data)));
+
+  paths = (const char **) g_hash_table_get_keys_as_array (dependencies, NULL);
+  qsort (paths, g_hash_table_size (dependencies), sizeof (char *),
+         _srt_indirect_strcmp0);
+
+  json_builder_begin_object (builder);
+  json_builder_set_member_name (builder, "key");
+  json_builder_add_string_value (builder, key);
+  json_builder_set_member_name (builder, "dependencies");
+  json_builder_begin_object (builder);
+
+  for (i = 0; paths[i] != NULL; i++)
+    {
+      g_autofree gchar *stamp = NULL;
+      gint64 mtime;
+
+      stamp = dependency_stamp (sysroot, paths[i], &mtime);
+
+      /* If something changed while we were searching, or so shortly
+       * before that a later change might not alter the timestamp on a
+       * filesystem with coarse timestamps, we can't be sure that the
+       * result matches the stamp. Try again next time instead.
+       * Changes that set an older mtime still change the ctime, which
+       * is part of the stamp. */
+      if (mtime >= (started / G_USEC_PER_SEC) - 1)
+        {
+          g_debug ("Not caching %s for %s: \"%s\" changed recently",
+                   module_members[which], _srt_sysroot_get_path (sysroot),
+                   paths[i]);
+          return TRUE;
+        }
+
+      json_builder_set_member_name (builder, paths[i]);
+      json_builder_add_string_value (builder, stamp);
+    }
+
+  json_builder_end_object (builder);
+  json_builder_set_member_name (builder, module_members[which]);
+  json_builder_begin_array (builder);
+
+  for (iter = modules; iter != NULL; iter = iter->next)
+    graphics_modules_cache_add_driver (builder, which, iter->data);
+
+  json_builder_end_array (builder);
+  json_builder_end_object (builder);
+
+  root = json_builder_get_root (builder);
+  generator = json_generator_new ();
+  json_generator_set_root (generator, root);
+  text = json_generator_to_data (generator, NULL);
+
+  if (!glnx_shutil_mkdir_p_at (AT_FDCWD, cache_dir, 0700, NULL, error))
+    return FALSE;
+
+  if (!glnx_opendirat (AT_FDCWD, cache_dir, TRUE, &dirfd, error))
+    return FALSE;
+
+  return glnx_file_replace_contents_at (dirfd, filename,
+                                        (const guint8 *) text, strlen (text),
+                                        GLNX_FILE_REPLACE_NODATASYNC,
+                                        NULL, error);
+}
+
+/*
+ * _srt_list_graphics_modules_cached:
+ * @cache_dir: (type filename): Directory in which to store cache files
+ * @sysroot: (not nullable): The root directory, usually `/`
+ * @runner: The execution environment
+ * @multiarch_tuple: (not nullable) (type filename): A Debian-style multiarch tuple
+ *  such as %SRT_ABI_X86_64
+ * @check_flags: Flags affecting how we do the search
+ * @which: Graphics modules to look for
+ *
+ * Same as _srt_list_graphics_modules(), but reuse the result of a
+ * previous search if none of the directories or files that it depended
+ * on have changed since then. GLX modules are not cached, and neither
+ * is the result of a search that could not be completed.
+ *
+ * Returns: (transfer full) (element-type GObject) (nullable): A list of
+ *  opaque #SrtDriDriver, etc. objects, or %NULL if nothing was found. Free with
+ *  `g_list_free_full(list, g_object_unref)`.
+ */
+GList *
+_srt_list_graphics_modules_cached (const char *cache_dir,
+                                   SrtSysroot *sysroot,
+                                   SrtSubprocessRunner *runner,
+                                   const char *multiarch_tuple,
+                                   SrtCheckFlags check_flags,
+                                   SrtGraphicsModule which)
+{
+  g_autoptr(GHashTable) dependencies = NULL;
+  g_autoptr(GError) local_error = NULL;
+  g_autofree gchar *key = NULL;
+  g_autofree gchar *filename = NULL;
+  g_autofree gchar *digest = NULL;
+  GList *modules = NULL;
+  gboolean complete = FALSE;
+  gint64 started;
+
+  g_return_val_if_fail (cache_dir != NULL, NULL);
+  g_return_val_if_fail (SRT_IS_SYSROOT (sysroot), NULL);
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), NULL);
+  g_return_val_if_fail (multiarch_tuple != NULL, NULL);
+
+  if (which == SRT_GRAPHICS_GLX_MODULE)
+    return _srt_list_graphics_modules (sysroot, runner, multiarch_tuple,
+                                       check_flags, which, NULL, NULL);
+
+  key = graphics_modules_cache_key (sysroot, runner, multiarch_tuple,
+                                    check_flags, which);
+  digest = g_compute_checksum_for_string (G_CHECKSUM_SHA256, key, -1);
+  filename = g_strdup_printf ("%s.json", digest);
+
+  if (graphics_modules_cache_load (cache_dir, filename, key, sysroot,
+                                   which, &modules, &local_error))
+    {
+      g_debug ("Reusing cached %s for %s in %s",
+               module_members[which], multiarch_tuple,
+               _srt_sysroot_get_path (sysroot));
+      return modules;
+    }
+
+  g_debug ("Unable to use cached %s for %s in %s: %s",
+           module_members[which], multiarch_tuple,
+           _srt_sysroot_get_path (sysroot), local_error->message);
+  g_clear_error (&local_error);
+
+  dependencies = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  started = g_get_real_time ();
+  modules = _srt_list_graphics_modules (sysroot, runner, multiarch_tuple,
+                                        check_flags, which, dependencies,
+                                        &complete);
+
+  /* If a helper failed, the next search might find more */
+  if (!complete)
+    g_debug ("Not caching %s for %s in %s: search was incomplete",
+             module_members[which], multiarch_tuple,
+             _srt_sysroot_get_path (sysroot));
+  else if (!graphics_modules_cache_save (cache_dir, filename, key, sysroot,
+                                         which, dependencies, modules,
+                                         started, &local_error))
+    g_debug ("Unable to save cached %s: %s",
+             module_members[which], local_error->message);
+
+  return modules;
+}
@@ -528,20 +528,23 @@ srt_egl_icd_write_to_file (SrtEglIcd *self,
 
 static void
 egl_icd_load_json_cb (SrtSysroot *sysroot,
+                      SrtJsonManifestCache *cache,
                       const char *filename,
                       void *user_data)
 {
-  prepend_manifest_from_json (SRT_TYPE_EGL_ICD, sysroot, filename,
+  prepend_manifest_from_json (SRT_TYPE_EGL_ICD, sysroot, cache, filename,
                               MANIFEST_JSON_MEMBER_NAME_ICD, user_data);
 }
 
 static void
 egl_external_platform_load_json_cb (SrtSysroot *sysroot,
+                                    SrtJsonManifestCache *cache,
                                     const char *filename,
                                     void *user_data)
 {
-  prepend_manifest_from_json (SRT_TYPE_EGL_EXTERNAL_PLATFORM, sysroot, filename,
-                              MANIFEST_JSON_MEMBER_NAME_ICD, user_data);
+  prepend_manifest_from_json (SRT_TYPE_EGL_EXTERNAL_PLATFORM, sysroot, cache,
+                              filename, MANIFEST_JSON_MEMBER_NAME_ICD,
+                              user_data);
 }
 
 #define EGL_VENDOR_SUFFIX "glvnd/egl_vendor.d"
@@ -657,7 +660,7 @@ _srt_load_egl_things (GType which,
       g_auto(GStrv) filenames = g_strsplit (value, G_SEARCHPATH_SEPARATOR_S, -1);
 
       for (i = 0; filenames[i] != NULL; i++)
-        prepend_manifest_from_json (which, sysroot, filenames[i],
+        prepend_manifest_from_json (which, sysroot, NULL, filenames[i],
                                     MANIFEST_JSON_MEMBER_NAME_ICD, &ret);
     }
   else
@@ -170,6 +170,31 @@ void _srt_base_json_graphics_module_set_library_arch (SrtBaseJsonGraphicsModule
 void _srt_base_json_graphics_module_take_original_json (SrtBaseJsonGraphicsModule *self,
                                                         gchar *contents);
 
+typedef struct _SrtJsonManifest SrtJsonManifest;
+typedef struct _SrtJsonManifestCache SrtJsonManifestCache;
+
+SrtJsonManifestCache *_srt_json_manifest_cache_new (void);
+void _srt_json_manifest_cache_free (SrtJsonManifestCache *self);
+SrtJsonManifest *_srt_json_manifest_load (SrtJsonManifestCache *cache,
+                                          SrtSysroot *sysroot,
+                                          const char *path,
+                                          SrtResolveFlags flags,
+                                          gchar **resolved,
+                                          GError **error);
+SrtJsonManifest *_srt_json_manifest_ref (SrtJsonManifest *self);
+void _srt_json_manifest_unref (void *self);
+const char *_srt_json_manifest_get_contents (SrtJsonManifest *self,
+                                             gsize *len_out);
+gboolean _srt_json_manifest_get_root (SrtJsonManifest *self,
+                                      JsonNode **root_out,
+                                      GError **error);
+void _srt_json_manifest_prefetch (SrtJsonManifestCache *cache,
+                                  SrtSysroot *sysroot,
+                                  GPtrArray *paths);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtJsonManifest, _srt_json_manifest_unref)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtJsonManifestCache, _srt_json_manifest_cache_free)
+
 /*
  * A #GCompareFunc that does not sort the members of the directory.
  */
@@ -179,20 +204,28 @@ void load_json_dir (SrtSysroot *sysroot,
                     const char *dir,
                     const char *suffix,
                     GCompareFunc sort,
-                    void (*load_json_cb) (SrtSysroot *, const char *, void *),
+                    void (*load_json_cb) (SrtSysroot *,
+                                          SrtJsonManifestCache *,
+                                          const char *,
+                                          void *),
                     void *user_data);
 void load_json_dirs (SrtSysroot *sysroot,
                      const char * const *search_paths,
                      const char *suffix,
                      GCompareFunc sort,
-                     void (*load_json_cb) (SrtSysroot *, const char *, void *),
+                     void (*load_json_cb) (SrtSysroot *,
+                                           SrtJsonManifestCache *,
+                                           const char *,
+                                           void *),
                      void *user_data);
 GObject *load_manifest_from_json (GType type,
                                   SrtSysroot *sysroot,
+                                  SrtJsonManifestCache *cache,
                                   const char *filename,
                                   const char *json_member_name);
 void prepend_manifest_from_json (GType type,
                                  SrtSysroot *sysroot,
+                                 SrtJsonManifestCache *cache,
                                  const char *filename,
                                  const char *json_member_name,
                                  GList **list);
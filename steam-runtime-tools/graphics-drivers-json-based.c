@@ -32,6 +32,9 @@
 #include "steam-runtime-tools/library-internal.h"
 #include "steam-runtime-tools/resolve-in-sysroot-internal.h"
 
+#include <string.h>
+#include <sys/stat.h>
+
 enum
 {
   BASE_PROP_0,
@@ -711,21 +714,431 @@ _srt_loadable_flag_duplicates (GType which,
 }
 
 /*
- * load_json_dir:
+ * SrtJsonManifest:
+ *
+ * The contents of a JSON manifest, and the result of parsing it.
+ * Manifests that were loaded from regular files can be shared between
+ * callers in different threads via a #SrtJsonManifestCache, so the
+ * parsed tree must be treated as read-only.
+ */
+struct _SrtJsonManifest
+{
+  gchar *contents;
+  gsize len;
+  /* NULL if not parsed, or if parsing failed */
+  JsonParser *parser;
+  /* Set if parsing failed */
+  GError *error;
+};
+
+typedef struct
+{
+  dev_t dev;
+  ino_t ino;
+  gint64 mtime_sec;
+  gint64 mtime_nsec;
+  gint64 ctime_sec;
+  gint64 ctime_nsec;
+  goffset size;
+} ManifestKey;
+
+static guint
+manifest_key_hash (gconstpointer p)
+{
+  const ManifestKey *key = p;
+
+  return (guint) (key->ino
+                  ^ (key->dev << 7)
+                  ^ key->mtime_sec
+                  ^ key->mtime_nsec
+                  ^ key->ctime_sec
+                  ^ key->ctime_nsec
+                  ^ key->size);
+}
+
+static gboolean
+manifest_key_equal (gconstpointer a,
+                    gconstpointer b)
+{
+  const ManifestKey *ka = a;
+  const ManifestKey *kb = b;
+
+  return (ka->dev == kb->dev
+          && ka->ino == kb->ino
+          && ka->mtime_sec == kb->mtime_sec
+          && ka->mtime_nsec == kb->mtime_nsec
+          && ka->ctime_sec == kb->ctime_sec
+          && ka->ctime_nsec == kb->ctime_nsec
+          && ka->size == kb->size);
+}
+
+/*
+ * SrtJsonManifestCache:
+ *
+ * Manifests that were loaded from regular files during one enumeration,
+ * keyed by the file's identity. The identity includes the ctime, so
+ * that a file that was rewritten in-place within the same mtime
+ * granularity is not mistaken for the copy that was cached.
+ */
+struct _SrtJsonManifestCache
+{
+  /* Protects manifests */
+  GMutex lock;
+  /* (element-type ManifestKey SrtJsonManifest) */
+  GHashTable *manifests;
+};
+
+/*
+ * _srt_json_manifest_cache_new:
+ *
+ * Returns: (transfer full): A new, empty cache, which can be used
+ *  from more than one thread
+ */
+SrtJsonManifestCache *
+_srt_json_manifest_cache_new (void)
+{
+  SrtJsonManifestCache *self = g_new0 (SrtJsonManifestCache, 1);
+
+  g_mutex_init (&self->lock);
+  self->manifests = g_hash_table_new_full (manifest_key_hash,
+                                           manifest_key_equal,
+                                           g_free,
+                                           _srt_json_manifest_unref);
+  return self;
+}
+
+void
+_srt_json_manifest_cache_free (SrtJsonManifestCache *self)
+{
+  g_return_if_fail (self != NULL);
+
+  g_clear_pointer (&self->manifests, g_hash_table_unref);
+  g_mutex_clear (&self->lock);
+  g_free (self);
+}
+
+static void
+srt_json_manifest_clear (void *p)
+{
+  SrtJsonManifest *self = p;
+
+  g_clear_pointer (&self->contents, g_free);
+  g_clear_object (&self->parser);
+  g_clear_error (&self->error);
+}
+
+SrtJsonManifest *
+_srt_json_manifest_ref (SrtJsonManifest *self)
+{
+  return g_atomic_rc_box_acquire (self);
+}
+
+void
+_srt_json_manifest_unref (void *self)
+{
+  g_atomic_rc_box_release_full (self, srt_json_manifest_clear);
+}
+
+/*
+ * srt_json_manifest_new_take:
+ * @contents: (transfer full): Contents of the file, with a `\0` appended
+ * @len: Length of @contents, not including the appended `\0`
+ *
+ * Returns: (transfer full): A new manifest
+ */
+static SrtJsonManifest *
+srt_json_manifest_new_take (gchar *contents,
+                            gsize len)
+{
+  SrtJsonManifest *self = g_atomic_rc_box_new0 (SrtJsonManifest);
+
+  self->contents = contents;
+  self->len = len;
+
+  /* Callers diagnose these more clearly than json-glib would,
+   * so don't try to parse them */
+  if (len <= G_MAXSSIZE && strnlen (contents, len + 1) >= len)
+    {
+      self->parser = json_parser_new ();
+
+      if (!json_parser_load_from_data (self->parser, contents, len,
+                                       &self->error))
+        g_clear_object (&self->parser);
+    }
+
+  return self;
+}
+
+/*
+ * _srt_json_manifest_load:
+ * @cache: (nullable): A cache of manifests loaded during the current
+ *  enumeration, or %NULL to always read @path
+ * @sysroot: (not nullable): The root directory, usually `/`
+ * @path: (type filename): Path to a JSON manifest within @sysroot
+ * @flags: Flags affecting how @path is resolved
+ * @resolved: (out) (optional): Used to return the resolved path,
+ *  as for _srt_sysroot_open()
+ * @error: Used to raise an error if @path cannot be read
+ *
+ * Read and parse a JSON manifest, or return a copy from @cache if the
+ * same file was already loaded and has not changed since then.
+ * A manifest that is not valid JSON is not an error here: use
+ * _srt_json_manifest_get_root() to find out whether it could be parsed.
+ *
+ * Returns: (transfer full): The manifest, or %NULL on error
+ */
+SrtJsonManifest *
+_srt_json_manifest_load (SrtJsonManifestCache *cache,
+                         SrtSysroot *sysroot,
+                         const char *path,
+                         SrtResolveFlags flags,
+                         gchar **resolved,
+                         GError **error)
+{
+  g_autoptr(SrtJsonManifest) manifest = NULL;
+  g_autoptr(GBytes) bytes = NULL;
+  glnx_autofd int fd = -1;
+  struct stat stat_buf;
+  ManifestKey key = {};
+  gboolean cacheable;
+  gchar *contents;
+  gsize len;
+
+  g_return_val_if_fail (SRT_IS_SYSROOT (sysroot), NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  fd = _srt_sysroot_open (sysroot, path,
+                          flags | SRT_RESOLVE_FLAGS_READABLE,
+                          resolved, error);
+
+  if (fd < 0)
+    return NULL;
+
+  if (!glnx_fstat (fd, &stat_buf, error))
+    return NULL;
+
+  cacheable = (cache != NULL && S_ISREG (stat_buf.st_mode));
+
+  if (cacheable)
+    {
+      key.dev = stat_buf.st_dev;
+      key.ino = stat_buf.st_ino;
+      key.mtime_sec = stat_buf.st_mtim.tv_sec;
+      key.mtime_nsec = stat_buf.st_mtim.tv_nsec;
+      key.ctime_sec = stat_buf.st_ctim.tv_sec;
+      key.ctime_nsec = stat_buf.st_ctim.tv_nsec;
+      key.size = stat_buf.st_size;
+
+      g_mutex_lock (&cache->lock);
+      manifest = g_hash_table_lookup (cache->manifests, &key);
+
+      if (manifest != NULL)
+        _srt_json_manifest_ref (manifest);
+
+      g_mutex_unlock (&cache->lock);
+
+      if (manifest != NULL)
+        return g_steal_pointer (&manifest);
+    }
+
+  bytes = glnx_fd_readall_bytes (fd, NULL, error);
+
+  if (bytes == NULL)
+    return NULL;
+
+  len = g_bytes_get_size (bytes);
+  contents = g_new0 (char, len + 1);
+
+  if (len > 0)
+    memcpy (contents, g_bytes_get_data (bytes, NULL), len);
+
+  manifest = srt_json_manifest_new_take (contents, len);
+
+  /* If the file changed size while we were reading it, then the key
+   * no longer describes what we read */
+  if (cacheable && len == (gsize) stat_buf.st_size)
+    {
+      SrtJsonManifest *existing;
+
+      g_mutex_lock (&cache->lock);
+      existing = g_hash_table_lookup (cache->manifests, &key);
+
+      if (existing != NULL)
+        {
+          /* Another thread loaded the same file at the same time:
+           * use its copy, so that there is only one */
+          g_clear_pointer (&manifest, _srt_json_manifest_unref);
+          manifest = _srt_json_manifest_ref (existing);
+        }
+      else
+        {
+          ManifestKey *stored = g_new0 (ManifestKey, 1);
+
+          *stored = key;
+          g_hash_table_insert (cache->manifests, stored,
+                               _srt_json_manifest_ref (manifest));
+        }
+
+      g_mutex_unlock (&cache->lock);
+    }
+
+  return g_steal_pointer (&manifest);
+}
+
+/*
+ * _srt_json_manifest_get_contents:
+ * @self: A manifest
+ * @len_out: (out) (optional): Used to return the length of the contents,
+ *  not including the `\0` that is always appended
+ *
+ * Returns: (transfer none): The contents of the manifest, which might
+ *  contain `\0` or be invalid UTF-8
+ */
+const char *
+_srt_json_manifest_get_contents (SrtJsonManifest *self,
+                                 gsize *len_out)
+{
+  g_return_val_if_fail (self != NULL, NULL);
+
+  if (len_out != NULL)
+    *len_out = self->len;
+
+  return self->contents;
+}
+
+/*
+ * _srt_json_manifest_get_root:
+ * @self: A manifest
+ * @root_out: (out) (transfer none) (not optional): Used to return the
+ *  root node, which might be %NULL for an empty document. It remains
+ *  valid for as long as a reference to @self is held, and must not
+ *  be modified.
+ * @error: Used to raise an error if @self could not be parsed
+ *
+ * Returns: %TRUE if @self was parsed successfully
+ */
+gboolean
+_srt_json_manifest_get_root (SrtJsonManifest *self,
+                             JsonNode **root_out,
+                             GError **error)
+{
+  g_return_val_if_fail (self != NULL, FALSE);
+  g_return_val_if_fail (root_out != NULL, FALSE);
+
+  *root_out = NULL;
+
+  if (self->error != NULL)
+    {
+      g_propagate_error (error, g_error_copy (self->error));
+      return FALSE;
+    }
+
+  if (self->parser == NULL)
+    return glnx_throw (error, "JSON file is too large or contains \\0");
+
+  *root_out = json_parser_get_root (self->parser);
+  return TRUE;
+}
+
+typedef struct
+{
+  SrtJsonManifestCache *cache;
+  SrtSysroot *sysroot;
+} PrefetchData;
+
+static void
+json_manifest_prefetch_cb (gpointer data,
+                           gpointer user_data)
+{
+  g_autoptr(SrtJsonManifest) manifest = NULL;
+  g_autoptr(GError) local_error = NULL;
+  PrefetchData *prefetch = user_data;
+  SrtSysroot *sysroot = prefetch->sysroot;
+  const char *path = data;
+
+  manifest = _srt_json_manifest_load (prefetch->cache, sysroot, path,
+                                      SRT_RESOLVE_FLAGS_NONE,
+                                      NULL, &local_error);
+
+  /* The caller will load it again and report the error properly */
+  if (manifest == NULL)
+    g_debug ("Unable to prefetch \"%s%s\": %s",
+             sysroot->path, path, local_error->message);
+}
+
+#define PREFETCH_MAX_THREADS 8
+
+/*
+ * _srt_json_manifest_prefetch:
+ * @cache: (not nullable): A cache of manifests
+ * @sysroot: (not nullable): The root directory, usually `/`
+ * @paths: (element-type filename): Absolute paths to JSON manifests
+ *  within @sysroot
+ *
+ * Read and parse @paths in parallel, so that subsequent calls to
+ * _srt_json_manifest_load() with @cache for the same files will hit
+ * the cache. Errors are ignored here.
+ */
+void
+_srt_json_manifest_prefetch (SrtJsonManifestCache *cache,
+                             SrtSysroot *sysroot,
+                             GPtrArray *paths)
+{
+  g_autoptr(GHashTable) seen = NULL;
+  PrefetchData prefetch = { cache, sysroot };
+  GThreadPool *pool;
+  guint n_threads;
+  gsize i;
+
+  g_return_if_fail (cache != NULL);
+  g_return_if_fail (SRT_IS_SYSROOT (sysroot));
+  g_return_if_fail (paths != NULL);
+
+  if (paths->len < 2)
+    return;
+
+  n_threads = CLAMP (g_get_num_processors (), 1,
+                     MIN (paths->len, PREFETCH_MAX_THREADS));
+
+  if (n_threads < 2)
+    return;
+
+  g_debug ("Prefetching %u JSON manifests in %s with %u threads...",
+           paths->len, sysroot->path, n_threads);
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  /* Not exclusive, so this cannot fail */
+  pool = g_thread_pool_new (json_manifest_prefetch_cb, &prefetch,
+                            n_threads, FALSE, NULL);
+
+  for (i = 0; i < paths->len; i++)
+    {
+      const char *path = g_ptr_array_index (paths, i);
+
+      if (g_hash_table_add (seen, (gpointer) path))
+        g_thread_pool_push (pool, (gpointer) path, NULL);
+    }
+
+  /* Wait for all queued manifests to be loaded */
+  g_thread_pool_free (pool, FALSE, TRUE);
+}
+
+/*
+ * list_json_dir:
  * @sysroot: (not nullable): The root directory, usually `/`
  * @dir: A directory to search
  * @suffix: (nullable): A path to append to @dir, such as `"vulkan/icd.d"`
- * @sort: (nullable): If not %NULL, load ICDs sorted by filename in this order
- * @load_json_cb: Called for each potential ICD found
- * @user_data: Passed to @load_json_cb
+ * @sort: (nullable): If not %NULL, list ICDs sorted by filename in this order
+ * @paths: (element-type filename): Absolute paths to the potential
+ *  ICDs found are appended here
  */
-void
-load_json_dir (SrtSysroot *sysroot,
+static void
+list_json_dir (SrtSysroot *sysroot,
                const char *dir,
                const char *suffix,
                GCompareFunc sort,
-               void (*load_json_cb) (SrtSysroot *, const char *, void *),
-               void *user_data)
+               GPtrArray *paths)
 {
   g_autoptr(GError) error = NULL;
   g_auto(GLnxDirFdIterator) iter = { .initialized = FALSE };
@@ -736,9 +1149,6 @@ load_json_dir (SrtSysroot *sysroot,
   g_autoptr(GPtrArray) members = NULL;
   gsize i;
 
-  g_return_if_fail (SRT_IS_SYSROOT (sysroot));
-  g_return_if_fail (load_json_cb != NULL);
-
   if (dir == NULL)
     return;
 
@@ -797,15 +1207,71 @@ load_json_dir (SrtSysroot *sysroot,
 
   for (i = 0; i < members->len; i++)
     {
-      gchar *path;
-
       member = g_ptr_array_index (members, i);
-      path = g_build_filename (dir, member, NULL);
-      load_json_cb (sysroot, path, user_data);
-      g_free (path);
+      g_ptr_array_add (paths, g_build_filename (dir, member, NULL));
     }
 }
 
+/*
+ * load_json_paths:
+ * @sysroot: (not nullable): The root directory, usually `/`
+ * @paths: (element-type filename): Absolute paths to potential ICDs
+ * @load_json_cb: Called for each item in @paths, in order
+ * @user_data: Passed to @load_json_cb
+ *
+ * Read and parse all of @paths in parallel, then pass each one to
+ * @load_json_cb, together with a manifest cache in which it will find
+ * them. The cache only lasts until this function returns, so files that
+ * change between one enumeration and the next are always re-read.
+ */
+static void
+load_json_paths (SrtSysroot *sysroot,
+                 GPtrArray *paths,
+                 void (*load_json_cb) (SrtSysroot *,
+                                       SrtJsonManifestCache *,
+                                       const char *,
+                                       void *),
+                 void *user_data)
+{
+  g_autoptr(SrtJsonManifestCache) cache = _srt_json_manifest_cache_new ();
+  gsize i;
+
+  _srt_json_manifest_prefetch (cache, sysroot, paths);
+
+  for (i = 0; i < paths->len; i++)
+    load_json_cb (sysroot, cache, g_ptr_array_index (paths, i), user_data);
+}
+
+/*
+ * load_json_dir:
+ * @sysroot: (not nullable): The root directory, usually `/`
+ * @dir: A directory to search
+ * @suffix: (nullable): A path to append to @dir, such as `"vulkan/icd.d"`
+ * @sort: (nullable): If not %NULL, load ICDs sorted by filename in this order
+ * @load_json_cb: Called for each potential ICD found
+ * @user_data: Passed to @load_json_cb
+ */
+void
+load_json_dir (SrtSysroot *sysroot,
+               const char *dir,
+               const char *suffix,
+               GCompareFunc sort,
+               void (*load_json_cb) (SrtSysroot *,
+                                     SrtJsonManifestCache *,
+                                     const char *,
+                                     void *),
+               void *user_data)
+{
+  g_autoptr(GPtrArray) paths = NULL;
+
+  g_return_if_fail (SRT_IS_SYSROOT (sysroot));
+  g_return_if_fail (load_json_cb != NULL);
+
+  paths = g_ptr_array_new_with_free_func (g_free);
+  list_json_dir (sysroot, dir, suffix, sort, paths);
+  load_json_paths (sysroot, paths, load_json_cb, user_data);
+}
+
 /*
  * load_json_dir:
  * @sysroot: (not nullable): The root directory, usually `/`
@@ -816,24 +1282,30 @@ load_json_dir (SrtSysroot *sysroot,
  * @user_data: Passed to @load_json_cb
  *
  * If @search_paths contains duplicated directories they'll be filtered out
- * to prevent loading the same JSONs multiple times.
+ * to prevent loading the same JSONs multiple times. The JSONs from all
+ * directories are read in parallel before @load_json_cb is called.
  */
 void
 load_json_dirs (SrtSysroot *sysroot,
                 const char * const *search_paths,
                 const char *suffix,
                 GCompareFunc sort,
-                void (*load_json_cb) (SrtSysroot *, const char *, void *),
+                void (*load_json_cb) (SrtSysroot *,
+                                      SrtJsonManifestCache *,
+                                      const char *,
+                                      void *),
                 void *user_data)
 {
   const char *const *iter;
   g_autoptr(GHashTable) searched_set = NULL;
+  g_autoptr(GPtrArray) paths = NULL;
   g_autoptr(GError) error = NULL;
 
   g_return_if_fail (SRT_IS_SYSROOT (sysroot));
   g_return_if_fail (load_json_cb != NULL);
 
   searched_set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  paths = g_ptr_array_new_with_free_func (g_free);
 
   for (iter = search_paths;
        iter != NULL && *iter != NULL;
@@ -857,7 +1329,7 @@ load_json_dirs (SrtSysroot *sysroot,
       if (!g_hash_table_contains (searched_set, file_realpath_in_sysroot))
         {
           g_hash_table_add (searched_set, g_steal_pointer (&file_realpath_in_sysroot));
-          load_json_dir (sysroot, *iter, suffix, sort, load_json_cb, user_data);
+          list_json_dir (sysroot, *iter, suffix, sort, paths);
         }
       else
         {
@@ -865,12 +1337,15 @@ load_json_dirs (SrtSysroot *sysroot,
                    file_realpath_in_sysroot);
         }
     }
+
+  load_json_paths (sysroot, paths, load_json_cb, user_data);
 }
 
 /*
  * load_manifest_from_json:
  * @type: %SRT_TYPE_EGL_ICD or %SRT_TYPE_EGL_EXTERNAL_PLATFORM or %SRT_TYPE_VULKAN_ICD
  * @sysroot: (not nullable): The root directory, usually `/`
+ * @cache: (nullable): Manifests already loaded during this enumeration
  * @filename: The filename of the metadata
  * @json_member_name: Name of the JSON object beneath the root, containing the
  *  main body of the manifest.
@@ -882,15 +1357,17 @@ load_json_dirs (SrtSysroot *sysroot,
 GObject *
 load_manifest_from_json (GType type,
                          SrtSysroot *sysroot,
+                         SrtJsonManifestCache *cache,
                          const char *filename,
                          const char *json_member_name)
 {
-  g_autoptr(JsonParser) parser = NULL;
+  g_autoptr(SrtJsonManifest) manifest = NULL;
   g_autofree gchar *canon = NULL;
   g_autofree gchar *resolved_filename = NULL;
   g_autofree gchar *contents = NULL;
   g_autoptr(GError) error = NULL;
-  /* These are all borrowed from the parser */
+  /* These are all borrowed from the manifest */
+  const char *shared_contents;
   JsonNode *node;
   JsonObject *object;
   JsonNode *subnode;
@@ -919,20 +1396,28 @@ load_manifest_from_json (GType type,
   g_debug ("Attempting to load %s from \"%s/%s\"",
            g_type_name (type), sysroot->path, filename);
 
-  if (!_srt_sysroot_load (sysroot, filename,
-                          SRT_RESOLVE_FLAGS_RETURN_ABSOLUTE,
-                          /* Make sure to get a fully resolved path for OpenXR
-                             runtimes, because that's the path used to resolve
-                             relative library paths. */
-                          type == SRT_TYPE_OPENXR_1_RUNTIME
-                            ? &resolved_filename
-                            : NULL,
-                          &contents, &len, &error))
+  manifest = _srt_json_manifest_load (cache, sysroot, filename,
+                                      SRT_RESOLVE_FLAGS_RETURN_ABSOLUTE,
+                                      /* Make sure to get a fully resolved
+                                         path for OpenXR runtimes, because
+                                         that's the path used to resolve
+                                         relative library paths. */
+                                      type == SRT_TYPE_OPENXR_1_RUNTIME
+                                        ? &resolved_filename
+                                        : NULL,
+                                      &error);
+
+  if (manifest == NULL)
     {
       issues |= SRT_LOADABLE_ISSUES_CANNOT_LOAD;
       goto out;
     }
 
+  /* The manifest might be shared with other callers, so copy it,
+   * including any \0 and the \0 that terminates it */
+  shared_contents = _srt_json_manifest_get_contents (manifest, &len);
+  contents = g_memdup2 (shared_contents, len + 1);
+
   if (G_UNLIKELY (len > G_MAXSSIZE))
     {
       g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -956,16 +1441,12 @@ load_manifest_from_json (GType type,
       goto out;
     }
 
-  parser = json_parser_new ();
-
-  if (!json_parser_load_from_data (parser, contents, len, &error))
+  if (!_srt_json_manifest_get_root (manifest, &node, &error))
     {
       issues |= SRT_LOADABLE_ISSUES_CANNOT_LOAD;
       goto out;
     }
 
-  node = json_parser_get_root (parser);
-
   if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node))
     {
       g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -1175,6 +1656,7 @@ out:
  * prepend_manifest_from_json:
  * @type: %SRT_TYPE_EGL_ICD or %SRT_TYPE_EGL_EXTERNAL_PLATFORM or %SRT_TYPE_VULKAN_ICD
  * @sysroot: (not nullable): The root directory, usually `/`
+ * @cache: (nullable): Manifests already loaded during this enumeration
  * @filename: The filename of the metadata
  * @json_member_name: Name of the JSON object beneath the root, containing the
  *  main body of the manifest.
@@ -1188,11 +1670,12 @@ out:
 void
 prepend_manifest_from_json (GType type,
                             SrtSysroot *sysroot,
+                            SrtJsonManifestCache *cache,
                             const char *filename,
                             const char *json_member_name,
                             GList **out_list)
 {
-  GObject *ret = load_manifest_from_json (type, sysroot, filename,
+  GObject *ret = load_manifest_from_json (type, sysroot, cache, filename,
                                           json_member_name);
   g_return_if_fail (ret != NULL);
   *out_list = g_list_prepend (*out_list, ret);
@@ -632,10 +632,12 @@ parse_active_runtime_filename (const char *filename,
 
 static SrtOpenXr1Runtime *
 load_runtime_from_json (SrtSysroot *sysroot,
+                        SrtJsonManifestCache *cache,
                         const char *filename)
 {
   GObject *object = load_manifest_from_json (SRT_TYPE_OPENXR_1_RUNTIME,
                                              sysroot,
+                                             cache,
                                              filename,
                                              _SRT_GRAPHICS_MANIFEST_MEMBER_OPENXR_1_RUNTIME);
   return object != NULL ? SRT_OPENXR_1_RUNTIME (object) : NULL;
@@ -688,6 +690,7 @@ typedef struct {
 
 static void
 openxr_1_runtime_load_json_cb (SrtSysroot *sysroot,
+                               SrtJsonManifestCache *cache,
                                const char *filename,
                                void *user_data)
 {
@@ -709,7 +712,7 @@ openxr_1_runtime_load_json_cb (SrtSysroot *sysroot,
   if (!is_active && data->out_inactive == NULL)
     return;
 
-  rt = load_runtime_from_json (sysroot, filename);
+  rt = load_runtime_from_json (sysroot, cache, filename);
   if (rt == NULL)
     return;
 
@@ -788,7 +791,7 @@ _srt_load_openxr_1_runtimes (SrtSysroot *sysroot,
   value = _srt_environ_getenv (envp, "XR_RUNTIME_JSON");
   if (value != NULL)
     {
-      *out_active_fallback = load_runtime_from_json (sysroot, value);
+      *out_active_fallback = load_runtime_from_json (sysroot, NULL, value);
       /* If the caller isn't interested in inactive runtimes, then skip the
          scanning altogether... */
       if (out_inactive == NULL)
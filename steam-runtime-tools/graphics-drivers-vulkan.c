@@ -438,10 +438,11 @@ srt_vulkan_icd_new_replace_library_path (SrtVulkanIcd *self,
 
 static void
 vulkan_icd_load_json_cb (SrtSysroot *sysroot,
+                         SrtJsonManifestCache *cache,
                          const char *filename,
                          void *user_data)
 {
-  prepend_manifest_from_json (SRT_TYPE_VULKAN_ICD, sysroot, filename,
+  prepend_manifest_from_json (SRT_TYPE_VULKAN_ICD, sysroot, cache, filename,
                               MANIFEST_JSON_MEMBER_NAME_ICD, user_data);
 }
 
@@ -651,7 +652,8 @@ _srt_load_vulkan_icds (SrtSysroot *sysroot,
       g_debug ("Vulkan driver search path overridden to: %s", value);
 
       for (i = 0; filenames[i] != NULL; i++)
-        prepend_manifest_from_json (SRT_TYPE_VULKAN_ICD, sysroot, filenames[i],
+        prepend_manifest_from_json (SRT_TYPE_VULKAN_ICD, sysroot, NULL,
+                                    filenames[i],
                                     MANIFEST_JSON_MEMBER_NAME_ICD, &ret);
 
       g_strfreev (filenames);
@@ -673,7 +675,8 @@ _srt_load_vulkan_icds (SrtSysroot *sysroot,
           g_debug ("Vulkan additional driver search path: %s", add);
 
           for (i = 0; filenames[i] != NULL; i++)
-            prepend_manifest_from_json (SRT_TYPE_VULKAN_ICD, sysroot, filenames[i],
+            prepend_manifest_from_json (SRT_TYPE_VULKAN_ICD, sysroot, NULL,
+                                        filenames[i],
                                         MANIFEST_JSON_MEMBER_NAME_ICD, &ret);
         }
 
@@ -1254,6 +1257,7 @@ vulkan_layer_parse_json (const gchar *path,
 /**
  * load_vulkan_layer_json:
  * @sysroot: (not nullable): Sysroot in which to load the layer
+ * @cache: (nullable): Manifests already loaded during this enumeration
  * @path: (not nullable): Path to a Vulkan layer JSON file
  *
  * Returns: (transfer full) (element-type SrtVulkanLayer): A list of Vulkan
@@ -1261,17 +1265,18 @@ vulkan_layer_parse_json (const gchar *path,
  */
 static GList *
 load_vulkan_layer_json (SrtSysroot *sysroot,
+                        SrtJsonManifestCache *cache,
                         const gchar *path)
 {
   g_autoptr(GError) error = NULL;
-  g_autoptr(JsonParser) parser = NULL;
+  g_autoptr(SrtJsonManifest) manifest = NULL;
   JsonNode *node = NULL;
   JsonNode *arr_node = NULL;
   JsonObject *object = NULL;
   JsonObject *json_layer = NULL;
   JsonArray *json_layers = NULL;
   const gchar *file_format_version = NULL;
-  g_autofree gchar *contents = NULL;
+  const char *contents = NULL;
   g_autofree gchar *canon = NULL;
   gsize contents_len = 0;
   guint length;
@@ -1292,10 +1297,14 @@ load_vulkan_layer_json (SrtSysroot *sysroot,
   g_debug ("Attempting to load JSON layer from %s%s",
            sysroot->path, path);
 
-  if (!_srt_sysroot_load (sysroot, path, SRT_RESOLVE_FLAGS_NONE,
-                          NULL, &contents, &contents_len, &error))
+  manifest = _srt_json_manifest_load (cache, sysroot, path,
+                                      SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+
+  if (manifest == NULL)
     goto return_error;
 
+  contents = _srt_json_manifest_get_contents (manifest, &contents_len);
+
   if (G_UNLIKELY (contents_len > G_MAXSSIZE))
     {
       g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -1314,16 +1323,12 @@ load_vulkan_layer_json (SrtSysroot *sysroot,
       goto return_error;
     }
 
-  parser = json_parser_new ();
-
-  if (!json_parser_load_from_data (parser, contents, contents_len, &error))
+  if (!_srt_json_manifest_get_root (manifest, &node, &error))
     {
       g_debug ("error %s", error->message);
       goto return_error;
     }
 
-  node = json_parser_get_root (parser);
-
   if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node))
     {
       g_set_error (&error, G_IO_ERROR, G_IO_ERROR_FAILED,
@@ -1424,6 +1429,7 @@ return_error:
 
 static void
 vulkan_layer_load_json (SrtSysroot *sysroot,
+                        SrtJsonManifestCache *cache,
                         const char *filename,
                         GList **list)
 {
@@ -1431,15 +1437,17 @@ vulkan_layer_load_json (SrtSysroot *sysroot,
   g_return_if_fail (filename != NULL);
   g_return_if_fail (list != NULL);
 
-  *list = g_list_concat (load_vulkan_layer_json (sysroot, filename), *list);
+  *list = g_list_concat (load_vulkan_layer_json (sysroot, cache, filename),
+                         *list);
 }
 
 static void
 vulkan_layer_load_json_cb (SrtSysroot *sysroot,
+                           SrtJsonManifestCache *cache,
                            const char *filename,
                            void *user_data)
 {
-  vulkan_layer_load_json (sysroot, filename, user_data);
+  vulkan_layer_load_json (sysroot, cache, filename, user_data);
 }
 
 /*
@@ -33,6 +33,7 @@
 #include "steam-runtime-tools/graphics-internal.h"
 #include "steam-runtime-tools/library.h"
 #include "steam-runtime-tools/library-internal.h"
+#include "steam-runtime-tools/library-scanner-internal.h"
 #include "steam-runtime-tools/resolve-in-sysroot-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
 
@@ -378,50 +379,35 @@ _argv_for_list_glx_icds_in_path (SrtSysroot *sysroot,
 }
 
 /*
- * _srt_list_modules_from_directory:
+ * _srt_list_found_libraries_from_directory:
  * @runner: The execution environment
  * @argv: (array zero-terminated=1) (not nullable): The `argv` of the helper to use
  * @tmp_directory: (not nullable) (type filename): Full path to the destination
  *  directory used by the "capsule-capture-libs" helper
- * @known_table: (not optional): set of library names, plus their links, that
- *  we already found. Newely found libraries will be added to this list.
- *  For VDPAU provide a set with just paths where we already looked into, and in
- *  the VDPAU case the set will not be changed by this function.
- * @module: Which graphic module to search
- * @is_extra: If this path should be considered an extra or not. This is used only if
- *  @module is #SRT_GRAPHICS_VDPAU_MODULE.
- * @modules_out: (not optional) (inout): Prepend the found modules to this list.
- *  If @module is #SRT_GRAPHICS_GLX_MODULE, the element-type will be #SrtGlxIcd.
- *  Otherwise if @module is #SRT_GRAPHICS_VDPAU_MODULE, the element-type will be #SrtVdpauDriver.
  *
- * Modules are added to @modules_out in reverse lexicographic order
- * (`libvdpau_r600.so` is before `libvdpau_r300.so`, which is before `libvdpau_nouveau.so`).
+ * Run @argv with environment from @runner.
+ * On success, @argv is expected to populate @tmp_directory
+ * with symbolic links to absolute targets.
+ *
+ * Returns: (transfer container) (element-type SrtFoundLibrary) (nullable):
+ *  The names and targets of the symbolic links, sorted by name,
+ *  or %NULL on error
  */
-static void
-_srt_list_modules_from_directory (SrtSubprocessRunner *runner,
-                                  GPtrArray *argv,
-                                  const gchar *tmp_directory,
-                                  GHashTable *known_table,
-                                  SrtGraphicsModule module,
-                                  gboolean is_extra,
-                                  GList **modules_out)
+static GPtrArray *
+_srt_list_found_libraries_from_directory (SrtSubprocessRunner *runner,
+                                          GPtrArray *argv,
+                                          const gchar *tmp_directory)
 {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GDir) dir_iter = NULL;
+  g_autoptr(GPtrArray) members = NULL;
+  g_autoptr(GPtrArray) found = NULL;
   g_autoptr(SrtCompletedSubprocess) completed = NULL;
-  GError *error = NULL;
-  GDir *dir_iter = NULL;
-  GPtrArray *members = NULL;
   const gchar *member;
-  gchar *full_path = NULL;
-  gchar *driver_path = NULL;
-  gchar *driver_directory = NULL;
-  gchar *driver_link = NULL;
-  gchar *soname_path = NULL;
 
-  g_return_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner));
-  g_return_if_fail (argv != NULL);
-  g_return_if_fail (tmp_directory != NULL);
-  g_return_if_fail (known_table != NULL);
-  g_return_if_fail (modules_out != NULL);
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), NULL);
+  g_return_val_if_fail (argv != NULL, NULL);
+  g_return_val_if_fail (tmp_directory != NULL, NULL);
 
   completed = _srt_subprocess_runner_run_sync (runner,
                                                helper_flags,
@@ -433,13 +419,13 @@ _srt_list_modules_from_directory (SrtSubprocessRunner *runner,
   if (completed == NULL)
     {
       g_debug ("An error occurred calling the helper: %s", error->message);
-      goto out;
+      return NULL;
     }
 
   if (!_srt_completed_subprocess_check (completed, &error))
     {
       g_debug ("Subprocess failed: %s", error->message);
-      goto out;
+      return NULL;
     }
 
   dir_iter = g_dir_open (tmp_directory, 0, &error);
@@ -447,7 +433,7 @@ _srt_list_modules_from_directory (SrtSubprocessRunner *runner,
   if (dir_iter == NULL)
     {
       g_debug ("Failed to open \"%s\": %s", tmp_directory, error->message);
-      goto out;
+      return NULL;
     }
 
   members = g_ptr_array_new_with_free_func (g_free);
@@ -456,159 +442,355 @@ _srt_list_modules_from_directory (SrtSubprocessRunner *runner,
     g_ptr_array_add (members, g_strdup (member));
 
   g_ptr_array_sort (members, _srt_indirect_strcmp0);
+  found = g_ptr_array_new_full (members->len,
+                                (GDestroyNotify) _srt_found_library_free);
 
   for (gsize i = 0; i < members->len; i++)
     {
+      g_autofree gchar *full_path = NULL;
+      g_autofree gchar *lib_link = NULL;
       member = g_ptr_array_index (members, i);
 
       full_path = g_build_filename (tmp_directory, member, NULL);
-      driver_path = g_file_read_link (full_path, &error);
-      if (driver_path == NULL)
+      lib_link = g_file_read_link (full_path, &error);
+      if (lib_link == NULL)
         {
           g_debug ("An error occurred trying to read the symlink: %s", error->message);
-          g_free (full_path);
-          goto out;
+          return NULL;
         }
-      if (!g_path_is_absolute (driver_path))
+      if (!g_path_is_absolute (lib_link))
         {
-          g_debug ("We were expecting an absolute path, instead we have: %s", driver_path);
-          g_free (full_path);
-          g_free (driver_path);
-          goto out;
+          g_debug ("We were expecting an absolute path, instead we have: %s", lib_link);
+          return NULL;
         }
 
-      switch (module)
-        {
-          case SRT_GRAPHICS_GLX_MODULE:
-            /* Instead of just using just the library name to filter duplicates, we use it in
-             * combination with its path. Because in one of the multiple iterations we might
-             * find the same library that points to two different locations. And in this
-             * case we want to log both of them.
-             *
-             * `member` cannot contain `/`, so we know we can use `/` to make
-             * a composite key for deduplication. */
-            soname_path = g_strjoin ("/", member, driver_path, NULL);
-            if (!g_hash_table_contains (known_table, soname_path))
-              {
-                g_hash_table_add (known_table, g_strdup (soname_path));
-                *modules_out = g_list_prepend (*modules_out, srt_glx_icd_new (member, driver_path));
-              }
-            g_free (soname_path);
-            break;
+      g_ptr_array_add (found, _srt_found_library_new (member, lib_link, NULL));
+    }
 
-          case SRT_GRAPHICS_VDPAU_MODULE:
-            driver_directory = g_path_get_dirname (driver_path);
-            if (!g_hash_table_contains (known_table, driver_directory))
-              {
-                /* We do not add `driver_directory` to the hash table because it contains
-                 * a list of directories where we already looked into. In this case we are
-                 * just adding a single driver instead of searching for all the `libvdpau_*`
-                 * files in `driver_directory`. */
-                driver_link = g_file_read_link (driver_path, NULL);
-                *modules_out = g_list_prepend (*modules_out, srt_vdpau_driver_new (driver_path,
-                                                                                  driver_link,
-                                                                                  is_extra));
-                g_free (driver_link);
-              }
-            g_free (driver_directory);
-            break;
+  return g_steal_pointer (&found);
+}
 
-          case SRT_GRAPHICS_DRI_MODULE:
-          case SRT_GRAPHICS_VAAPI_MODULE:
-          case NUM_SRT_GRAPHICS_MODULES:
-          default:
-            g_return_if_reached ();
-        }
+/*
+ * Return a scanner that can find libraries for @multiarch_tuple in
+ * @sysroot without running a helper, or %NULL if we need to use the
+ * capsule-capture-libs helper. Free with _srt_library_scanner_unref().
+ */
+static SrtLibraryScanner *
+_srt_get_library_scanner (SrtSysroot *sysroot,
+                          SrtSubprocessRunner *runner,
+                          const char *multiarch_tuple)
+{
+  const SrtKnownArchitecture *arch;
 
-      g_free (full_path);
-      g_free (driver_path);
-    }
+  /* In the automated tests we compare the results with the helper's */
+  if (_srt_subprocess_runner_getenv (runner, "SRT_TEST_DISABLE_LIBRARY_SCANNER") != NULL)
+    return NULL;
 
-out:
-  if (dir_iter != NULL)
-    g_dir_close (dir_iter);
-  g_clear_pointer (&members, g_ptr_array_unref);
-  g_clear_error (&error);
+  arch = _srt_architecture_get_by_tuple (multiarch_tuple);
+
+  /* We can only recognise libraries of the right ABI if we know its
+   * ELF machine type. The mock ABIs used in unit tests don't have one,
+   * and instead rely on a mock capsule-capture-libs helper. */
+  if (arch == NULL || arch->machine_type == EM_NONE)
+    return NULL;
+
+  return _srt_library_scanner_get (sysroot);
 }
 
 /*
- * Run @argv with environment from @runner.
- * On success, @argv is expected to populate @tmp_directory
- * with symbolic links to absolute targets. Return their targets.
+ * Take ownership of @library and add it to @found if it is not %NULL,
+ * unless a library with the same name was already found, in the same way
+ * that capsule-capture-libs only creates the first symbolic link with
+ * a particular name.
  */
-static char **
-_srt_list_links_from_directory (SrtSubprocessRunner *runner,
-                                GPtrArray *argv,
-                                const gchar *tmp_directory)
+static void
+_srt_add_found_library (GPtrArray *found,
+                        SrtFoundLibrary *library)
 {
-  g_autoptr(GError) error = NULL;
-  g_autoptr(GDir) dir_iter = NULL;
-  g_autoptr(GPtrArray) members = NULL;
-  g_autoptr(SrtCompletedSubprocess) completed = NULL;
-  const gchar *member;
+  gsize i;
 
-  g_autoptr(GPtrArray) lib_links = g_ptr_array_new_with_free_func (g_free);
+  if (library == NULL)
+    return;
 
-  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), NULL);
-  g_return_val_if_fail (argv != NULL, NULL);
-  g_return_val_if_fail (tmp_directory != NULL, NULL);
+  for (i = 0; i < found->len; i++)
+    {
+      const SrtFoundLibrary *other = g_ptr_array_index (found, i);
 
-  completed = _srt_subprocess_runner_run_sync (runner,
-                                               helper_flags,
-                                               (const char * const *) argv->pdata,
-                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
-                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
-                                               &error);
+      if (strcmp (other->name, library->name) == 0)
+        {
+          _srt_found_library_free (library);
+          return;
+        }
+    }
 
-  if (completed == NULL)
+  g_ptr_array_add (found, library);
+}
+
+static void
+_srt_add_found_libraries (GPtrArray *found,
+                          GPtrArray *libraries)
+{
+  gsize i;
+
+  for (i = 0; i < libraries->len; i++)
     {
-      g_debug ("An error occurred calling the helper: %s", error->message);
-      return NULL;
+      const SrtFoundLibrary *library = g_ptr_array_index (libraries, i);
+
+      _srt_add_found_library (found,
+                              _srt_found_library_new (library->name,
+                                                      library->path,
+                                                      library->real_path));
     }
+}
 
-  if (!_srt_completed_subprocess_check (completed, &error))
+static int
+_srt_found_library_cmp_name (gconstpointer a,
+                             gconstpointer b)
+{
+  const SrtFoundLibrary * const *left = a;
+  const SrtFoundLibrary * const *right = b;
+
+  return strcmp ((*left)->name, (*right)->name);
+}
+
+/*
+ * Make the paths in @found valid in the current namespace,
+ * in the same way as capsule-capture-libs without `--link-target`,
+ * and sort them by name.
+ */
+static void
+_srt_found_libraries_prepend_sysroot (GPtrArray *found,
+                                      SrtSysroot *sysroot)
+{
+  gboolean direct = _srt_sysroot_is_direct (sysroot);
+  gsize i;
+
+  for (i = 0; i < found->len; i++)
     {
-      g_debug ("Subprocess failed: %s", error->message);
-      return NULL;
+      SrtFoundLibrary *library = g_ptr_array_index (found, i);
+      gchar *path;
+
+      /* The helper only follows symlinks itself if the sysroot is not
+       * the real root directory */
+      if (!direct && library->real_path != NULL)
+        path = g_build_filename (sysroot->path, library->real_path, NULL);
+      else
+        path = g_build_filename (sysroot->path, library->path, NULL);
+
+      g_free (library->path);
+      library->path = path;
     }
 
-  dir_iter = g_dir_open (tmp_directory, 0, &error);
+  g_ptr_array_sort (found, _srt_found_library_cmp_name);
+}
 
-  if (dir_iter == NULL)
+/*
+ * Equivalent to running the helper with _argv_for_list_vdpau_drivers().
+ */
+static GPtrArray *
+_srt_scan_vdpau_drivers (SrtLibraryScanner *scanner,
+                         SrtSysroot *sysroot,
+                         SrtSubprocessRunner *runner,
+                         const char *multiarch_tuple)
+{
+  static const char * const well_known[] =
+  {
+    "nouveau",
+    "nvidia",
+    "r300",
+    "r600",
+    "radeonsi",
+    "va_gl",
+    NULL
+  };
+  g_autoptr(GPtrArray) found = NULL;
+  g_autoptr(GPtrArray) matched = NULL;
+  const gchar *vdpau_driver = NULL;
+  const gchar *ld_library_path = NULL;
+  gsize i;
+
+  vdpau_driver = _srt_subprocess_runner_getenv (runner, "VDPAU_DRIVER");
+  ld_library_path = _srt_subprocess_runner_getenv (runner, "LD_LIBRARY_PATH");
+  found = g_ptr_array_new_with_free_func ((GDestroyNotify) _srt_found_library_free);
+  matched = _srt_library_scanner_match_soname (scanner, multiarch_tuple,
+                                               "libvdpau_*.so");
+  _srt_add_found_libraries (found, matched);
+
+  /* As in _argv_for_list_vdpau_drivers(), also look for the chosen driver
+   * and some commonly used drivers that might not be in the ld.so cache */
+  if (vdpau_driver != NULL && strchr (vdpau_driver, '/') == NULL)
     {
-      g_debug ("Failed to open \"%s\": %s", tmp_directory, error->message);
-      return NULL;
+      g_autofree gchar *soname = g_strjoin (NULL, "libvdpau_", vdpau_driver, ".so", NULL);
+
+      _srt_add_found_library (found,
+                              _srt_library_scanner_find_soname (scanner,
+                                                                multiarch_tuple,
+                                                                soname,
+                                                                ld_library_path));
     }
 
-  members = g_ptr_array_new_with_free_func (g_free);
+  for (i = 0; well_known[i] != NULL; i++)
+    {
+      g_autofree gchar *soname = g_strjoin (NULL, "libvdpau_", well_known[i], ".so", NULL);
 
-  while ((member = g_dir_read_name (dir_iter)) != NULL)
-    g_ptr_array_add (members, g_strdup (member));
+      _srt_add_found_library (found,
+                              _srt_library_scanner_find_soname (scanner,
+                                                                multiarch_tuple,
+                                                                soname,
+                                                                ld_library_path));
+    }
 
-  for (gsize i = 0; i < members->len; i++)
+  _srt_found_libraries_prepend_sysroot (found, sysroot);
+  return g_steal_pointer (&found);
+}
+
+/*
+ * Equivalent to running the helper with _argv_for_list_glx_icds() and,
+ * if @overrides_path is non-%NULL, _argv_for_list_glx_icds_in_path().
+ */
+static GPtrArray *
+_srt_scan_glx_icds (SrtLibraryScanner *scanner,
+                    SrtSysroot *sysroot,
+                    SrtSubprocessRunner *runner,
+                    const char *multiarch_tuple,
+                    const char *overrides_path)
+{
+  static const char * const sonames[] =
+  {
+    "libGLX_indirect.so.0",
+    "libGLX_mesa.so.0",
+    "libGLX_nvidia.so.0",
+    NULL
+  };
+  g_autoptr(GPtrArray) found = NULL;
+  g_autoptr(GPtrArray) matched = NULL;
+  const gchar *ld_library_path = NULL;
+  gsize i;
+
+  ld_library_path = _srt_subprocess_runner_getenv (runner, "LD_LIBRARY_PATH");
+  found = g_ptr_array_new_with_free_func ((GDestroyNotify) _srt_found_library_free);
+  matched = _srt_library_scanner_match_soname (scanner, multiarch_tuple,
+                                               "libGLX_*.so.0");
+  _srt_add_found_libraries (found, matched);
+
+  for (i = 0; sonames[i] != NULL; i++)
+    _srt_add_found_library (found,
+                            _srt_library_scanner_find_soname (scanner,
+                                                              multiarch_tuple,
+                                                              sonames[i],
+                                                              ld_library_path));
+
+  if (overrides_path != NULL)
     {
-      g_autofree gchar *full_path = NULL;
-      g_autofree gchar *lib_link = NULL;
-      member = g_ptr_array_index (members, i);
+      g_autofree gchar *dir = g_build_filename (overrides_path, "lib",
+                                                multiarch_tuple, NULL);
 
-      full_path = g_build_filename (tmp_directory, member, NULL);
-      lib_link = g_file_read_link (full_path, &error);
-      if (lib_link == NULL)
+      g_clear_pointer (&matched, g_ptr_array_unref);
+      matched = _srt_library_scanner_match_path (scanner, multiarch_tuple,
+                                                 dir, "libGLX_*.so.*");
+
+      /* The helper would have put these in a separate directory, so they
+       * are not deduplicated against the libraries found by SONAME */
+      for (i = 0; i < matched->len; i++)
         {
-          g_debug ("An error occurred trying to read the symlink: %s", error->message);
-          return NULL;
+          const SrtFoundLibrary *library = g_ptr_array_index (matched, i);
+
+          g_ptr_array_add (found,
+                           _srt_found_library_new (library->name,
+                                                   library->path,
+                                                   library->real_path));
         }
-      if (!g_path_is_absolute (lib_link))
+    }
+
+  _srt_found_libraries_prepend_sysroot (found, sysroot);
+  return g_steal_pointer (&found);
+}
+
+/*
+ * _srt_add_found_modules:
+ * @found: (element-type SrtFoundLibrary): Libraries found by the
+ *  "capsule-capture-libs" helper or a #SrtLibraryScanner, sorted by name,
+ *  with absolute paths that are valid in the current namespace
+ * @known_table: (not optional): set of library names, plus their links, that
+ *  we already found. Newely found libraries will be added to this list.
+ *  For VDPAU provide a set with just paths where we already looked into, and in
+ *  the VDPAU case the set will not be changed by this function.
+ * @module: Which graphic module to search
+ * @is_extra: If this path should be considered an extra or not. This is used only if
+ *  @module is #SRT_GRAPHICS_VDPAU_MODULE.
+ * @modules_out: (not optional) (inout): Prepend the found modules to this list.
+ *  If @module is #SRT_GRAPHICS_GLX_MODULE, the element-type will be #SrtGlxIcd.
+ *  Otherwise if @module is #SRT_GRAPHICS_VDPAU_MODULE, the element-type will be #SrtVdpauDriver.
+ *
+ * Modules are added to @modules_out in reverse lexicographic order
+ * (`libvdpau_r600.so` is before `libvdpau_r300.so`, which is before `libvdpau_nouveau.so`).
+ */
+static void
+_srt_add_found_modules (GPtrArray *found,
+                        GHashTable *known_table,
+                        SrtGraphicsModule module,
+                        gboolean is_extra,
+                        GList **modules_out)
+{
+  g_return_if_fail (found != NULL);
+  g_return_if_fail (known_table != NULL);
+  g_return_if_fail (modules_out != NULL);
+
+  for (gsize i = 0; i < found->len; i++)
+    {
+      const SrtFoundLibrary *library = g_ptr_array_index (found, i);
+      const char *member = library->name;
+      const char *driver_path = library->path;
+
+      switch (module)
         {
-          g_debug ("We were expecting an absolute path, instead we have: %s", lib_link);
-          return NULL;
-        }
+          case SRT_GRAPHICS_GLX_MODULE:
+            {
+              g_autofree gchar *soname_path = NULL;
+
+              /* Instead of just using just the library name to filter duplicates, we use it in
+               * combination with its path. Because in one of the multiple iterations we might
+               * find the same library that points to two different locations. And in this
+               * case we want to log both of them.
+               *
+               * `member` cannot contain `/`, so we know we can use `/` to make
+               * a composite key for deduplication. */
+              soname_path = g_strjoin ("/", member, driver_path, NULL);
+              if (!g_hash_table_contains (known_table, soname_path))
+                {
+                  g_hash_table_add (known_table, g_steal_pointer (&soname_path));
+                  *modules_out = g_list_prepend (*modules_out, srt_glx_icd_new (member, driver_path));
+                }
+            }
+            break;
 
-      g_ptr_array_add (lib_links, g_steal_pointer (&lib_link));
-    }
+          case SRT_GRAPHICS_VDPAU_MODULE:
+            {
+              g_autofree gchar *driver_directory = g_path_get_dirname (driver_path);
 
-  g_ptr_array_add (lib_links, NULL);
-  return (GStrv) g_ptr_array_free (g_steal_pointer (&lib_links), FALSE);
+              if (!g_hash_table_contains (known_table, driver_directory))
+                {
+                  g_autofree gchar *driver_link = NULL;
+
+                  /* We do not add `driver_directory` to the hash table because it contains
+                   * a list of directories where we already looked into. In this case we are
+                   * just adding a single driver instead of searching for all the `libvdpau_*`
+                   * files in `driver_directory`. */
+                  driver_link = g_file_read_link (driver_path, NULL);
+                  *modules_out = g_list_prepend (*modules_out, srt_vdpau_driver_new (driver_path,
+                                                                                    driver_link,
+                                                                                    is_extra));
+                }
+            }
+            break;
+
+          case SRT_GRAPHICS_DRI_MODULE:
+          case SRT_GRAPHICS_VAAPI_MODULE:
+          case NUM_SRT_GRAPHICS_MODULES:
+          default:
+            g_return_if_reached ();
+        }
+    }
 }
 
 /*
@@ -939,6 +1121,8 @@ _srt_get_library_class (const char * const *envp,
  *  If the @loader_path suggests looking in one of these directories, it
  *  will not be checked again.
  *  When this function looks in a new directory, it is added to this set.
+ * @dependencies: (nullable): If not %NULL, the directory containing
+ *  @loader_path is added to this set
  * @drivers_out: (inout): Results are prepended to this list.
  *  The type depends on @module, the same as for _srt_get_modules_from_path().
  */
@@ -951,6 +1135,7 @@ _srt_get_modules_from_loader_library (SrtSysroot *sysroot,
                                       gboolean is_extra,
                                       SrtGraphicsModule module,
                                       GHashTable *drivers_set,
+                                      GHashTable *dependencies,
                                       GList **drivers_out)
 {
   g_autofree gchar *libdir = NULL;
@@ -965,6 +1150,9 @@ _srt_get_modules_from_loader_library (SrtSysroot *sysroot,
   libdir = g_path_get_dirname (loader_path);
   envp = _srt_subprocess_runner_get_environ (runner);
 
+  if (dependencies != NULL)
+    g_hash_table_add (dependencies, g_strdup (libdir));
+
   if (module == SRT_GRAPHICS_VDPAU_MODULE)
     libdir_driver = g_build_filename (libdir, "vdpau", NULL);
   else
@@ -1043,11 +1231,13 @@ _srt_list_glx_icds (SrtSysroot *sysroot,
 {
   GPtrArray *by_soname_argv = NULL;
   GPtrArray *overrides_argv = NULL;
+  GPtrArray *found = NULL;
   GError *error = NULL;
   gchar *by_soname_tmp_dir = NULL;
   gchar *overrides_tmp_dir = NULL;
   gchar *overrides_path = NULL;
   GHashTable *known_libs = NULL;
+  g_autoptr(SrtLibraryScanner) scanner = NULL;
 
   g_return_if_fail (SRT_IS_SYSROOT (sysroot));
   g_return_if_fail (multiarch_tuple != NULL);
@@ -1055,6 +1245,22 @@ _srt_list_glx_icds (SrtSysroot *sysroot,
   g_return_if_fail (_srt_check_not_setuid ());
 
   known_libs = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  scanner = _srt_get_library_scanner (sysroot, runner, multiarch_tuple);
+
+  if (scanner != NULL)
+    {
+      gboolean have_overrides;
+
+      have_overrides = _srt_sysroot_test (sysroot, "/overrides",
+                                          SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY,
+                                          NULL);
+      found = _srt_scan_glx_icds (scanner, sysroot, runner, multiarch_tuple,
+                                  have_overrides ? "/overrides" : NULL);
+      _srt_add_found_modules (found, known_libs,
+                              SRT_GRAPHICS_GLX_MODULE, FALSE, drivers_out);
+      goto out;
+    }
+
   by_soname_tmp_dir = g_dir_make_tmp ("glx-icds-XXXXXX", &error);
   if (by_soname_tmp_dir == NULL)
     {
@@ -1071,8 +1277,12 @@ _srt_list_glx_icds (SrtSysroot *sysroot,
       goto out;
     }
 
-  _srt_list_modules_from_directory (runner, by_soname_argv, by_soname_tmp_dir, known_libs,
-                                    SRT_GRAPHICS_GLX_MODULE, FALSE, drivers_out);
+  found = _srt_list_found_libraries_from_directory (runner, by_soname_argv,
+                                                    by_soname_tmp_dir);
+
+  if (found != NULL)
+    _srt_add_found_modules (found, known_libs,
+                            SRT_GRAPHICS_GLX_MODULE, FALSE, drivers_out);
 
   /* When in a container we might miss valid GLX drivers because the `ld.so.cache` in
    * use doesn't have a reference about them. To fix that we also include every
@@ -1097,13 +1307,19 @@ _srt_list_glx_icds (SrtSysroot *sysroot,
           goto out;
         }
 
-      _srt_list_modules_from_directory (runner, overrides_argv, overrides_tmp_dir, known_libs,
-                                        SRT_GRAPHICS_GLX_MODULE, FALSE, drivers_out);
+      g_clear_pointer (&found, g_ptr_array_unref);
+      found = _srt_list_found_libraries_from_directory (runner, overrides_argv,
+                                                        overrides_tmp_dir);
+
+      if (found != NULL)
+        _srt_add_found_modules (found, known_libs,
+                                SRT_GRAPHICS_GLX_MODULE, FALSE, drivers_out);
     }
 
 out:
   g_clear_pointer (&by_soname_argv, g_ptr_array_unref);
   g_clear_pointer (&overrides_argv, g_ptr_array_unref);
+  g_clear_pointer (&found, g_ptr_array_unref);
   if (by_soname_tmp_dir)
     {
       if (!_srt_rm_rf (by_soname_tmp_dir))
@@ -1129,6 +1345,10 @@ out:
  *  such as %SRT_ABI_X86_64
  * @check_flags: Flags affecting how we do the search
  * @module: Which graphic module to search
+ * @dependencies: (nullable): If not %NULL, add the paths in @sysroot
+ *  whose contents can affect the result to this set: the directories
+ *  that were searched, the directories containing the loader libraries,
+ *  and the files that influence where those loaders are found
  * @drivers_out: (inout): Prepend the found drivers to this list.
  *  If @module is #SRT_GRAPHICS_DRI_MODULE or #SRT_GRAPHICS_VAAPI_MODULE or
  *  #SRT_GRAPHICS_VDPAU_MODULE, the element-type will be #SrtDriDriver, or
@@ -1138,13 +1358,17 @@ out:
  * most-preferred directories last. Within a directory, the drivers will be
  * in reverse lexicographic order: `r600_dri.so` before `r200_dri.so`, which in turn
  * is before `nouveau_dri.so`.
+ *
+ * Returns: %FALSE if part of the search could not be done, for example
+ *  because a helper subprocess failed, so @drivers_out might be incomplete
  */
-static void
+static gboolean
 _srt_get_modules_full (SrtSysroot *sysroot,
                        SrtSubprocessRunner *runner,
                        const char *multiarch_tuple,
                        SrtCheckFlags check_flags,
                        SrtGraphicsModule module,
+                       GHashTable *dependencies,
                        GList **drivers_out)
 {
   const char * const *loader_libraries;
@@ -1161,15 +1385,17 @@ _srt_get_modules_full (SrtSysroot *sysroot,
   g_autoptr(GHashTable) drivers_set = NULL;
   gboolean is_extra = FALSE;
   g_autoptr(GPtrArray) vdpau_argv = NULL;
+  g_autoptr(GPtrArray) vdpau_found = NULL;
   g_autoptr(GError) error = NULL;
+  gboolean complete = TRUE;
   gsize i;
   gsize j;
 
-  g_return_if_fail (SRT_IS_SYSROOT (sysroot));
-  g_return_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner));
-  g_return_if_fail (multiarch_tuple != NULL);
-  g_return_if_fail (drivers_out != NULL);
-  g_return_if_fail (_srt_check_not_setuid ());
+  g_return_val_if_fail (SRT_IS_SYSROOT (sysroot), FALSE);
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), FALSE);
+  g_return_val_if_fail (multiarch_tuple != NULL, FALSE);
+  g_return_val_if_fail (drivers_out != NULL, FALSE);
+  g_return_val_if_fail (_srt_check_not_setuid (), FALSE);
 
   switch (module)
     {
@@ -1191,7 +1417,7 @@ _srt_get_modules_full (SrtSysroot *sysroot,
       case SRT_GRAPHICS_GLX_MODULE:
       case NUM_SRT_GRAPHICS_MODULES:
       default:
-        g_return_if_reached ();
+        g_return_val_if_reached (FALSE);
     }
 
   envp = _srt_subprocess_runner_get_environ (runner);
@@ -1200,6 +1426,14 @@ _srt_get_modules_full (SrtSysroot *sysroot,
 
   drivers_set = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
+  if (dependencies != NULL)
+    {
+      /* Installing or removing a loader library normally triggers ldconfig,
+       * which is our best indication that it might have moved */
+      g_hash_table_add (dependencies, g_strdup ("/etc/ld.so.cache"));
+      g_hash_table_add (dependencies, g_strdup ("/.flatpak-info"));
+    }
+
   if (drivers_path)
     {
       /* If the graphics environment variable for this module is set, we make
@@ -1354,7 +1588,8 @@ _srt_get_modules_full (SrtSysroot *sysroot,
                   _srt_get_modules_from_loader_library (sysroot, runner, library_path,
                                                         multiarch_tuple,
                                                         check_flags, is_extra, module,
-                                                        drivers_set, drivers_out);
+                                                        drivers_set, dependencies,
+                                                        drivers_out);
                   break;
                 }
             }
@@ -1371,37 +1606,74 @@ _srt_get_modules_full (SrtSysroot *sysroot,
        * to locate the loader libraries because it doesn't take into
        * consideration our custom sysroot, and dlopening a library in the host
        * system that has unmet dependencies may fail.
-       * Instead we use capsule-capture-libs, and check the symlinks that it
-       * creates. */
+       * Instead we look them up in the sysroot's ld.so cache in-process,
+       * or for ABIs where we can't do that, use capsule-capture-libs and
+       * check the symlinks that it creates. */
       g_autoptr(GPtrArray) gfx_argv = NULL;
-      g_auto(GStrv) loader_lib_link = NULL;
-      capture_libs_output_dir = g_dir_make_tmp ("graphics-drivers-XXXXXX", &error);
-      if (capture_libs_output_dir == NULL)
+      g_autoptr(GPtrArray) loader_libs = NULL;
+      g_autoptr(SrtLibraryScanner) scanner = NULL;
+
+      scanner = _srt_get_library_scanner (sysroot, runner, multiarch_tuple);
+
+      if (scanner != NULL)
         {
-          g_debug ("An error occurred trying to create a temporary folder: %s",
-                   error->message);
-          goto out;
-        }
+          loader_libs = g_ptr_array_new_with_free_func ((GDestroyNotify) _srt_found_library_free);
+
+          /* Equivalent to capsule-capture-libs --link-target=/ */
+          for (i = 0; loader_libraries[i] != NULL; i++)
+            _srt_add_found_library (loader_libs,
+                                    _srt_library_scanner_find_soname (scanner,
+                                                                      multiarch_tuple,
+                                                                      loader_libraries[i],
+                                                                      ld_library_path));
 
-      gfx_argv = _argv_for_list_loader_libraries (sysroot, runner,
-                                                  multiarch_tuple, capture_libs_output_dir,
-                                                  loader_libraries, &error);
-      if (gfx_argv == NULL)
+          for (i = 0; i < loader_libs->len; i++)
+            {
+              SrtFoundLibrary *library = g_ptr_array_index (loader_libs, i);
+
+              g_free (library->path);
+              library->path = g_strdup (library->real_path);
+            }
+        }
+      else
         {
-          g_debug ("An error occurred trying to locate graphics drivers: %s",
-                   error->message);
-          goto out;
+          capture_libs_output_dir = g_dir_make_tmp ("graphics-drivers-XXXXXX", &error);
+          if (capture_libs_output_dir == NULL)
+            {
+              g_debug ("An error occurred trying to create a temporary folder: %s",
+                       error->message);
+              complete = FALSE;
+              goto out;
+            }
+
+          gfx_argv = _argv_for_list_loader_libraries (sysroot, runner,
+                                                      multiarch_tuple, capture_libs_output_dir,
+                                                      loader_libraries, &error);
+          if (gfx_argv == NULL)
+            {
+              g_debug ("An error occurred trying to locate graphics drivers: %s",
+                       error->message);
+              complete = FALSE;
+              goto out;
+            }
+
+          loader_libs = _srt_list_found_libraries_from_directory (runner, gfx_argv,
+                                                                  capture_libs_output_dir);
+
+          if (loader_libs == NULL)
+            complete = FALSE;
         }
 
-      loader_lib_link = _srt_list_links_from_directory (runner, gfx_argv,
-                                                        capture_libs_output_dir);
-      for (i = 0; loader_lib_link != NULL && loader_lib_link[i] != NULL; i++)
+      for (i = 0; loader_libs != NULL && i < loader_libs->len; i++)
         {
-          g_debug ("Searching modules using the loader path \"%s\"", loader_lib_link[i]);
-          _srt_get_modules_from_loader_library (sysroot, runner, loader_lib_link[i],
+          const SrtFoundLibrary *library = g_ptr_array_index (loader_libs, i);
+
+          g_debug ("Searching modules using the loader path \"%s\"", library->path);
+          _srt_get_modules_from_loader_library (sysroot, runner, library->path,
                                                 multiarch_tuple,
                                                 check_flags, is_extra, module,
-                                                drivers_set, drivers_out);
+                                                drivers_set, dependencies,
+                                                drivers_out);
         }
     }
   else
@@ -1456,13 +1728,16 @@ _srt_get_modules_full (SrtSysroot *sysroot,
           _srt_get_modules_from_loader_library (sysroot, runner, driver_canonical_path,
                                                 multiarch_tuple,
                                                 check_flags, is_extra, module,
-                                                drivers_set, drivers_out);
+                                                drivers_set, dependencies,
+                                                drivers_out);
         }
     }
 
 
   if (module == SRT_GRAPHICS_VDPAU_MODULE)
     {
+      g_autoptr(SrtLibraryScanner) scanner = NULL;
+
       /* VDPAU modules are also loaded by just dlopening the bare filename
        * libvdpau_${VDPAU_DRIVER}.so
        * To cover that we search in all directories listed in LD_LIBRARY_PATH.
@@ -1508,23 +1783,41 @@ _srt_get_modules_full (SrtSysroot *sysroot,
             }
         }
 
-      /* Also use "capsule-capture-libs" to search for VDPAU drivers that we might have
-       * missed */
-      tmp_dir = g_dir_make_tmp ("vdpau-drivers-XXXXXX", &error);
-      if (tmp_dir == NULL)
+      /* Also use "capsule-capture-libs", or an in-process equivalent,
+       * to search for VDPAU drivers that we might have missed */
+      scanner = _srt_get_library_scanner (sysroot, runner, multiarch_tuple);
+
+      if (scanner != NULL)
         {
-          g_debug ("An error occurred trying to create a temporary folder: %s", error->message);
-          goto out;
+          vdpau_found = _srt_scan_vdpau_drivers (scanner, sysroot, runner,
+                                                 multiarch_tuple);
         }
-      vdpau_argv = _argv_for_list_vdpau_drivers (sysroot, runner,
-                                                 multiarch_tuple, tmp_dir, &error);
-      if (vdpau_argv == NULL)
+      else
         {
-          g_debug ("An error occurred trying to capture VDPAU drivers: %s", error->message);
-          goto out;
+          tmp_dir = g_dir_make_tmp ("vdpau-drivers-XXXXXX", &error);
+          if (tmp_dir == NULL)
+            {
+              g_debug ("An error occurred trying to create a temporary folder: %s", error->message);
+              complete = FALSE;
+              goto out;
+            }
+          vdpau_argv = _argv_for_list_vdpau_drivers (sysroot, runner,
+                                                     multiarch_tuple, tmp_dir, &error);
+          if (vdpau_argv == NULL)
+            {
+              g_debug ("An error occurred trying to capture VDPAU drivers: %s", error->message);
+              complete = FALSE;
+              goto out;
+            }
+          vdpau_found = _srt_list_found_libraries_from_directory (runner, vdpau_argv, tmp_dir);
+
+          if (vdpau_found == NULL)
+            complete = FALSE;
         }
-      _srt_list_modules_from_directory (runner, vdpau_argv, tmp_dir, drivers_set,
-                                        SRT_GRAPHICS_VDPAU_MODULE, is_extra, drivers_out);
+
+      if (vdpau_found != NULL)
+        _srt_add_found_modules (vdpau_found, drivers_set,
+                                SRT_GRAPHICS_VDPAU_MODULE, is_extra, drivers_out);
 
       if (!(check_flags & SRT_CHECK_FLAGS_SKIP_EXTRAS))
         {
@@ -1537,6 +1830,9 @@ _srt_get_modules_full (SrtSysroot *sysroot,
 
           if (!g_hash_table_contains (drivers_set, debian_additional))
             {
+              if (dependencies != NULL)
+                g_hash_table_add (dependencies, g_strdup (debian_additional));
+
               _srt_get_modules_from_path (sysroot, runner,
                                           multiarch_tuple, check_flags, debian_additional,
                                           TRUE, module, drivers_out);
@@ -1545,6 +1841,17 @@ _srt_get_modules_full (SrtSysroot *sysroot,
     }
 
 out:
+  if (dependencies != NULL)
+    {
+      GHashTableIter iter;
+      gpointer key;
+
+      g_hash_table_iter_init (&iter, drivers_set);
+
+      while (g_hash_table_iter_next (&iter, &key, NULL))
+        g_hash_table_add (dependencies, g_strdup (key));
+    }
+
   if (tmp_dir)
     {
       if (!_srt_rm_rf (tmp_dir))
@@ -1556,6 +1863,7 @@ out:
         g_debug ("Unable to remove the temporary directory: %s", capture_libs_output_dir);
     }
 
+  return complete;
 }
 
 /*
@@ -1566,6 +1874,12 @@ out:
  *  such as %SRT_ABI_X86_64
  * @check_flags: Flags affecting how we do the search
  * @which: Graphics modules to look for
+ * @dependencies: (nullable): If not %NULL, add the paths in @sysroot
+ *  whose contents can affect the result to this set.
+ *  This is not implemented for GLX modules.
+ * @complete_out: (out) (optional): Used to return %FALSE if part of
+ *  the search could not be done, so the result might be incomplete.
+ *  This is not implemented for GLX modules.
  *
  * Implementation of srt_system_info_list_dri_drivers() etc.
  *
@@ -1585,9 +1899,12 @@ _srt_list_graphics_modules (SrtSysroot *sysroot,
                             SrtSubprocessRunner *runner,
                             const char *multiarch_tuple,
                             SrtCheckFlags check_flags,
-                            SrtGraphicsModule which)
+                            SrtGraphicsModule which,
+                            GHashTable *dependencies,
+                            gboolean *complete_out)
 {
   GList *drivers = NULL;
+  gboolean complete = TRUE;
 
   g_return_val_if_fail (SRT_IS_SYSROOT (sysroot), NULL);
   g_return_val_if_fail (multiarch_tuple != NULL, NULL);
@@ -1595,8 +1912,12 @@ _srt_list_graphics_modules (SrtSysroot *sysroot,
   if (which == SRT_GRAPHICS_GLX_MODULE)
     _srt_list_glx_icds (sysroot, runner, multiarch_tuple, &drivers);
   else
-    _srt_get_modules_full (sysroot, runner, multiarch_tuple,
-                           check_flags, which, &drivers);
+    complete = _srt_get_modules_full (sysroot, runner, multiarch_tuple,
+                                      check_flags, which, dependencies,
+                                      &drivers);
+
+  if (complete_out != NULL)
+    *complete_out = complete;
 
   return g_list_reverse (drivers);
 }
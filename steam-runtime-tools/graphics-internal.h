@@ -309,7 +309,16 @@ GList *_srt_list_graphics_modules (SrtSysroot *sysroot,
                                    SrtSubprocessRunner *runner,
                                    const char *multiarch_tuple,
                                    SrtCheckFlags check_flags,
-                                   SrtGraphicsModule which);
+                                   SrtGraphicsModule which,
+                                   GHashTable *dependencies,
+                                   gboolean *complete_out);
+G_GNUC_INTERNAL
+GList *_srt_list_graphics_modules_cached (const char *cache_dir,
+                                          SrtSysroot *sysroot,
+                                          SrtSubprocessRunner *runner,
+                                          const char *multiarch_tuple,
+                                          SrtCheckFlags check_flags,
+                                          SrtGraphicsModule which);
 
 G_GNUC_INTERNAL
 GList *_srt_load_vulkan_layers_extended (SrtSysroot *sysroot,
@@ -97,3 +97,24 @@ gboolean _srt_json_builder_print (JsonBuilder *builder,
                                   FILE *fh,
                                   SrtJsonOutputFlags flags,
                                   GError **error);
+
+/*
+ * SrtJsonMember:
+ * @name: The member name, unescaped
+ * @key_start: Offset of the opening quote of the member name
+ * @start: Offset of the first byte of the member's value
+ * @end: Offset just after the last byte of the member's value
+ *
+ * The location of a member in the text of a JSON object.
+ */
+typedef struct
+{
+  gchar *name;
+  gsize key_start;
+  gsize start;
+  gsize end;
+} SrtJsonMember;
+
+GArray *_srt_json_scan_object_members (const char *data,
+                                       gsize len,
+                                       GError **error);
@@ -25,6 +25,8 @@
 
 #include "steam-runtime-tools/json-utils-internal.h"
 
+#include <string.h>
+
 #include "steam-runtime-tools/glib-backports-internal.h"
 #include "steam-runtime-tools/json-glib-backports-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
@@ -505,3 +507,253 @@ _srt_json_builder_print (JsonBuilder *builder,
 
   return TRUE;
 }
+
+static void
+srt_json_member_clear (gpointer p)
+{
+  SrtJsonMember *self = p;
+
+  g_clear_pointer (&self->name, g_free);
+}
+
+/*
+ * Return TRUE if @c is whitespace as defined by RFC 8259.
+ * Unlike strchr(" \t\r\n", c), this is FALSE for '\0'.
+ */
+static inline gboolean
+json_is_space (char c)
+{
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static void
+json_skip_space (const char *data,
+                 gsize len,
+                 gsize *pos)
+{
+  while (*pos < len && json_is_space (data[*pos]))
+    (*pos)++;
+}
+
+/*
+ * Skip a string starting at `data[*pos]`, which must be `"`.
+ * On success, `*pos` is left just after the closing quote, and
+ * @escaped is set if the string contained a backslash escape.
+ */
+static gboolean
+json_skip_string (const char *data,
+                  gsize len,
+                  gsize *pos,
+                  gboolean *escaped)
+{
+  gsize i;
+
+  g_return_val_if_fail (data[*pos] == '"', FALSE);
+
+  for (i = *pos + 1; i < len; i++)
+    {
+      if (data[i] == '\\')
+        {
+          if (escaped != NULL)
+            *escaped = TRUE;
+
+          i++;
+        }
+      else if (data[i] == '"')
+        {
+          *pos = i + 1;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+/*
+ * Skip a value starting at `data[*pos]`, leaving `*pos` just after it.
+ * This only tracks nesting and strings: the contents are not validated.
+ */
+static gboolean
+json_skip_value (const char *data,
+                 gsize len,
+                 gsize *pos)
+{
+  gsize depth = 0;
+  gsize i = *pos;
+
+  while (i < len)
+    {
+      char c = data[i];
+
+      if (c == '"')
+        {
+          if (!json_skip_string (data, len, &i, NULL))
+            return FALSE;
+
+          if (depth == 0)
+            break;
+
+          continue;
+        }
+
+      if (c == '{' || c == '[')
+        {
+          depth++;
+        }
+      else if (c == '}' || c == ']')
+        {
+          /* End of the enclosing object or array, after a scalar */
+          if (depth == 0)
+            break;
+
+          depth--;
+
+          if (depth == 0)
+            {
+              i++;
+              break;
+            }
+        }
+      else if (depth == 0 && (c == ',' || json_is_space (c)))
+        {
+          break;
+        }
+
+      i++;
+    }
+
+  if (depth != 0 || i == *pos)
+    return FALSE;
+
+  *pos = i;
+  return TRUE;
+}
+
+/*
+ * _srt_json_scan_object_members:
+ * @data: (array length=len): Text of a JSON object, not necessarily
+ *  `\0`-terminated
+ * @len: Length of @data in bytes
+ * @error: Used to raise an error on failure
+ *
+ * Find the members of a JSON object without parsing their values,
+ * so that a large document can be split into sections that are only
+ * parsed if they are needed. Only the structure of the object is
+ * checked: the values must still be parsed with json-glib before use.
+ *
+ * Returns: (transfer full) (element-type SrtJsonMember): The members
+ *  in the order they appear, with their offsets relative to @data
+ */
+GArray *
+_srt_json_scan_object_members (const char *data,
+                               gsize len,
+                               GError **error)
+{
+  g_autoptr(GArray) members = NULL;
+  gsize pos = 0;
+
+  members = g_array_new (FALSE, FALSE, sizeof (SrtJsonMember));
+  g_array_set_clear_func (members, srt_json_member_clear);
+
+  json_skip_space (data, len, &pos);
+
+  if (pos >= len || data[pos] != '{')
+    return glnx_null_throw (error, "Expected a JSON object");
+
+  pos++;
+  json_skip_space (data, len, &pos);
+
+  if (pos < len && data[pos] == '}')
+    {
+      pos++;
+      goto out;
+    }
+
+  while (TRUE)
+    {
+      SrtJsonMember member = {};
+      gboolean escaped = FALSE;
+
+      json_skip_space (data, len, &pos);
+
+      if (pos >= len || data[pos] != '"')
+        return glnx_null_throw (error,
+                                "Expected a member name at offset %" G_GSIZE_FORMAT,
+                                pos);
+
+      member.key_start = pos;
+
+      if (!json_skip_string (data, len, &pos, &escaped))
+        return glnx_null_throw (error,
+                                "Unterminated string at offset %" G_GSIZE_FORMAT,
+                                member.key_start);
+
+      if (escaped)
+        {
+          g_autofree gchar *key = g_strndup (data + member.key_start,
+                                             pos - member.key_start);
+          g_autoptr(JsonNode) node = json_from_string (key, error);
+
+          if (node == NULL)
+            return NULL;
+
+          member.name = json_node_dup_string (node);
+        }
+      else
+        {
+          member.name = g_strndup (data + member.key_start + 1,
+                                   pos - member.key_start - 2);
+        }
+
+      json_skip_space (data, len, &pos);
+
+      if (pos >= len || data[pos] != ':')
+        {
+          srt_json_member_clear (&member);
+          return glnx_null_throw (error,
+                                  "Expected ':' at offset %" G_GSIZE_FORMAT,
+                                  pos);
+        }
+
+      pos++;
+      json_skip_space (data, len, &pos);
+      member.start = pos;
+
+      if (!json_skip_value (data, len, &pos))
+        {
+          glnx_throw (error, "Invalid value for member \"%s\"", member.name);
+          srt_json_member_clear (&member);
+          return NULL;
+        }
+
+      member.end = pos;
+      g_array_append_val (members, member);
+      json_skip_space (data, len, &pos);
+
+      if (pos < len && data[pos] == ',')
+        {
+          pos++;
+          continue;
+        }
+
+      if (pos < len && data[pos] == '}')
+        {
+          pos++;
+          break;
+        }
+
+      return glnx_null_throw (error,
+                              "Expected ',' or '}' at offset %" G_GSIZE_FORMAT,
+                              pos);
+    }
+
+out:
+  json_skip_space (data, len, &pos);
+
+  if (pos != len)
+    return glnx_null_throw (error,
+                            "Unexpected data after JSON object at offset %" G_GSIZE_FORMAT,
+                            pos);
+
+  return g_steal_pointer (&members);
+}
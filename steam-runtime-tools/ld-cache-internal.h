@@ -0,0 +1,33 @@
+/*<private_header>*/
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <glib.h>
+
+/*
+ * SrtLdCacheEntry:
+ * @soname: The name by which the library is looked up, usually its SONAME
+ * @path: The absolute path to the library
+ */
+typedef struct
+{
+  gchar *soname;
+  gchar *path;
+} SrtLdCacheEntry;
+
+void _srt_ld_cache_entry_free (SrtLdCacheEntry *self);
+
+GPtrArray *_srt_ld_cache_list_entries (int dfd,
+                                       const char *path,
+                                       GError **error);
+GPtrArray *_srt_ld_cache_list_libraries (int dfd,
+                                         const char *path,
+                                         GError **error);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtLdCacheEntry, _srt_ld_cache_entry_free)
+#endif
@@ -0,0 +1,305 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "steam-runtime-tools/ld-cache-internal.h"
+
+#include <string.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+
+/*
+ * The layout of ld.so.cache, as described by glibc's sysdeps/generic/dl-cache.h.
+ * There are two formats: the "old" format, which might be followed by
+ * the "new" format for compatibility (glibc < 2.32 writes this by default),
+ * or the "new" format alone.
+ * All integers are in the host byte order.
+ */
+
+#define LD_CACHE_MAGIC_OLD "ld.so-1.7.0"
+#define LD_CACHE_MAGIC_NEW "glibc-ld.so.cache1.1"
+
+typedef struct
+{
+  char magic[sizeof (LD_CACHE_MAGIC_OLD) - 1];
+  guint32 n_libs;
+  /* Followed by n_libs LdCacheEntryOld, then the string table */
+} LdCacheHeaderOld;
+
+typedef struct
+{
+  gint32 flags;
+  /* Offsets into the string table */
+  guint32 key;
+  guint32 value;
+} LdCacheEntryOld;
+
+typedef struct
+{
+  char magic[sizeof (LD_CACHE_MAGIC_NEW) - 1];
+  guint32 n_libs;
+  guint32 len_strings;
+  guint32 unused[5];
+  /* Followed by n_libs LdCacheEntryNew, then the string table */
+} LdCacheHeaderNew;
+
+typedef struct
+{
+  gint32 flags;
+  /* Offsets relative to the beginning of LdCacheHeaderNew */
+  guint32 key;
+  guint32 value;
+  guint32 os_version;
+  guint64 hwcap;
+} LdCacheEntryNew;
+
+G_STATIC_ASSERT (sizeof (LdCacheHeaderOld) == 16);
+G_STATIC_ASSERT (sizeof (LdCacheEntryOld) == 12);
+G_STATIC_ASSERT (sizeof (LdCacheHeaderNew) == 48);
+G_STATIC_ASSERT (sizeof (LdCacheEntryNew) == 24);
+
+/*
+ * Return the nul-terminated string at @offset in a string table
+ * of length @len, or %NULL if it is out of range.
+ */
+static const char *
+ld_cache_get_string (const char *strings,
+                     gsize len,
+                     guint32 offset)
+{
+  if (offset >= len
+      || memchr (strings + offset, '\0', len - offset) == NULL)
+    return NULL;
+
+  return strings + offset;
+}
+
+static void
+ld_cache_add_entry (GPtrArray *entries,
+                    const char *key,
+                    const char *value)
+{
+  SrtLdCacheEntry *entry;
+
+  if (key == NULL || key[0] == '\0' || value == NULL || value[0] == '\0')
+    return;
+
+  entry = g_new0 (SrtLdCacheEntry, 1);
+  entry->soname = g_strdup (key);
+  entry->path = g_strdup (value);
+  g_ptr_array_add (entries, entry);
+}
+
+/*
+ * Add the entries from a cache in the old format, which starts at
+ * @data and continues to the end of the file.
+ */
+static gboolean
+ld_cache_read_old (const char *data,
+                   gsize len,
+                   GPtrArray *entries,
+                   GError **error)
+{
+  LdCacheHeaderOld header;
+  const char *strings;
+  gsize i;
+
+  memcpy (&header, data, sizeof (header));
+  strings = data + sizeof (header) + header.n_libs * sizeof (LdCacheEntryOld);
+
+  for (i = 0; i < header.n_libs; i++)
+    {
+      LdCacheEntryOld entry;
+
+      memcpy (&entry,
+              data + sizeof (header) + i * sizeof (LdCacheEntryOld),
+              sizeof (entry));
+      ld_cache_add_entry (entries,
+                          ld_cache_get_string (strings,
+                                               len - (strings - data),
+                                               entry.key),
+                          ld_cache_get_string (strings,
+                                               len - (strings - data),
+                                               entry.value));
+    }
+
+  return TRUE;
+}
+
+/*
+ * Add the entries from a cache in the new format, which starts at
+ * @data and continues to the end of the file.
+ */
+static gboolean
+ld_cache_read_new (const char *data,
+                   gsize len,
+                   GPtrArray *entries,
+                   GError **error)
+{
+  LdCacheHeaderNew header;
+  gsize i;
+
+  memcpy (&header, data, sizeof (header));
+
+  if (header.n_libs > (len - sizeof (header)) / sizeof (LdCacheEntryNew))
+    return glnx_throw (error, "Truncated: %u entries do not fit",
+                       header.n_libs);
+
+  for (i = 0; i < header.n_libs; i++)
+    {
+      LdCacheEntryNew entry;
+
+      memcpy (&entry,
+              data + sizeof (header) + i * sizeof (LdCacheEntryNew),
+              sizeof (entry));
+      /* In this format, string offsets are relative to the header */
+      ld_cache_add_entry (entries,
+                          ld_cache_get_string (data, len, entry.key),
+                          ld_cache_get_string (data, len, entry.value));
+    }
+
+  return TRUE;
+}
+
+void
+_srt_ld_cache_entry_free (SrtLdCacheEntry *self)
+{
+  g_free (self->soname);
+  g_free (self->path);
+  g_free (self);
+}
+
+/*
+ * _srt_ld_cache_list_entries:
+ * @dfd: A directory file descriptor, `AT_FDCWD` or -1
+ * @path: (type filename): Path to a cache generated by ldconfig(8),
+ *  typically `/etc/ld.so.cache`, relative to @dfd
+ * @error: Used to raise an error on failure
+ *
+ * Read the entries in @path without running ldconfig(8), which would
+ * rescan all library directories.
+ *
+ * Returns: (transfer container) (element-type SrtLdCacheEntry): The
+ *  entries, in the same order as in the cache, which is the order in
+ *  which the dynamic linker would try them
+ */
+GPtrArray *
+_srt_ld_cache_list_entries (int dfd,
+                            const char *path,
+                            GError **error)
+{
+  g_autoptr(GPtrArray) entries = NULL;
+  g_autoptr(GMappedFile) file = NULL;
+  glnx_autofd int fd = -1;
+  const char *data;
+  gsize len;
+  gboolean ok;
+
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  entries = g_ptr_array_new_with_free_func ((GDestroyNotify) _srt_ld_cache_entry_free);
+
+  if (!glnx_openat_rdonly (dfd, path, TRUE, &fd, error))
+    return NULL;
+
+  file = g_mapped_file_new_from_fd (fd, FALSE, error);
+
+  if (file == NULL)
+    return glnx_prefix_error_null (error, "Unable to map \"%s\"", path);
+
+  data = g_mapped_file_get_contents (file);
+  len = g_mapped_file_get_length (file);
+
+  if (len >= sizeof (LdCacheHeaderOld)
+      && memcmp (data, LD_CACHE_MAGIC_OLD, strlen (LD_CACHE_MAGIC_OLD)) == 0)
+    {
+      LdCacheHeaderOld header;
+      gsize new_offset;
+
+      memcpy (&header, data, sizeof (header));
+
+      if (header.n_libs > (len - sizeof (header)) / sizeof (LdCacheEntryOld))
+        return glnx_null_throw (error,
+                                "\"%s\" is truncated: %u entries do not fit",
+                                path, header.n_libs);
+
+      /* The new format might follow for compatibility, aligned to
+       * a multiple of 8 bytes. If it does, prefer it. */
+      new_offset = sizeof (header) + header.n_libs * sizeof (LdCacheEntryOld);
+      new_offset = (new_offset + 7) & ~((gsize) 7);
+
+      if (new_offset + sizeof (LdCacheHeaderNew) <= len
+          && memcmp (data + new_offset, LD_CACHE_MAGIC_NEW,
+                     strlen (LD_CACHE_MAGIC_NEW)) == 0)
+        ok = ld_cache_read_new (data + new_offset, len - new_offset,
+                                entries, error);
+      else
+        ok = ld_cache_read_old (data, len, entries, error);
+    }
+  else if (len >= sizeof (LdCacheHeaderNew)
+           && memcmp (data, LD_CACHE_MAGIC_NEW, strlen (LD_CACHE_MAGIC_NEW)) == 0)
+    {
+      ok = ld_cache_read_new (data, len, entries, error);
+    }
+  else
+    {
+      return glnx_null_throw (error,
+                              "\"%s\" is not in a recognised ld.so.cache format",
+                              path);
+    }
+
+  if (!ok)
+    return glnx_prefix_error_null (error, "Unable to read \"%s\"", path);
+
+  return g_steal_pointer (&entries);
+}
+
+/*
+ * _srt_ld_cache_list_libraries:
+ * @dfd: A directory file descriptor, `AT_FDCWD` or -1
+ * @path: (type filename): Path to a cache generated by ldconfig(8),
+ *  typically `/etc/ld.so.cache`, relative to @dfd
+ * @error: Used to raise an error on failure
+ *
+ * Read the absolute paths of the libraries listed in @path without
+ * running ldconfig(8), which would rescan all library directories.
+ *
+ * Returns: (transfer container) (element-type filename): The paths,
+ *  in the same order as in the cache, without duplicates
+ */
+GPtrArray *
+_srt_ld_cache_list_libraries (int dfd,
+                              const char *path,
+                              GError **error)
+{
+  g_autoptr(GPtrArray) entries = NULL;
+  g_autoptr(GPtrArray) libraries = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  gsize i;
+
+  entries = _srt_ld_cache_list_entries (dfd, path, error);
+
+  if (entries == NULL)
+    return NULL;
+
+  libraries = g_ptr_array_new_full (entries->len, g_free);
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+
+  for (i = 0; i < entries->len; i++)
+    {
+      SrtLdCacheEntry *entry = g_ptr_array_index (entries, i);
+
+      /* The same path can appear more than once, for example
+       * with different hwcaps */
+      if (!g_hash_table_add (seen, entry->path))
+        continue;
+
+      g_ptr_array_add (libraries, g_strdup (entry->path));
+    }
+
+  return g_steal_pointer (&libraries);
+}
@@ -37,6 +37,16 @@ G_GNUC_INTERNAL gchar *_srt_libdl_detect_lib (SrtSubprocessRunner *runner,
                                               const char *multiarch_tuple,
                                               GError **error);
 
+G_GNUC_INTERNAL void _srt_libdl_detect_async (SrtSubprocessRunner *runner,
+                                              const char *multiarch_tuple,
+                                              const char *helper_name,
+                                              GCancellable *cancellable,
+                                              GAsyncReadyCallback callback,
+                                              gpointer user_data);
+G_GNUC_INTERNAL gchar *_srt_libdl_detect_finish (SrtSubprocessRunner *runner,
+                                                 GAsyncResult *result,
+                                                 GError **error);
+
 typedef enum
 {
   SRT_LOADABLE_KIND_ERROR,
@@ -29,22 +29,13 @@
 #include "steam-runtime-tools/utils.h"
 #include "steam-runtime-tools/utils-internal.h"
 
-static gchar *
-_srt_libdl_run_helper (SrtSubprocessRunner *runner,
+static GPtrArray *
+_srt_libdl_get_helper (SrtSubprocessRunner *runner,
                        const char *multiarch_tuple,
                        const char *helper_name,
                        GError **error)
 {
-  SrtHelperFlags helper_flags = SRT_HELPER_FLAGS_NONE;
   g_autoptr(GPtrArray) argv = NULL;
-  g_autoptr(SrtCompletedSubprocess) completed = NULL;
-  g_autofree gchar *child_stdout = NULL;
-  gsize len;
-
-  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), NULL);
-  g_return_val_if_fail (helper_name != NULL, NULL);
-  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
-  g_return_val_if_fail (_srt_check_not_setuid (), NULL);
 
 #if defined(_SRT_MULTIARCH)
   if (multiarch_tuple == NULL)
@@ -52,7 +43,7 @@ _srt_libdl_run_helper (SrtSubprocessRunner *runner,
 #endif
 
   argv = _srt_subprocess_runner_get_helper (runner, multiarch_tuple,
-                                            helper_name, helper_flags,
+                                            helper_name, SRT_HELPER_FLAGS_NONE,
                                             error);
 
   if (argv == NULL)
@@ -61,16 +52,15 @@ _srt_libdl_run_helper (SrtSubprocessRunner *runner,
   g_ptr_array_add (argv, NULL);
 
   g_debug ("Running %s", (const char *) g_ptr_array_index (argv, 0));
+  return g_steal_pointer (&argv);
+}
 
-  completed = _srt_subprocess_runner_run_sync (runner,
-                                               helper_flags,
-                                               (const char * const *) argv->pdata,
-                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
-                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
-                                               error);
-
-  if (completed == NULL)
-    return NULL;
+static gchar *
+_srt_libdl_get_helper_output (SrtCompletedSubprocess *completed,
+                              GError **error)
+{
+  g_autofree gchar *child_stdout = NULL;
+  gsize len;
 
   if (!_srt_completed_subprocess_report (completed, NULL, NULL, NULL, NULL))
     return glnx_null_throw (error, "%s",
@@ -87,6 +77,138 @@ _srt_libdl_run_helper (SrtSubprocessRunner *runner,
   return g_steal_pointer(&child_stdout);
 }
 
+static gchar *
+_srt_libdl_run_helper (SrtSubprocessRunner *runner,
+                       const char *multiarch_tuple,
+                       const char *helper_name,
+                       GError **error)
+{
+  g_autoptr(GPtrArray) argv = NULL;
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), NULL);
+  g_return_val_if_fail (helper_name != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  g_return_val_if_fail (_srt_check_not_setuid (), NULL);
+
+  argv = _srt_libdl_get_helper (runner, multiarch_tuple, helper_name, error);
+
+  if (argv == NULL)
+    return NULL;
+
+  completed = _srt_subprocess_runner_run_sync (runner,
+                                               SRT_HELPER_FLAGS_NONE,
+                                               (const char * const *) argv->pdata,
+                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                               error);
+
+  if (completed == NULL)
+    return NULL;
+
+  return _srt_libdl_get_helper_output (completed, error);
+}
+
+static void
+_srt_libdl_detect_cb (GObject *source_object,
+                      GAsyncResult *result,
+                      gpointer user_data)
+{
+  SrtSubprocessRunner *runner = SRT_SUBPROCESS_RUNNER (source_object);
+  g_autoptr(GTask) task = user_data;
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+  g_autoptr(GError) error = NULL;
+  gchar *output;
+
+  completed = _srt_subprocess_runner_run_finish (runner, result, &error);
+
+  if (completed == NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  output = _srt_libdl_get_helper_output (completed, &error);
+
+  if (output == NULL)
+    g_task_return_error (task, g_steal_pointer (&error));
+  else
+    g_task_return_pointer (task, output, g_free);
+}
+
+/*
+ * _srt_libdl_detect_async:
+ * @runner: The subprocess runner
+ * @multiarch_tuple: (nullable): A multiarch tuple, or %NULL to use the
+ *  architecture we were compiled for
+ * @helper_name: `detect-lib` or `detect-platform`
+ * @cancellable: (nullable): If cancelled, the helper is not started,
+ *  or is killed if it has already started
+ * @callback: Called when the helper has finished
+ * @user_data: Passed to @callback
+ *
+ * Start the same check as _srt_libdl_detect_lib() or
+ * _srt_libdl_detect_platform(), using _srt_subprocess_runner_run_async()
+ * so that it can run at the same time as other checks.
+ */
+void
+_srt_libdl_detect_async (SrtSubprocessRunner *runner,
+                         const char *multiarch_tuple,
+                         const char *helper_name,
+                         GCancellable *cancellable,
+                         GAsyncReadyCallback callback,
+                         gpointer user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GPtrArray) argv = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_return_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner));
+  g_return_if_fail (helper_name != NULL);
+  g_return_if_fail (_srt_check_not_setuid ());
+
+  task = g_task_new (runner, cancellable, callback, user_data);
+  g_task_set_source_tag (task, _srt_libdl_detect_async);
+
+  argv = _srt_libdl_get_helper (runner, multiarch_tuple, helper_name, &error);
+
+  if (argv == NULL)
+    {
+      g_task_return_error (task, g_steal_pointer (&error));
+      return;
+    }
+
+  _srt_subprocess_runner_run_async (runner,
+                                    SRT_HELPER_FLAGS_NONE,
+                                    (const char * const *) argv->pdata,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                    cancellable,
+                                    _srt_libdl_detect_cb,
+                                    g_steal_pointer (&task));
+}
+
+/*
+ * _srt_libdl_detect_finish:
+ * @runner: The subprocess runner
+ * @result: The result passed to the callback
+ * @error: Used to raise an error if %NULL is returned
+ *
+ * Returns: (transfer full): The expansion of `$LIB` or `$PLATFORM`,
+ *  as for _srt_libdl_detect_lib() or _srt_libdl_detect_platform()
+ */
+gchar *
+_srt_libdl_detect_finish (SrtSubprocessRunner *runner,
+                          GAsyncResult *result,
+                          GError **error)
+{
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, runner), NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
+
 gchar *
 _srt_libdl_detect_platform (SrtSubprocessRunner *runner,
                             const char *multiarch_tuple,
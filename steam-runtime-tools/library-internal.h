@@ -103,6 +103,30 @@ _srt_library_new (const char *multiarch_tuple,
 }
 #endif
 
+/*
+ * SrtLibraryCheck:
+ * @requested_name: The `SONAME` or path of a shared library
+ * @symbols_path: (nullable): The filename of a file listing symbols
+ * @hidden_deps: (nullable): Libraries to load before @requested_name
+ *
+ * One of the libraries to be checked by _srt_check_libraries_presence().
+ */
+typedef struct
+{
+  const char *requested_name;
+  const char *symbols_path;
+  const char * const *hidden_deps;
+} SrtLibraryCheck;
+
+G_GNUC_INTERNAL
+SrtLibraryIssues _srt_check_libraries_presence (SrtSubprocessRunner *runner,
+                                                const char *multiarch,
+                                                const SrtLibraryCheck *checks,
+                                                gsize n_checks,
+                                                SrtCheckFlags check_flags,
+                                                SrtLibrarySymbolsFormat symbols_format,
+                                                SrtLibrary **details_out);
+
 G_GNUC_INTERNAL
 SrtLibraryIssues _srt_check_library_presence (SrtSubprocessRunner *runner,
                                               const char *requested_name,
@@ -0,0 +1,57 @@
+/*<private_header>*/
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "steam-runtime-tools/resolve-in-sysroot-internal.h"
+
+typedef struct _SrtLibraryScanner SrtLibraryScanner;
+
+/*
+ * SrtFoundLibrary:
+ * @name: The name by which the library was found: its key in the
+ *  ld.so cache for a SONAME, or the basename of @path otherwise
+ * @path: The absolute path to the library, as it was found
+ * @real_path: (nullable): @path with symbolic links in its last
+ *  component followed, in the same way as capsule-capture-libs when
+ *  it is asked for a `--link-target`, or %NULL if not known
+ *
+ * A library found by a #SrtLibraryScanner or by the
+ * capsule-capture-libs helper.
+ */
+typedef struct
+{
+  gchar *name;
+  gchar *path;
+  gchar *real_path;
+} SrtFoundLibrary;
+
+SrtFoundLibrary *_srt_found_library_new (const char *name,
+                                         const char *path,
+                                         const char *real_path);
+void _srt_found_library_free (SrtFoundLibrary *self);
+
+SrtLibraryScanner *_srt_library_scanner_get (SrtSysroot *sysroot);
+void _srt_library_scanner_unref (SrtLibraryScanner *self);
+
+SrtFoundLibrary *_srt_library_scanner_find_soname (SrtLibraryScanner *self,
+                                                   const char *multiarch_tuple,
+                                                   const char *soname,
+                                                   const char *ld_library_path);
+GPtrArray *_srt_library_scanner_match_soname (SrtLibraryScanner *self,
+                                              const char *multiarch_tuple,
+                                              const char *pattern);
+GPtrArray *_srt_library_scanner_match_path (SrtLibraryScanner *self,
+                                            const char *multiarch_tuple,
+                                            const char *directory,
+                                            const char *pattern);
+
+#ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtFoundLibrary, _srt_found_library_free)
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtLibraryScanner, _srt_library_scanner_unref)
+#endif
@@ -0,0 +1,657 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "steam-runtime-tools/library-scanner-internal.h"
+
+#include <fnmatch.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/stat.h>
+
+#include <gelf.h>
+#include <libelf.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/architecture-internal.h"
+#include "steam-runtime-tools/elf-utils-internal.h"
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/ld-cache-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+
+/*
+ * LdCacheStamp:
+ *
+ * Enough information about the sysroot's ld.so cache to notice when it
+ * has been replaced or modified, or all zeroes if it does not exist.
+ */
+typedef struct
+{
+  dev_t dev;
+  ino_t ino;
+  off_t size;
+  struct timespec mtime;
+  struct timespec ctime;
+} LdCacheStamp;
+
+static void
+ld_cache_stamp_init (LdCacheStamp *stamp,
+                     SrtSysroot *sysroot)
+{
+  glnx_autofd int fd = -1;
+  struct stat stat_buf;
+
+  memset (stamp, 0, sizeof (*stamp));
+  fd = _srt_sysroot_open (sysroot, "/etc/ld.so.cache",
+                          SRT_RESOLVE_FLAGS_MUST_BE_REGULAR, NULL, NULL);
+
+  if (fd < 0 || fstat (fd, &stat_buf) != 0)
+    return;
+
+  stamp->dev = stat_buf.st_dev;
+  stamp->ino = stat_buf.st_ino;
+  stamp->size = stat_buf.st_size;
+  stamp->mtime = stat_buf.st_mtim;
+  stamp->ctime = stat_buf.st_ctim;
+}
+
+static gboolean
+ld_cache_stamp_equal (const LdCacheStamp *a,
+                      const LdCacheStamp *b)
+{
+  return (a->dev == b->dev
+          && a->ino == b->ino
+          && a->size == b->size
+          && a->mtime.tv_sec == b->mtime.tv_sec
+          && a->mtime.tv_nsec == b->mtime.tv_nsec
+          && a->ctime.tv_sec == b->ctime.tv_sec
+          && a->ctime.tv_nsec == b->ctime.tv_nsec);
+}
+
+/*
+ * SrtLibraryScanner:
+ *
+ * Finds libraries in a sysroot in-process, in the same order as the
+ * capsule-capture-libs helper: see _srt_library_scanner_find_soname().
+ *
+ * The ld.so cache is read once, and each candidate file is opened at
+ * most once to find out which ABI it belongs to, no matter how many
+ * ABIs and kinds of module are asked for. Results are reused until
+ * the sysroot's ld.so cache changes, which is what normally happens
+ * when libraries are installed, removed or upgraded: after that,
+ * _srt_library_scanner_get() returns a new scanner.
+ */
+struct _SrtLibraryScanner
+{
+  GMutex mutex;
+  /* (not owned): the sysroot owns a reference to the scanner */
+  SrtSysroot *sysroot;
+  /* The ld.so cache that this scanner's results are based on */
+  LdCacheStamp ld_cache_stamp;
+  /* (element-type SrtLdCacheEntry) (nullable): Loaded on first use */
+  GPtrArray *ld_cache;
+  /* Absolute path in sysroot => owned ScannedFile */
+  GHashTable *files;
+};
+
+/*
+ * ScannedFile:
+ * @real_path: The absolute path in the sysroot with symlinks in its
+ *  last component followed, or %NULL if it could not be opened as
+ *  an ELF object
+ * @machine: ELF machine type, such as `EM_X86_64`
+ * @elf_class: ELF class, such as `ELFCLASS64`
+ * @elf_encoding: ELF data encoding, such as `ELFDATA2LSB`
+ */
+typedef struct
+{
+  gchar *real_path;
+  guint16 machine;
+  guint8 elf_class;
+  guint8 elf_encoding;
+} ScannedFile;
+
+static void
+scanned_file_free (ScannedFile *self)
+{
+  g_free (self->real_path);
+  g_free (self);
+}
+
+/*
+ * Follow symbolic links in the last component of @path, in the same way
+ * as capsule-capture-libs: an absolute target is taken to be relative
+ * to the sysroot, and a relative target is appended to the directory
+ * containing the link, without further canonicalization.
+ *
+ * Returns: (transfer full): The absolute path in @sysroot
+ */
+static gchar *
+sysroot_follow_final_symlinks (SrtSysroot *sysroot,
+                               const char *path)
+{
+  g_autofree gchar *current = g_strdup (path);
+  int i;
+
+  for (i = 0; i < MAXSYMLINKS; i++)
+    {
+      g_autofree gchar *target = NULL;
+      glnx_autofd int fd = -1;
+
+      fd = _srt_sysroot_open (sysroot, current,
+                              SRT_RESOLVE_FLAGS_KEEP_FINAL_SYMLINK,
+                              NULL, NULL);
+
+      if (fd < 0)
+        break;
+
+      /* Fails with EINVAL if it is not a symlink */
+      target = glnx_readlinkat_malloc (fd, "", NULL, NULL);
+
+      if (target == NULL)
+        break;
+
+      if (target[0] == '/')
+        {
+          g_clear_pointer (&current, g_free);
+          current = g_steal_pointer (&target);
+        }
+      else
+        {
+          g_autofree gchar *dir = g_path_get_dirname (current);
+
+          g_clear_pointer (&current, g_free);
+          current = g_build_filename (dir, target, NULL);
+        }
+    }
+
+  return g_steal_pointer (&current);
+}
+
+static ScannedFile *
+scanned_file_new (SrtSysroot *sysroot,
+                  const char *path)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(Elf) elf = NULL;
+  g_autofree gchar *resolved = NULL;
+  glnx_autofd int path_fd = -1;
+  glnx_autofd int fd = -1;
+  ScannedFile *file = g_new0 (ScannedFile, 1);
+  GElf_Ehdr eh;
+  gboolean ok;
+
+  path_fd = _srt_sysroot_open (sysroot, path,
+                               (SRT_RESOLVE_FLAGS_MUST_BE_REGULAR
+                                | SRT_RESOLVE_FLAGS_RETURN_ABSOLUTE),
+                               &resolved, &local_error);
+
+  if (path_fd < 0)
+    {
+      g_debug ("%s", local_error->message);
+      return file;
+    }
+
+  if (_srt_sysroot_is_direct (sysroot))
+    ok = _srt_open_elf (AT_FDCWD, resolved, &fd, &elf, &local_error);
+  else
+    ok = _srt_open_elf (sysroot->fd, resolved + 1, &fd, &elf, &local_error);
+
+  if (!ok)
+    {
+      g_debug ("%s", local_error->message);
+      return file;
+    }
+
+  if (gelf_getehdr (elf, &eh) == NULL)
+    {
+      g_debug ("Error reading ELF header of \"%s\": %s",
+               path, elf_errmsg (elf_errno ()));
+      return file;
+    }
+
+  file->machine = eh.e_machine;
+  file->elf_class = eh.e_ident[EI_CLASS];
+  file->elf_encoding = eh.e_ident[EI_DATA];
+  file->real_path = sysroot_follow_final_symlinks (sysroot, path);
+  return file;
+}
+
+static gboolean
+scanned_file_is_abi (const ScannedFile *self,
+                     const SrtKnownArchitecture *arch)
+{
+  return (self->real_path != NULL
+          && self->machine == arch->machine_type
+          && self->elf_class == arch->elf_class
+          && self->elf_encoding == arch->elf_encoding);
+}
+
+SrtFoundLibrary *
+_srt_found_library_new (const char *name,
+                        const char *path,
+                        const char *real_path)
+{
+  SrtFoundLibrary *self = g_new0 (SrtFoundLibrary, 1);
+
+  self->name = g_strdup (name);
+  self->path = g_strdup (path);
+  self->real_path = g_strdup (real_path);
+  return self;
+}
+
+void
+_srt_found_library_free (SrtFoundLibrary *self)
+{
+  g_free (self->name);
+  g_free (self->path);
+  g_free (self->real_path);
+  g_free (self);
+}
+
+static void
+library_scanner_clear (gpointer data)
+{
+  SrtLibraryScanner *self = data;
+
+  g_clear_pointer (&self->ld_cache, g_ptr_array_unref);
+  g_clear_pointer (&self->files, g_hash_table_unref);
+  g_mutex_clear (&self->mutex);
+}
+
+void
+_srt_library_scanner_unref (SrtLibraryScanner *self)
+{
+  g_atomic_rc_box_release_full (self, library_scanner_clear);
+}
+
+/*
+ * _srt_library_scanner_get:
+ * @sysroot: The root directory, usually `/`
+ *
+ * Return the library scanner for @sysroot, creating it if necessary.
+ * It is safe to use from more than one thread. It caches the ld.so cache
+ * and the ABI of each library, until the sysroot's ld.so cache changes:
+ * after that, a new scanner is returned. A scanner that is already in
+ * use carries on with its old results.
+ *
+ * Returns: (transfer full): A scanner, which must not be used after
+ *  @sysroot has been freed. Free with _srt_library_scanner_unref().
+ */
+SrtLibraryScanner *
+_srt_library_scanner_get (SrtSysroot *sysroot)
+{
+  static GMutex lock;
+  static GQuark quark = 0;
+  SrtLibraryScanner *self;
+  LdCacheStamp stamp;
+
+  g_return_val_if_fail (SRT_IS_SYSROOT (sysroot), NULL);
+
+  ld_cache_stamp_init (&stamp, sysroot);
+
+  g_mutex_lock (&lock);
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("srt-library-scanner");
+
+  self = g_object_get_qdata (G_OBJECT (sysroot), quark);
+
+  if (self == NULL || !ld_cache_stamp_equal (&self->ld_cache_stamp, &stamp))
+    {
+      self = g_atomic_rc_box_new0 (SrtLibraryScanner);
+      g_mutex_init (&self->mutex);
+      self->sysroot = sysroot;
+      self->ld_cache_stamp = stamp;
+      self->files = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify) scanned_file_free);
+      /* This releases the sysroot's reference to the old scanner, if any */
+      g_object_set_qdata_full (G_OBJECT (sysroot), quark, self,
+                               (GDestroyNotify) _srt_library_scanner_unref);
+    }
+
+  g_atomic_rc_box_acquire (self);
+  g_mutex_unlock (&lock);
+  return self;
+}
+
+/*
+ * Returns: (transfer none) (element-type SrtLdCacheEntry): The entries
+ *  in the sysroot's ld.so cache, which might be empty
+ */
+static GPtrArray *
+library_scanner_get_ld_cache (SrtLibraryScanner *self)
+{
+  GPtrArray *ret;
+
+  g_mutex_lock (&self->mutex);
+
+  if (self->ld_cache == NULL)
+    {
+      g_autoptr(GError) local_error = NULL;
+      g_autofree gchar *resolved = NULL;
+      glnx_autofd int fd = -1;
+
+      fd = _srt_sysroot_open (self->sysroot, "/etc/ld.so.cache",
+                              (SRT_RESOLVE_FLAGS_MUST_BE_REGULAR
+                               | SRT_RESOLVE_FLAGS_RETURN_ABSOLUTE),
+                              &resolved, &local_error);
+
+      if (fd >= 0 && _srt_sysroot_is_direct (self->sysroot))
+        self->ld_cache = _srt_ld_cache_list_entries (AT_FDCWD, resolved,
+                                                     &local_error);
+      else if (fd >= 0)
+        self->ld_cache = _srt_ld_cache_list_entries (self->sysroot->fd,
+                                                     resolved + 1,
+                                                     &local_error);
+
+      if (self->ld_cache == NULL)
+        {
+          g_debug ("Unable to load ld.so cache in \"%s\": %s",
+                   self->sysroot->path, local_error->message);
+          self->ld_cache = g_ptr_array_new ();
+        }
+    }
+
+  /* Never modified after it has been loaded */
+  ret = self->ld_cache;
+  g_mutex_unlock (&self->mutex);
+  return ret;
+}
+
+/*
+ * Open @path in the sysroot to find out its ABI, unless we already did.
+ *
+ * Returns: (transfer none): Information about @path, valid for
+ *  the lifetime of @self
+ */
+static const ScannedFile *
+library_scanner_scan (SrtLibraryScanner *self,
+                      const char *path)
+{
+  ScannedFile *file;
+  ScannedFile *existing;
+
+  g_mutex_lock (&self->mutex);
+  file = g_hash_table_lookup (self->files, path);
+  g_mutex_unlock (&self->mutex);
+
+  if (file != NULL)
+    return file;
+
+  /* Don't hold the lock while doing I/O, so that other threads can
+   * scan different files. If two threads scan the same file at the
+   * same time, the first result wins. */
+  file = scanned_file_new (self->sysroot, path);
+
+  g_mutex_lock (&self->mutex);
+  existing = g_hash_table_lookup (self->files, path);
+
+  if (existing != NULL)
+    {
+      scanned_file_free (file);
+      file = existing;
+    }
+  else
+    {
+      g_hash_table_replace (self->files, g_strdup (path), file);
+    }
+
+  g_mutex_unlock (&self->mutex);
+  return file;
+}
+
+/*
+ * Look for @soname in each directory in the colon-separated list
+ * @search_path, interpreted relative to the sysroot.
+ *
+ * Returns: (transfer full) (nullable): The library, or %NULL if not found
+ */
+static SrtFoundLibrary *
+library_scanner_search_path (SrtLibraryScanner *self,
+                             const SrtKnownArchitecture *arch,
+                             const char *soname,
+                             const char *search_path)
+{
+  g_auto(GStrv) dirs = g_strsplit (search_path, ":", -1);
+  gsize i;
+
+  for (i = 0; dirs[i] != NULL; i++)
+    {
+      g_autofree gchar *path = NULL;
+      const ScannedFile *file;
+
+      /* An empty entry would mean the current working directory, which
+       * is meaningless in a sysroot, so skip it */
+      if (dirs[i][0] == '\0')
+        continue;
+
+      path = g_build_filename ("/", dirs[i], soname, NULL);
+      file = library_scanner_scan (self, path);
+
+      if (scanned_file_is_abi (file, arch))
+        return _srt_found_library_new (soname, path, file->real_path);
+    }
+
+  return NULL;
+}
+
+/*
+ * _srt_library_scanner_find_soname:
+ * @self: The scanner
+ * @multiarch_tuple: A Debian-style multiarch tuple with a known ELF
+ *  machine type, such as %SRT_ABI_X86_64
+ * @soname: A SONAME such as `libvdpau.so.1`
+ * @ld_library_path: (nullable): The `LD_LIBRARY_PATH` with which
+ *  capsule-capture-libs would have been run
+ *
+ * Find the library that the dynamic linker would load for @soname,
+ * like capsule-capture-libs does for `soname:SONAME`, searching in
+ * the same order:
+ *
+ * - each directory in @ld_library_path, interpreted relative to the
+ *   sysroot, in the same way as capsule-capture-libs `--provider`
+ * - the sysroot's ld.so cache
+ * - `/lib` and `/usr/lib`
+ *
+ * Like capsule-capture-libs, this does not search the multiarch or
+ * `lib64` directories unless they are listed in the ld.so cache,
+ * and does not expand `$ORIGIN`, `$LIB` or `$PLATFORM`.
+ *
+ * Returns: (transfer full) (nullable): The library, or %NULL if not found
+ */
+SrtFoundLibrary *
+_srt_library_scanner_find_soname (SrtLibraryScanner *self,
+                                  const char *multiarch_tuple,
+                                  const char *soname,
+                                  const char *ld_library_path)
+{
+  SrtFoundLibrary *found;
+  const SrtKnownArchitecture *arch;
+  GPtrArray *ld_cache;
+  gsize i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (multiarch_tuple != NULL, NULL);
+  g_return_val_if_fail (soname != NULL, NULL);
+  g_return_val_if_fail (strchr (soname, '/') == NULL, NULL);
+
+  arch = _srt_architecture_get_by_tuple (multiarch_tuple);
+  g_return_val_if_fail (arch != NULL, NULL);
+
+  if (ld_library_path != NULL)
+    {
+      found = library_scanner_search_path (self, arch, soname,
+                                           ld_library_path);
+
+      if (found != NULL)
+        return found;
+    }
+
+  ld_cache = library_scanner_get_ld_cache (self);
+
+  for (i = 0; i < ld_cache->len; i++)
+    {
+      const SrtLdCacheEntry *entry = g_ptr_array_index (ld_cache, i);
+      const ScannedFile *file;
+
+      if (strcmp (entry->soname, soname) != 0)
+        continue;
+
+      file = library_scanner_scan (self, entry->path);
+
+      if (scanned_file_is_abi (file, arch))
+        return _srt_found_library_new (soname, entry->path, file->real_path);
+    }
+
+  return library_scanner_search_path (self, arch, soname, "/lib:/usr/lib");
+}
+
+/*
+ * _srt_library_scanner_match_soname:
+ * @self: The scanner
+ * @multiarch_tuple: A Debian-style multiarch tuple with a known ELF
+ *  machine type, such as %SRT_ABI_X86_64
+ * @pattern: A glob pattern such as `libGLX_*.so.0`
+ *
+ * Find libraries whose SONAME in the ld.so cache matches @pattern,
+ * like capsule-capture-libs does for `soname-match:PATTERN`.
+ *
+ * Returns: (transfer container) (element-type SrtFoundLibrary): The
+ *  first library of the right ABI for each matching SONAME, in
+ *  ld.so cache order
+ */
+GPtrArray *
+_srt_library_scanner_match_soname (SrtLibraryScanner *self,
+                                   const char *multiarch_tuple,
+                                   const char *pattern)
+{
+  g_autoptr(GPtrArray) found = NULL;
+  g_autoptr(GHashTable) seen = NULL;
+  const SrtKnownArchitecture *arch;
+  GPtrArray *ld_cache;
+  gsize i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (multiarch_tuple != NULL, NULL);
+  g_return_val_if_fail (pattern != NULL, NULL);
+
+  arch = _srt_architecture_get_by_tuple (multiarch_tuple);
+  g_return_val_if_fail (arch != NULL, NULL);
+
+  found = g_ptr_array_new_with_free_func ((GDestroyNotify) _srt_found_library_free);
+  seen = g_hash_table_new (g_str_hash, g_str_equal);
+  ld_cache = library_scanner_get_ld_cache (self);
+
+  for (i = 0; i < ld_cache->len; i++)
+    {
+      const SrtLdCacheEntry *entry = g_ptr_array_index (ld_cache, i);
+      const ScannedFile *file;
+
+      if (g_hash_table_contains (seen, entry->soname)
+          || fnmatch (pattern, entry->soname, 0) != 0)
+        continue;
+
+      file = library_scanner_scan (self, entry->path);
+
+      if (!scanned_file_is_abi (file, arch))
+        continue;
+
+      g_hash_table_add (seen, entry->soname);
+      g_ptr_array_add (found,
+                       _srt_found_library_new (entry->soname, entry->path,
+                                               file->real_path));
+    }
+
+  return g_steal_pointer (&found);
+}
+
+/*
+ * _srt_library_scanner_match_path:
+ * @self: The scanner
+ * @multiarch_tuple: A Debian-style multiarch tuple with a known ELF
+ *  machine type, such as %SRT_ABI_X86_64
+ * @directory: An absolute path in the sysroot
+ * @pattern: A glob pattern such as `libGLX_*.so.*`, matched against
+ *  the names of members of @directory
+ *
+ * Find libraries in @directory whose names match @pattern, like
+ * capsule-capture-libs does for `path-match:DIRECTORY/PATTERN`.
+ *
+ * Returns: (transfer container) (element-type SrtFoundLibrary): The
+ *  matching libraries of the right ABI, sorted by name
+ */
+GPtrArray *
+_srt_library_scanner_match_path (SrtLibraryScanner *self,
+                                 const char *multiarch_tuple,
+                                 const char *directory,
+                                 const char *pattern)
+{
+  g_auto(GLnxDirFdIterator) iter = { FALSE };
+  g_autoptr(GPtrArray) found = NULL;
+  g_autoptr(GPtrArray) members = NULL;
+  g_autoptr(GError) local_error = NULL;
+  const SrtKnownArchitecture *arch;
+  glnx_autofd int dirfd = -1;
+  gsize i;
+
+  g_return_val_if_fail (self != NULL, NULL);
+  g_return_val_if_fail (multiarch_tuple != NULL, NULL);
+  g_return_val_if_fail (directory != NULL, NULL);
+  g_return_val_if_fail (pattern != NULL, NULL);
+
+  arch = _srt_architecture_get_by_tuple (multiarch_tuple);
+  g_return_val_if_fail (arch != NULL, NULL);
+
+  found = g_ptr_array_new_with_free_func ((GDestroyNotify) _srt_found_library_free);
+
+  dirfd = _srt_sysroot_open (self->sysroot, directory,
+                             (SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY
+                              | SRT_RESOLVE_FLAGS_READABLE),
+                             NULL, &local_error);
+
+  if (dirfd < 0
+      || !glnx_dirfd_iterator_init_take_fd (&dirfd, &iter, &local_error))
+    {
+      g_debug ("Failed to open \"%s%s\": %s",
+               self->sysroot->path, directory, local_error->message);
+      return g_steal_pointer (&found);
+    }
+
+  members = g_ptr_array_new_with_free_func (g_free);
+
+  while (TRUE)
+    {
+      struct dirent *dent = NULL;
+
+      if (!glnx_dirfd_iterator_next_dent (&iter, &dent, NULL, &local_error))
+        {
+          g_debug ("I/O error reading members of \"%s%s\": %s",
+                   self->sysroot->path, directory, local_error->message);
+          break;
+        }
+
+      if (dent == NULL)
+        break;
+
+      if (fnmatch (pattern, dent->d_name, 0) == 0)
+        g_ptr_array_add (members, g_strdup (dent->d_name));
+    }
+
+  g_ptr_array_sort (members, _srt_indirect_strcmp0);
+
+  for (i = 0; i < members->len; i++)
+    {
+      const char *member = g_ptr_array_index (members, i);
+      g_autofree gchar *path = g_build_filename (directory, member, NULL);
+      const ScannedFile *file = library_scanner_scan (self, path);
+
+      if (scanned_file_is_abi (file, arch))
+        g_ptr_array_add (found,
+                         _srt_found_library_new (member, path, file->real_path));
+    }
+
+  return g_steal_pointer (&found);
+}
@@ -668,46 +668,39 @@ srt_check_library_presence (const char *requested_name,
 }
 
 /*
+ * @output: (inout) (nullable): The output of inspect-library, which will
+ *  be modified in-place, or %NULL if it failed
+ * @child_stderr: (nullable): The diagnostic messages from inspect-library
  * @details_in: (in) (nullable): Library details from a previous execution of
  *  inspect-library
  * @more_details_out: (out) (nullable): Used to return the inspected library
  *  details, joined with @details_in values
  */
 static SrtLibraryIssues
-_srt_inspect_library (SrtSubprocessRunner *runner,
-                      gchar **argv,
-                      const char *requested_name,
-                      const char *multiarch,
-                      SrtLibraryIssues issues,
-                      SrtLibrary *details_in,
-                      SrtLibrary **more_details_out)
+_srt_inspect_library_parse (gchar *output,
+                            const char *child_stderr,
+                            int exit_status,
+                            int terminating_signal,
+                            const char *requested_name,
+                            const char *multiarch,
+                            SrtLibraryIssues issues,
+                            SrtLibrary *details_in,
+                            SrtLibrary **more_details_out)
 {
-  g_autofree gchar *output = NULL;
-  const char *child_stderr = NULL;
   g_autofree gchar *absolute_path = NULL;
   g_autofree gchar *real_soname = NULL;
   const gchar *originally_requested_name;
-  int exit_status = -1;
-  int terminating_signal = 0;
   g_autoptr(GHashTable) missing_symbols_set = NULL;
   g_autoptr(GHashTable) misversioned_symbols_set = NULL;
   g_autoptr(GHashTable) missing_versions_set = NULL;
   g_autoptr(GHashTable) dependencies_set = NULL;
-  g_autoptr(SrtCompletedSubprocess) completed = NULL;
   gchar *next_line;
   g_autofree const char **missing_symbols_strv = NULL;
   g_autofree const char **misversioned_symbols_strv = NULL;
   g_autofree const char **missing_versions_strv = NULL;
   g_autofree const char **dependencies_strv = NULL;
-  g_autoptr(GError) error = NULL;
   gsize i;
   guint length;
-  gboolean timed_out = FALSE;
-
-  /* This function should not be called if a previous helper execution already
-   * failed. */
-  g_return_val_if_fail (!(issues & SRT_LIBRARY_ISSUES_CANNOT_LOAD),
-                        SRT_LIBRARY_ISSUES_UNKNOWN);
 
   /* We don't want to hardcode the logic of what each helper provides.
    * By using hash tables we can easily merge multiple libraries details
@@ -752,40 +745,6 @@ _srt_inspect_library (SrtSubprocessRunner *runner,
       originally_requested_name = requested_name;
     }
 
-  completed = _srt_subprocess_runner_run_sync (runner,
-                                               helper_flags,
-                                               (const char * const *) argv,
-                                               SRT_SUBPROCESS_OUTPUT_CAPTURE,
-                                               SRT_SUBPROCESS_OUTPUT_CAPTURE,
-                                               &error);
-
-  if (completed == NULL)
-    {
-      g_debug ("An error occurred calling the helper: %s", error->message);
-      issues |= SRT_LIBRARY_ISSUES_CANNOT_LOAD;
-      goto out;
-    }
-
-  /* Needs to be copied or stolen because we edit it in-place */
-  output = _srt_completed_subprocess_steal_stdout (completed);
-
-  child_stderr = _srt_completed_subprocess_get_stderr (completed);
-
-  if (!_srt_completed_subprocess_report (completed, NULL, &exit_status,
-                                         &terminating_signal, &timed_out))
-    {
-      issues |= SRT_LIBRARY_ISSUES_CANNOT_LOAD;
-
-      if (timed_out)
-        issues |= SRT_LIBRARY_ISSUES_TIMEOUT;
-
-      goto out;
-    }
-  else
-    {
-      exit_status = 0;
-    }
-
   next_line = output;
 
   while (next_line != NULL)
@@ -871,7 +830,6 @@ _srt_inspect_library (SrtSubprocessRunner *runner,
         }
     }
 
-out:
   /* Get the keys from the hash tables and sort them to have consistent lists */
   if (g_hash_table_size (missing_symbols_set) > 0)
     {
@@ -921,6 +879,69 @@ out:
   return issues;
 }
 
+/*
+ * @details_in: (in) (nullable): Library details from a previous execution of
+ *  inspect-library
+ * @more_details_out: (out) (nullable): Used to return the inspected library
+ *  details, joined with @details_in values
+ */
+static SrtLibraryIssues
+_srt_inspect_library (SrtSubprocessRunner *runner,
+                      gchar **argv,
+                      const char *requested_name,
+                      const char *multiarch,
+                      SrtLibraryIssues issues,
+                      SrtLibrary *details_in,
+                      SrtLibrary **more_details_out)
+{
+  g_autofree gchar *output = NULL;
+  const char *child_stderr = NULL;
+  int exit_status = -1;
+  int terminating_signal = 0;
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+  g_autoptr(GError) error = NULL;
+  gboolean timed_out = FALSE;
+
+  /* This function should not be called if a previous helper execution already
+   * failed. */
+  g_return_val_if_fail (!(issues & SRT_LIBRARY_ISSUES_CANNOT_LOAD),
+                        SRT_LIBRARY_ISSUES_UNKNOWN);
+
+  completed = _srt_subprocess_runner_run_sync (runner,
+                                               helper_flags,
+                                               (const char * const *) argv,
+                                               SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                               SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                               &error);
+
+  if (completed == NULL)
+    {
+      g_debug ("An error occurred calling the helper: %s", error->message);
+      issues |= SRT_LIBRARY_ISSUES_CANNOT_LOAD;
+    }
+  else if (!_srt_completed_subprocess_report (completed, NULL, &exit_status,
+                                              &terminating_signal, &timed_out))
+    {
+      child_stderr = _srt_completed_subprocess_get_stderr (completed);
+      issues |= SRT_LIBRARY_ISSUES_CANNOT_LOAD;
+
+      if (timed_out)
+        issues |= SRT_LIBRARY_ISSUES_TIMEOUT;
+    }
+  else
+    {
+      /* Needs to be copied or stolen because we edit it in-place */
+      output = _srt_completed_subprocess_steal_stdout (completed);
+      child_stderr = _srt_completed_subprocess_get_stderr (completed);
+      exit_status = 0;
+    }
+
+  return _srt_inspect_library_parse (output, child_stderr,
+                                     exit_status, terminating_signal,
+                                     requested_name, multiarch, issues,
+                                     details_in, more_details_out);
+}
+
 static void
 _srt_add_inspect_library_arguments (GPtrArray *argv,
                                     const char *requested_name,
@@ -1082,3 +1103,475 @@ _srt_check_library_presence (SrtSubprocessRunner *runner,
 
   return issues;
 }
+
+/*
+ * InspectRequest:
+ * @name: Used to match up the results with the request
+ * @requested_name: The library that the helper will be asked to load
+ * @args: (nullable): Arguments to append to the helper's command-line,
+ *  or %NULL if this request does not need to be inspected
+ * @issues: Issues already known before running the helper
+ * @details_in: (nullable) (owned): Library details from a previous
+ *  execution of inspect-library
+ * @details_out: (nullable) (owned): The result, or %NULL if not yet known
+ */
+typedef struct
+{
+  const char *name;
+  const char *requested_name;
+  GPtrArray *args;
+  SrtLibraryIssues issues;
+  SrtLibrary *details_in;
+  SrtLibrary *details_out;
+} InspectRequest;
+
+static void
+inspect_request_clear (InspectRequest *self)
+{
+  g_clear_pointer (&self->args, g_ptr_array_unref);
+  g_clear_object (&self->details_in);
+  g_clear_object (&self->details_out);
+}
+
+/*
+ * _srt_inspect_libraries:
+ * @helper: The inspect-library or inspect-library-libelf helper
+ * @requests: (array length=n_requests): Libraries to inspect
+ *
+ * Inspect all of @requests with a single execution of @helper in its
+ * `--batch` mode, instead of one execution per library.
+ *
+ * Requests with no @args, or with @details_out already set, are skipped.
+ * Requests that could not be completed, for example because @helper
+ * does not support `--batch`, are left with details_out set to %NULL,
+ * and the caller is expected to retry them individually.
+ */
+static void
+_srt_inspect_libraries (SrtSubprocessRunner *runner,
+                        GPtrArray *helper,
+                        const char *multiarch,
+                        InspectRequest *requests,
+                        gsize n_requests)
+{
+  g_autoptr(GHashTable) by_name = g_hash_table_new (g_str_hash, g_str_equal);
+  g_autoptr(GPtrArray) argv = NULL;
+  g_autoptr(GString) batch = g_string_new ("");
+  g_autoptr(GString) record = g_string_new ("");
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *batch_dir = NULL;
+  g_autofree gchar *batch_path = NULL;
+  g_autofree gchar *output = NULL;
+  g_autofree gchar *record_stderr = NULL;
+  int record_exit_status = -1;
+  int record_signal = 0;
+  gboolean record_timed_out = FALSE;
+  glnx_autofd int fd = -1;
+  guint timeout;
+  gchar *next_line;
+  gsize i;
+
+  for (i = 0; i < n_requests; i++)
+    {
+      InspectRequest *req = &requests[i];
+
+      /* If the same name is requested more than once, the duplicates
+       * are left for the caller to check individually */
+      if (req->args == NULL
+          || req->details_out != NULL
+          || g_hash_table_contains (by_name, req->name))
+        continue;
+
+      g_hash_table_insert (by_name, (char *) req->name, req);
+      g_string_append_len (batch, req->name, strlen (req->name) + 1);
+
+      for (guint j = 0; j < req->args->len; j++)
+        {
+          const char *arg = g_ptr_array_index (req->args, j);
+
+          g_string_append_len (batch, arg, strlen (arg) + 1);
+        }
+
+      g_string_append_c (batch, '\0');
+    }
+
+  if (g_hash_table_size (by_name) == 0)
+    return;
+
+  /* The directory is only accessible by us, so that other users cannot
+   * replace or read the batch file while the helper is using it */
+  batch_dir = g_dir_make_tmp ("srt-inspect-library-XXXXXX", &error);
+
+  if (batch_dir == NULL)
+    {
+      g_debug ("Unable to create directory for batch file: %s",
+               error->message);
+      return;
+    }
+
+  batch_path = g_build_filename (batch_dir, "batch", NULL);
+  fd = open (batch_path, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC | O_NOCTTY,
+             0600);
+
+  if (fd < 0)
+    {
+      g_debug ("Unable to create batch file: %s", g_strerror (errno));
+      goto out;
+    }
+
+  if (glnx_loop_write (fd, batch->str, batch->len) < 0)
+    {
+      g_debug ("Unable to write batch file: %s", g_strerror (errno));
+      goto out;
+    }
+
+  /* Each request has the time limit that we would have applied to a
+   * separate execution of the helper. The batch as a whole has that
+   * limit multiplied by the number of requests, plus one for the
+   * helper's own overhead, in case the helper itself gets stuck */
+  if (_srt_subprocess_runner_get_test_flags (runner) & SRT_TEST_FLAGS_TIME_OUT_SOONER)
+    timeout = 1;
+  else
+    timeout = 10;
+
+  argv = g_ptr_array_new_with_free_func (g_free);
+
+  for (i = 0; i < helper->len; i++)
+    g_ptr_array_add (argv, g_strdup (g_ptr_array_index (helper, i)));
+
+  g_ptr_array_add (argv, g_strdup_printf ("--batch=%s", batch_path));
+  g_ptr_array_add (argv, g_strdup_printf ("--timeout=%u", timeout));
+  g_ptr_array_add (argv, NULL);
+
+  completed = _srt_subprocess_runner_run_sync_full (runner,
+                                                    helper_flags,
+                                                    g_hash_table_size (by_name) + 1,
+                                                    (const char * const *) argv->pdata,
+                                                    SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                                    SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                                    NULL,
+                                                    &error);
+
+  if (completed == NULL)
+    {
+      g_debug ("An error occurred calling the helper: %s", error->message);
+      goto out;
+    }
+
+  if (!_srt_completed_subprocess_check (completed, &error))
+    {
+      /* Probably an older helper that does not support --batch */
+      g_debug ("Unable to inspect libraries in batch mode: %s", error->message);
+      goto out;
+    }
+
+  output = _srt_completed_subprocess_steal_stdout (completed);
+  next_line = output;
+
+  while (next_line != NULL && *next_line != '\0')
+    {
+      char *line = next_line;
+      char *equals;
+      g_autofree gchar *decoded = NULL;
+      InspectRequest *req;
+
+      next_line = strchr (line, '\n');
+
+      if (next_line != NULL)
+        {
+          *next_line = '\0';
+          next_line++;
+        }
+
+      equals = strchr (line, '=');
+
+      if (equals == NULL)
+        {
+          g_warning ("Unexpected line in inspect-library output: %s", line);
+          continue;
+        }
+
+      /* These lines describe the request as a whole, rather than
+       * being part of the output for a single library */
+      if (g_str_has_prefix (line, "stderr="))
+        {
+          g_free (record_stderr);
+          record_stderr = g_strcompress (equals + 1);
+          continue;
+        }
+      else if (g_str_has_prefix (line, "exit_status="))
+        {
+          record_exit_status = atoi (equals + 1);
+          continue;
+        }
+      else if (g_str_has_prefix (line, "terminating_signal="))
+        {
+          record_signal = atoi (equals + 1);
+          continue;
+        }
+      else if (g_str_has_prefix (line, "timed_out="))
+        {
+          record_timed_out = g_str_equal (equals + 1, "true");
+          continue;
+        }
+      else if (!g_str_has_prefix (line, "end="))
+        {
+          g_string_append (record, line);
+          g_string_append_c (record, '\n');
+          continue;
+        }
+
+      decoded = g_strcompress (equals + 1);
+      req = g_hash_table_lookup (by_name, decoded);
+
+      if (req == NULL || req->details_out != NULL)
+        {
+          g_warning ("Unexpected inspect-library output for \"%s\"", decoded);
+        }
+      else if (record_exit_status == 0 && record_signal == 0)
+        {
+          req->issues = _srt_inspect_library_parse (record->str,
+                                                    record_stderr,
+                                                    0, 0,
+                                                    req->requested_name,
+                                                    multiarch,
+                                                    req->issues,
+                                                    req->details_in,
+                                                    &req->details_out);
+        }
+      else
+        {
+          req->issues |= SRT_LIBRARY_ISSUES_CANNOT_LOAD;
+
+          if (record_timed_out)
+            req->issues |= SRT_LIBRARY_ISSUES_TIMEOUT;
+
+          if (record_signal != 0)
+            record_exit_status = -1;
+
+          req->issues = _srt_inspect_library_parse (NULL,
+                                                    record_stderr,
+                                                    record_exit_status,
+                                                    record_signal,
+                                                    req->requested_name,
+                                                    multiarch,
+                                                    req->issues,
+                                                    req->details_in,
+                                                    &req->details_out);
+        }
+
+      g_string_truncate (record, 0);
+      g_clear_pointer (&record_stderr, g_free);
+      record_exit_status = -1;
+      record_signal = 0;
+      record_timed_out = FALSE;
+    }
+
+out:
+  if (batch_dir != NULL && !_srt_rm_rf (batch_dir))
+    g_debug ("Unable to remove the temporary directory: %s", batch_dir);
+}
+
+/*
+ * _srt_check_libraries_presence:
+ * @checks: (array length=n_checks): The libraries to check
+ * @details_out: (array length=n_checks) (out caller-allocates) (transfer full):
+ *  Used to return an #SrtLibrary for each of @checks
+ *
+ * Equivalent to calling _srt_check_library_presence() for each of
+ * @checks, but using a single execution of each helper for all of them
+ * where possible.
+ *
+ * Returns: The union of the issues found for each of @checks
+ */
+SrtLibraryIssues
+_srt_check_libraries_presence (SrtSubprocessRunner *runner,
+                               const char *multiarch,
+                               const SrtLibraryCheck *checks,
+                               gsize n_checks,
+                               SrtCheckFlags check_flags,
+                               SrtLibrarySymbolsFormat symbols_format,
+                               SrtLibrary **details_out)
+{
+  g_autoptr(GPtrArray) helper = NULL;
+  g_autoptr(GPtrArray) helper_libelf = NULL;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GError) libelf_error = NULL;
+  g_autofree InspectRequest *requests = NULL;
+  g_autofree gboolean *done = NULL;
+  SrtLibraryIssues combined = SRT_LIBRARY_ISSUES_NONE;
+  gsize i;
+
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), SRT_LIBRARY_ISSUES_UNKNOWN);
+  g_return_val_if_fail (multiarch != NULL, SRT_LIBRARY_ISSUES_UNKNOWN);
+  g_return_val_if_fail (checks != NULL || n_checks == 0, SRT_LIBRARY_ISSUES_UNKNOWN);
+  g_return_val_if_fail (details_out != NULL, SRT_LIBRARY_ISSUES_UNKNOWN);
+  g_return_val_if_fail (_srt_check_not_setuid (), SRT_LIBRARY_ISSUES_UNKNOWN);
+
+  if (n_checks == 0)
+    return SRT_LIBRARY_ISSUES_NONE;
+
+  helper = _srt_subprocess_runner_get_helper (runner, multiarch,
+                                              "inspect-library", helper_flags,
+                                              &error);
+
+  /* If the helper is unavailable, let _srt_check_library_presence()
+   * report that for each library in the usual way */
+  if (helper == NULL)
+    goto fallback;
+
+  requests = g_new0 (InspectRequest, n_checks);
+  done = g_new0 (gboolean, n_checks);
+
+  for (i = 0; i < n_checks; i++)
+    {
+      requests[i].name = checks[i].requested_name;
+      requests[i].requested_name = checks[i].requested_name;
+      requests[i].args = g_ptr_array_new_with_free_func (g_free);
+
+      if (checks[i].symbols_path == NULL)
+        requests[i].issues = SRT_LIBRARY_ISSUES_UNKNOWN_EXPECTATIONS;
+
+      _srt_add_inspect_library_arguments (requests[i].args,
+                                          checks[i].requested_name,
+                                          checks[i].symbols_path,
+                                          NULL,
+                                          checks[i].hidden_deps,
+                                          symbols_format);
+    }
+
+  g_debug ("Checking %" G_GSIZE_FORMAT " %s libraries in batch mode",
+           n_checks, multiarch);
+  _srt_inspect_libraries (runner, helper, multiarch, requests, n_checks);
+
+  /* Anything that could not be checked in batch mode will fall back to
+   * being checked individually */
+  for (i = 0; i < n_checks; i++)
+    done[i] = (requests[i].details_out != NULL);
+
+  if (check_flags & SRT_CHECK_FLAGS_SKIP_SLOW_CHECKS)
+    goto fallback;
+
+  for (i = 0; i < n_checks; i++)
+    {
+      InspectRequest *req = &requests[i];
+      const char *path;
+
+      g_clear_pointer (&req->args, g_ptr_array_unref);
+
+      if (!done[i]
+          || (req->issues & SRT_LIBRARY_ISSUES_CANNOT_LOAD)
+          || checks[i].symbols_path == NULL)
+        continue;
+
+      path = srt_library_get_absolute_path (req->details_out);
+
+      if (path == NULL)
+        continue;
+
+      if (helper_libelf == NULL && libelf_error == NULL)
+        helper_libelf = _srt_subprocess_runner_get_helper (runner, multiarch,
+                                                           "inspect-library-libelf",
+                                                           helper_flags,
+                                                           &libelf_error);
+
+      /* As in _srt_check_library_presence(), keep the results from
+       * inspect-library, and use the error message as though the
+       * child had printed it on stderr */
+      if (helper_libelf == NULL)
+        {
+          g_autoptr(SrtLibrary) details = g_steal_pointer (&req->details_out);
+
+          req->issues |= SRT_LIBRARY_ISSUES_UNKNOWN;
+          req->details_out = _srt_library_new (multiarch,
+                                               path,
+                                               checks[i].requested_name,
+                                               req->issues,
+                                               libelf_error->message,
+                                               srt_library_get_missing_symbols (details),
+                                               srt_library_get_misversioned_symbols (details),
+                                               srt_library_get_missing_versions (details),
+                                               srt_library_get_dependencies (details),
+                                               srt_library_get_real_soname (details),
+                                               -1, 0);
+          continue;
+        }
+
+      /* This time we call `inspect-library-libelf` with the library absolute
+       * path, as in _srt_check_library_presence() */
+      req->details_in = g_steal_pointer (&req->details_out);
+      req->requested_name = path;
+      req->args = g_ptr_array_new_with_free_func (g_free);
+      _srt_add_inspect_library_arguments (req->args, path,
+                                          checks[i].symbols_path,
+                                          checks[i].requested_name,
+                                          NULL, symbols_format);
+    }
+
+  if (helper_libelf != NULL)
+    {
+      _srt_inspect_libraries (runner, helper_libelf, multiarch,
+                              requests, n_checks);
+
+      for (i = 0; i < n_checks; i++)
+        {
+          InspectRequest *req = &requests[i];
+          g_autoptr(GPtrArray) argv = NULL;
+
+          if (req->details_in == NULL || req->details_out != NULL)
+            continue;
+
+          argv = g_ptr_array_new_with_free_func (g_free);
+
+          for (guint j = 0; j < helper_libelf->len; j++)
+            g_ptr_array_add (argv, g_strdup (g_ptr_array_index (helper_libelf, j)));
+
+          for (guint j = 0; j < req->args->len; j++)
+            g_ptr_array_add (argv, g_strdup (g_ptr_array_index (req->args, j)));
+
+          g_ptr_array_add (argv, NULL);
+          req->issues = _srt_inspect_library (runner, (gchar **) argv->pdata,
+                                              req->requested_name, multiarch,
+                                              req->issues, req->details_in,
+                                              &req->details_out);
+        }
+    }
+
+  for (i = 0; i < n_checks; i++)
+    {
+      InspectRequest *req = &requests[i];
+
+      /* If we got as far as running inspect-library-libelf, the result
+       * replaces the one from inspect-library */
+      if (req->details_in != NULL && req->details_out != NULL)
+        g_clear_object (&req->details_in);
+      else if (req->details_in != NULL)
+        req->details_out = g_steal_pointer (&req->details_in);
+    }
+
+fallback:
+  for (i = 0; i < n_checks; i++)
+    {
+      if (requests != NULL && done[i])
+        {
+          details_out[i] = g_steal_pointer (&requests[i].details_out);
+          combined |= srt_library_get_issues (details_out[i]);
+        }
+      else
+        {
+          combined |= _srt_check_library_presence (runner,
+                                                   checks[i].requested_name,
+                                                   multiarch,
+                                                   checks[i].symbols_path,
+                                                   checks[i].hidden_deps,
+                                                   check_flags,
+                                                   symbols_format,
+                                                   &details_out[i]);
+        }
+
+      if (requests != NULL)
+        inspect_request_clear (&requests[i]);
+    }
+
+  return combined;
+}
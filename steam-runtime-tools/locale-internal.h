@@ -60,6 +60,14 @@ SrtLocale *_srt_check_locale (SrtSubprocessRunner *runner,
                               const char *multiarch_tuple,
                               const char *requested_name,
                               GError **error);
+G_GNUC_INTERNAL
+gboolean _srt_check_locales (SrtSubprocessRunner *runner,
+                             const char *multiarch_tuple,
+                             const char * const *requested_names,
+                             gsize n_names,
+                             SrtLocale **locales_out,
+                             GError **errors_out,
+                             GError **error);
 #endif
 
 SrtLocale *_srt_locale_get_locale_from_report (JsonObject *json_obj,
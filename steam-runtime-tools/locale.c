@@ -188,6 +188,77 @@ srt_locale_class_init (SrtLocaleClass *cls)
   g_object_class_install_properties (object_class, N_PROPERTIES, properties);
 }
 
+/*
+ * locale_new_from_helper_object:
+ * @object: One result from the check-locale helper
+ * @requested_name: The locale that was requested
+ * @failed: %TRUE if the helper reported failure via its exit status
+ * @error: Used to return an error if %NULL is returned
+ *
+ * Returns: (transfer full): A #SrtLocale object, or %NULL
+ */
+static SrtLocale *
+locale_new_from_helper_object (JsonObject *object,
+                               const char *requested_name,
+                               gboolean failed,
+                               GError **error)
+{
+  SrtLocale *ret;
+
+  if (json_object_has_member (object, "error"))
+    {
+      g_debug ("-> %s",
+               json_object_get_string_member (object, "error"));
+      g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_FAILED, "%s",
+                   json_object_get_string_member (object, "error"));
+      return NULL;
+    }
+
+  if (failed)
+    {
+      g_debug ("-> unknown error");
+      g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_FAILED,
+                   "Unknown error setting locale \"%s\"", requested_name);
+      return NULL;
+    }
+
+  if (!json_object_has_member (object, "charset")
+      || !json_object_has_member (object, "is_utf8")
+      || !json_object_has_member (object, "result"))
+    {
+      g_debug ("-> required fields not set");
+      g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_INTERNAL_ERROR,
+                   "Helper subprocess did not return required fields");
+      return NULL;
+    }
+
+  ret = _srt_locale_new (requested_name,
+                         json_object_get_string_member (object, "result"),
+                         json_object_get_string_member (object, "charset"),
+                         json_object_get_boolean_member (object, "is_utf8"));
+
+  g_debug ("-> %s (charset=%s) (utf8=%s)",
+           srt_locale_get_resulting_name (ret),
+           srt_locale_get_charset (ret),
+           srt_locale_is_utf8 (ret) ? "yes" : "no");
+  return ret;
+}
+
+static void
+locale_error_make_internal (GError **error,
+                            const char *requested_name)
+{
+  if (error != NULL
+      && *error != NULL
+      && (*error)->domain != SRT_LOCALE_ERROR)
+    {
+      g_prefix_error (error, "Unable to check whether locale \"%s\" works: ",
+                      requested_name);
+      (*error)->domain = SRT_LOCALE_ERROR;
+      (*error)->code = SRT_LOCALE_ERROR_INTERNAL_ERROR;
+    }
+}
+
 /*
  * _srt_check_locale:
  * @runner: Execution environment
@@ -280,60 +351,151 @@ _srt_check_locale (SrtSubprocessRunner *runner,
       goto out;
     }
 
+  if (!JSON_NODE_HOLDS_OBJECT (node))
+    {
+      g_debug ("-> not a JSON object");
+      g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_INTERNAL_ERROR,
+                   "Helper subprocess did not return a JSON object");
+      goto out;
+    }
+
   object = json_node_get_object (node);
+  ret = locale_new_from_helper_object (object, requested_name,
+                                       exit_status == 1, error);
+
+out:
+  locale_error_make_internal (error, requested_name);
+  g_clear_pointer (&argv, g_ptr_array_unref);
+  return ret;
+}
+
+/*
+ * _srt_check_locales:
+ * @runner: Execution environment
+ * @multiarch_tuple: Multiarch tuple of helper executable to use
+ * @requested_names: (array length=n_names): The locale names to check for
+ * @n_names: Number of locale names
+ * @locales_out: (array length=n_names) (out caller-allocates): Set to
+ *  a #SrtLocale object for each locale that could be set, or %NULL
+ * @errors_out: (array length=n_names) (out caller-allocates): Set to
+ *  an error in the %SRT_LOCALE_ERROR domain for each locale that could
+ *  not be set, or %NULL
+ * @error: Used to return an error if the helper could not be run
+ *
+ * Check whether each of @requested_names can be set, using a single
+ * run of the helper subprocess. If the helper does not support checking
+ * more than one locale, this fails, and the caller should fall back
+ * to _srt_check_locale().
+ *
+ * Returns: %TRUE if @locales_out and @errors_out were filled in
+ */
+gboolean
+_srt_check_locales (SrtSubprocessRunner *runner,
+                    const char *multiarch_tuple,
+                    const char * const *requested_names,
+                    gsize n_names,
+                    SrtLocale **locales_out,
+                    GError **errors_out,
+                    GError **error)
+{
+  g_autoptr(GPtrArray) argv = NULL;
+  g_autoptr(JsonNode) node = NULL;
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+  SrtHelperFlags helper_flags = SRT_HELPER_FLAGS_NONE;
+  JsonArray *array;
+  gsize i;
+
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (runner), FALSE);
+  g_return_val_if_fail (requested_names != NULL || n_names == 0, FALSE);
+  g_return_val_if_fail (locales_out != NULL, FALSE);
+  g_return_val_if_fail (errors_out != NULL, FALSE);
+  g_return_val_if_fail (error == NULL || *error == NULL, FALSE);
+  g_return_val_if_fail (_srt_check_not_setuid (), FALSE);
 
-  if (exit_status == 1)
+  for (i = 0; i < n_names; i++)
     {
-      if (json_object_has_member (object, "error"))
-        {
-          g_debug ("-> %s",
-                   json_object_get_string_member (object, "error"));
-          g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_FAILED, "%s",
-                       json_object_get_string_member (object, "error"));
-        }
-      else
-        {
-          g_debug ("-> unknown error");
-          g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_FAILED,
-                       "Unknown error setting locale \"%s\"", requested_name);
-        }
+      locales_out[i] = NULL;
+      errors_out[i] = NULL;
+    }
 
-      goto out;
+  /* The helper only uses the array format for 2 or more locales */
+  if (n_names < 2)
+    {
+      for (i = 0; i < n_names; i++)
+        locales_out[i] = _srt_check_locale (runner, multiarch_tuple,
+                                            requested_names[i],
+                                            &errors_out[i]);
+
+      return TRUE;
     }
 
-  if (!json_object_has_member (object, "charset")
-      || !json_object_has_member (object, "is_utf8")
-      || !json_object_has_member (object, "result"))
+#if defined(_SRT_MULTIARCH)
+  if (multiarch_tuple == NULL)
+    multiarch_tuple = _SRT_MULTIARCH;
+#endif
+
+  argv = _srt_subprocess_runner_get_helper (runner, multiarch_tuple,
+                                            "check-locale", helper_flags,
+                                            error);
+
+  if (argv == NULL)
+    return FALSE;
+
+  for (i = 0; i < n_names; i++)
+    g_ptr_array_add (argv, g_strdup (requested_names[i]));
+
+  g_ptr_array_add (argv, NULL);
+
+  g_debug ("Running %s with %" G_GSIZE_FORMAT " locales",
+           (const char *) g_ptr_array_index (argv, 0), n_names);
+
+  completed = _srt_subprocess_runner_run_sync (runner,
+                                               helper_flags,
+                                               (const char * const *) argv->pdata,
+                                               SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                               SRT_SUBPROCESS_OUTPUT_CAPTURE_DEBUG,
+                                               error);
+
+  if (completed == NULL
+      || !_srt_completed_subprocess_check (completed, error))
+    return FALSE;
+
+  node = json_from_string (_srt_completed_subprocess_get_stdout (completed),
+                           error);
+
+  if (node == NULL)
+    return FALSE;
+
+  if (!JSON_NODE_HOLDS_ARRAY (node)
+      || json_array_get_length (json_node_get_array (node)) != n_names)
     {
-      g_debug ("-> required fields not set");
       g_set_error (error, SRT_LOCALE_ERROR, SRT_LOCALE_ERROR_INTERNAL_ERROR,
-                   "Helper subprocess did not return required fields");
-      goto out;
+                   "Helper subprocess did not return one result per locale");
+      return FALSE;
     }
 
-  ret = _srt_locale_new (requested_name,
-                         json_object_get_string_member (object, "result"),
-                         json_object_get_string_member (object, "charset"),
-                         json_object_get_boolean_member (object, "is_utf8"));
-
-  g_debug ("-> %s (charset=%s) (utf8=%s)",
-           srt_locale_get_resulting_name (ret),
-           srt_locale_get_charset (ret),
-           srt_locale_is_utf8 (ret) ? "yes" : "no");
+  array = json_node_get_array (node);
 
-out:
-  if (error != NULL
-      && *error != NULL
-      && (*error)->domain != SRT_LOCALE_ERROR)
+  for (i = 0; i < n_names; i++)
     {
-      g_prefix_error (error, "Unable to check whether locale \"%s\" works: ",
-                      requested_name);
-      (*error)->domain = SRT_LOCALE_ERROR;
-      (*error)->code = SRT_LOCALE_ERROR_INTERNAL_ERROR;
+      JsonNode *element = json_array_get_element (array, i);
+
+      g_debug ("%s:", requested_names[i]);
+
+      if (JSON_NODE_HOLDS_OBJECT (element))
+        locales_out[i] = locale_new_from_helper_object (json_node_get_object (element),
+                                                        requested_names[i],
+                                                        FALSE,
+                                                        &errors_out[i]);
+      else
+        g_set_error (&errors_out[i], SRT_LOCALE_ERROR,
+                     SRT_LOCALE_ERROR_INTERNAL_ERROR,
+                     "Helper subprocess did not return a JSON object");
+
+      locale_error_make_internal (&errors_out[i], requested_names[i]);
     }
 
-  g_clear_pointer (&argv, g_ptr_array_unref);
-  return ret;
+  return TRUE;
 }
 
 /**
@@ -668,6 +668,7 @@ _srt_util_set_glib_log_handler (const char *prgname,
                                | G_LOG_LEVEL_WARNING
                                | G_LOG_LEVEL_MESSAGE);
   const char *log_env = g_getenv ("SRT_LOG");
+  const char *trace_file;
   gsize log_env_n_keys = G_N_ELEMENTS (log_enable);
 
   if (prgname != NULL)
@@ -735,6 +736,12 @@ _srt_util_set_glib_log_handler (const char *prgname,
       || !set_up_output (STDERR_FILENO, original_stderr_out, error))
     return FALSE;
 
+  /* This opens a file, so it must come after the standard fds are set up */
+  trace_file = g_getenv ("PRESSURE_VESSEL_TRACE_FILE");
+
+  if (trace_file != NULL && trace_file[0] != '\0')
+    _srt_profiling_enable_trace (trace_file);
+
   /* Avoid "stairstep" effect when using SrtPtyBridge, by sending CRLF
    * at the end of diagnostic messages */
   if (isatty (STDERR_FILENO))
@@ -6,8 +6,11 @@
 #include "steam-runtime-tools/logger-internal.h"
 
 #include <fcntl.h>
+#include <limits.h>
 #include <unistd.h>
 #include <syslog.h>
+#include <sys/inotify.h>
+#include <sys/uio.h>
 
 #include <glib.h>
 #include "libglnx.h"
@@ -93,7 +96,16 @@ struct _SrtLogger {
   int file_fd;
   int journal_fd;
   int terminal_fd;
+  /* Watches the log directory for the log file being deleted or replaced */
+  int inotify_fd;
   goffset max_bytes;
+  /* Size of the log file the last time we checked, plus whatever we
+   * have appended since then */
+  goffset file_size;
+  time_t file_checked_time;
+  time_t timestamp_time;
+  size_t timestamp_len;
+  char timestamp[32];
   int default_level;
   int file_level;
   int journal_level;
@@ -107,6 +119,7 @@ struct _SrtLogger {
   unsigned use_terminal : 1;
   unsigned use_terminal_colors : 1;
   unsigned parse_level_prefix : 1;
+  unsigned file_check_needed : 1;
 };
 
 struct _SrtLoggerClass
@@ -128,12 +141,14 @@ _srt_logger_init (SrtLogger *self)
   self->file_fd = -1;
   self->journal_fd = -1;
   self->terminal_fd = -1;
+  self->inotify_fd = -1;
   self->max_bytes = -1;
   self->default_level = SRT_SYSLOG_LEVEL_DEFAULT_LINE;
   self->file_level = SRT_SYSLOG_LEVEL_DEFAULT_FILE;
   self->journal_level = SRT_SYSLOG_LEVEL_DEFAULT_JOURNAL;
   self->terminal_level = SRT_SYSLOG_LEVEL_DEFAULT_TERMINAL;
   self->timestamps = TRUE;
+  self->file_check_needed = TRUE;
 }
 
 /* We need to have the log open read/write, otherwise the kernel won't let
@@ -169,6 +184,7 @@ _srt_logger_finalize (GObject *object)
   glnx_close_fd (&self->child_ready_to_parent);
   glnx_close_fd (&self->pipe_from_parent);
   glnx_close_fd (&self->file_fd);
+  glnx_close_fd (&self->inotify_fd);
 
   if (self->journal_fd > STDERR_FILENO)
     glnx_close_fd (&self->journal_fd);
@@ -1115,6 +1131,7 @@ _srt_logger_try_rotate (SrtLogger *self,
   glnx_close_fd (&self->file_fd);
   self->file_fd = g_steal_fd (&new_fd);
   self->file_stat = new_stat;
+  self->file_size = new_stat.st_size;
   ret = TRUE;
 
 out:
@@ -1132,6 +1149,58 @@ out:
   return ret;
 }
 
+/*
+ * loop_writev:
+ * @fd: A file descriptor
+ * @iov: (array length=iovcnt): Buffers to write, which will be modified
+ * @iovcnt: Number of buffers
+ *
+ * Like glnx_loop_write(), but for several buffers, so that in the common
+ * case they can be written with a single system call.
+ *
+ * Returns: 0 on success, or -1 with errno set on error
+ */
+static int
+loop_writev (int fd,
+             struct iovec *iov,
+             int iovcnt)
+{
+  while (iovcnt > 0)
+    {
+      ssize_t res = TEMP_FAILURE_RETRY (writev (fd, iov, iovcnt));
+      size_t done;
+
+      if (res < 0)
+        return -1;
+
+      if (res == 0)   /* Can't really happen */
+        {
+          errno = EIO;
+          return -1;
+        }
+
+      done = (size_t) res;
+
+      while (iovcnt > 0 && done >= iov->iov_len)
+        {
+          done -= iov->iov_len;
+          iov++;
+          iovcnt--;
+        }
+
+      if (iovcnt > 0)
+        {
+          iov->iov_base = (char *) iov->iov_base + done;
+          iov->iov_len -= done;
+        }
+    }
+
+  return 0;
+}
+
+#define IOV_FROM_CONST_STR(s) \
+  ((struct iovec) { (void *) (s), sizeof (s) - 1 })
+
 static void
 write_formatted_line (int fd,
                       int level,
@@ -1143,26 +1212,28 @@ write_formatted_line (int fd,
   static const char ansi_bold[] = "\033[1m";
   static const char ansi_bold_magenta[] = "\033[1;35m";
   static const char ansi_bold_red[] = "\033[1;31m";
+  struct iovec iov[5];
+  int n = 0;
 
-  glnx_loop_write (fd, ansi_reset, strlen (ansi_reset));
+  iov[n++] = IOV_FROM_CONST_STR (ansi_reset);
 
   switch (level) {
     case LOG_DEBUG:
-      glnx_loop_write (fd, ansi_dim, strlen (ansi_dim));
+      iov[n++] = IOV_FROM_CONST_STR (ansi_dim);
       break;
     case LOG_INFO:
       break;
     case LOG_NOTICE:
-      glnx_loop_write (fd, ansi_bold, strlen (ansi_bold));
+      iov[n++] = IOV_FROM_CONST_STR (ansi_bold);
       break;
     case LOG_WARNING:
-      glnx_loop_write (fd, ansi_bold_magenta, strlen (ansi_bold_magenta));
+      iov[n++] = IOV_FROM_CONST_STR (ansi_bold_magenta);
       break;
     case LOG_ERR:
     case LOG_CRIT:
     case LOG_ALERT:
     case LOG_EMERG:
-      glnx_loop_write (fd, ansi_bold_red, strlen (ansi_bold_red));
+      iov[n++] = IOV_FROM_CONST_STR (ansi_bold_red);
       break;
     default:
       g_warning ("Unexpected log level: %d", level);
@@ -1171,15 +1242,18 @@ write_formatted_line (int fd,
 
   if (len > 0 && line[len - 1] == '\n')
     {
-      glnx_loop_write (fd, line, len - 1);
-      glnx_loop_write (fd, ansi_reset, strlen (ansi_reset));
-      glnx_loop_write (fd, "\n", 1);
+      iov[n++] = (struct iovec) { (void *) line, len - 1 };
+      iov[n++] = IOV_FROM_CONST_STR (ansi_reset);
+      iov[n++] = IOV_FROM_CONST_STR ("\n");
     }
   else
     {
-      glnx_loop_write (fd, line, len);
-      glnx_loop_write (fd, ansi_reset, strlen (ansi_reset));
+      iov[n++] = (struct iovec) { (void *) line, len };
+      iov[n++] = IOV_FROM_CONST_STR (ansi_reset);
     }
+
+  g_assert (n <= G_N_ELEMENTS (iov));
+  loop_writev (fd, iov, n);
 }
 
 /*
@@ -1210,6 +1284,226 @@ logger_process_partial_line (SrtLogger *self,
     }
 }
 
+/*
+ * @self: The logger
+ *
+ * Read any pending events from #SrtLogger.inotify_fd, and set
+ * #SrtLogger.file_check_needed if the log file might have been deleted
+ * or replaced. This is called once per read from standard input,
+ * rather than once per line.
+ */
+static void
+logger_read_inotify_events (SrtLogger *self)
+{
+  union
+  {
+    struct inotify_event event;
+    char storage[4096];
+    char enough_for_inotify[sizeof (struct inotify_event) + NAME_MAX + 1];
+  } buf;
+  ssize_t bytes;
+  size_t remain;
+  size_t len;
+
+  while (self->inotify_fd >= 0)
+    {
+      bytes = TEMP_FAILURE_RETRY (read (self->inotify_fd, &buf, sizeof (buf)));
+
+      if (bytes < 0)
+        {
+          if (errno != EAGAIN)
+            {
+              g_debug ("Unable to read inotify events, "
+                       "checking log file on every line instead: %s",
+                       g_strerror (errno));
+              glnx_close_fd (&self->inotify_fd);
+              self->file_check_needed = TRUE;
+            }
+
+          return;
+        }
+
+      remain = (size_t) bytes;
+
+      while (remain > 0)
+        {
+          g_return_if_fail (remain >= sizeof (struct inotify_event));
+
+          if (buf.event.mask & IN_Q_OVERFLOW)
+            {
+              self->file_check_needed = TRUE;
+            }
+          else if (buf.event.mask & IN_IGNORED)
+            {
+              /* The log directory itself was deleted or unmounted */
+              g_debug ("No longer watching log directory, "
+                       "checking log file on every line instead");
+              glnx_close_fd (&self->inotify_fd);
+              self->file_check_needed = TRUE;
+              return;
+            }
+          else if (buf.event.len > 0
+                   && strcmp (buf.event.name, self->filename) == 0)
+            {
+              self->file_check_needed = TRUE;
+            }
+
+          len = sizeof (struct inotify_event) + buf.event.len;
+          remain -= len;
+
+          if (remain != 0)
+            memmove (&buf.storage[0], &buf.storage[len], remain);
+        }
+    }
+}
+
+/*
+ * @self: The logger
+ * @when: A nonzero time
+ * @out_len: (out): Length of the returned timestamp
+ *
+ * Format @when as a timestamp for the log file. The result is cached,
+ * because consecutive lines usually arrive within the same second.
+ *
+ * Returns: (transfer none): The timestamp, not necessarily
+ *  `\0`-terminated, or %NULL if it could not be formatted
+ */
+static const char *
+logger_get_timestamp (SrtLogger *self,
+                      time_t when,
+                      size_t *out_len)
+{
+  if (when != self->timestamp_time)
+    {
+      /* We use glibc time formatting rather than GDateTime here,
+       * to reduce malloc/free in the main logging loop. */
+      struct tm tm;
+
+      self->timestamp_time = when;
+      self->timestamp_len = 0;
+
+      /* If we can't format the timestamp for some reason, just don't
+       * output it */
+      if (localtime_r (&when, &tm) == &tm)
+        self->timestamp_len = strftime (self->timestamp,
+                                        sizeof (self->timestamp),
+                                        "[%F %T] ", &tm);
+    }
+
+  *out_len = self->timestamp_len;
+
+  if (self->timestamp_len == 0)
+    return NULL;
+
+  return self->timestamp;
+}
+
+/*
+ * @self: The logger
+ * @len: Number of bytes we are about to append
+ *
+ * Re-open the log file if it has been deleted or replaced, or rotate
+ * it if appending @len bytes would exceed the maximum size.
+ *
+ * To avoid a stat() per line, we only look at the filesystem if
+ * inotify has told us that the log file's directory entry might have
+ * changed, or if we have not checked during the current second (which
+ * picks up concurrent writers' output and anything that inotify can't
+ * see, for example on network filesystems). Without inotify, we check
+ * on every line.
+ */
+static void
+logger_check_file (SrtLogger *self,
+                   size_t len)
+{
+  const char *reason_to_reopen = NULL;
+  struct stat current_stat;
+  time_t now = time (NULL);
+
+  if (self->file_check_needed || now != self->file_checked_time)
+    {
+      self->file_check_needed = (self->inotify_fd < 0);
+      self->file_checked_time = now;
+
+      if (TEMP_FAILURE_RETRY (stat (self->filename, &current_stat)) == 0)
+        {
+          if (!_srt_is_same_stat (&current_stat, &self->file_stat))
+            reason_to_reopen = "File replaced";
+          else
+            self->file_size = current_stat.st_size;
+        }
+      else
+        {
+          int saved_errno = errno;
+
+          if (saved_errno != ENOENT)
+            _srt_log_warning ("Unable to stat log file \"%s\": %s",
+                              self->filename, g_strerror (saved_errno));
+
+          reason_to_reopen = g_strerror (saved_errno);
+        }
+    }
+
+  if (reason_to_reopen != NULL)
+    {
+      /* The log file is either deleted or replaced, probably by a
+       * developer who wanted to clear the logs out. Re-create it now
+       * instead of staying silent. */
+      glnx_autofd int new_fd = -1;
+      g_autoptr(GError) local_error = NULL;
+      gboolean reopened = FALSE;
+
+      g_info ("Re-opening \"%s\" because: %s",
+              self->filename, reason_to_reopen);
+
+      new_fd = TEMP_FAILURE_RETRY (open (self->filename,
+                                         OPEN_FLAGS,
+                                         0644));
+      if (new_fd < 0)
+        {
+          _srt_log_warning ("Unable to re-open log file: \"%s\": %s",
+                            self->filename, g_strerror (errno));
+        }
+      /* Reuse current_stat (which might or might not be populated)
+       * for the device and inode of the replacement file */
+      else if (fstat (new_fd, &current_stat) < 0)
+        {
+          _srt_log_warning ("Unable to stat log file \"%s\": %s",
+                            self->filename, g_strerror (errno));
+        }
+      else if (!lock_output_file (self->filename, new_fd, &local_error))
+        {
+          _srt_log_warning ("Unable to re-lock log file \"%s\": %s",
+                            self->filename, local_error->message);
+        }
+      else
+        {
+          g_info ("Successfully re-opened \"%s\"", self->filename);
+          glnx_close_fd (&self->file_fd);
+          self->file_fd = glnx_steal_fd (&new_fd);
+          self->file_stat = current_stat;
+          self->file_size = current_stat.st_size;
+          reopened = TRUE;
+        }
+
+      /* If that failed, try again next time */
+      if (!reopened)
+        self->file_check_needed = TRUE;
+    }
+  else if (self->max_bytes > 0
+           && (self->file_size + len) > self->max_bytes)
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      if (!_srt_logger_try_rotate (self, &local_error))
+        {
+          _srt_log_warning ("Unable to rotate log file: %s",
+                            local_error->message);
+          self->max_bytes = 0;
+        }
+    }
+}
+
 /*
  * @self: The logger
  * @level: Severity level between `LOG_EMERG` and `LOG_DEBUG`
@@ -1229,107 +1523,37 @@ logger_process_complete_line (SrtLogger *self,
                               const char *line,
                               size_t len)
 {
+  struct iovec iov[2];
+
   if (self->journal_fd >= 0 && level <= self->journal_level)
     {
       char prefix[] = {'<', '0', '>'};
       prefix[1] += level;
-      glnx_loop_write (self->journal_fd, prefix, sizeof (prefix));
-      glnx_loop_write (self->journal_fd, line, len);
+      iov[0] = (struct iovec) { prefix, sizeof (prefix) };
+      iov[1] = (struct iovec) { (void *) line, len };
+      loop_writev (self->journal_fd, iov, 2);
     }
 
   if (self->file_fd >= 0 && level <= self->file_level)
     {
-      if (self->filename != NULL)
-        {
-          const char *reason_to_reopen = NULL;
-          struct stat current_stat;
+      const char *timestamp = NULL;
+      size_t timestamp_len = 0;
+      int n = 0;
 
-          if (TEMP_FAILURE_RETRY (stat (self->filename, &current_stat)) == 0)
-            {
-              if (!_srt_is_same_stat (&current_stat, &self->file_stat))
-                reason_to_reopen = "File replaced";
-            }
-          else
-            {
-              int saved_errno = errno;
-
-              if (saved_errno != ENOENT)
-                _srt_log_warning ("Unable to stat log file \"%s\": %s",
-                                  self->filename, g_strerror (saved_errno));
-
-              reason_to_reopen = g_strerror (saved_errno);
-            }
+      if (self->filename != NULL)
+        logger_check_file (self, len);
 
-          if (reason_to_reopen != NULL)
-            {
-              /* The log file is either deleted or replaced, probably by a
-               * developer who wanted to clear the logs out. Re-create it now
-               * instead of staying silent. */
-              glnx_autofd int new_fd = -1;
-              g_autoptr(GError) local_error = NULL;
-
-              g_info ("Re-opening \"%s\" because: %s",
-                      self->filename, reason_to_reopen);
-
-              new_fd = TEMP_FAILURE_RETRY (open (self->filename,
-                                                 OPEN_FLAGS,
-                                                 0644));
-              if (new_fd < 0)
-                {
-                  _srt_log_warning ("Unable to re-open log file: \"%s\": %s",
-                                    self->filename, g_strerror (errno));
-                }
-              /* Reuse current_stat (which might or might not be populated)
-               * for the device and inode of the replacement file */
-              else if (fstat (new_fd, &current_stat) < 0)
-                {
-                  _srt_log_warning ("Unable to stat log file \"%s\": %s",
-                                    self->filename, g_strerror (errno));
-                }
-              else if (!lock_output_file (self->filename, new_fd, &local_error))
-                {
-                  _srt_log_warning ("Unable to re-lock log file \"%s\": %s",
-                                    self->filename, local_error->message);
-                }
-              else
-                {
-                  g_info ("Successfully re-opened \"%s\"", self->filename);
-                  self->file_fd = glnx_steal_fd (&new_fd);
-                  self->file_stat = current_stat;
-                }
-            }
-          else if (self->max_bytes > 0
-                   && (current_stat.st_size + len) > self->max_bytes)
-            {
-              g_autoptr(GError) local_error = NULL;
+      if (line_start_time != 0)
+        timestamp = logger_get_timestamp (self, line_start_time,
+                                          &timestamp_len);
 
-              if (!_srt_logger_try_rotate (self, &local_error))
-                {
-                  _srt_log_warning ("Unable to rotate log file: %s",
-                                    local_error->message);
-                  self->max_bytes = 0;
-                }
-            }
-        }
+      if (timestamp != NULL)
+        iov[n++] = (struct iovec) { (void *) timestamp, timestamp_len };
 
-      if (line_start_time != 0)
-        {
-          /* We use glibc time formatting rather than GDateTime here,
-           * to reduce malloc/free in the main logging loop. */
-          char buf[32];
-          size_t buf_used = 0;
-          struct tm tm;
-
-          /* If we can't format the timestamp for some reason, just don't
-           * output it */
-          if (localtime_r (&line_start_time, &tm) == &tm)
-            {
-              buf_used = strftime (buf, sizeof (buf), "[%F %T] ", &tm);
-              glnx_loop_write (self->file_fd, buf, buf_used);
-            }
-        }
+      iov[n++] = (struct iovec) { (void *) line, len };
 
-      glnx_loop_write (self->file_fd, line, len);
+      if (loop_writev (self->file_fd, iov, n) == 0)
+        self->file_size += timestamp_len + len;
     }
 }
 
@@ -1366,6 +1590,21 @@ _srt_logger_process (SrtLogger *self,
 
       if (!lock_output_file (self->filename, self->file_fd, error))
         return FALSE;
+
+      /* Rather than stat()ing the log file for every line, watch for
+       * changes to the directory entries in the logs directory. If this
+       * fails, logger_check_file() falls back to checking every line. */
+      self->inotify_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+
+      if (self->inotify_fd < 0)
+        g_debug ("Unable to create inotify fd: %s", g_strerror (errno));
+      else if (inotify_add_watch (self->inotify_fd, ".",
+                                  IN_CREATE | IN_DELETE | IN_MOVE) < 0)
+        {
+          g_debug ("Unable to watch \"%s\": %s",
+                   self->log_dir, g_strerror (errno));
+          glnx_close_fd (&self->inotify_fd);
+        }
     }
 
   if (self->sh_syntax)
@@ -1397,6 +1636,8 @@ _srt_logger_process (SrtLogger *self,
       if (res < 0)
         return glnx_throw_errno_prefix (error, "Error reading standard input");
 
+      logger_read_inotify_events (self);
+
       if (self->timestamps && filled == 0)
         line_start_time = time (NULL);
 
@@ -21,7 +21,10 @@
 #pragma once
 
 #include <fcntl.h>
+#include <stdint.h>
+#include <sys/ioctl.h>
 #include <sys/prctl.h>
+#include <sys/syscall.h>
 
 #ifndef F_OFD_GETLK
 #define F_OFD_GETLK 36
@@ -40,3 +43,40 @@
 #ifndef PR_SET_CHILD_SUBREAPER
 #define PR_SET_CHILD_SUBREAPER 36
 #endif
+
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
+/* Linux 5.3; the same on all architectures that use the unified
+ * syscall numbering */
+#ifndef __NR_pidfd_open
+#define __NR_pidfd_open 434
+#endif
+
+/* Linux 5.1; likewise */
+#ifndef __NR_pidfd_send_signal
+#define __NR_pidfd_send_signal 424
+#endif
+
+/* Linux 5.6; likewise */
+#ifndef __NR_openat2
+#define __NR_openat2 437
+#endif
+
+#ifndef RESOLVE_NO_MAGICLINKS
+#define RESOLVE_NO_MAGICLINKS 0x02
+#endif
+
+#ifndef RESOLVE_IN_ROOT
+#define RESOLVE_IN_ROOT 0x10
+#endif
+
+/* The same layout as struct open_how in <linux/openat2.h>, which we
+ * don't include because it is not available on older systems */
+typedef struct
+{
+  uint64_t flags;
+  uint64_t mode;
+  uint64_t resolve;
+} SrtOpenHow;
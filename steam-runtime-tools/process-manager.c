@@ -9,7 +9,9 @@
 #include <fcntl.h>
 #include <sys/prctl.h>
 #include <sys/signalfd.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib-unix.h>
@@ -140,6 +142,39 @@ _srt_wait_for_child_processes (pid_t main_process,
   return TRUE;
 }
 
+/*
+ * A direct child process that we know about, either because we forked
+ * it or because it was reparented to us.
+ */
+typedef struct
+{
+  int pid;
+  /* A pidfd referring to the process, or -1 if unsupported */
+  int pidfd;
+  /* 0, SIGTERM or SIGKILL: the last signal we sent */
+  int signalled;
+} ChildProcess;
+
+static ChildProcess *
+child_process_new (int pid,
+                   int pidfd)
+{
+  ChildProcess *self = g_new0 (ChildProcess, 1);
+
+  self->pid = pid;
+  self->pidfd = pidfd;
+  return self;
+}
+
+static void
+child_process_free (gpointer p)
+{
+  ChildProcess *self = p;
+
+  glnx_close_fd (&self->pidfd);
+  g_free (self);
+}
+
 typedef struct
 {
   GError *error;
@@ -148,20 +183,25 @@ typedef struct
   GSource *kill_source;
   GSource *sigchld_source;
   gchar *children_file;
-  /* GINT_TO_POINTER (pid) => arbitrary */
-  GHashTable *sent_sigterm;
-  /* GINT_TO_POINTER (pid) => arbitrary */
-  GHashTable *sent_sigkill;
+  /* GINT_TO_POINTER (pid) => owned ChildProcess */
+  GHashTable *children;
   /* Scratch space to build temporary strings */
   GString *buffer;
   /* 0, SIGTERM or SIGKILL */
   int sending_signal;
+  /* The value of sending_signal during the last scan for children */
+  int scanned_signal;
   /* Nonzero if wait_source has been attached to context */
   guint wait_source_id;
   guint kill_source_id;
   guint sigchld_source_id;
   /* TRUE if we reach a point where we have no more child processes. */
   gboolean finished;
+  /* TRUE if we have reaped a process since the last scan for children,
+   * so processes might have been reparented to us */
+  gboolean need_scan;
+  /* TRUE if pidfd_open() is not usable */
+  gboolean no_pidfd;
 } TerminationData;
 
 /*
@@ -200,8 +240,7 @@ termination_data_clear (TerminationData *data)
   g_clear_pointer (&data->children_file, g_free);
   g_clear_pointer (&data->context, g_main_context_unref);
   g_clear_error (&data->error);
-  g_clear_pointer (&data->sent_sigterm, g_hash_table_unref);
-  g_clear_pointer (&data->sent_sigkill, g_hash_table_unref);
+  g_clear_pointer (&data->children, g_hash_table_unref);
 
   if (data->buffer != NULL)
     g_string_free (g_steal_pointer (&data->buffer), TRUE);
@@ -210,40 +249,130 @@ termination_data_clear (TerminationData *data)
 G_DEFINE_AUTO_CLEANUP_CLEAR_FUNC (TerminationData, termination_data_clear)
 
 /*
- * Sends the configured signal to the given child process, checking the state
- * of it if the signal was already sent.
+ * Send @sig to @child, preferring its pidfd if we have one, so that we
+ * cannot signal an unrelated process that has reused its process ID.
+ */
+static int
+child_process_kill (ChildProcess *child,
+                    int sig)
+{
+  if (child->pidfd >= 0)
+    {
+      if (syscall (__NR_pidfd_send_signal, child->pidfd, sig, NULL, 0) == 0)
+        return 0;
+
+      if (errno != ENOSYS && errno != EPERM)
+        return -1;
+    }
+
+  return kill (child->pid, sig);
+}
+
+/*
+ * Sends the configured signal to the given child process, unless it was
+ * already sent.
  */
 static void
 termination_data_signal_child (TerminationData *data,
-                               int child)
+                               ChildProcess *child)
 {
-  GHashTable *already;
-
   g_return_if_fail (data->sending_signal != 0);
 
-  if (data->sending_signal == SIGKILL)
-    already = data->sent_sigkill;
-  else
-    already = data->sent_sigterm;
+  if (child->signalled == data->sending_signal
+      || child->signalled == SIGKILL)
+    return;
+
+  g_debug ("Sending signal %d to process %d",
+           data->sending_signal, child->pid);
+  child->signalled = data->sending_signal;
+
+  if (child_process_kill (child, data->sending_signal) < 0)
+    g_warning ("Unable to send signal %d to process %d: %s",
+               data->sending_signal, child->pid, g_strerror (errno));
+
+  /* In case the child is stopped, wake it up to receive the signal */
+  if (child_process_kill (child, SIGCONT) < 0)
+    g_warning ("Unable to send SIGCONT to process %d: %s",
+               child->pid, g_strerror (errno));
+
+  /* When the child terminates, we will get SIGCHLD and come
+   * back to here. */
+}
+
+/*
+ * Signal the child process @pid, which was found by listing our
+ * children, and start tracking it if it is new.
+ *
+ * If @maybe_thread is true, @pid might be a thread belonging to a child
+ * process rather than a process in its own right. We don't kill threads,
+ * only processes.
+ */
+static void
+termination_data_found_child (TerminationData *data,
+                              int pid,
+                              gboolean maybe_thread)
+{
+  ChildProcess *child;
+  int pidfd = -1;
+
+  child = g_hash_table_lookup (data->children, GINT_TO_POINTER (pid));
 
-  if (!g_hash_table_contains (already, GINT_TO_POINTER (child)))
+  if (child != NULL)
     {
-      g_debug ("Sending signal %d to process %d",
-               data->sending_signal, child);
-      g_hash_table_add (already, GINT_TO_POINTER (child));
+      termination_data_signal_child (data, child);
+      return;
+    }
 
-      if (kill (child, data->sending_signal) < 0)
-        g_warning ("Unable to send signal %d to process %d: %s",
-                   data->sending_signal, child, g_strerror (errno));
+  if (!data->no_pidfd)
+    {
+      pidfd = (int) syscall (__NR_pidfd_open, pid, 0);
 
-      /* In case the child is stopped, wake it up to receive the signal */
-      if (kill (child, SIGCONT) < 0)
-        g_warning ("Unable to send SIGCONT to process %d: %s",
-                   child, g_strerror (errno));
+      if (pidfd < 0)
+        {
+          switch (errno)
+            {
+              case EINVAL:
+                /* pidfd_open() refuses to open threads other than the
+                 * thread-group leader */
+                g_debug ("Task %d is a thread, not a process", pid);
+                return;
+
+              case ESRCH:
+                g_debug ("Process %d has already gone away", pid);
+                return;
+
+              case ENOSYS:
+              case EPERM:
+                /* EPERM might be a seccomp filter that doesn't know
+                 * about it */
+                g_debug ("pidfd_open() not supported, will fall back: %s",
+                         g_strerror (errno));
+                data->no_pidfd = TRUE;
+                break;
+
+              default:
+                g_debug ("pidfd_open(%d) failed: %s", pid, g_strerror (errno));
+                break;
+            }
+        }
+    }
+
+  if (pidfd < 0 && maybe_thread)
+    {
+      g_string_printf (data->buffer, "/proc/%d", pid);
 
-      /* When the child terminates, we will get SIGCHLD and come
-       * back to here. */
+      /* If the task is just a thread, it won't have a /proc/%d directory
+       * in its own right. */
+      if (!g_file_test (data->buffer->str, G_FILE_TEST_IS_DIR))
+        {
+          g_debug ("Task %d is a thread, not a process", pid);
+          return;
+        }
     }
+
+  child = child_process_new (pid, pidfd);
+  g_hash_table_replace (data->children, GINT_TO_POINTER (pid), child);
+  termination_data_signal_child (data, child);
 }
 
 /*
@@ -289,6 +418,12 @@ termination_data_read_ppid (TerminationData *data,
  * - before wait_period: do nothing
  * - after wait_period but before grace_period: send SIGTERM
  * - after wait_period and grace_period: send SIGKILL
+ *
+ * Our set of direct child processes can only grow when a descendant
+ * exits and its children are reparented to us, so we only list our
+ * children again when we have reaped something or the phase changes.
+ * Processes we already know about are tracked in data->children and
+ * are not inspected again.
  */
 static void
 termination_data_refresh (TerminationData *data)
@@ -331,18 +466,29 @@ termination_data_refresh (TerminationData *data)
           break;
         }
 
-      /* This process has gone away, so remove any record that we have
-       * sent it signals. If the pid is reused, we'll want to send
-       * the same signals again. */
+      /* This process has gone away, so stop tracking it. If the pid is
+       * reused, we'll want to send the same signals again. */
       g_debug ("Process %d exited", died);
-      g_hash_table_remove (data->sent_sigkill, GINT_TO_POINTER (died));
-      g_hash_table_remove (data->sent_sigterm, GINT_TO_POINTER (died));
+      g_hash_table_remove (data->children, GINT_TO_POINTER (died));
+      data->need_scan = TRUE;
     }
 
   /* If we are still in the wait_period, nothing more to do yet */
   if (data->sending_signal == 0)
     return;
 
+  /* If nothing has exited since we last looked, we cannot have adopted
+   * any new children, and everything we know about has already been
+   * sent the current signal */
+  if (!data->need_scan && data->scanned_signal == data->sending_signal)
+    {
+      g_debug ("No new child processes since last check");
+      return;
+    }
+
+  data->need_scan = FALSE;
+  data->scanned_signal = data->sending_signal;
+
   /* See whether we have any remaining children. These could be direct
    * child processes, or they could be children we adopted because
    * their parent was one of our descendants and has exited, leaving the
@@ -361,7 +507,6 @@ termination_data_refresh (TerminationData *data)
            p = endptr)
         {
           guint64 maybe_child;
-          int child;
 
           while (*p != '\0' && g_ascii_isspace (*p))
             p++;
@@ -385,18 +530,7 @@ termination_data_refresh (TerminationData *data)
               return;
             }
 
-          child = (int) maybe_child;
-          g_string_printf (data->buffer, "/proc/%d", child);
-
-          /* If the task is just a thread, it won't have a /proc/%d directory
-           * in its own right. We don't kill threads, only processes. */
-          if (!g_file_test (data->buffer->str, G_FILE_TEST_IS_DIR))
-            {
-              g_debug ("Task %d is a thread, not a process", child);
-              continue;
-            }
-
-          termination_data_signal_child (data, child);
+          termination_data_found_child (data, (int) maybe_child, TRUE);
         }
     }
   else
@@ -421,6 +555,7 @@ termination_data_refresh (TerminationData *data)
       while (TRUE)
         {
           g_autoptr(GError) ppid_error = NULL;
+          ChildProcess *known;
           struct dirent *dent;
           char *endptr;
           guint64 maybe_child;
@@ -447,6 +582,17 @@ termination_data_refresh (TerminationData *data)
             }
 
           child = (int) maybe_child;
+
+          /* No need to read the status of processes that we know are
+           * our children: they cannot be reparented away from us */
+          known = g_hash_table_lookup (data->children, GINT_TO_POINTER (child));
+
+          if (known != NULL)
+            {
+              termination_data_signal_child (data, known);
+              continue;
+            }
+
           if (!termination_data_read_ppid (data, iter.real_iter.fd, child,
                                            &child_ppid, &ppid_error))
             {
@@ -460,7 +606,7 @@ termination_data_refresh (TerminationData *data)
           if (child_ppid != our_pid)
             continue;
 
-          termination_data_signal_child (data, child);
+          termination_data_found_child (data, child, FALSE);
         }
     }
 }
@@ -588,8 +734,9 @@ _srt_subreaper_terminate_all_child_processes (GTimeSpan wait_period,
   data.children_file = g_strdup_printf ("/proc/%d/task/%d/children",
                                         getpid (), getpid ());
   data.context = g_main_context_new ();
-  data.sent_sigterm = g_hash_table_new (NULL, NULL);
-  data.sent_sigkill = g_hash_table_new (NULL, NULL);
+  data.children = g_hash_table_new_full (NULL, NULL, NULL,
+                                         child_process_free);
+  data.need_scan = TRUE;
   /* Big enough to fit either '/proc/<PID>' or '<PID>/status' without
    * reallocation (the the latter is 1 byte longer than the former). */
   data.buffer = g_string_new ("2345678901/status");
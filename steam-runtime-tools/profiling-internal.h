@@ -36,5 +36,11 @@ typedef struct _SrtProfilingTimer SrtProfilingTimer;
 G_GNUC_PRINTF (1, 2) G_GNUC_INTERNAL
 SrtProfilingTimer *_srt_profiling_start (const char *format, ...);
 G_GNUC_INTERNAL void _srt_profiling_end (SrtProfilingTimer *start);
+G_GNUC_INTERNAL void _srt_profiling_rate (SrtProfilingTimer *timer,
+                                          guint64 n_items,
+                                          const char *units);
+G_GNUC_INTERNAL void _srt_profiling_counter (const char *name,
+                                             gint64 value);
 G_GNUC_INTERNAL void _srt_profiling_enable (GLogLevelFlags level);
+G_GNUC_INTERNAL void _srt_profiling_enable_trace (const char *path);
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtProfilingTimer, _srt_profiling_end)
@@ -26,11 +26,249 @@
 #include "steam-runtime-tools/profiling-internal.h"
 
 #include <errno.h>
-#include <sys/times.h>
+#include <fcntl.h>
+#include <sys/prctl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
 
-/* If strictly positive, profiling is enabled. */
-static long profiling_ticks_per_sec = 0;
+/* If true, profiling messages are logged at profiling_level. */
+static gboolean profiling_log = FALSE;
 static GLogLevelFlags profiling_level = G_LOG_LEVEL_DEBUG;
+/* If nonnegative, Chrome trace events are appended to this fd. */
+static int profiling_trace_fd = -1;
+
+typedef struct _ThreadState ThreadState;
+
+struct _SrtProfilingTimer
+{
+  char *message;
+  /* The thread that started this measurement (owned) */
+  ThreadState *thread;
+  /* Protected by @thread's lock */
+  SrtProfilingTimer *parent;
+  const char *units;
+  guint64 n_items;
+  gint64 monotonic_nsec;
+  gint64 thread_cpu_nsec;
+  struct rusage cpu;
+  struct rusage children_cpu;
+  guint depth;
+};
+
+/*
+ * ThreadState:
+ *
+ * Reference-counted, because a measurement can be ended in a different
+ * thread, possibly after the thread that started it has exited.
+ */
+struct _ThreadState
+{
+  /* Protects @current and the parent of each timer in the stack */
+  GMutex lock;
+  /* Innermost timer that was started in this thread and has not ended */
+  SrtProfilingTimer *current;
+  pid_t tid;
+  /* Only accessed from the thread itself */
+  gboolean named;
+};
+
+static void
+thread_state_clear (void *p)
+{
+  ThreadState *self = p;
+
+  g_mutex_clear (&self->lock);
+}
+
+static void
+thread_state_unref (void *p)
+{
+  g_atomic_rc_box_release_full (p, thread_state_clear);
+}
+
+static GPrivate thread_state_private = G_PRIVATE_INIT (thread_state_unref);
+
+static gboolean
+profiling_is_enabled (void)
+{
+  return profiling_log || profiling_trace_fd >= 0;
+}
+
+static ThreadState *
+get_thread_state (void)
+{
+  ThreadState *state = g_private_get (&thread_state_private);
+
+  if (state == NULL)
+    {
+      state = g_atomic_rc_box_new0 (ThreadState);
+      g_mutex_init (&state->lock);
+      state->tid = (pid_t) syscall (SYS_gettid);
+      g_private_set (&thread_state_private, state);
+    }
+
+  return state;
+}
+
+static gint64
+get_clock_nsec (clockid_t clock_id)
+{
+  struct timespec ts;
+
+  if (clock_gettime (clock_id, &ts) != 0)
+    return 0;
+
+  return ((gint64) ts.tv_sec * G_GINT64_CONSTANT (1000000000)) + ts.tv_nsec;
+}
+
+static double
+timeval_diff (const struct timeval *end,
+              const struct timeval *start)
+{
+  return (end->tv_sec - start->tv_sec)
+         + (end->tv_usec - start->tv_usec) / (double) G_USEC_PER_SEC;
+}
+
+static void
+append_json_string (GString *buf,
+                    const char *str)
+{
+  const char *p;
+
+  g_string_append_c (buf, '"');
+
+  for (p = str; *p != '\0'; p++)
+    {
+      switch (*p)
+        {
+          case '"':
+            g_string_append (buf, "\\\"");
+            break;
+
+          case '\\':
+            g_string_append (buf, "\\\\");
+            break;
+
+          case '\n':
+            g_string_append (buf, "\\n");
+            break;
+
+          case '\t':
+            g_string_append (buf, "\\t");
+            break;
+
+          default:
+            if ((unsigned char) *p < 0x20)
+              g_string_append_printf (buf, "\\u%04x", (unsigned char) *p);
+            else
+              g_string_append_c (buf, *p);
+        }
+    }
+
+  g_string_append_c (buf, '"');
+}
+
+/*
+ * Start a trace event with the given name and phase. The caller must
+ * append any phase-specific members and then call trace_event_finish().
+ * Timestamps in Chrome's trace format are in microseconds.
+ */
+static GString *
+trace_event_begin (const char *name,
+                   const char *phase,
+                   gint64 monotonic_nsec,
+                   pid_t tid)
+{
+  GString *buf = g_string_new ("{\"name\":");
+
+  append_json_string (buf, name);
+  g_string_append_printf (buf,
+                          ",\"cat\":\"srt\",\"ph\":\"%s\""
+                          ",\"ts\":%" G_GINT64_FORMAT ".%03d"
+                          ",\"pid\":%d,\"tid\":%d",
+                          phase,
+                          monotonic_nsec / 1000,
+                          (int) (monotonic_nsec % 1000),
+                          (int) getpid (), (int) tid);
+  return buf;
+}
+
+/*
+ * Terminate @buf and append it to the trace file in a single write,
+ * so that events from concurrent threads and processes sharing the
+ * same trace file are not interleaved.
+ */
+static void
+trace_event_finish (GString *buf)
+{
+  g_string_append (buf, "},\n");
+
+  if (profiling_trace_fd >= 0
+      && glnx_loop_write (profiling_trace_fd, buf->str, buf->len) < 0)
+    g_debug ("Unable to write trace event: %s", g_strerror (errno));
+
+  g_string_free (buf, TRUE);
+}
+
+static void
+trace_metadata (const char *what,
+                pid_t tid,
+                const char *value)
+{
+  GString *buf = trace_event_begin (what, "M", 0, tid);
+
+  g_string_append (buf, ",\"args\":{\"name\":");
+  append_json_string (buf, value);
+  g_string_append_c (buf, '}');
+  trace_event_finish (buf);
+}
+
+static void
+trace_ensure_thread_named (ThreadState *state)
+{
+  char name[17] = "";
+
+  if (profiling_trace_fd < 0 || state->named)
+    return;
+
+  state->named = TRUE;
+
+  if (prctl (PR_GET_NAME, name, 0, 0, 0) != 0 || name[0] == '\0')
+    g_snprintf (name, sizeof (name), "%d", (int) state->tid);
+
+  trace_metadata ("thread_name", state->tid, name);
+}
+
+/*
+ * Create @path, already containing the start of the array, unless it
+ * already exists. Creating the file and writing the header are done
+ * atomically, so that if more than one process starts writing to a new
+ * trace file at the same time, none of them can append an event before
+ * the header. Viewers tolerate a trailing comma and a missing "]".
+ */
+static gboolean
+trace_file_create (const char *path,
+                   GError **error)
+{
+  g_auto(GLnxTmpfile) tmpf = { FALSE };
+  g_autofree gchar *dir = g_path_get_dirname (path);
+
+  if (!glnx_open_tmpfile_linkable_at (AT_FDCWD, dir, O_WRONLY | O_CLOEXEC,
+                                      &tmpf, error))
+    return FALSE;
+
+  if (glnx_loop_write (tmpf.fd, "[\n", 2) < 0)
+    return glnx_throw_errno_prefix (error, "Unable to write");
+
+  if (fchmod (tmpf.fd, 0644) != 0)
+    return glnx_throw_errno_prefix (error, "Unable to set permissions");
+
+  return glnx_link_tmpfile_at (&tmpf, GLNX_LINK_TMPFILE_NOREPLACE_IGNORE_EXIST,
+                               AT_FDCWD, path, error);
+}
 
 /*
  * Enable time measurement and profiling messages.
@@ -38,30 +276,72 @@ static GLogLevelFlags profiling_level = G_LOG_LEVEL_DEBUG;
 void
 _srt_profiling_enable (GLogLevelFlags level)
 {
-  errno = 0;
-  profiling_ticks_per_sec = sysconf (_SC_CLK_TCK);
-
   if (level & G_LOG_LEVEL_MASK)
     profiling_level = level;
   else
     profiling_level = G_LOG_LEVEL_DEBUG;
 
-  if (profiling_ticks_per_sec <= 0)
-    g_warning ("Unable to enable profiling: %s", g_strerror (errno));
-  else
-    g_log (G_LOG_DOMAIN, profiling_level, "Enabled profiling");
+  profiling_log = TRUE;
+  g_log (G_LOG_DOMAIN, profiling_level, "Enabled profiling");
 }
 
-struct _SrtProfilingTimer
+/*
+ * @path: A filename
+ *
+ * Enable time measurement, and append the results to @path in the
+ * JSON Array Format of the Chrome Trace Event format, which can be
+ * loaded into `chrome://tracing` or <https://ui.perfetto.dev/>.
+ *
+ * All timestamps are taken from `CLOCK_MONOTONIC`, so if the same
+ * @path is used by more than one process, for example a
+ * pressure-vessel-wrap process and the pv-adverb that it runs, their
+ * events can be seen on the same timeline. The file is never truncated,
+ * and the closing `]` is omitted, as permitted by the format.
+ */
+void
+_srt_profiling_enable_trace (const char *path)
 {
-  char *message;
-  clock_t wallclock;
-  struct tms cpu;
-};
+  g_autoptr(GError) local_error = NULL;
+  glnx_autofd int fd = -1;
+  ThreadState *state;
+
+  if (profiling_trace_fd >= 0)
+    return;
+
+  fd = open (path, O_WRONLY | O_APPEND | O_CLOEXEC | O_NOCTTY);
+
+  if (fd < 0 && errno == ENOENT)
+    {
+      if (!trace_file_create (path, &local_error))
+        {
+          g_warning ("Unable to create trace file \"%s\": %s",
+                     path, local_error->message);
+          return;
+        }
+
+      fd = open (path, O_WRONLY | O_APPEND | O_CLOEXEC | O_NOCTTY);
+    }
+
+  if (fd < 0)
+    {
+      g_warning ("Unable to open trace file \"%s\": %s",
+                 path, g_strerror (errno));
+      return;
+    }
+
+  profiling_trace_fd = g_steal_fd (&fd);
+  state = get_thread_state ();
+  trace_metadata ("process_name", state->tid,
+                  g_get_prgname () != NULL ? g_get_prgname () : "(unknown)");
+  g_log (G_LOG_DOMAIN, profiling_level,
+         "Writing profiling trace to \"%s\"", path);
+}
 
 /*
  * Start a time measurement. Must be paired with _srt_profiling_end(),
- * unless %NULL is returned.
+ * unless %NULL is returned. Measurements that are started while another
+ * measurement is in progress in the same thread are nested inside it,
+ * and should be ended first.
  *
  * Returns: (transfer full): an object representing the start time,
  *  or %NULL if profiling is disabled
@@ -71,26 +351,121 @@ _srt_profiling_start (const char *format,
                       ...)
 {
   SrtProfilingTimer *ret;
+  ThreadState *state;
   va_list args;
 
-  if (profiling_ticks_per_sec <= 0)
+  if (!profiling_is_enabled ())
     return NULL;
 
+  state = get_thread_state ();
   ret = g_new0 (SrtProfilingTimer, 1);
   va_start (args, format);
   ret->message = g_strdup_vprintf (format, args);
   va_end (args);
+  ret->thread = g_atomic_rc_box_acquire (state);
+
+  g_mutex_lock (&state->lock);
+  ret->parent = state->current;
+
+  if (ret->parent != NULL)
+    ret->depth = ret->parent->depth + 1;
+
+  state->current = ret;
+  g_mutex_unlock (&state->lock);
 
-  g_log (G_LOG_DOMAIN, profiling_level, "Profiling: start: %s", ret->message);
-  ret->wallclock = times (&ret->cpu);
+  trace_ensure_thread_named (state);
+
+  if (profiling_log)
+    g_log (G_LOG_DOMAIN, profiling_level, "Profiling: start: %*s%s",
+           (int) ret->depth * 2, "", ret->message);
+
+  getrusage (RUSAGE_SELF, &ret->cpu);
+  getrusage (RUSAGE_CHILDREN, &ret->children_cpu);
+  ret->thread_cpu_nsec = get_clock_nsec (CLOCK_THREAD_CPUTIME_ID);
+  ret->monotonic_nsec = get_clock_nsec (CLOCK_MONOTONIC);
   return ret;
 }
 
+/*
+ * @timer: (nullable) (transfer none): A measurement in progress
+ * @n_items: Number of items processed so far
+ * @units: (not nullable): Plural noun describing the items, for example
+ *  "entries". Must remain valid until @timer ends.
+ *
+ * Log how many items were processed per second since @timer started.
+ * The most recent value is also recorded in the trace event for @timer.
+ */
+void
+_srt_profiling_rate (SrtProfilingTimer *timer,
+                     guint64 n_items,
+                     const char *units)
+{
+  double elapsed;
+
+  if (timer == NULL)
+    return;
+
+  timer->n_items = n_items;
+  timer->units = units;
+
+  if (!profiling_log)
+    return;
+
+  elapsed = (get_clock_nsec (CLOCK_MONOTONIC) - timer->monotonic_nsec)
+            / 1e9;
+
+  g_log (G_LOG_DOMAIN, profiling_level,
+         "Profiling: rate: %" G_GUINT64_FORMAT " %s in %.3fs "
+         "(%.0f %s/sec): %s",
+         n_items, units, elapsed,
+         elapsed > 0.0 ? n_items / elapsed : 0.0, units,
+         timer->message);
+}
+
+/*
+ * @name: Name of a quantity, for example "Vulkan ICDs"
+ * @value: Its current value
+ *
+ * Record the current value of a quantity that is expected to be
+ * interesting when profiling, such as the number of items found.
+ * In the trace file, counters with the same @name are shown as a graph.
+ */
+void
+_srt_profiling_counter (const char *name,
+                        gint64 value)
+{
+  ThreadState *state;
+  GString *buf;
+
+  if (!profiling_is_enabled ())
+    return;
+
+  if (profiling_log)
+    g_log (G_LOG_DOMAIN, profiling_level,
+           "Profiling: counter: %s = %" G_GINT64_FORMAT, name, value);
+
+  if (profiling_trace_fd < 0)
+    return;
+
+  state = get_thread_state ();
+  trace_ensure_thread_named (state);
+  buf = trace_event_begin (name, "C",
+                           get_clock_nsec (CLOCK_MONOTONIC),
+                           state->tid);
+  g_string_append_printf (buf, ",\"args\":{\"value\":%" G_GINT64_FORMAT "}",
+                          value);
+  trace_event_finish (buf);
+}
+
 /*
  * @start: (nullable) (transfer full): The start of the measurement
  *
  * Finish a time measurement and log how much real (wallclock) time,
- * user CPU time and system CPU type was taken.
+ * user CPU time and system CPU type was taken. This is normally called
+ * in the same thread that called _srt_profiling_start(). If it is called
+ * in a different thread, the measurement is still recorded on the
+ * starting thread's timeline, but without its thread CPU time, which
+ * cannot be measured from elsewhere.
  *
  * A `g_autoptr(SrtProfilingTimer)` automatically ends profiling when the
  * timer goes out of scope.
@@ -98,26 +473,110 @@ _srt_profiling_start (const char *format,
 void
 _srt_profiling_end (SrtProfilingTimer *start)
 {
-  clock_t end;
-  struct tms end_cpu;
+  g_autofree gchar *parent_message = NULL;
+  ThreadState *state;
+  gboolean same_thread;
+  gint64 end_nsec;
+  gint64 end_thread_cpu_nsec;
+  struct rusage end_cpu;
+  struct rusage end_children_cpu;
 
   if (start == NULL)
     return;
 
-  end = times (&end_cpu);
+  end_nsec = get_clock_nsec (CLOCK_MONOTONIC);
+  end_thread_cpu_nsec = get_clock_nsec (CLOCK_THREAD_CPUTIME_ID);
+  getrusage (RUSAGE_SELF, &end_cpu);
+  getrusage (RUSAGE_CHILDREN, &end_children_cpu);
 
-  g_log (G_LOG_DOMAIN, profiling_level,
-         "Profiling: end (real %.1fs, user %.1fs, sys %.1fs): %s",
-         (end - start->wallclock) / (double) profiling_ticks_per_sec,
-         (end_cpu.tms_utime
-          + end_cpu.tms_cutime
-          - start->cpu.tms_utime
-          - start->cpu.tms_cutime) / (double) profiling_ticks_per_sec,
-         (end_cpu.tms_stime
-          + end_cpu.tms_cstime
-          - start->cpu.tms_stime
-          - start->cpu.tms_cstime) / (double) profiling_ticks_per_sec,
-         start->message);
+  state = start->thread;
+  same_thread = (g_private_get (&thread_state_private) == state);
+
+  g_mutex_lock (&state->lock);
+
+  if (state->current == start)
+    {
+      state->current = start->parent;
+    }
+  else
+    {
+      SrtProfilingTimer *iter;
+
+      /* Ended out of order: unlink it from the stack so that the
+       * measurements nested inside it don't point to freed memory */
+      for (iter = state->current; iter != NULL; iter = iter->parent)
+        {
+          if (iter->parent == start)
+            {
+              iter->parent = start->parent;
+              break;
+            }
+        }
+    }
+
+  /* Once the lock is released, the parent could be ended and freed
+   * by another thread */
+  if (start->parent != NULL)
+    parent_message = g_strdup (start->parent->message);
+
+  g_mutex_unlock (&state->lock);
+
+  if (profiling_log)
+    g_log (G_LOG_DOMAIN, profiling_level,
+           "Profiling: end (real %.3fs, user %.3fs, sys %.3fs): %*s%s%s",
+           (end_nsec - start->monotonic_nsec) / 1e9,
+           timeval_diff (&end_cpu.ru_utime, &start->cpu.ru_utime)
+           + timeval_diff (&end_children_cpu.ru_utime,
+                           &start->children_cpu.ru_utime),
+           timeval_diff (&end_cpu.ru_stime, &start->cpu.ru_stime)
+           + timeval_diff (&end_children_cpu.ru_stime,
+                           &start->children_cpu.ru_stime),
+           (int) start->depth * 2, "",
+           start->message,
+           same_thread ? "" : " (ended in another thread)");
+
+  if (profiling_trace_fd >= 0)
+    {
+      gint64 dur = end_nsec - start->monotonic_nsec;
+      gint64 tdur = end_thread_cpu_nsec - start->thread_cpu_nsec;
+      GString *buf = trace_event_begin (start->message, "X",
+                                        start->monotonic_nsec,
+                                        state->tid);
+
+      g_string_append_printf (buf,
+                              ",\"dur\":%" G_GINT64_FORMAT ".%03d",
+                              dur / 1000, (int) (dur % 1000));
+
+      if (same_thread)
+        g_string_append_printf (buf,
+                                ",\"tts\":%" G_GINT64_FORMAT ".%03d"
+                                ",\"tdur\":%" G_GINT64_FORMAT ".%03d",
+                                start->thread_cpu_nsec / 1000,
+                                (int) (start->thread_cpu_nsec % 1000),
+                                tdur / 1000, (int) (tdur % 1000));
+
+      g_string_append_printf (buf, ",\"args\":{\"depth\":%u",
+                              start->depth);
+
+      if (parent_message != NULL)
+        {
+          g_string_append (buf, ",\"parent\":");
+          append_json_string (buf, parent_message);
+        }
+
+      if (start->units != NULL)
+        {
+          g_string_append_c (buf, ',');
+          append_json_string (buf, start->units);
+          g_string_append_printf (buf, ":%" G_GUINT64_FORMAT,
+                                  start->n_items);
+        }
+
+      g_string_append_c (buf, '}');
+      trace_event_finish (buf);
+    }
+
+  thread_state_unref (start->thread);
   g_free (start->message);
   g_free (start);
 }
@@ -38,6 +38,21 @@ typedef struct _SrtPtyBridgeClass SrtPtyBridgeClass;
 #define SRT_IS_PTY_BRIDGE_CLASS(cls) (G_TYPE_CHECK_CLASS_TYPE ((cls), SRT_TYPE_PTY_BRIDGE))
 #define SRT_PTY_BRIDGE_GET_CLASS(obj) (G_TYPE_INSTANCE_GET_CLASS((obj), SRT_TYPE_PTY_BRIDGE, SrtPtyBridgeClass)
 
+/*
+ * SrtPtyBridgeCounters:
+ * @input_bytes: Bytes copied from the input source to the terminal
+ * @input_bytes_spliced: Subset of @input_bytes that were moved with splice()
+ * @output_bytes: Bytes copied from the terminal to the output destination
+ * @output_bytes_spliced: Subset of @output_bytes that were moved with splice()
+ */
+typedef struct
+{
+  guint64 input_bytes;
+  guint64 input_bytes_spliced;
+  guint64 output_bytes;
+  guint64 output_bytes_spliced;
+} SrtPtyBridgeCounters;
+
 GType _srt_pty_bridge_get_type (void);
 SrtPtyBridge *_srt_pty_bridge_new (int input_source_fd,
                                    int output_dest_fd,
@@ -50,6 +65,8 @@ gboolean _srt_pty_bridge_handle_signal (SrtPtyBridge *self,
                                         GError **error);
 void _srt_pty_bridge_close_terminal_fd (SrtPtyBridge *self);
 gboolean _srt_pty_bridge_is_active (SrtPtyBridge *self);
+void _srt_pty_bridge_get_counters (SrtPtyBridge *self,
+                                   SrtPtyBridgeCounters *counters);
 
 #ifdef G_DEFINE_AUTOPTR_CLEANUP_FUNC
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (SrtPtyBridge, g_object_unref)
@@ -29,6 +29,8 @@
 
 #include <stdint.h>
 #include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <termios.h>
 
 #ifndef TIOCGPTPEER
@@ -58,20 +60,35 @@ typedef enum
   BRIDGE_FD_WAS_BLOCKING = (1 << 3),
   /* Set if the fd reached a hangup or error condition. */
   BRIDGE_FD_HANGUP = (1 << 4),
+  /* Set if the fd is a pipe, so we can try to splice() between it
+   * and the ptmx_fd. Cleared if the kernel can't do that. */
+  BRIDGE_FD_CAN_SPLICE = (1 << 5),
   BRIDGE_FD_DEFAULT = 0
 } BridgeFdFlags;
 
+/* Large enough that bulk output, such as a game's debug log, can be
+ * copied in a few big chunks per main loop iteration */
+#define BRIDGE_BUFFER_SIZE (64 * 1024)
+
 typedef struct
 {
-  /* Buffer for communication between fd and ptmx_fd */
-  char buffer[LINE_MAX];
+  /* Ring buffer of BRIDGE_BUFFER_SIZE bytes for communication
+   * between fd and ptmx_fd */
+  char *buffer;
 
   /* Watches for ability to read input on fd or ptmx_fd */
   GSource *read_source;
   /* Watches for ability to write output on ptmx_fd or fd */
   GSource *write_source;
-  /* Bytes used at the beginning of buffer */
+  /* Offset of the first byte used in buffer */
+  size_t buffer_start;
+  /* Bytes used in buffer, starting from buffer_start and wrapping
+   * around to the beginning if necessary */
   size_t buffer_used;
+  /* Total number of bytes that reached the other side */
+  guint64 bytes_transferred;
+  /* Subset of bytes_transferred that were moved by splice() */
+  guint64 bytes_spliced;
 
   /* Attributes that might need to be restored when we are finished.
    * Only valid if flags & HAVE_ATTRS. */
@@ -87,10 +104,128 @@ typedef struct
 static void
 bridge_fd_init (BridgeFd *self)
 {
+  self->buffer = g_malloc (BRIDGE_BUFFER_SIZE);
   self->fd = -1;
   self->flags = BRIDGE_FD_DEFAULT;
 }
 
+static gboolean
+bridge_fd_buffer_is_full (BridgeFd *self)
+{
+  return self->buffer_used == BRIDGE_BUFFER_SIZE;
+}
+
+/*
+ * Fill @iov with the used part of the buffer, in order.
+ * Returns the number of elements of @iov that were filled (0 to 2).
+ */
+static int
+bridge_fd_get_used (BridgeFd *self,
+                    struct iovec iov[2])
+{
+  size_t first;
+
+  if (self->buffer_used == 0)
+    return 0;
+
+  first = MIN (self->buffer_used, BRIDGE_BUFFER_SIZE - self->buffer_start);
+  iov[0].iov_base = self->buffer + self->buffer_start;
+  iov[0].iov_len = first;
+
+  if (first == self->buffer_used)
+    return 1;
+
+  iov[1].iov_base = self->buffer;
+  iov[1].iov_len = self->buffer_used - first;
+  return 2;
+}
+
+/*
+ * Fill @iov with the unused part of the buffer, in order.
+ * Returns the number of elements of @iov that were filled (0 to 2).
+ */
+static int
+bridge_fd_get_free (BridgeFd *self,
+                    struct iovec iov[2])
+{
+  size_t available = BRIDGE_BUFFER_SIZE - self->buffer_used;
+  size_t end;
+  size_t first;
+
+  if (available == 0)
+    return 0;
+
+  end = (self->buffer_start + self->buffer_used) % BRIDGE_BUFFER_SIZE;
+  first = MIN (available, BRIDGE_BUFFER_SIZE - end);
+  iov[0].iov_base = self->buffer + end;
+  iov[0].iov_len = first;
+
+  if (first == available)
+    return 1;
+
+  iov[1].iov_base = self->buffer;
+  iov[1].iov_len = available - first;
+  return 2;
+}
+
+/*
+ * Record that @len bytes were written out from the beginning of the
+ * used part of the buffer.
+ */
+static void
+bridge_fd_consume (BridgeFd *self,
+                   size_t len)
+{
+  g_assert (self->buffer_used >= len);
+  self->buffer_start = (self->buffer_start + len) % BRIDGE_BUFFER_SIZE;
+  self->buffer_used -= len;
+  self->bytes_transferred += len;
+
+  /* Keep the next read contiguous if possible */
+  if (self->buffer_used == 0)
+    self->buffer_start = 0;
+}
+
+/*
+ * Try to move data from @from_fd to @to_fd without copying it through
+ * our buffer. This is only possible if one of them is a pipe, and is
+ * only done while the buffer is empty, so that the order is preserved.
+ *
+ * Returns: the number of bytes moved, or 0 if the caller should fall
+ *  back to reading into the buffer, for example because @to_fd is not
+ *  ready to be written or the kernel cannot splice these fds
+ */
+static size_t
+bridge_fd_try_splice (BridgeFd *self,
+                      int from_fd,
+                      int to_fd)
+{
+  ssize_t len;
+
+  if (!(self->flags & BRIDGE_FD_CAN_SPLICE) || self->buffer_used > 0)
+    return 0;
+
+  len = splice (from_fd, NULL, to_fd, NULL, BRIDGE_BUFFER_SIZE,
+                SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+
+  if (len > 0)
+    {
+      trace ("Spliced %zd bytes from fd %d to fd %d", len, from_fd, to_fd);
+      self->bytes_transferred += len;
+      self->bytes_spliced += len;
+      return len;
+    }
+
+  if (len < 0 && G_IN_SET (errno, EINVAL, ENOSYS, EOPNOTSUPP))
+    {
+      g_debug ("Unable to splice from fd %d to fd %d, copying instead: %s",
+               from_fd, to_fd, g_strerror (errno));
+      self->flags &= ~BRIDGE_FD_CAN_SPLICE;
+    }
+
+  return 0;
+}
+
 static int
 fd_reopen (int fd,
            int flags)
@@ -201,6 +336,14 @@ bridge_fd_set_attributes (BridgeFd *self,
   if (was_blocking)
     self->flags |= BRIDGE_FD_WAS_BLOCKING;
 
+  if (self->fd >= 0)
+    {
+      struct stat stat_buf;
+
+      if (fstat (self->fd, &stat_buf) == 0 && S_ISFIFO (stat_buf.st_mode))
+        self->flags |= BRIDGE_FD_CAN_SPLICE;
+    }
+
   if (tcgetattr (self->fd, &self->saved_attrs) >= 0)
     {
       struct termios raw_attrs;
@@ -437,10 +580,20 @@ srt_pty_bridge_finalize (GObject *object)
 {
   SrtPtyBridge *self = SRT_PTY_BRIDGE (object);
 
+  g_debug ("pty bridge finished: "
+           "%" G_GUINT64_FORMAT " bytes of input (%" G_GUINT64_FORMAT " spliced), "
+           "%" G_GUINT64_FORMAT " bytes of output (%" G_GUINT64_FORMAT " spliced)",
+           self->input_source.bytes_transferred,
+           self->input_source.bytes_spliced,
+           self->output_dest.bytes_transferred,
+           self->output_dest.bytes_spliced);
+
   /* The order here must be the opposite of what is done in initable_init,
    * so that we progressively go back to the terminals' original state. */
   bridge_fd_close (&self->output_dest);
   bridge_fd_close (&self->input_source);
+  g_clear_pointer (&self->output_dest.buffer, g_free);
+  g_clear_pointer (&self->input_source.buffer, g_free);
 
   g_clear_error (&self->init_error);
   g_clear_pointer (&self->context, g_main_context_unref);
@@ -486,29 +639,33 @@ static void _srt_pty_bridge_enable_input (SrtPtyBridge *self);
 static gboolean
 _srt_pty_bridge_write_ptmx (SrtPtyBridge *self)
 {
+  struct iovec iov[2];
+  gboolean oob;
   ssize_t len;
-  char *buffer;
-  size_t available;
+  int n_iov;
 
   if (self->oob_buffer->len > 0)
     {
       /* Try to write out-of-band interrupts (Ctrl+C, etc.) first */
-      buffer = self->oob_buffer->str;
-      available = self->oob_buffer->len;
+      oob = TRUE;
+      iov[0].iov_base = self->oob_buffer->str;
+      iov[0].iov_len = self->oob_buffer->len;
+      n_iov = 1;
       trace ("Writing up to %zu bytes of out-of-band interrupts",
-             available);
+             self->oob_buffer->len);
     }
   else
     {
       /* Only write out ordinary text if there are no Ctrl+C, etc. pending */
-      buffer = self->input_source.buffer;
-      available = self->input_source.buffer_used;
-      trace ("Writing up to %zu bytes of normal input", available);
+      oob = FALSE;
+      n_iov = bridge_fd_get_used (&self->input_source, iov);
+      trace ("Writing up to %zu bytes of normal input",
+             self->input_source.buffer_used);
     }
 
-  if (G_LIKELY (available > 0))
+  if (G_LIKELY (n_iov > 0))
     {
-      len = write (self->ptmx_fd, buffer, available);
+      len = writev (self->ptmx_fd, iov, n_iov);
 
       if (len < 0)
         {
@@ -535,19 +692,10 @@ _srt_pty_bridge_write_ptmx (SrtPtyBridge *self)
         {
           trace ("Wrote %zd bytes of input to ptmx", len);
 
-          if (buffer == self->input_source.buffer)
-            {
-              g_assert (self->input_source.buffer_used >= (size_t) len);
-              memmove (buffer,
-                       buffer + len,
-                       self->input_source.buffer_used - len);
-              self->input_source.buffer_used -= len;
-            }
+          if (oob)
+            g_string_erase (self->oob_buffer, 0, len);
           else
-            {
-              g_assert (buffer == self->oob_buffer->str);
-              g_string_erase (self->oob_buffer, 0, len);
-            }
+            bridge_fd_consume (&self->input_source, len);
         }
     }
 
@@ -653,13 +801,22 @@ _srt_pty_bridge_input_in_cb (int input_source_fd,
       return G_SOURCE_REMOVE;   /* Destroys input_source.read_source */
     }
 
-  if (G_LIKELY (self->input_source.buffer_used < sizeof (self->input_source.buffer)))
+  /* If we have nothing buffered, try to move the input directly to the
+   * ptmx. If that isn't possible right now, fall back to buffering it. */
+  if (self->oob_buffer->len == 0
+      && self->input_source.write_source == NULL
+      && bridge_fd_try_splice (&self->input_source,
+                               self->input_source.fd, self->ptmx_fd) > 0)
+    return G_SOURCE_CONTINUE;
+
+  if (G_LIKELY (!bridge_fd_buffer_is_full (&self->input_source)))
     {
+      struct iovec iov[2];
       ssize_t len;
+      int n_iov;
 
-      len = read (self->input_source.fd,
-                  self->input_source.buffer + self->input_source.buffer_used,
-                  sizeof (self->input_source.buffer) - self->input_source.buffer_used);
+      n_iov = bridge_fd_get_free (&self->input_source, iov);
+      len = readv (self->input_source.fd, iov, n_iov);
 
       if (len < 0)
         {
@@ -688,7 +845,7 @@ _srt_pty_bridge_input_in_cb (int input_source_fd,
 
   _srt_pty_bridge_try_write_ptmx (self);
 
-  if (self->input_source.buffer_used == sizeof (self->input_source.buffer))
+  if (bridge_fd_buffer_is_full (&self->input_source))
     {
       trace ("Input buffer is full, pausing reading from input source");
       g_clear_pointer (&self->input_source.read_source, g_source_unref);
@@ -704,12 +861,15 @@ _srt_pty_bridge_input_in_cb (int input_source_fd,
 static gboolean
 _srt_pty_bridge_write_output (SrtPtyBridge *self)
 {
+  struct iovec iov[2];
   ssize_t len;
+  int n_iov;
 
-  if (G_LIKELY (self->output_dest.buffer_used > 0))
+  n_iov = bridge_fd_get_used (&self->output_dest, iov);
+
+  if (G_LIKELY (n_iov > 0))
     {
-      len = write (self->output_dest.fd, self->output_dest.buffer,
-                   self->output_dest.buffer_used);
+      len = writev (self->output_dest.fd, iov, n_iov);
 
       if (len < 0)
         {
@@ -727,11 +887,7 @@ _srt_pty_bridge_write_output (SrtPtyBridge *self)
         }
       else if (len > 0)
         {
-          g_assert (self->output_dest.buffer_used >= (size_t) len);
-          memmove (self->output_dest.buffer,
-                   self->output_dest.buffer + len,
-                   self->output_dest.buffer_used - len);
-          self->output_dest.buffer_used -= len;
+          bridge_fd_consume (&self->output_dest, len);
         }
     }
 
@@ -779,6 +935,7 @@ _srt_pty_bridge_try_write_output (SrtPtyBridge *self)
   if (self->output_dest.flags & BRIDGE_FD_HANGUP)
     {
       trace ("No output destination available, discarding output");
+      self->output_dest.buffer_start = 0;
       self->output_dest.buffer_used = 0;
       /* We can't just close the ptmx fd, because we are also using it
        * to copy from the input source to the ptmx */
@@ -841,13 +998,23 @@ _srt_pty_bridge_ptmx_in_cb (int ptmx_fd,
   g_return_val_if_fail (g_main_current_source () == self->output_dest.read_source,
                         G_SOURCE_REMOVE);
 
-  if (G_LIKELY (self->output_dest.buffer_used < sizeof (self->output_dest.buffer)))
+  /* If we have nothing buffered, try to move the output directly to the
+   * destination. If that isn't possible right now, fall back to
+   * buffering it. */
+  if (!(self->output_dest.flags & BRIDGE_FD_HANGUP)
+      && self->output_dest.write_source == NULL
+      && bridge_fd_try_splice (&self->output_dest,
+                               self->ptmx_fd, self->output_dest.fd) > 0)
+    return G_SOURCE_CONTINUE;
+
+  if (G_LIKELY (!bridge_fd_buffer_is_full (&self->output_dest)))
     {
+      struct iovec iov[2];
       ssize_t len;
+      int n_iov;
 
-      len = read (self->ptmx_fd,
-                  self->output_dest.buffer + self->output_dest.buffer_used,
-                  sizeof (self->output_dest.buffer) - self->output_dest.buffer_used);
+      n_iov = bridge_fd_get_free (&self->output_dest, iov);
+      len = readv (self->ptmx_fd, iov, n_iov);
 
       if (len < 0)
         {
@@ -888,7 +1055,7 @@ _srt_pty_bridge_ptmx_in_cb (int ptmx_fd,
 
   _srt_pty_bridge_try_write_output (self);
 
-  if (self->output_dest.buffer_used == sizeof (self->output_dest.buffer))
+  if (bridge_fd_buffer_is_full (&self->output_dest))
     {
       trace ("Output buffer is full, pausing reading from ptmx");
       g_clear_pointer (&self->output_dest.read_source, g_source_unref);
@@ -910,7 +1077,7 @@ _srt_pty_bridge_enable_input (SrtPtyBridge *self)
   trace ("Checking whether to re-enable input sources");
 
   if (self->input_source.fd >= 0 &&
-      self->input_source.buffer_used < sizeof (self->input_source.buffer) &&
+      !bridge_fd_buffer_is_full (&self->input_source) &&
       self->input_source.read_source == NULL)
     {
       trace ("Input buffer not full, scheduling read from input source");
@@ -924,7 +1091,7 @@ _srt_pty_bridge_enable_input (SrtPtyBridge *self)
     }
 
   if (self->ptmx_fd >= 0 &&
-      self->output_dest.buffer_used < sizeof (self->output_dest.buffer) &&
+      !bridge_fd_buffer_is_full (&self->output_dest) &&
       self->output_dest.read_source == NULL)
     {
       trace ("Output buffer not full, scheduling read from ptmx");
@@ -1241,3 +1408,25 @@ _srt_pty_bridge_close_terminal_fd (SrtPtyBridge *self)
 {
   glnx_close_fd (&self->terminal_fd);
 }
+
+/*
+ * _srt_pty_bridge_get_counters:
+ * @self: the bridge
+ * @counters: (out caller-allocates): used to return the number of bytes
+ *  that have passed through the bridge so far
+ *
+ * Can only be called from a thread that owns the main-context
+ * where the bridge was constructed.
+ */
+void
+_srt_pty_bridge_get_counters (SrtPtyBridge *self,
+                              SrtPtyBridgeCounters *counters)
+{
+  g_return_if_fail (SRT_IS_PTY_BRIDGE (self));
+  g_return_if_fail (counters != NULL);
+
+  counters->input_bytes = self->input_source.bytes_transferred;
+  counters->input_bytes_spliced = self->input_source.bytes_spliced;
+  counters->output_bytes = self->output_dest.bytes_transferred;
+  counters->output_bytes_spliced = self->output_dest.bytes_spliced;
+}
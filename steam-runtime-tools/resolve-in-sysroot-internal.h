@@ -148,3 +148,6 @@ int _srt_resolve_in_sysroot (int sysroot,
                              SrtResolveFlags flags,
                              gchar **real_path_out,
                              GError **error) G_GNUC_WARN_UNUSED_RESULT;
+
+G_GNUC_INTERNAL
+void _srt_resolve_in_sysroot_set_use_openat2 (gboolean use_openat2);
@@ -26,6 +26,7 @@
 #include "libglnx.h"
 
 #include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/missing-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
 
 /* Enabling debug logging for this is rather too verbose, so only
@@ -228,6 +229,259 @@ check_fd_is_regular_file (const char *path,
   return TRUE;
 }
 
+/*
+ * Apply the checks and conversions requested by @flags to `*fdp`,
+ * an `O_PATH` file descriptor that was opened on @current_path relative
+ * to the sysroot, and return the resulting file descriptor.
+ */
+static int
+resolve_in_sysroot_finish (int *fdp,
+                           GString *current_path,
+                           SrtResolveFlags flags,
+                           gchar **real_path_out,
+                           GError **error)
+{
+  g_autofree char *proc_fd_name = NULL;
+
+  /* Avoid returning an empty path */
+  if (flags & SRT_RESOLVE_FLAGS_RETURN_ABSOLUTE)
+    g_string_prepend_c (current_path, '/');
+  else if (current_path->len == 0)
+    g_string_append_c (current_path, '.');
+
+  if ((flags & SRT_RESOLVE_FLAGS_MUST_BE_REGULAR) != 0
+      && !check_fd_is_regular_file (current_path->str, *fdp, error))
+    return -1;
+
+  if (flags & (SRT_RESOLVE_FLAGS_READABLE
+               | SRT_RESOLVE_FLAGS_MUST_BE_EXECUTABLE))
+    proc_fd_name = g_strdup_printf ("/proc/self/fd/%d", *fdp);
+
+  if (flags & SRT_RESOLVE_FLAGS_MUST_BE_EXECUTABLE)
+    {
+      /* faccessat doesn't support AT_EMPTY_PATH, so we have to use this
+       * instead. */
+      g_assert (proc_fd_name != NULL);
+
+      if (access (proc_fd_name, X_OK) != 0)
+        {
+          glnx_throw_errno_prefix (error, "\"%s\" is not executable",
+                                   current_path->str);
+          return -1;
+        }
+    }
+
+  if (flags & SRT_RESOLVE_FLAGS_READABLE)
+    {
+      glnx_autofd int fd = -1;
+
+      g_assert (proc_fd_name != NULL);
+
+      if (flags & SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY)
+        {
+          if (!glnx_opendirat (-1, proc_fd_name, TRUE, &fd, error))
+            {
+              g_prefix_error (error, "Unable to open \"%s\" as directory: ",
+                              current_path->str);
+              return -1;
+            }
+        }
+      else
+        {
+          if (!glnx_openat_rdonly (-1, proc_fd_name, TRUE, &fd, error))
+            {
+              g_prefix_error (error, "Unable to open \"%s\": ",
+                              current_path->str);
+              return -1;
+            }
+        }
+
+      if (real_path_out != NULL)
+        *real_path_out = g_strdup (current_path->str);
+
+      return g_steal_fd (&fd);
+    }
+
+  if (real_path_out != NULL)
+    *real_path_out = g_strdup (current_path->str);
+
+  return g_steal_fd (fdp);
+}
+
+/*
+ * Return the path to @fd as seen from the root of this process's
+ * filesystem namespace, or %NULL if it cannot be determined reliably.
+ */
+static gchar *
+dup_fd_path (int fd)
+{
+  char proc_fd_name[64];
+  g_autofree gchar *path = NULL;
+
+  g_snprintf (proc_fd_name, sizeof (proc_fd_name), "/proc/self/fd/%d", fd);
+  path = glnx_readlinkat_malloc (AT_FDCWD, proc_fd_name, NULL, NULL);
+
+  /* Anything other than an absolute path means the file is not
+   * reachable from our root, and " (deleted)" is ambiguous */
+  if (path == NULL
+      || path[0] != '/'
+      || g_str_has_suffix (path, " (deleted)"))
+    return NULL;
+
+  return g_steal_pointer (&path);
+}
+
+/* Set to TRUE by _srt_resolve_in_sysroot_set_use_openat2() */
+static gint openat2_disabled = FALSE;
+
+/*
+ * _srt_resolve_in_sysroot_set_use_openat2:
+ * @use_openat2: %FALSE to always resolve one component at a time
+ *
+ * Control whether _srt_resolve_in_sysroot() tries openat2() first.
+ * This is only intended for unit tests, so that they can exercise the
+ * fallback path on kernels where openat2() works.
+ */
+void
+_srt_resolve_in_sysroot_set_use_openat2 (gboolean use_openat2)
+{
+  g_atomic_int_set (&openat2_disabled, !use_openat2);
+}
+
+/*
+ * Try to resolve @descendant in @sysroot with a single openat2() call,
+ * which has the same semantics as the component-by-component resolution
+ * in _srt_resolve_in_sysroot() if we ask the kernel to treat
+ * @sysroot as the root (Linux 5.6+).
+ *
+ * If @current_path is not %NULL, set it to the resolved path, relative
+ * to @sysroot.
+ *
+ * Returns: An `O_PATH` file descriptor, or -1 with @error set on
+ *  failure, or -1 with @error unset if the caller should fall back to
+ *  resolving one component at a time
+ */
+static int
+resolve_in_sysroot_openat2 (int sysroot,
+                            const char *descendant,
+                            SrtResolveFlags flags,
+                            GString *current_path,
+                            GError **error)
+{
+  /* Set to TRUE when we find that openat2() is unsupported */
+  static gint unsupported = FALSE;
+  SrtOpenHow how = {};
+  glnx_autofd int fd = -1;
+
+  if (g_atomic_int_get (&unsupported) || g_atomic_int_get (&openat2_disabled))
+    return -1;
+
+  if (flags & SRT_RESOLVE_FLAGS_REJECT_SYMLINKS)
+    return -1;
+
+  how.flags = O_CLOEXEC | O_PATH;
+  /* Treat symlinks to /proc/self/fd/N and similar as an error, so that
+   * we fall back to interpreting their targets as paths in @sysroot */
+  how.resolve = RESOLVE_IN_ROOT | RESOLVE_NO_MAGICLINKS;
+
+  if (flags & SRT_RESOLVE_FLAGS_KEEP_FINAL_SYMLINK)
+    how.flags |= O_NOFOLLOW;
+
+  if (descendant[0] == '\0')
+    descendant = ".";
+
+  fd = TEMP_FAILURE_RETRY ((int) syscall (__NR_openat2, sysroot, descendant,
+                                          &how, sizeof (how)));
+
+  if (fd < 0)
+    {
+      int saved_errno = errno;
+
+      switch (saved_errno)
+        {
+          case ENOSYS:
+          case EPERM:
+            /* EPERM might be a seccomp filter that doesn't know about it */
+            g_debug ("openat2() not supported, will fall back: %s",
+                     g_strerror (saved_errno));
+            g_atomic_int_set (&unsupported, TRUE);
+            return -1;
+
+          case ENOENT:
+          case ENOTDIR:
+            /* With MKDIR_P, the slow path will create it */
+            if (saved_errno == ENOENT && (flags & SRT_RESOLVE_FLAGS_MKDIR_P))
+              return -1;
+
+            errno = saved_errno;
+            glnx_throw_errno_prefix (error, "Unable to open \"%s\"",
+                                     descendant);
+            return -1;
+
+          default:
+            /* For example ELOOP (maybe a magic link), EXDEV or EAGAIN
+             * (a concurrent rename or mount): let the slow path deal
+             * with it */
+            trace ("openat2 \"%s\": %s", descendant, g_strerror (saved_errno));
+            return -1;
+        }
+    }
+
+  if (flags & SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY)
+    {
+      struct stat stat_buf;
+
+      if (!glnx_fstatat (fd, "", &stat_buf, AT_EMPTY_PATH, error))
+        {
+          g_prefix_error (error,
+                          "Unable to determine whether \"%s\" "
+                          "is a directory",
+                          descendant);
+          return -1;
+        }
+
+      if (!S_ISDIR (stat_buf.st_mode))
+        {
+          g_set_error (error, G_IO_ERROR, G_IO_ERROR_NOT_DIRECTORY,
+                       "\"%s\" is not a directory (type 0o%o)",
+                       descendant, stat_buf.st_mode & S_IFMT);
+          return -1;
+        }
+    }
+
+  if (current_path != NULL)
+    {
+      g_autofree gchar *root_path = dup_fd_path (sysroot);
+      g_autofree gchar *path = dup_fd_path (fd);
+      const char *rel = NULL;
+
+      if (root_path != NULL && path != NULL)
+        {
+          if (strcmp (root_path, "/") == 0)
+            rel = path;
+          else if (g_str_has_prefix (path, root_path))
+            rel = path + strlen (root_path);
+
+          /* Don't match /sysroot-other when looking for /sysroot */
+          if (rel != NULL && rel[0] != '\0' && rel[0] != '/')
+            rel = NULL;
+        }
+
+      if (rel == NULL)
+        {
+          trace ("Unable to find \"%s\" relative to \"%s\"", path, root_path);
+          return -1;
+        }
+
+      while (rel[0] == '/')
+        rel++;
+
+      g_string_assign (current_path, rel);
+    }
+
+  return g_steal_fd (&fd);
+}
+
 /*
  * _srt_resolve_in_sysroot:
  * @sysroot: (transfer none): A file descriptor representing the root
@@ -275,7 +529,7 @@ _srt_resolve_in_sysroot (int sysroot,
   /* @buffer contains parts of @descendant. We edit it in-place to replace
    * each directory separator we have dealt with by \0. */
   g_autofree gchar *buffer = g_strdup (descendant);
-  g_autofree char *proc_fd_name = NULL;
+  glnx_autofd int result_fd = -1;
   /* @remaining points to the remaining path to traverse. For example,
    * if we are trying to resolve a/b/c/d, we have already opened a, and we
    * will open b next, then @buffer contains "a\0b/c" and remaining
@@ -295,6 +549,41 @@ _srt_resolve_in_sysroot (int sysroot,
                                             | SRT_RESOLVE_FLAGS_MUST_BE_REGULAR),
                         -1);
 
+  if (flags & SRT_RESOLVE_FLAGS_MKDIR_P)
+    flags |= SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY;
+
+    {
+      g_autoptr(GError) local_error = NULL;
+
+      result_fd = resolve_in_sysroot_openat2 (sysroot, descendant, flags,
+                                              real_path_out != NULL ? current_path : NULL,
+                                              &local_error);
+
+      if (local_error != NULL)
+        {
+          g_propagate_error (error, g_steal_pointer (&local_error));
+          return -1;
+        }
+
+      if (result_fd >= 0)
+        {
+          /* If the caller didn't ask for the real path, this is only
+           * used in error messages */
+          if (real_path_out == NULL)
+            {
+              const char *p = descendant;
+
+              while (p[0] == '/')
+                p++;
+
+              g_string_assign (current_path, p);
+            }
+
+          return resolve_in_sysroot_finish (&result_fd, current_path, flags,
+                                            real_path_out, error);
+        }
+    }
+
     {
       glnx_autofd int fd = -1;
 
@@ -312,9 +601,6 @@ _srt_resolve_in_sysroot (int sysroot,
       fd_array_take (fds, &fd);
     }
 
-  if (flags & SRT_RESOLVE_FLAGS_MKDIR_P)
-    flags |= SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY;
-
   remaining = buffer;
 
   while (remaining != NULL)
@@ -488,76 +774,13 @@ _srt_resolve_in_sysroot (int sysroot,
         }
     }
 
-  /* Avoid returning an empty path */
-  if (flags & SRT_RESOLVE_FLAGS_RETURN_ABSOLUTE)
-    g_string_prepend_c (current_path, '/');
-  else if (current_path->len == 0)
-    g_string_append_c (current_path, '.');
-
-  if ((flags & SRT_RESOLVE_FLAGS_MUST_BE_REGULAR) != 0
-      && !check_fd_is_regular_file (current_path->str,
-                                    g_array_index (fds, int, fds->len - 1),
-                                    error))
-    return -1;
-
-  if (flags & (SRT_RESOLVE_FLAGS_READABLE
-               | SRT_RESOLVE_FLAGS_MUST_BE_EXECUTABLE))
-    proc_fd_name = g_strdup_printf ("/proc/self/fd/%d",
-                                    g_array_index (fds, int, fds->len - 1));
-
-  if (flags & SRT_RESOLVE_FLAGS_MUST_BE_EXECUTABLE)
-    {
-      /* faccessat doesn't support AT_EMPTY_PATH, so we have to use this
-       * instead. */
-      g_assert (proc_fd_name != NULL);
-
-      if (access (proc_fd_name, X_OK) != 0)
-        {
-          glnx_throw_errno_prefix (error, "\"%s\" is not executable",
-                                   current_path->str);
-          return -1;
-        }
-    }
-
-  if (flags & SRT_RESOLVE_FLAGS_READABLE)
-    {
-      glnx_autofd int fd = -1;
-
-      g_assert (proc_fd_name != NULL);
-
-      if (flags & SRT_RESOLVE_FLAGS_MUST_BE_DIRECTORY)
-        {
-          if (!glnx_opendirat (-1, proc_fd_name, TRUE, &fd, error))
-            {
-              g_prefix_error (error, "Unable to open \"%s\" as directory: ",
-                              current_path->str);
-              return -1;
-            }
-        }
-      else
-        {
-          if (!glnx_openat_rdonly (-1, proc_fd_name, TRUE, &fd, error))
-            {
-              g_prefix_error (error, "Unable to open \"%s\": ",
-                              current_path->str);
-              return -1;
-            }
-        }
-
-      if (real_path_out != NULL)
-        *real_path_out = g_string_free (g_steal_pointer (&current_path), FALSE);
-
-      return g_steal_fd (&fd);
-    }
-
-  if (real_path_out != NULL)
-    *real_path_out = g_string_free (g_steal_pointer (&current_path), FALSE);
-
   /* Taking the address might look like nonsense here, but it's
    * documented to work: g_array_index expands to fds->data[some_offset].
    * We need to steal ownership of the fd back from @fds so it won't be
    * closed with the rest of them when @fds is freed. */
-  return g_steal_fd (&g_array_index (fds, int, fds->len - 1));
+  result_fd = g_steal_fd (&g_array_index (fds, int, fds->len - 1));
+  return resolve_in_sysroot_finish (&result_fd, current_path, flags,
+                                    real_path_out, error);
 }
 
 int
@@ -108,3 +108,24 @@ SrtCompletedSubprocess *_srt_subprocess_runner_run_sync (SrtSubprocessRunner *se
                                                          SrtSubprocessOutput stdout_mode,
                                                          SrtSubprocessOutput stderr_mode,
                                                          GError **error);
+SrtCompletedSubprocess *_srt_subprocess_runner_run_sync_full (SrtSubprocessRunner *self,
+                                                              SrtHelperFlags flags,
+                                                              guint timeout_scale,
+                                                              const char * const *argv,
+                                                              SrtSubprocessOutput stdout_mode,
+                                                              SrtSubprocessOutput stderr_mode,
+                                                              GCancellable *cancellable,
+                                                              GError **error);
+void _srt_subprocess_runner_set_max_in_flight (SrtSubprocessRunner *self,
+                                               guint max_in_flight);
+void _srt_subprocess_runner_run_async (SrtSubprocessRunner *self,
+                                       SrtHelperFlags flags,
+                                       const char * const *argv,
+                                       SrtSubprocessOutput stdout_mode,
+                                       SrtSubprocessOutput stderr_mode,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+SrtCompletedSubprocess *_srt_subprocess_runner_run_finish (SrtSubprocessRunner *self,
+                                                           GAsyncResult *result,
+                                                           GError **error);
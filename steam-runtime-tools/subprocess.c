@@ -6,6 +6,7 @@
 #include "steam-runtime-tools/subprocess-internal.h"
 
 #include "steam-runtime-tools/enums.h"
+#include "steam-runtime-tools/missing-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
 
 /* Enabling debug logging for this is rather too verbose, so only
@@ -234,6 +235,8 @@ typedef struct
   GString *err;
   GError *error;
   GMainContext *completing_context;
+  GCancellable *cancellable;
+  GSource *cancel_source;
   GSource *sigterm_source;
   GSource *sigkill_source;
   SrtHelperFlags flags;
@@ -247,6 +250,7 @@ typedef struct
   int stderr_fd;
   unsigned can_use_waitid : 1;
   unsigned timed_out : 1;
+  unsigned cancelled : 1;
   unsigned waiting_in_thread : 1;
 } SrtSubprocess;
 
@@ -270,6 +274,12 @@ static void
 _srt_subprocess_clear (SrtSubprocess *self)
 {
   _srt_subprocess_cancel_timeout (self);
+
+  if (self->cancel_source != NULL)
+    g_source_destroy (self->cancel_source);
+
+  g_clear_pointer (&self->cancel_source, g_source_unref);
+  g_clear_object (&self->cancellable);
   glnx_close_fd (&self->stdout_fd);
   glnx_close_fd (&self->stderr_fd);
   gstring_free0 (self->out);
@@ -514,6 +524,29 @@ _srt_subprocess_schedule_sigterm (SrtSubprocess *self)
   g_source_attach (self->sigterm_source, self->completing_context);
 }
 
+static gboolean
+_srt_subprocess_cancelled_cb (GCancellable *cancellable,
+                              void *user_data)
+{
+  SrtSubprocess *self = user_data;
+
+  trace ("Process %d cancelled", self->pid);
+
+  self->cancelled = 1;
+  g_clear_pointer (&self->cancel_source, g_source_unref);
+
+  /* The helpers we run are diagnostic tools with nothing to clean up,
+   * so there is no need to give them a chance to exit gracefully */
+  if (self->pid > 0)
+    {
+      g_debug ("Process %d cancelled, sending SIGKILL", self->pid);
+      kill (self->pid, SIGKILL);
+      kill (self->pid, SIGCONT);
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
 static gboolean
 _srt_subprocess_poll_cb (void *user_data)
 {
@@ -532,6 +565,67 @@ _srt_subprocess_poll_cb (void *user_data)
     }
 }
 
+/*
+ * Return a file descriptor that becomes readable when @pid exits,
+ * or -1 if not supported (before Linux 5.3).
+ */
+static int
+_srt_subprocess_pidfd_open (GPid pid)
+{
+  /* Set to TRUE when we find that pidfd_open() is unsupported */
+  static gint unsupported = FALSE;
+  int fd;
+
+  if (g_atomic_int_get (&unsupported))
+    return -1;
+
+  fd = (int) syscall (__NR_pidfd_open, pid, 0);
+
+  if (fd < 0)
+    {
+      int saved_errno = errno;
+
+      if (saved_errno == ENOSYS || saved_errno == EPERM)
+        {
+          /* EPERM might be a seccomp filter that doesn't know about it */
+          g_debug ("pidfd_open() not supported, will fall back: %s",
+                   g_strerror (saved_errno));
+          g_atomic_int_set (&unsupported, TRUE);
+        }
+      else
+        {
+          g_debug ("pidfd_open(%d) failed: %s", pid, g_strerror (saved_errno));
+        }
+    }
+
+  return fd;
+}
+
+static gboolean
+_srt_subprocess_pidfd_cb (int fd,
+                          GIOCondition condition,
+                          void *user_data)
+{
+  SrtSubprocess *self = user_data;
+
+  trace ("Notified by pidfd that process %d has exited", self->pid);
+
+  _srt_subprocess_cancel_timeout (self);
+  /* The process has already exited, so this won't block */
+  _srt_subprocess_waitpid (self, 0);
+
+  if (self->pid != 0)
+    {
+      g_warning ("Failed to get exit status of process %d: %s",
+                 self->pid, g_strerror (errno));
+      self->wait_status = -1;
+      /* We can't expect that waiting for it again will work any better. */
+      self->pid = 0;
+    }
+
+  return G_SOURCE_REMOVE;
+}
+
 typedef struct
 {
   /* Thread safety: ownership is transferred to the thread pool when
@@ -621,11 +715,25 @@ _srt_subprocess_complete_sync (SrtSubprocess *self)
       else if (self->sigkill_seconds > 0)
         _srt_subprocess_schedule_sigkill (self);
 
+      if (self->cancellable != NULL)
+        {
+          self->cancel_source = g_cancellable_source_new (self->cancellable);
+          g_source_set_callback (self->cancel_source,
+                                 G_SOURCE_FUNC (_srt_subprocess_cancelled_cb),
+                                 self, NULL);
+          g_source_set_name (self->cancel_source, "kill cancelled child");
+          g_source_attach (self->cancel_source, self->completing_context);
+        }
+
       _srt_subprocess_read_pipes (self);
 
-      if (self->flags & SRT_HELPER_FLAGS_TIME_OUT)
+      /* If we can be cancelled, we need to keep iterating the main
+       * context while we wait, the same as if there was a timeout */
+      if ((self->flags & SRT_HELPER_FLAGS_TIME_OUT)
+          || self->cancellable != NULL)
         {
           g_autoptr(GSource) tick_source = NULL;
+          glnx_autofd int pidfd = -1;
 
           /* Opportunistically check whether the process already exited:
            * if it has, there's no need to go to the expense of creating a
@@ -635,7 +743,28 @@ _srt_subprocess_complete_sync (SrtSubprocess *self)
           if (self->pid == 0)
             goto out;
 
-          if (self->can_use_waitid)
+          pidfd = _srt_subprocess_pidfd_open (self->pid);
+
+          if (pidfd >= 0)
+            {
+              g_autoptr(GSource) pidfd_source = NULL;
+
+              /* The process exiting and the timeouts are all dispatched
+               * from the same main context, with no extra thread and
+               * no polling interval. */
+              pidfd_source = g_unix_fd_source_new (pidfd, G_IO_IN);
+              g_source_set_callback (pidfd_source,
+                                     G_SOURCE_FUNC (_srt_subprocess_pidfd_cb),
+                                     self, NULL);
+              g_source_set_name (pidfd_source, "wait for child process");
+              g_source_attach (pidfd_source, self->completing_context);
+
+              while (self->pid != 0)
+                g_main_context_iteration (self->completing_context, TRUE);
+
+              g_source_destroy (pidfd_source);
+            }
+          else if (self->can_use_waitid)
             {
               GThread *thread;
               WaitidInThread thread_data =
@@ -680,6 +809,10 @@ _srt_subprocess_complete_sync (SrtSubprocess *self)
         }
     }
 out:
+  if (self->cancel_source != NULL)
+    g_source_destroy (self->cancel_source);
+
+  g_clear_pointer (&self->cancel_source, g_source_unref);
   g_main_context_pop_thread_default (self->completing_context);
 }
 
@@ -714,6 +847,13 @@ struct _SrtSubprocessRunner
    * or the installed helpers */
   gchar *helpers_path;
   SrtTestFlags test_flags;
+  /* Protects @jobs and @max_in_flight */
+  GMutex lock;
+  /* Runs jobs queued by _srt_subprocess_runner_run_async(), or %NULL
+   * if not yet needed */
+  GThreadPool *jobs;
+  /* Maximum number of jobs to run at the same time, or 0 for automatic */
+  guint max_in_flight;
   unsigned can_use_waitid : 1;
 };
 
@@ -739,6 +879,7 @@ static GParamSpec *properties[N_PROPERTIES] = { NULL };
 static void
 _srt_subprocess_runner_init (SrtSubprocessRunner *self)
 {
+  g_mutex_init (&self->lock);
 }
 
 static void
@@ -845,6 +986,12 @@ _srt_subprocess_runner_finalize (GObject *object)
 {
   SrtSubprocessRunner *self = SRT_SUBPROCESS_RUNNER (object);
 
+  /* Each queued job holds a reference to @self, so the pool is idle.
+   * Don't wait for it: we might be running in one of its threads. */
+  if (self->jobs != NULL)
+    g_thread_pool_free (g_steal_pointer (&self->jobs), FALSE, FALSE);
+
+  g_mutex_clear (&self->lock);
   g_strfreev (self->envp);
   g_free (self->bin_path);
   g_free (self->helpers_path);
@@ -1072,9 +1219,11 @@ _srt_subprocess_runner_get_helper (SrtSubprocessRunner *self,
 static gboolean
 _srt_subprocess_runner_spawn (SrtSubprocessRunner *self,
                               SrtHelperFlags flags,
+                              guint timeout_scale,
                               const char * const *argv,
                               SrtSubprocessOutput stdout_mode,
                               SrtSubprocessOutput stderr_mode,
+                              GCancellable *cancellable,
                               SrtSubprocess *subprocess,
                               GError **error)
 {
@@ -1114,6 +1263,8 @@ _srt_subprocess_runner_spawn (SrtSubprocessRunner *self,
           sigterm_seconds = 10;
           sigkill_seconds = 3;
         }
+
+      sigterm_seconds *= MAX (timeout_scale, 1);
     }
 
   subprocess->flags = flags;
@@ -1123,6 +1274,9 @@ _srt_subprocess_runner_spawn (SrtSubprocessRunner *self,
   subprocess->sigkill_seconds = sigkill_seconds;
   subprocess->can_use_waitid = self->can_use_waitid;
 
+  if (cancellable != NULL)
+    subprocess->cancellable = g_object_ref (cancellable);
+
   switch (stdout_mode)
     {
       case SRT_SUBPROCESS_OUTPUT_CAPTURE:
@@ -1181,12 +1335,52 @@ _srt_subprocess_runner_run_sync (SrtSubprocessRunner *self,
                                  SrtSubprocessOutput stdout_mode,
                                  SrtSubprocessOutput stderr_mode,
                                  GError **error)
+{
+  return _srt_subprocess_runner_run_sync_full (self, flags, 1, argv,
+                                               stdout_mode, stderr_mode,
+                                               NULL, error);
+}
+
+/*
+ * _srt_subprocess_runner_run_sync_full:
+ * @self: The subprocess runner
+ * @flags: Flags affecting how the subprocess is run
+ * @timeout_scale: If @flags contains %SRT_HELPER_FLAGS_TIME_OUT,
+ *  multiply the time allowed before sending SIGTERM by this factor.
+ *  This is useful for helpers that carry out several tasks, each of
+ *  which would normally be given the usual time limit.
+ * @argv: (array zero-terminated=1): Arguments
+ * @stdout_mode: What to do with standard output
+ * @stderr_mode: What to do with standard error
+ * @cancellable: (nullable): If cancelled, the subprocess is not started,
+ *  or is killed if it was already running
+ * @error: Used to raise an error if %NULL is returned
+ *
+ * Same as _srt_subprocess_runner_run_sync(), but with a longer
+ * time limit and the possibility of cancellation. If cancelled,
+ * %G_IO_ERROR_CANCELLED is raised.
+ *
+ * Returns: (transfer full): The completed subprocess, or %NULL on error
+ */
+SrtCompletedSubprocess *
+_srt_subprocess_runner_run_sync_full (SrtSubprocessRunner *self,
+                                      SrtHelperFlags flags,
+                                      guint timeout_scale,
+                                      const char * const *argv,
+                                      SrtSubprocessOutput stdout_mode,
+                                      SrtSubprocessOutput stderr_mode,
+                                      GCancellable *cancellable,
+                                      GError **error)
 {
   g_auto(SrtSubprocess) subprocess = SRT_SUBPROCESS_INIT;
 
+  if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    return NULL;
+
   if (!_srt_subprocess_runner_spawn (self,
-                                     flags, argv, stdout_mode, stderr_mode,
-                                     &subprocess, error))
+                                     flags, timeout_scale, argv,
+                                     stdout_mode, stderr_mode,
+                                     cancellable, &subprocess, error))
     return NULL;
 
   _srt_subprocess_complete_sync (&subprocess);
@@ -1194,5 +1388,193 @@ _srt_subprocess_runner_run_sync (SrtSubprocessRunner *self,
   if (!_srt_subprocess_check_no_error (&subprocess, error))
     return NULL;
 
+  if (subprocess.cancelled)
+    {
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                   "Subprocess %s was cancelled", argv[0]);
+      return NULL;
+    }
+
   return _srt_completed_subprocess_new_from_subprocess (&subprocess);
 }
+
+typedef struct
+{
+  GStrv argv;
+  SrtHelperFlags flags;
+  SrtSubprocessOutput stdout_mode;
+  SrtSubprocessOutput stderr_mode;
+} RunJob;
+
+static void
+run_job_free (void *p)
+{
+  RunJob *self = p;
+
+  g_strfreev (self->argv);
+  g_free (self);
+}
+
+/*
+ * GFunc for self->jobs.
+ * Called in a worker thread, be careful with thread safety.
+ */
+static void
+_srt_subprocess_runner_job_cb (gpointer data,
+                               gpointer user_data)
+{
+  g_autoptr(GTask) task = data;
+  g_autoptr(GError) error = NULL;
+  SrtSubprocessRunner *self = g_task_get_source_object (task);
+  RunJob *job = g_task_get_task_data (task);
+  SrtCompletedSubprocess *completed;
+
+  if (g_task_return_error_if_cancelled (task))
+    return;
+
+  completed = _srt_subprocess_runner_run_sync_full (self,
+                                                    job->flags,
+                                                    1,
+                                                    (const char * const *) job->argv,
+                                                    job->stdout_mode,
+                                                    job->stderr_mode,
+                                                    g_task_get_cancellable (task),
+                                                    &error);
+
+  if (completed == NULL)
+    g_task_return_error (task, g_steal_pointer (&error));
+  else
+    g_task_return_pointer (task, completed, g_object_unref);
+}
+
+static guint
+_srt_subprocess_runner_get_max_threads (SrtSubprocessRunner *self)
+{
+  if (self->max_in_flight > 0)
+    return self->max_in_flight;
+
+  return MAX (g_get_num_processors (), 1);
+}
+
+/*
+ * _srt_subprocess_runner_set_max_in_flight:
+ * @self: The subprocess runner
+ * @max_in_flight: The maximum number of subprocesses started by
+ *  _srt_subprocess_runner_run_async() that can run at the same time,
+ *  or 0 to use the number of processors
+ */
+void
+_srt_subprocess_runner_set_max_in_flight (SrtSubprocessRunner *self,
+                                          guint max_in_flight)
+{
+  g_return_if_fail (SRT_IS_SUBPROCESS_RUNNER (self));
+
+  g_mutex_lock (&self->lock);
+  self->max_in_flight = max_in_flight;
+
+  if (self->jobs != NULL)
+    g_thread_pool_set_max_threads (self->jobs,
+                                   _srt_subprocess_runner_get_max_threads (self),
+                                   NULL);
+
+  g_mutex_unlock (&self->lock);
+}
+
+/*
+ * _srt_subprocess_runner_run_async:
+ * @self: The subprocess runner
+ * @flags: Flags affecting how the subprocess is run
+ * @argv: (array zero-terminated=1): Arguments, as for
+ *  _srt_subprocess_runner_run_sync()
+ * @stdout_mode: What to do with standard output
+ * @stderr_mode: What to do with standard error
+ * @cancellable: (nullable): If cancelled before the subprocess is
+ *  started, it will not be started; if cancelled while it is running,
+ *  it will be killed. Either way, the result is %G_IO_ERROR_CANCELLED.
+ * @callback: Called in the thread-default main context of the caller
+ *  when the subprocess has finished
+ * @user_data: Passed to @callback
+ *
+ * Queue a subprocess to be run as if by _srt_subprocess_runner_run_sync(),
+ * without blocking the caller. At most the number of subprocesses set by
+ * _srt_subprocess_runner_set_max_in_flight() run at the same time,
+ * and the rest wait for a free slot in the order they were queued.
+ *
+ * If @argv is a helper, the caller should normally have found it with
+ * _srt_subprocess_runner_get_helper() before calling this function.
+ */
+void
+_srt_subprocess_runner_run_async (SrtSubprocessRunner *self,
+                                  SrtHelperFlags flags,
+                                  const char * const *argv,
+                                  SrtSubprocessOutput stdout_mode,
+                                  SrtSubprocessOutput stderr_mode,
+                                  GCancellable *cancellable,
+                                  GAsyncReadyCallback callback,
+                                  gpointer user_data)
+{
+  g_autoptr(GTask) task = NULL;
+  g_autoptr(GError) error = NULL;
+  RunJob *job;
+
+  g_return_if_fail (SRT_IS_SUBPROCESS_RUNNER (self));
+  g_return_if_fail (argv != NULL && argv[0] != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  task = g_task_new (self, cancellable, callback, user_data);
+  g_task_set_source_tag (task, _srt_subprocess_runner_run_async);
+
+  job = g_new0 (RunJob, 1);
+  job->argv = g_strdupv ((gchar **) argv);
+  job->flags = flags;
+  job->stdout_mode = stdout_mode;
+  job->stderr_mode = stderr_mode;
+  g_task_set_task_data (task, job, run_job_free);
+
+  /* Worker threads use this, so make sure it's cached first */
+  _srt_subprocess_runner_resolve_helpers_path (self, NULL);
+
+  g_mutex_lock (&self->lock);
+
+  if (self->jobs == NULL)
+    self->jobs = g_thread_pool_new (_srt_subprocess_runner_job_cb, NULL,
+                                    _srt_subprocess_runner_get_max_threads (self),
+                                    FALSE, &error);
+
+  if (self->jobs != NULL)
+    g_thread_pool_push (self->jobs, g_steal_pointer (&task), NULL);
+
+  g_mutex_unlock (&self->lock);
+
+  /* If we couldn't create a thread pool, just run it here */
+  if (task != NULL)
+    {
+      g_debug ("Unable to run subprocess in background: %s", error->message);
+      _srt_subprocess_runner_job_cb (g_steal_pointer (&task), NULL);
+    }
+}
+
+/*
+ * _srt_subprocess_runner_run_finish:
+ * @self: The subprocess runner
+ * @result: The result passed to the callback
+ * @error: Used to raise an error on failure
+ *
+ * Return the result of _srt_subprocess_runner_run_async().
+ *
+ * Returns: (transfer full): The completed subprocess, or %NULL if it
+ *  could not be started
+ */
+SrtCompletedSubprocess *
+_srt_subprocess_runner_run_finish (SrtSubprocessRunner *self,
+                                   GAsyncResult *result,
+                                   GError **error)
+{
+  g_return_val_if_fail (SRT_IS_SUBPROCESS_RUNNER (self), NULL);
+  g_return_val_if_fail (g_task_is_valid (result, self), NULL);
+  g_return_val_if_fail (g_async_result_is_tagged (result,
+                                                  _srt_subprocess_runner_run_async),
+                        NULL);
+
+  return g_task_propagate_pointer (G_TASK (result), error);
+}
@@ -60,6 +60,18 @@ void _srt_system_info_set_check_flags (SrtSystemInfo *self,
 
 void _srt_system_info_set_sysroot (SrtSystemInfo *self,
                                    SrtSysroot *sysroot);
+void _srt_system_info_set_driver_cache_dir (SrtSystemInfo *self,
+                                            const char *path);
+
+void _srt_system_info_set_max_parallel_checks (SrtSystemInfo *self,
+                                               guint max_parallel);
+void _srt_system_info_check_graphics_for_abis (SrtSystemInfo *self,
+                                               const char * const *multiarch_tuples);
+void _srt_system_info_prefetch_for_abis (SrtSystemInfo *self,
+                                         const char * const *multiarch_tuples,
+                                         GCancellable *cancellable);
+void _srt_system_info_prefetch_locales (SrtSystemInfo *self,
+                                        const char * const *requested_names);
 
 void _srt_system_info_set_subprocess_runner (SrtSystemInfo *self,
                                              SrtSubprocessRunner *runner);
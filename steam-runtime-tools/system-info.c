@@ -102,10 +102,25 @@ typedef enum
   TRI_MAYBE = -1
 } Tristate;
 
+/*
+ * A byte range in the text of a report, or an empty range if there is
+ * nothing left to parse.
+ */
+typedef struct
+{
+  gsize start;
+  gsize end;
+} ReportRange;
+
 typedef struct
 {
   gchar *version;
   gchar *path;
+  /* The report, parts of which are only parsed when first needed */
+  GMappedFile *file;
+  /* Top-level sections that have not been parsed yet */
+  ReportRange egl;
+  ReportRange vulkan;
 } FromReport;
 
 struct _SrtSystemInfo
@@ -192,6 +207,10 @@ struct _SrtSystemInfo
   } cpu_features;
   SrtOsInfo *os_info;
   SrtCheckFlags check_flags;
+  /* If non-%NULL, cache DRI, VA-API and VDPAU drivers here */
+  gchar *driver_cache_dir;
+  /* 0 means choose automatically */
+  guint max_parallel_checks;
   Tristate can_write_uinput;
   /* cached_driver_environment != NULL indicates we have already checked the
    * driver-selection environment variables */
@@ -281,8 +300,14 @@ typedef struct
   gboolean graphics_cache_available;
 
   ModuleList graphics_modules[NUM_SRT_GRAPHICS_MODULES];
+
+  /* Section of the report describing this ABI, if not parsed yet */
+  ReportRange report;
 } Abi;
 
+static void abi_ensure_from_report (SrtSystemInfo *self,
+                                    Abi *abi);
+
 static Abi *
 ensure_abi_unless_immutable (SrtSystemInfo *self,
                              const char *multiarch_tuple)
@@ -299,7 +324,10 @@ ensure_abi_unless_immutable (SrtSystemInfo *self,
       abi = g_ptr_array_index (self->abis, i);
 
       if (abi->multiarch_tuple == quark)
-        return abi;
+        {
+          abi_ensure_from_report (self, abi);
+          return abi;
+        }
     }
 
   if (self->from_report != NULL)
@@ -585,6 +613,7 @@ srt_system_info_finalize (GObject *object)
   g_clear_pointer (&self->abis, g_ptr_array_unref);
   g_clear_pointer (&self->multiarch_tuples, g_array_unref);
   g_free (self->expectations);
+  g_free (self->driver_cache_dir);
   g_clear_pointer (&self->cached_driver_environment, g_strfreev);
 
   if (self->cached_hidden_deps)
@@ -594,6 +623,7 @@ srt_system_info_finalize (GObject *object)
     {
       g_free (self->from_report->version);
       g_free (self->from_report->path);
+      g_clear_pointer (&self->from_report->file, g_mapped_file_unref);
       g_free (self->from_report);
     }
 
@@ -859,52 +889,332 @@ get_libdl_from_report (SrtSystemInfo *self,
     }
 }
 
-/**
- * srt_system_info_new_from_json:
+/*
+ * Parse @range from the report that @from_report was loaded from,
+ * and mark it as no longer needing to be parsed.
+ *
+ * Returns: (transfer full) (nullable): The parsed value, or %NULL
+ *  if @range is empty or cannot be parsed
+ */
+static JsonNode *
+from_report_parse_range (FromReport *from_report,
+                         ReportRange *range,
+                         const char *name)
+{
+  g_autoptr(JsonParser) parser = NULL;
+  g_autoptr(GError) error = NULL;
+  const char *data;
+  JsonNode *node;
+
+  if (range->end <= range->start)
+    return NULL;
+
+  g_debug ("Parsing \"%s\" from report", name);
+  data = g_mapped_file_get_contents (from_report->file);
+  parser = json_parser_new ();
+
+  if (!json_parser_load_from_data (parser, data + range->start,
+                                   range->end - range->start, &error))
+    {
+      g_warning ("Unable to parse \"%s\" from report: %s",
+                 name, error->message);
+      node = NULL;
+    }
+  else
+    {
+      node = json_parser_get_root (parser);
+
+      if (node != NULL)
+        node = json_node_copy (node);
+    }
+
+  range->start = range->end = 0;
+  return node;
+}
+
+/*
+ * Parse the top-level section @name of the report that @from_report
+ * was loaded from, if not already done.
+ *
+ * Returns: (transfer full): A JSON object with @name as its only member,
+ *  or with no members if the section was missing or invalid, suitable
+ *  for passing to functions that look up @name in the top-level object
+ */
+static JsonObject *
+from_report_parse_section (FromReport *from_report,
+                           ReportRange *range,
+                           const char *name)
+{
+  JsonObject *json_obj = json_object_new ();
+  JsonNode *node;
+
+  node = from_report_parse_range (from_report, range, name);
+
+  if (node != NULL)
+    json_object_set_member (json_obj, name, node);
+
+  return json_obj;
+}
+
+/*
+ * Fill in @abi from its section in a report.
+ */
+static void
+get_abi_from_report (SrtSystemInfo *info,
+                     Abi *abi,
+                     JsonObject *json_arch_obj)
+{
+  const char *multiarch_tuple = g_quark_to_string (abi->multiarch_tuple);
+  SrtOpenXr1Runtime *xr_rt;
+
+  abi->can_run = _srt_architecture_can_run_from_report (json_arch_obj);
+
+  get_libdl_from_report (info, abi, json_arch_obj);
+
+  abi->libraries_cache_available = TRUE;
+  abi->cached_combined_issues = _srt_library_get_issues_from_report (json_arch_obj);
+
+  get_runtime_linker_from_report (info, abi, json_arch_obj);
+
+  _srt_graphics_get_from_report (json_arch_obj,
+                                 multiarch_tuple,
+                                 &abi->cached_graphics_results);
+
+  abi->graphics_modules[SRT_GRAPHICS_DRI_MODULE].modules = _srt_dri_driver_get_from_report (json_arch_obj);
+  abi->graphics_modules[SRT_GRAPHICS_DRI_MODULE].available = TRUE;
+
+  abi->graphics_modules[SRT_GRAPHICS_VAAPI_MODULE].modules = _srt_va_api_driver_get_from_report (json_arch_obj);
+  abi->graphics_modules[SRT_GRAPHICS_VAAPI_MODULE].available = TRUE;
+
+  abi->graphics_modules[SRT_GRAPHICS_VDPAU_MODULE].modules = _srt_vdpau_driver_get_from_report (json_arch_obj);
+  abi->graphics_modules[SRT_GRAPHICS_VDPAU_MODULE].available = TRUE;
+
+  abi->graphics_modules[SRT_GRAPHICS_GLX_MODULE].modules = _srt_glx_icd_get_from_report (json_arch_obj);
+  abi->graphics_modules[SRT_GRAPHICS_GLX_MODULE].available = TRUE;
+
+  xr_rt = _srt_openxr_1_runtime_get_active_from_abi_report (json_arch_obj);
+  if (xr_rt != NULL)
+      g_hash_table_insert (info->openxr_1_runtimes.active,
+                           g_strdup (multiarch_tuple), xr_rt);
+}
+
+/*
+ * If @self was loaded from a report and the section describing @abi
+ * has not been parsed yet, parse it now.
+ */
+static void
+abi_ensure_from_report (SrtSystemInfo *self,
+                        Abi *abi)
+{
+  g_autoptr(JsonNode) node = NULL;
+  g_autoptr(JsonObject) empty = NULL;
+  const char *multiarch_tuple = g_quark_to_string (abi->multiarch_tuple);
+
+  if (self->from_report == NULL || abi->report.end <= abi->report.start)
+    return;
+
+  node = from_report_parse_range (self->from_report, &abi->report,
+                                  multiarch_tuple);
+
+  if (node != NULL && JSON_NODE_HOLDS_OBJECT (node))
+    {
+      get_abi_from_report (self, abi, json_node_get_object (node));
+      return;
+    }
+
+  if (node != NULL)
+    g_warning ("Expected \"%s\" in report to be a JSON object",
+               multiarch_tuple);
+
+  /* Behave as though the section was empty, so that we don't fall back
+   * to probing the live system for an ABI that came from a report */
+  empty = json_object_new ();
+  get_abi_from_report (self, abi, empty);
+}
+
+/*
+ * If @self was loaded from a report, make sure every ABI in it has
+ * been parsed.
+ */
+static void
+ensure_all_abis_from_report (SrtSystemInfo *self)
+{
+  gsize i;
+
+  for (i = 0; i < self->abis->len; i++)
+    abi_ensure_from_report (self, g_ptr_array_index (self->abis, i));
+}
+
+/*
+ * Fill in the EGL ICDs and external platforms from the top-level
+ * object of a report, or an object containing only its "egl" member.
+ */
+static void
+get_egl_from_report (SrtSystemInfo *self,
+                     JsonObject *json_obj)
+{
+  self->icds.have_egl = TRUE;
+  self->icds.egl = _srt_get_egl_from_json_report (SRT_TYPE_EGL_ICD, json_obj);
+  self->egl_ext_platform.have = TRUE;
+  self->egl_ext_platform.list = _srt_get_egl_from_json_report (SRT_TYPE_EGL_EXTERNAL_PLATFORM,
+                                                               json_obj);
+}
+
+/*
+ * If @self was loaded lazily from a report and its EGL section has not
+ * been parsed yet, parse it now.
+ */
+static void
+ensure_egl_from_report (SrtSystemInfo *self)
+{
+  g_autoptr(JsonObject) json_obj = NULL;
+
+  if (self->from_report == NULL || self->icds.have_egl)
+    return;
+
+  json_obj = from_report_parse_section (self->from_report,
+                                        &self->from_report->egl, "egl");
+  get_egl_from_report (self, json_obj);
+}
+
+/*
+ * Fill in the Vulkan ICDs and layers from the top-level object of a
+ * report, or an object containing only its "vulkan" member.
+ */
+static void
+get_vulkan_from_report (SrtSystemInfo *self,
+                        JsonObject *json_obj)
+{
+  self->icds.have_vulkan = TRUE;
+  self->icds.vulkan = _srt_get_vulkan_from_json_report (json_obj);
+  self->layers.have_vulkan_explicit = TRUE;
+  self->layers.vulkan_explicit = _srt_get_explicit_vulkan_layers_from_json_report (json_obj);
+  self->layers.have_vulkan_implicit = TRUE;
+  self->layers.vulkan_implicit = _srt_get_implicit_vulkan_layers_from_json_report (json_obj);
+}
+
+/*
+ * If @self was loaded lazily from a report and its Vulkan section has
+ * not been parsed yet, parse it now.
+ */
+static void
+ensure_vulkan_from_report (SrtSystemInfo *self)
+{
+  g_autoptr(JsonObject) json_obj = NULL;
+
+  if (self->from_report == NULL || self->icds.have_vulkan)
+    return;
+
+  json_obj = from_report_parse_section (self->from_report,
+                                        &self->from_report->vulkan, "vulkan");
+  get_vulkan_from_report (self, json_obj);
+}
+
+/*
+ * system_info_new_from_json:
  * @path: (not nullable) (type filename): Path to a JSON report
+ * @lazy: If true, only parse the largest sections of the report when
+ *  they are first needed
  * @error: Used to raise an error on failure
  *
- * Return a new #SrtSystemInfo with the info parsed from an existing JSON
- * report.
- * The #SrtSystemInfo will be immutable: whatever information was in the JSON
- * report, that will be the only information that is available.
+ * Implementation of srt_system_info_new_from_json_full().
  *
- * Returns: (transfer full): A new #SrtSystemInfo. Free with g_object_unref()
+ * Returns: (transfer full): A new #SrtSystemInfo
  */
-SrtSystemInfo *
-srt_system_info_new_from_json (const char *path,
-                               GError **error)
+static SrtSystemInfo *
+system_info_new_from_json (const char *path,
+                           gboolean lazy,
+                           GError **error)
 {
   static const char * const no_strings[] = { NULL };
-  SrtSystemInfo *info = NULL;
+  g_autoptr(SrtSystemInfo) info = NULL;
+  g_autoptr(GMappedFile) file = NULL;
+  g_autoptr(GArray) members = NULL;
+  g_autoptr(JsonParser) parser = NULL;
+  const SrtJsonMember *architectures = NULL;
+  const SrtJsonMember *egl = NULL;
+  const SrtJsonMember *vulkan = NULL;
   JsonObject *json_obj = NULL;
   JsonObject *json_sub_obj = NULL;
-  JsonParser *parser = NULL;
   JsonNode *node = NULL;
-
-  g_return_val_if_fail (_srt_check_not_setuid (), NULL);
-  g_return_val_if_fail (path != NULL, NULL);
-  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
+  const char *data = NULL;
+  gsize i;
 
   info = srt_system_info_new (NULL);
   srt_system_info_set_environ (info, (gchar * const *) no_strings);
 
   parser = json_parser_new ();
 
-  if (!json_parser_load_from_file (parser, path, error))
+  if (lazy)
     {
-      g_clear_object (&info);
-      goto out;
+      g_autoptr(GString) eager = NULL;
+      gsize len;
+
+      file = g_mapped_file_new (path, FALSE, error);
+
+      if (file == NULL)
+        return NULL;
+
+      data = g_mapped_file_get_contents (file);
+      len = g_mapped_file_get_length (file);
+
+      /* Find the top-level sections without parsing them, then parse
+       * only the small ones now. */
+      members = _srt_json_scan_object_members (data, len, error);
+
+      if (members == NULL)
+        {
+          g_prefix_error (error, "%s: ", path);
+          return NULL;
+        }
+
+      eager = g_string_new ("{");
+
+      for (i = 0; i < members->len; i++)
+        {
+          const SrtJsonMember *member = &g_array_index (members, SrtJsonMember, i);
+
+          if (strcmp (member->name, "architectures") == 0)
+            {
+              architectures = member;
+            }
+          else if (strcmp (member->name, "egl") == 0)
+            {
+              egl = member;
+            }
+          else if (strcmp (member->name, "vulkan") == 0)
+            {
+              vulkan = member;
+            }
+          else
+            {
+              if (eager->len > 1)
+                g_string_append_c (eager, ',');
+
+              g_string_append_len (eager, data + member->key_start,
+                                   member->end - member->key_start);
+            }
+        }
+
+      g_string_append_c (eager, '}');
+
+      if (!json_parser_load_from_data (parser, eager->str, eager->len, error))
+        {
+          g_prefix_error (error, "%s: ", path);
+          return NULL;
+        }
+    }
+  else if (!json_parser_load_from_file (parser, path, error))
+    {
+      return NULL;
     }
 
   node = json_parser_get_root (parser);
   if (node == NULL || !JSON_NODE_HOLDS_OBJECT (node))
     {
-      if (error)
-        g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
-                    "Expected to find a JSON object in the provided JSON");
-      g_clear_object (&info);
-      goto out;
+      g_set_error (error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                   "Expected to find a JSON object in the provided JSON");
+      return NULL;
     }
 
   json_obj = json_node_get_object (node);
@@ -944,57 +1254,46 @@ srt_system_info_new_from_json (const char *path,
                                           &info->openxr_1_runtimes.active_fallback,
                                           &info->openxr_1_runtimes.inactive);
 
+  if (architectures != NULL)
+    {
+      g_autoptr(GArray) arch_members = NULL;
+
+      arch_members = _srt_json_scan_object_members (data + architectures->start,
+                                                    architectures->end - architectures->start,
+                                                    error);
+
+      if (arch_members == NULL)
+        {
+          g_prefix_error (error, "%s: architectures: ", path);
+          return NULL;
+        }
+
+      /* Only record where each ABI is described: it will be parsed
+       * by ensure_abi_unless_immutable() when first used. */
+      for (i = 0; i < arch_members->len; i++)
+        {
+          const SrtJsonMember *member = &g_array_index (arch_members, SrtJsonMember, i);
+          Abi *abi = ensure_abi_unless_immutable (info, member->name);
 
-  if (json_object_has_member (json_obj, "architectures"))
+          abi->report.start = architectures->start + member->start;
+          abi->report.end = architectures->start + member->end;
+        }
+    }
+  else if (!lazy && json_object_has_member (json_obj, "architectures"))
     {
-      JsonObject *json_arch_obj = NULL;
       /* The list itself is owned, the contents are not */
       g_autoptr(GList) multiarch_tuples = NULL;
 
       json_sub_obj = json_object_get_object_member (json_obj, "architectures");
-
       multiarch_tuples = json_object_get_members (json_sub_obj);
+
       for (GList *l = multiarch_tuples; l != NULL; l = l->next)
         {
-          Abi *abi = NULL;
-          SrtOpenXr1Runtime *xr_rt;
-
-          if (!json_object_has_member (json_sub_obj, l->data))
-            continue;
-
-          json_arch_obj = json_object_get_object_member (json_sub_obj, l->data);
-
-          abi = ensure_abi_unless_immutable (info, l->data);
-
-          abi->can_run = _srt_architecture_can_run_from_report (json_arch_obj);
-
-          get_libdl_from_report (info, abi, json_arch_obj);
-
-          abi->libraries_cache_available = TRUE;
-          abi->cached_combined_issues = _srt_library_get_issues_from_report (json_arch_obj);
-
-          get_runtime_linker_from_report (info, abi, json_arch_obj);
-
-          _srt_graphics_get_from_report (json_arch_obj,
-                                         l->data,
-                                         &abi->cached_graphics_results);
-
-          abi->graphics_modules[SRT_GRAPHICS_DRI_MODULE].modules = _srt_dri_driver_get_from_report (json_arch_obj);
-          abi->graphics_modules[SRT_GRAPHICS_DRI_MODULE].available = TRUE;
+          Abi *abi = ensure_abi_unless_immutable (info, l->data);
 
-          abi->graphics_modules[SRT_GRAPHICS_VAAPI_MODULE].modules = _srt_va_api_driver_get_from_report (json_arch_obj);
-          abi->graphics_modules[SRT_GRAPHICS_VAAPI_MODULE].available = TRUE;
-
-          abi->graphics_modules[SRT_GRAPHICS_VDPAU_MODULE].modules = _srt_vdpau_driver_get_from_report (json_arch_obj);
-          abi->graphics_modules[SRT_GRAPHICS_VDPAU_MODULE].available = TRUE;
-
-          abi->graphics_modules[SRT_GRAPHICS_GLX_MODULE].modules = _srt_glx_icd_get_from_report (json_arch_obj);
-          abi->graphics_modules[SRT_GRAPHICS_GLX_MODULE].available = TRUE;
-
-          xr_rt = _srt_openxr_1_runtime_get_active_from_abi_report (json_arch_obj);
-          if (xr_rt != NULL)
-              g_hash_table_insert (info->openxr_1_runtimes.active,
-                                   g_strdup (l->data), xr_rt);
+          get_abi_from_report (info, abi,
+                               json_object_get_object_member (json_sub_obj,
+                                                              l->data));
         }
     }
 
@@ -1042,20 +1341,6 @@ srt_system_info_new_from_json (const char *path,
         }
     }
 
-  info->icds.have_egl = TRUE;
-  info->icds.egl = _srt_get_egl_from_json_report (SRT_TYPE_EGL_ICD, json_obj);
-  info->egl_ext_platform.have = TRUE;
-  info->egl_ext_platform.list = _srt_get_egl_from_json_report (SRT_TYPE_EGL_EXTERNAL_PLATFORM,
-                                                               json_obj);
-
-  info->icds.have_vulkan = TRUE;
-  info->icds.vulkan = _srt_get_vulkan_from_json_report (json_obj);
-
-  info->layers.have_vulkan_explicit = TRUE;
-  info->layers.vulkan_explicit = _srt_get_explicit_vulkan_layers_from_json_report (json_obj);
-  info->layers.have_vulkan_implicit = TRUE;
-  info->layers.vulkan_implicit = _srt_get_implicit_vulkan_layers_from_json_report (json_obj);
-
   info->desktop_entry.have_data = TRUE;
   info->desktop_entry.values = _srt_get_steam_desktop_entries_from_json_report (json_obj);
 
@@ -1082,11 +1367,84 @@ srt_system_info_new_from_json (const char *path,
       info->from_report->path = g_strdup (s);
     }
 
-out:
-  if (parser != NULL)
-    g_object_unref (parser);
+  info->from_report->file = g_steal_pointer (&file);
+
+  if (egl != NULL)
+    {
+      info->from_report->egl.start = egl->start;
+      info->from_report->egl.end = egl->end;
+    }
+
+  if (vulkan != NULL)
+    {
+      info->from_report->vulkan.start = vulkan->start;
+      info->from_report->vulkan.end = vulkan->end;
+    }
+
+  if (!lazy)
+    {
+      get_egl_from_report (info, json_obj);
+      get_vulkan_from_report (info, json_obj);
+    }
+
+  return g_steal_pointer (&info);
+}
+
+/**
+ * srt_system_info_new_from_json:
+ * @path: (not nullable) (type filename): Path to a JSON report
+ * @error: Used to raise an error on failure
+ *
+ * Return a new #SrtSystemInfo with the info parsed from an existing JSON
+ * report.
+ * The #SrtSystemInfo will be immutable: whatever information was in the JSON
+ * report, that will be the only information that is available.
+ *
+ * This is equivalent to srt_system_info_new_from_json_full() with
+ * %SRT_SYSTEM_INFO_JSON_FLAGS_NONE.
+ *
+ * Returns: (transfer full): A new #SrtSystemInfo. Free with g_object_unref()
+ */
+SrtSystemInfo *
+srt_system_info_new_from_json (const char *path,
+                               GError **error)
+{
+  return srt_system_info_new_from_json_full (path,
+                                             SRT_SYSTEM_INFO_JSON_FLAGS_NONE,
+                                             error);
+}
+
+/**
+ * srt_system_info_new_from_json_full:
+ * @path: (not nullable) (type filename): Path to a JSON report
+ * @flags: Flags affecting how the report is loaded
+ * @error: Used to raise an error on failure
+ *
+ * Return a new #SrtSystemInfo with the info parsed from an existing JSON
+ * report, as for srt_system_info_new_from_json().
+ *
+ * If @flags contains %SRT_SYSTEM_INFO_JSON_FLAGS_LAZY, the largest
+ * sections of the report, describing each architecture and the EGL and
+ * Vulkan drivers, are only parsed when they are first needed. This is
+ * faster for callers that only need part of a large report.
+ * If one of those sections is malformed, a warning is logged when it is
+ * first used and it is treated as though it was empty, instead of
+ * making this function fail.
+ *
+ * Returns: (transfer full): A new #SrtSystemInfo. Free with g_object_unref()
+ */
+SrtSystemInfo *
+srt_system_info_new_from_json_full (const char *path,
+                                    SrtSystemInfoJsonFlags flags,
+                                    GError **error)
+{
+  g_return_val_if_fail (_srt_check_not_setuid (), NULL);
+  g_return_val_if_fail (path != NULL, NULL);
+  g_return_val_if_fail (error == NULL || *error == NULL, NULL);
 
-  return info;
+  return system_info_new_from_json (path,
+                                    (flags & SRT_SYSTEM_INFO_JSON_FLAGS_LAZY) != 0,
+                                    error);
 }
 
 /**
@@ -1630,6 +1988,11 @@ srt_system_info_check_libraries (SrtSystemInfo *self,
   FILE *fp = NULL;
   GError *error = NULL;
   SrtLibraryIssues ret = SRT_LIBRARY_ISSUES_UNKNOWN;
+  g_autoptr(GPtrArray) sonames = NULL;
+  g_autoptr(GPtrArray) symbols_files = NULL;
+  g_autoptr(GArray) checks = NULL;
+  g_autofree SrtLibrary **libraries = NULL;
+  gsize i;
 
   g_return_val_if_fail (SRT_IS_SYSTEM_INFO (self), SRT_LIBRARY_ISSUES_UNKNOWN);
   g_return_val_if_fail (multiarch_tuple != NULL, SRT_LIBRARY_ISSUES_UNKNOWN);
@@ -1675,6 +2038,10 @@ srt_system_info_check_libraries (SrtSystemInfo *self,
 
   ensure_hidden_deps (self);
 
+  sonames = g_ptr_array_new_with_free_func (g_free);
+  symbols_files = g_ptr_array_new_with_free_func (g_free);
+  checks = g_array_new (FALSE, FALSE, sizeof (SrtLibraryCheck));
+
   while ((filename = g_dir_read_name (dir)))
     {
       char *line = NULL;
@@ -1703,28 +2070,42 @@ srt_system_info_check_libraries (SrtSystemInfo *self,
 
           if (line[0] != '#' && line[0] != '*' && line[0] != '|' && line[0] != ' ')
             {
-              /* This line introduces a new SONAME. We extract it and call
-                * `_srt_check_library_presence` with the symbols file where we
-                * found it, as an argument. */
-              SrtLibrary *library = NULL;
+              /* This line introduces a new SONAME. We extract it and
+               * check it later, together with all the others, with the
+               * symbols file where we found it as an argument. */
               char *soname = g_strdup (strsep (&pointer_into_line, " \t"));
-              gchar **hidden_deps = g_hash_table_lookup (self->cached_hidden_deps, soname);
-              abi->cached_combined_issues |= _srt_check_library_presence (self->runner,
-                                                                          soname,
-                                                                          multiarch_tuple,
-                                                                          symbols_file,
-                                                                          (const gchar * const *)hidden_deps,
-                                                                          self->check_flags,
-                                                                          SRT_LIBRARY_SYMBOLS_FORMAT_DEB_SYMBOLS,
-                                                                          &library);
-              g_hash_table_insert (abi->cached_results, soname, library);
+              SrtLibraryCheck check =
+              {
+                .requested_name = soname,
+                .symbols_path = symbols_file,
+                .hidden_deps = g_hash_table_lookup (self->cached_hidden_deps, soname),
+              };
+
+              g_ptr_array_add (sonames, soname);
+              g_array_append_val (checks, check);
             }
         }
       free (line);
-      g_clear_pointer (&symbols_file, g_free);
+      g_ptr_array_add (symbols_files, g_steal_pointer (&symbols_file));
       g_clear_pointer (&fp, fclose);
     }
 
+  /* Checking all the libraries at once is a lot faster than starting
+   * a helper subprocess for each one */
+  libraries = g_new0 (SrtLibrary *, checks->len + 1);
+  abi->cached_combined_issues |= _srt_check_libraries_presence (self->runner,
+                                                                multiarch_tuple,
+                                                                (const SrtLibraryCheck *) checks->data,
+                                                                checks->len,
+                                                                self->check_flags,
+                                                                SRT_LIBRARY_SYMBOLS_FORMAT_DEB_SYMBOLS,
+                                                                libraries);
+
+  for (i = 0; i < checks->len; i++)
+    g_hash_table_insert (abi->cached_results,
+                         g_strdup (g_ptr_array_index (sonames, i)),
+                         libraries[i]);
+
   abi->libraries_cache_available = TRUE;
   if (libraries_out != NULL)
     {
@@ -2027,6 +2408,368 @@ srt_system_info_check_graphics (SrtSystemInfo *self,
   return issues;
 }
 
+/* The combinations checked by srt_system_info_check_all_graphics(),
+ * in the order that they are checked */
+static const struct
+{
+  SrtWindowSystem window_system;
+  SrtRenderingInterface rendering_interface;
+} all_graphics_checks[] =
+{
+  { SRT_WINDOW_SYSTEM_GLX, SRT_RENDERING_INTERFACE_GL },
+  { SRT_WINDOW_SYSTEM_EGL_X11, SRT_RENDERING_INTERFACE_GL },
+  { SRT_WINDOW_SYSTEM_EGL_X11, SRT_RENDERING_INTERFACE_GLESV2 },
+  { SRT_WINDOW_SYSTEM_X11, SRT_RENDERING_INTERFACE_VULKAN },
+  { SRT_WINDOW_SYSTEM_X11, SRT_RENDERING_INTERFACE_VDPAU },
+  { SRT_WINDOW_SYSTEM_X11, SRT_RENDERING_INTERFACE_VAAPI },
+};
+
+typedef struct
+{
+  /* borrowed */
+  SrtSubprocessRunner *runner;
+  Abi *abi;
+  const char *multiarch_tuple;
+  SrtWindowSystem window_system;
+  SrtRenderingInterface rendering_interface;
+  /* results */
+  SrtGraphicsIssues issues;
+  SrtGraphics *graphics;
+} GraphicsCheck;
+
+static void
+graphics_check_run (gpointer data,
+                    gpointer user_data)
+{
+  GraphicsCheck *check = data;
+
+  check->issues = _srt_check_graphics (check->runner,
+                                       check->multiarch_tuple,
+                                       check->window_system,
+                                       check->rendering_interface,
+                                       &check->graphics);
+}
+
+/*
+ * ensure_all_graphics:
+ * @self: The #SrtSystemInfo
+ * @multiarch_tuples: (array length=n_tuples): ABIs to check
+ *
+ * Run each of the checks in all_graphics_checks for each of
+ * @multiarch_tuples, unless the result is already cached.
+ * Each check waits for a helper subprocess, so we run up to
+ * max_parallel_checks of them at the same time.
+ * The results are added to the cache in a deterministic order,
+ * regardless of the order in which they finish.
+ */
+static void
+ensure_all_graphics (SrtSystemInfo *self,
+                     const char * const *multiarch_tuples,
+                     gsize n_tuples)
+{
+  g_autoptr(GArray) checks = NULL;
+  g_autoptr(GError) error = NULL;
+  GThreadPool *pool = NULL;
+  guint max_parallel;
+  gsize i, j;
+
+  if (self->from_report != NULL)
+    return;
+
+  checks = g_array_new (FALSE, FALSE, sizeof (GraphicsCheck));
+
+  for (i = 0; i < n_tuples; i++)
+    {
+      Abi *abi = ensure_abi_unless_immutable (self, multiarch_tuples[i]);
+
+      if (abi == NULL || abi->graphics_cache_available)
+        continue;
+
+      for (j = 0; j < G_N_ELEMENTS (all_graphics_checks); j++)
+        {
+          int hash_key = _srt_graphics_hash_key (all_graphics_checks[j].window_system,
+                                                 all_graphics_checks[j].rendering_interface);
+          GraphicsCheck check =
+          {
+            .runner = self->runner,
+            .abi = abi,
+            .multiarch_tuple = multiarch_tuples[i],
+            .window_system = all_graphics_checks[j].window_system,
+            .rendering_interface = all_graphics_checks[j].rendering_interface,
+          };
+
+          if (g_hash_table_contains (abi->cached_graphics_results,
+                                     GINT_TO_POINTER (hash_key)))
+            continue;
+
+          g_array_append_val (checks, check);
+        }
+    }
+
+  max_parallel = self->max_parallel_checks;
+
+  if (max_parallel == 0)
+    max_parallel = g_get_num_processors ();
+
+  max_parallel = MIN (max_parallel, checks->len);
+
+  if (max_parallel > 1)
+    {
+      /* Make sure the helpers path is cached before we use it from
+       * more than one thread */
+      _srt_subprocess_runner_resolve_helpers_path (self->runner, NULL);
+
+      pool = g_thread_pool_new (graphics_check_run, NULL, max_parallel,
+                                FALSE, &error);
+
+      if (pool == NULL)
+        g_debug ("Unable to check graphics in parallel: %s", error->message);
+    }
+
+  for (i = 0; i < checks->len; i++)
+    {
+      GraphicsCheck *check = &g_array_index (checks, GraphicsCheck, i);
+
+      if (pool != NULL)
+        g_thread_pool_push (pool, check, NULL);
+      else
+        graphics_check_run (check, NULL);
+    }
+
+  /* Wait for all the checks to finish */
+  if (pool != NULL)
+    g_thread_pool_free (pool, FALSE, TRUE);
+
+  for (i = 0; i < checks->len; i++)
+    {
+      GraphicsCheck *check = &g_array_index (checks, GraphicsCheck, i);
+      int hash_key = _srt_graphics_hash_key (check->window_system,
+                                             check->rendering_interface);
+
+      g_hash_table_insert (check->abi->cached_graphics_results,
+                           GINT_TO_POINTER (hash_key),
+                           g_steal_pointer (&check->graphics));
+      check->abi->cached_combined_graphics_issues |= check->issues;
+    }
+}
+
+/*
+ * _srt_system_info_check_graphics_for_abis:
+ * @self: The #SrtSystemInfo object to use.
+ * @multiarch_tuples: (array zero-terminated=1): ABIs to check
+ *
+ * Do the same checks as srt_system_info_check_all_graphics() for
+ * each of @multiarch_tuples, and cache the results, so that
+ * srt_system_info_check_all_graphics() can return them without
+ * waiting. Checking all of them together allows more checks to
+ * run in parallel.
+ */
+void
+_srt_system_info_check_graphics_for_abis (SrtSystemInfo *self,
+                                          const char * const *multiarch_tuples)
+{
+  gsize i;
+
+  g_return_if_fail (SRT_IS_SYSTEM_INFO (self));
+  g_return_if_fail (multiarch_tuples != NULL);
+
+  ensure_all_graphics (self, multiarch_tuples,
+                       g_strv_length ((gchar **) multiarch_tuples));
+
+  for (i = 0; multiarch_tuples[i] != NULL; i++)
+    {
+      Abi *abi = ensure_abi_unless_immutable (self, multiarch_tuples[i]);
+
+      if (abi != NULL)
+        abi->graphics_cache_available = TRUE;
+    }
+}
+
+/*
+ * _srt_system_info_set_max_parallel_checks:
+ * @self: The #SrtSystemInfo
+ * @max_parallel: The maximum number of helper subprocesses to wait for
+ *  at the same time, 1 to run them one at a time, or 0 to choose
+ *  automatically
+ */
+void
+_srt_system_info_set_max_parallel_checks (SrtSystemInfo *self,
+                                          guint max_parallel)
+{
+  g_return_if_fail (SRT_IS_SYSTEM_INFO (self));
+  self->max_parallel_checks = max_parallel;
+  _srt_subprocess_runner_set_max_in_flight (self->runner, max_parallel);
+}
+
+typedef enum
+{
+  ABI_CHECK_CAN_RUN,
+  ABI_CHECK_LIBDL_LIB,
+  ABI_CHECK_LIBDL_PLATFORM,
+} AbiCheckKind;
+
+typedef struct
+{
+  SrtSystemInfo *info;
+  gchar *multiarch_tuple;
+  gsize *pending;
+  AbiCheckKind kind;
+} AbiCheck;
+
+static void
+abi_check_cb (GObject *source_object,
+              GAsyncResult *result,
+              gpointer user_data)
+{
+  SrtSubprocessRunner *runner = SRT_SUBPROCESS_RUNNER (source_object);
+  AbiCheck *check = user_data;
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *value = NULL;
+  gboolean can_run;
+  Abi *abi;
+
+  abi = ensure_abi_unless_immutable (check->info, check->multiarch_tuple);
+
+  switch (check->kind)
+    {
+      case ABI_CHECK_CAN_RUN:
+        can_run = _srt_architecture_can_run_finish (runner, result, &error);
+
+        /* If cancelled, leave it to be checked later if necessary */
+        if (abi != NULL && abi->can_run == TRI_MAYBE && error == NULL)
+          abi->can_run = can_run ? TRI_YES : TRI_NO;
+
+        break;
+
+      case ABI_CHECK_LIBDL_LIB:
+        value = _srt_libdl_detect_finish (runner, result, &error);
+
+        if (abi != NULL
+            && abi->libdl_lib == NULL
+            && abi->libdl_lib_error == NULL
+            && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          {
+            abi->libdl_lib = g_steal_pointer (&value);
+            abi->libdl_lib_error = g_steal_pointer (&error);
+          }
+
+        break;
+
+      case ABI_CHECK_LIBDL_PLATFORM:
+        value = _srt_libdl_detect_finish (runner, result, &error);
+
+        if (abi != NULL
+            && abi->libdl_platform == NULL
+            && abi->libdl_platform_error == NULL
+            && !g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+          {
+            abi->libdl_platform = g_steal_pointer (&value);
+            abi->libdl_platform_error = g_steal_pointer (&error);
+          }
+
+        break;
+
+      default:
+        g_warn_if_reached ();
+    }
+
+  *check->pending -= 1;
+  g_free (check->multiarch_tuple);
+  g_free (check);
+}
+
+static AbiCheck *
+abi_check_new (SrtSystemInfo *info,
+               const char *multiarch_tuple,
+               AbiCheckKind kind,
+               gsize *pending)
+{
+  AbiCheck *check = g_new0 (AbiCheck, 1);
+
+  check->info = info;
+  check->multiarch_tuple = g_strdup (multiarch_tuple);
+  check->kind = kind;
+  check->pending = pending;
+  *pending += 1;
+  return check;
+}
+
+/*
+ * _srt_system_info_prefetch_for_abis:
+ * @self: The #SrtSystemInfo object to use.
+ * @multiarch_tuples: (array zero-terminated=1): ABIs to check
+ * @cancellable: (nullable): If cancelled, checks that have not finished
+ *  yet are abandoned, and will be done on-demand later if necessary
+ *
+ * Do the same checks as srt_system_info_can_run(),
+ * srt_system_info_dup_libdl_lib() and srt_system_info_dup_libdl_platform()
+ * for each of @multiarch_tuples, and cache the results. The checks are
+ * queued together, so that up to the number of parallel checks set by
+ * _srt_system_info_set_max_parallel_checks() can run at the same time.
+ *
+ * Other checks, such as srt_system_info_check_libraries() and
+ * srt_system_info_check_locale(), already combine their work into
+ * a small number of helper subprocesses and are not affected.
+ */
+void
+_srt_system_info_prefetch_for_abis (SrtSystemInfo *self,
+                                    const char * const *multiarch_tuples,
+                                    GCancellable *cancellable)
+{
+  g_autoptr(GMainContext) context = NULL;
+  gsize pending = 0;
+  gsize i;
+
+  g_return_if_fail (SRT_IS_SYSTEM_INFO (self));
+  g_return_if_fail (multiarch_tuples != NULL);
+  g_return_if_fail (cancellable == NULL || G_IS_CANCELLABLE (cancellable));
+
+  if (self->from_report != NULL)
+    return;
+
+  context = g_main_context_new ();
+  g_main_context_push_thread_default (context);
+
+  for (i = 0; multiarch_tuples[i] != NULL; i++)
+    {
+      const char *tuple = multiarch_tuples[i];
+      Abi *abi = ensure_abi_unless_immutable (self, tuple);
+      AbiCheck *check;
+
+      if (abi == NULL)
+        continue;
+
+      if (abi->can_run == TRI_MAYBE)
+        {
+          check = abi_check_new (self, tuple, ABI_CHECK_CAN_RUN, &pending);
+          _srt_architecture_can_run_async (self->runner, tuple, cancellable,
+                                           abi_check_cb, check);
+        }
+
+      if (abi->libdl_lib == NULL && abi->libdl_lib_error == NULL)
+        {
+          check = abi_check_new (self, tuple, ABI_CHECK_LIBDL_LIB, &pending);
+          _srt_libdl_detect_async (self->runner, tuple, "detect-lib",
+                                   cancellable, abi_check_cb, check);
+        }
+
+      if (abi->libdl_platform == NULL && abi->libdl_platform_error == NULL)
+        {
+          check = abi_check_new (self, tuple, ABI_CHECK_LIBDL_PLATFORM,
+                                 &pending);
+          _srt_libdl_detect_async (self->runner, tuple, "detect-platform",
+                                   cancellable, abi_check_cb, check);
+        }
+    }
+
+  /* Even if cancelled, we have to wait for the callbacks, because they
+   * refer to @pending on our stack */
+  while (pending > 0)
+    g_main_context_iteration (context, TRUE);
+
+  g_main_context_pop_thread_default (context);
+}
+
 /**
  * srt_system_info_check_all_graphics:
  * @self: The #SrtSystemInfo object to use.
@@ -2069,49 +2812,7 @@ GList * srt_system_info_check_all_graphics (SrtSystemInfo *self,
 
   // Try each rendering interface
   // Try each window system
-
-  abi->cached_combined_graphics_issues |=
-    srt_system_info_check_graphics (self,
-                                    multiarch_tuple,
-                                    SRT_WINDOW_SYSTEM_GLX,
-                                    SRT_RENDERING_INTERFACE_GL,
-                                    NULL);
-
-  abi->cached_combined_graphics_issues |=
-    srt_system_info_check_graphics (self,
-                                    multiarch_tuple,
-                                    SRT_WINDOW_SYSTEM_EGL_X11,
-                                    SRT_RENDERING_INTERFACE_GL,
-                                    NULL);
-
-  abi->cached_combined_graphics_issues |=
-    srt_system_info_check_graphics (self,
-                                    multiarch_tuple,
-                                    SRT_WINDOW_SYSTEM_EGL_X11,
-                                    SRT_RENDERING_INTERFACE_GLESV2,
-                                    NULL);
-
-  abi->cached_combined_graphics_issues |=
-    srt_system_info_check_graphics (self,
-                                    multiarch_tuple,
-                                    SRT_WINDOW_SYSTEM_X11,
-                                    SRT_RENDERING_INTERFACE_VULKAN,
-                                    NULL);
-
-  abi->cached_combined_graphics_issues |=
-    srt_system_info_check_graphics (self,
-                                    multiarch_tuple,
-                                    SRT_WINDOW_SYSTEM_X11,
-                                    SRT_RENDERING_INTERFACE_VDPAU,
-                                    NULL);
-
-  abi->cached_combined_graphics_issues |=
-    srt_system_info_check_graphics (self,
-                                    multiarch_tuple,
-                                    SRT_WINDOW_SYSTEM_X11,
-                                    SRT_RENDERING_INTERFACE_VAAPI,
-                                    NULL);
-
+  ensure_all_graphics (self, &multiarch_tuple, 1);
   abi->graphics_cache_available = TRUE;
 
   list = g_list_sort (g_hash_table_get_values (abi->cached_graphics_results),
@@ -2147,6 +2848,10 @@ _srt_system_info_set_subprocess_runner (SrtSystemInfo *self,
 
   old = g_steal_pointer (&self->runner);
   self->runner = g_object_ref (runner);
+
+  if (self->max_parallel_checks != 0)
+    _srt_subprocess_runner_set_max_in_flight (self->runner,
+                                              self->max_parallel_checks);
 }
 
 /**
@@ -3084,9 +3789,11 @@ srt_system_info_get_locale_issues (SrtSystemInfo *self)
 
   if (!self->locales.have_issues && self->from_report == NULL)
     {
+      static const char * const needed[] = { "", "C.UTF-8", "en_US.UTF-8", NULL };
       SrtLocale *locale = NULL;
 
       self->locales.issues = SRT_LOCALE_ISSUES_NONE;
+      _srt_system_info_prefetch_locales (self, needed);
 
       locale = srt_system_info_check_locale (self, "", NULL);
 
@@ -3131,6 +3838,85 @@ srt_system_info_get_locale_issues (SrtSystemInfo *self)
   return self->locales.issues;
 }
 
+/*
+ * _srt_system_info_prefetch_locales:
+ * @self: The #SrtSystemInfo
+ * @requested_names: (array zero-terminated=1): Locales that will be
+ *  checked with srt_system_info_check_locale()
+ *
+ * Check all of @requested_names that are not already cached in a
+ * single run of the helper subprocess, instead of one run per locale.
+ * If that fails, srt_system_info_check_locale() will check them one
+ * at a time as usual.
+ */
+void
+_srt_system_info_prefetch_locales (SrtSystemInfo *self,
+                                   const char * const *requested_names)
+{
+  g_autoptr(GPtrArray) names = NULL;
+  g_autoptr(GError) local_error = NULL;
+  g_autofree SrtLocale **locales = NULL;
+  g_autofree GError **errors = NULL;
+  gsize i;
+
+  g_return_if_fail (SRT_IS_SYSTEM_INFO (self));
+  g_return_if_fail (requested_names != NULL);
+
+  if (self->from_report != NULL)
+    return;
+
+  if (self->locales.cached_locales == NULL)
+    self->locales.cached_locales = g_hash_table_new_full (NULL, NULL, NULL,
+                                                          maybe_locale_free);
+
+  names = g_ptr_array_new ();
+
+  for (i = 0; requested_names[i] != NULL; i++)
+    {
+      const char *name = g_intern_string (requested_names[i]);
+
+      if (!g_hash_table_contains (self->locales.cached_locales,
+                                  GUINT_TO_POINTER (g_quark_from_string (name)))
+          && !g_ptr_array_find (names, name, NULL))
+        g_ptr_array_add (names, (char *) name);
+    }
+
+  if (names->len < 2)
+    return;
+
+  locales = g_new0 (SrtLocale *, names->len);
+  errors = g_new0 (GError *, names->len);
+
+  if (!_srt_check_locales (self->runner,
+                           srt_system_info_get_primary_multiarch_tuple (self),
+                           (const char * const *) names->pdata,
+                           names->len,
+                           locales,
+                           errors,
+                           &local_error))
+    {
+      g_debug ("Unable to check locales together, will check individually: %s",
+               local_error->message);
+      return;
+    }
+
+  for (i = 0; i < names->len; i++)
+    {
+      MaybeLocale *maybe;
+
+      if (locales[i] != NULL)
+        maybe = maybe_locale_new_positive (locales[i]);
+      else
+        maybe = maybe_locale_new_negative (errors[i]);
+
+      g_hash_table_replace (self->locales.cached_locales,
+                            GUINT_TO_POINTER (g_quark_from_string (g_ptr_array_index (names, i))),
+                            maybe);
+      g_clear_object (&locales[i]);
+      g_clear_error (&errors[i]);
+    }
+}
+
 /**
  * srt_system_info_check_locale:
  * @self: The #SrtSystemInfo
@@ -3241,6 +4027,32 @@ _srt_system_info_set_check_flags (SrtSystemInfo *self,
   forget_drivers (self);
 }
 
+/*
+ * _srt_system_info_set_driver_cache_dir:
+ * @self: The #SrtSystemInfo
+ * @path: (nullable) (type filename): A directory in which to cache the
+ *  result of searching for DRI, VA-API and VDPAU drivers, or %NULL
+ *  to search every time (the default)
+ *
+ * The directory is created when needed. Cached results are reused
+ * only if none of the directories that were searched, the drivers that
+ * were found or the environment variables that influence the search
+ * have changed.
+ */
+void
+_srt_system_info_set_driver_cache_dir (SrtSystemInfo *self,
+                                       const char *path)
+{
+  g_return_if_fail (SRT_IS_SYSTEM_INFO (self));
+
+  if (g_strcmp0 (path, self->driver_cache_dir) == 0)
+    return;
+
+  g_free (self->driver_cache_dir);
+  self->driver_cache_dir = g_strdup (path);
+  forget_graphics_modules (self);
+}
+
 /**
  * srt_system_info_set_test_flags:
  * @self: The #SrtSystemInfo
@@ -3309,6 +4121,8 @@ srt_system_info_list_egl_icds (SrtSystemInfo *self,
 
   g_return_val_if_fail (SRT_IS_SYSTEM_INFO (self), NULL);
 
+  ensure_egl_from_report (self);
+
   if (!self->icds.have_egl && self->from_report == NULL && self->sysroot != NULL)
     {
       g_assert (self->icds.egl == NULL);
@@ -3375,6 +4189,8 @@ srt_system_info_list_egl_external_platforms (SrtSystemInfo *self,
 
   g_return_val_if_fail (SRT_IS_SYSTEM_INFO (self), NULL);
 
+  ensure_egl_from_report (self);
+
   if (!self->egl_ext_platform.have && self->from_report == NULL && self->sysroot != NULL)
     {
       g_assert (self->egl_ext_platform.list == NULL);
@@ -3445,6 +4261,8 @@ srt_system_info_list_vulkan_icds (SrtSystemInfo *self,
 
   g_return_val_if_fail (SRT_IS_SYSTEM_INFO (self), NULL);
 
+  ensure_vulkan_from_report (self);
+
   if (!self->icds.have_vulkan && self->from_report == NULL && self->sysroot != NULL)
     {
       g_assert (self->icds.vulkan == NULL);
@@ -3503,6 +4321,8 @@ srt_system_info_list_explicit_vulkan_layers (SrtSystemInfo *self)
 
   g_return_val_if_fail (SRT_IS_SYSTEM_INFO (self), NULL);
 
+  ensure_vulkan_from_report (self);
+
   if (!self->layers.have_vulkan_explicit && self->from_report == NULL && self->sysroot != NULL)
     {
       g_auto(GStrv) multiarch_tuples = srt_system_info_dup_multiarch_tuples (self);
@@ -3556,6 +4376,8 @@ srt_system_info_list_implicit_vulkan_layers (SrtSystemInfo *self)
 
   g_return_val_if_fail (SRT_IS_SYSTEM_INFO (self), NULL);
 
+  ensure_vulkan_from_report (self);
+
   if (!self->layers.have_vulkan_implicit && self->from_report == NULL && self->sysroot != NULL)
     {
       g_auto(GStrv) multiarch_tuples = srt_system_info_dup_multiarch_tuples (self);
@@ -3623,11 +4445,24 @@ _srt_system_info_list_graphics_modules (SrtSystemInfo *self,
 
   if (!abi->graphics_modules[which].available && self->from_report == NULL && self->sysroot != NULL)
     {
-      abi->graphics_modules[which].modules = _srt_list_graphics_modules (self->sysroot,
-                                                                         self->runner,
-                                                                         multiarch_tuple,
-                                                                         self->check_flags,
-                                                                         which);
+      if (self->driver_cache_dir != NULL)
+        abi->graphics_modules[which].modules =
+          _srt_list_graphics_modules_cached (self->driver_cache_dir,
+                                             self->sysroot,
+                                             self->runner,
+                                             multiarch_tuple,
+                                             self->check_flags,
+                                             which);
+      else
+        abi->graphics_modules[which].modules =
+          _srt_list_graphics_modules (self->sysroot,
+                                      self->runner,
+                                      multiarch_tuple,
+                                      self->check_flags,
+                                      which,
+                                      NULL,
+                                      NULL);
+
       abi->graphics_modules[which].available = TRUE;
     }
 
@@ -3860,6 +4695,7 @@ srt_system_info_list_inactive_openxr_1_runtimes (SrtSystemInfo *self,
   if (!srt_system_info_load_openxr_1_runtimes (self))
     return NULL;
 
+  ensure_all_abis_from_report (self);
   g_hash_table_iter_init (&active_iter, self->openxr_1_runtimes.active);
   while (g_hash_table_iter_next (&active_iter, &active_tuple, &active_rt))
     {
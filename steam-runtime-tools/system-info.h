@@ -79,6 +79,21 @@ typedef enum
   SRT_DRIVER_FLAGS_NONE = 0
 } SrtDriverFlags;
 
+/**
+ * SrtSystemInfoJsonFlags:
+ * @SRT_SYSTEM_INFO_JSON_FLAGS_NONE: Parse the whole report immediately
+ * @SRT_SYSTEM_INFO_JSON_FLAGS_LAZY: Only parse the largest sections of the
+ *  report when they are first needed
+ *
+ * A bitfield with flags affecting srt_system_info_new_from_json_full(),
+ * or %SRT_SYSTEM_INFO_JSON_FLAGS_NONE (which is numerically zero).
+ */
+typedef enum
+{
+  SRT_SYSTEM_INFO_JSON_FLAGS_LAZY = (1 << 0),
+  SRT_SYSTEM_INFO_JSON_FLAGS_NONE = 0
+} SrtSystemInfoJsonFlags;
+
 typedef struct _SrtSystemInfo SrtSystemInfo;
 typedef struct _SrtSystemInfoClass SrtSystemInfoClass;
 
@@ -98,6 +113,10 @@ SrtSystemInfo *srt_system_info_new (const char *expectations);
 _SRT_PUBLIC
 SrtSystemInfo *srt_system_info_new_from_json (const char *path,
                                               GError **error);
+_SRT_PUBLIC
+SrtSystemInfo *srt_system_info_new_from_json_full (const char *path,
+                                                   SrtSystemInfoJsonFlags flags,
+                                                   GError **error);
 
 _SRT_PUBLIC
 const char *srt_system_info_get_version (SrtSystemInfo *self);
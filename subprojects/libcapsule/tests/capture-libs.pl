@@ -881,6 +881,31 @@ like(readlink "$libdir/libcapsule-test-dependent-runpath.so.1", qr{^/run/host/},
 like(readlink "$libdir/libcapsule-test-dependency.so.1", qr{^/run/host/},
      '$libdir/libcapsule-test-dependency.so.1 is a symlink to /run/host + something');
 
+run_ok(['rm', '-fr', $libdir]);
+mkdir($libdir);
+{
+    my $input = join('', map { join("\0", @$_)."\0\0" } (
+        ["$libdir/first", 'soname:libc.so.6'],
+        ["$libdir/second", 'soname:libcapsule-test-does-not-exist.so.0'],
+        ["$libdir/third", 'if-exists:soname:libcapsule-test-does-not-exist.so.0',
+         'soname:libm.so.6'],
+    ));
+    my $output;
+    run_ok([$CAPSULE_CAPTURE_LIBS_TOOL, '--link-target=/run/host', '--batch'],
+           '<', \$input, '>', \$output);
+    diag $output;
+    my @replies = split /\n/, $output;
+    is(scalar @replies, 3, 'one reply per request in --batch mode');
+    is($replies[0], 'ok', 'first request succeeded');
+    like($replies[1], qr{^error [0-9]+ .*libcapsule-test-does-not-exist},
+         'second request failed without stopping the batch');
+    is($replies[2], 'ok', 'third request succeeded');
+    like(readlink "$libdir/first/libc.so.6", qr{^/run/host$libc_re$},
+         'first request captured libc.so.6');
+    like(readlink "$libdir/third/libm.so.6", qr{^/run/host$LIBDIR/libm[-.]},
+         'third request captured libm.so.6');
+}
+
 done_testing;
 
 # vim:set sw=4 sts=4 et:
@@ -0,0 +1,256 @@
+// Copyright © 2025 Collabora Ltd
+// SPDX-License-Identifier: LGPL-2.1-or-later
+
+// This file is part of libcapsule.
+
+// libcapsule is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as
+// published by the Free Software Foundation; either version 2.1 of the
+// License, or (at your option) any later version.
+
+// libcapsule is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+
+// You should have received a copy of the GNU Lesser General Public
+// License along with libcapsule.  If not, see <http://www.gnu.org/licenses/>.
+
+// Compare the time taken to look up the SONAMEs that pressure-vessel
+// asks capsule-capture-libs for when it imports the host graphics stack
+// in ld.so.cache, with and without the SONAME index.
+//
+// Usage: ld-cache-bench [LD_SO_CACHE [ITERATIONS [SONAMES_FILE]]]
+//
+// SONAMES_FILE replaces the built-in list with one SONAME per line,
+// for example the libraries and dependencies that a real run of
+// capsule-capture-libs looked up.
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "utils/ld-cache.h"
+#include "utils/utils.h"
+
+// The exact SONAMEs from collect_graphics_libraries_patterns() in
+// pressure-vessel/runtime.c. The soname-match: patterns are not
+// included, because matching them has to walk the whole cache either way.
+static const char * const graphics_sonames[] =
+{
+    "libvulkan.so.1",
+    "libvdpau.so.1",
+    "libva.so.1",
+    "libva-drm.so.1",
+    "libva-glx.so.1",
+    "libva-x11.so.1",
+    "libva.so.2",
+    "libva-drm.so.2",
+    "libva-glx.so.2",
+    "libva-x11.so.2",
+    "libdrm.so.2",
+    "libdrm_amdgpu.so.1",
+    "libdrm_etnaviv.so.1",
+    "libdrm_freedreno.so.1",
+    "libdrm_intel.so.1",
+    "libdrm_nouveau.so.2",
+    "libdrm_radeon.so.1",
+    "libdrm_tegra.so.0",
+    "libEGL.so.1",
+    "libGL.so.1",
+    "libGLESv1_CM.so.1",
+    "libGLESv2.so.2",
+    "libGLX.so.0",
+    "libGLX_indirect.so.0",
+    "libGLdispatch.so.0",
+    "libOpenCL.so.1",
+    "libOpenGL.so.0",
+    "libEGL_mesa.so.0",
+    "libGLX_mesa.so.0",
+    "libEGL_nvidia.so.0",
+    "libGLESv1_CM_nvidia.so.1",
+    "libGLESv2_nvidia.so.2",
+    "libGLX_nvidia.so.0",
+    "libXNVCtrl.so.0",
+    "libcuda.so.1",
+    "libcudadebugger.so.1",
+    "libnvcuvid.so.1",
+    "libnvidia-allocator.so.1",
+    "libnvidia-api.so.1",
+    "libnvidia-cfg.so.1",
+    "libnvidia-egl-gbm.so.1",
+    "libnvidia-egl-wayland.so.1",
+    "libnvidia-encode.so.1",
+    "libnvidia-fbc.so.1",
+    "libnvidia-ifr.so.1",
+    "libnvidia-ml.so.1",
+    "libnvidia-ngx.so.1",
+    "libnvidia-nvvm.so.4",
+    "libnvidia-opencl.so.1",
+    "libnvidia-opticalflow.so.1",
+    "libnvidia-ptxjitcompiler.so.1",
+    "libnvoptix.so.1",
+    "libvdpau_nvidia.so.1",
+    // Not expected to exist, to measure failed lookups too
+    "libnot-a-real-library.so.0",
+};
+
+// Read one SONAME per line from @path, ignoring blank lines.
+// Returns a NULL-terminated array, or NULL on error.
+static char **
+read_sonames (const char *path,
+              size_t *n_out)
+{
+    FILE *file = fopen( path, "r" );
+    ptr_list *names = NULL;
+    char line[1024];
+
+    if( file == NULL )
+        return NULL;
+
+    names = ptr_list_alloc( 64 );
+
+    while( fgets( line, sizeof(line), file ) != NULL )
+    {
+        line[strcspn( line, "\r\n" )] = '\0';
+
+        if( line[0] != '\0' )
+            ptr_list_push_ptr( names, xstrdup( line ) );
+    }
+
+    fclose( file );
+    return (char **) ptr_list_free_to_array( names, n_out );
+}
+
+typedef struct
+{
+    const char *name;
+    unsigned long hits;
+} lookup;
+
+static intptr_t
+count_cb (const char *name,
+          int flag,
+          unsigned int osv,
+          uint64_t hwcap,
+          const char *path,
+          void *data)
+{
+    lookup *target = data;
+
+    if( strcmp( name, target->name ) == 0 )
+        target->hits++;
+
+    return 0;
+}
+
+static double
+now (void)
+{
+    struct timespec ts;
+
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int
+main (int argc, char **argv)
+{
+    const char *path = "/etc/ld.so.cache";
+    unsigned long iterations = 1000;
+    unsigned long linear_hits = 0;
+    unsigned long indexed_hits = 0;
+    ld_cache cache = {};
+    const char * const *sonames = graphics_sonames;
+    size_t n_sonames = N_ELEMENTS( graphics_sonames );
+    char **from_file = NULL;
+    char *message = NULL;
+    int code = 0;
+    double start, linear, indexed;
+    unsigned long i;
+    size_t j;
+
+    if( argc > 4 )
+    {
+        fprintf( stderr,
+                 "Usage: %s [LD_SO_CACHE [ITERATIONS [SONAMES_FILE]]]\n",
+                 argv[0] );
+        return 2;
+    }
+
+    if( argc > 1 )
+        path = argv[1];
+
+    if( argc > 2 )
+        iterations = strtoul( argv[2], NULL, 10 );
+
+    if( argc > 3 )
+    {
+        from_file = read_sonames( argv[3], &n_sonames );
+
+        if( from_file == NULL )
+        {
+            fprintf( stderr, "%s: %s: %s\n", argv[0], argv[3],
+                     strerror( errno ) );
+            return 1;
+        }
+
+        sonames = (const char * const *) from_file;
+    }
+
+
+    if( !ld_cache_open( &cache, path, &code, &message ) )
+    {
+        fprintf( stderr, "%s: %s\n", argv[0], message );
+        free( message );
+        return 1;
+    }
+
+    start = now();
+
+    for( i = 0; i < iterations; i++ )
+    {
+        for( j = 0; j < n_sonames; j++ )
+        {
+            lookup target = { sonames[j], 0 };
+
+            ld_cache_foreach( &cache, count_cb, &target );
+            linear_hits += target.hits;
+        }
+    }
+
+    linear = now() - start;
+
+    // includes building the index on first use
+    start = now();
+
+    for( i = 0; i < iterations; i++ )
+    {
+        for( j = 0; j < n_sonames; j++ )
+        {
+            lookup target = { sonames[j], 0 };
+
+            ld_cache_foreach_name( &cache, sonames[j], count_cb, &target );
+            indexed_hits += target.hits;
+        }
+    }
+
+    indexed = now() - start;
+
+    printf( "%s: %lu x %zu lookups\n", path, iterations, n_sonames );
+    printf( "linear:  %.6fs (%lu hits)\n", linear, linear_hits );
+    printf( "indexed: %.6fs (%lu hits)\n", indexed, indexed_hits );
+
+    free_strv_full( from_file );
+    ld_cache_close( &cache );
+
+    if( linear_hits != indexed_hits )
+    {
+        fprintf( stderr, "%s: results differ\n", argv[0] );
+        return 1;
+    }
+
+    return 0;
+}
@@ -108,6 +108,7 @@ static const char * const libc_patterns[] = {
 
 enum
 {
+  OPTION_BATCH,
   OPTION_COMPARE_BY,
   OPTION_CONTAINER,
   OPTION_DEST,
@@ -137,6 +138,7 @@ static bool option_glibc = true;
 
 static struct option long_options[] =
 {
+    { "batch", no_argument, NULL, OPTION_BATCH },
     { "compare-by", required_argument, NULL, OPTION_COMPARE_BY },
     { "container", required_argument, NULL, OPTION_CONTAINER },
     { "dest", required_argument, NULL, OPTION_DEST },
@@ -155,6 +157,15 @@ static struct option long_options[] =
 
 static int dest_fd = -1;
 
+// Each tree's ld.so.cache is opened once per process and lent to every
+// ld_libs that needs it, instead of being re-opened for each library.
+// We only ever look at the provider and the container.
+static struct
+{
+    const char *tree;
+    ld_cache cache;
+} shared_ld_caches[2];
+
 static bool resolve_ld_so ( const char *prefix,
                             char path[PATH_MAX],
                             const char **within_prefix,
@@ -223,6 +234,15 @@ static void usage (int code)
                "\tPATTERNs from PROVIDER available, assuming LIBDIR\n"
                "\twill be added to the container's LD_LIBRARY_PATH.\n" );
   fprintf( fh, "\n" );
+  fprintf( fh, "%s --batch [OPTIONS]\n",
+           program_invocation_short_name );
+  fprintf( fh, "\tRead requests from standard input, each consisting of\n"
+               "\ta LIBDIR and one or more PATTERNs, each terminated by\n"
+               "\ta NUL byte, followed by an extra NUL byte. For each\n"
+               "\trequest, behave as though run with --dest=LIBDIR\n"
+               "\tPATTERN..., then write \"ok\" or \"error CODE MESSAGE\"\n"
+               "\tas a line on standard output. Exit at end of input.\n" );
+  fprintf( fh, "\n" );
   fprintf( fh, "%s --print-ld.so\n",
            program_invocation_short_name );
   fprintf( fh, "\tPrint the ld.so filename for this architecture and exit.\n" );
@@ -364,20 +384,84 @@ typedef struct
     library_knowledge knowledge;
 } capture_options;
 
+static const ld_cache *
+get_shared_ld_cache( const char *tree, int *code, char **message )
+{
+    size_t i;
+    size_t j;
+
+    for( i = 0; i < N_ELEMENTS( shared_ld_caches ); i++ )
+    {
+        if( shared_ld_caches[i].tree == NULL )
+            break;
+
+        if( strcmp( shared_ld_caches[i].tree, tree ) == 0 )
+            return &shared_ld_caches[i].cache;
+    }
+
+    if( i >= N_ELEMENTS( shared_ld_caches ) )
+    {
+        _capsule_set_error( code, message, EINVAL,
+                            "Too many trees to cache ld.so.cache for \"%s\"",
+                            tree );
+        return NULL;
+    }
+
+    for( j = 0; ld_cache_filenames[j] != NULL; j++ )
+    {
+        _capsule_autofree char *cache_path = NULL;
+
+        if( message != NULL )
+            _capsule_clear( message );
+
+        cache_path = build_filename_alloc( tree, ld_cache_filenames[j], NULL );
+
+        if( ld_cache_open( &shared_ld_caches[i].cache, cache_path,
+                           code, message ) )
+        {
+            shared_ld_caches[i].tree = tree;
+            return &shared_ld_caches[i].cache;
+        }
+    }
+
+    // return the last error
+    return NULL;
+}
+
+static void
+close_shared_ld_caches( void )
+{
+    size_t i;
+
+    for( i = 0; i < N_ELEMENTS( shared_ld_caches ); i++ )
+    {
+        if( shared_ld_caches[i].tree != NULL )
+            ld_cache_close( &shared_ld_caches[i].cache );
+
+        shared_ld_caches[i].tree = NULL;
+    }
+}
+
 static bool
 init_with_target( ld_libs *ldlibs, const char *tree, const char *target,
                   int *code, char **message )
 {
+    const ld_cache *cache;
+
     if( !ld_libs_init( ldlibs, NULL, tree, debug_flags, code, message ) )
     {
         goto fail;
     }
 
-    if( !ld_libs_load_cache( ldlibs, code, message ) )
+    cache = get_shared_ld_cache( tree, code, message );
+
+    if( cache == NULL )
     {
         goto fail;
     }
 
+    ld_cache_borrow( &ldlibs->ldcache, cache );
+
     if( !ld_libs_set_target( ldlibs, target, code, message ) )
     {
         goto fail;
@@ -867,31 +951,18 @@ capture_soname_match( const char *pattern, const capture_options *options,
         .code = code,
         .message = message,
     };
+    const ld_cache *cache;
     bool ret = false;
-    size_t i;
 
     DEBUG( DEBUG_TOOL, "%s", pattern );
 
-    for( i = 0; ld_cache_filenames[i] != NULL; i++ )
-    {
-        _capsule_autofree char *cache_path = NULL;
-
-        if( message != NULL )
-            _capsule_clear( message );
-
-        cache_path = build_filename_alloc( option_provider,
-                                           ld_cache_filenames[i],
-                                           NULL );
+    cache = get_shared_ld_cache( option_provider, code, message );
 
-        if( ld_cache_open( &ctx.cache, cache_path, code, message ) )
-            break;
-        else
-            assert( !ctx.cache.is_open );
-    }
-
-    if( !ctx.cache.is_open )
+    if( cache == NULL )
         goto out;
 
+    ld_cache_borrow( &ctx.cache, cache );
+
     if( ld_cache_foreach( &ctx.cache, cache_foreach_cb, &ctx ) != 0 )
         goto out;
 
@@ -1333,6 +1404,185 @@ capture_patterns( const char * const *patterns,
     return true;
 }
 
+static bool
+open_dest( const char *dest, int *code, char **message )
+{
+    if( strcmp( dest, "." ) != 0 &&
+        mkdir( dest, 0755 ) < 0 &&
+        errno != EEXIST )
+    {
+        int saved_errno = errno;
+
+        _capsule_set_error( code, message, saved_errno,
+                            "creating \"%s\": %s",
+                            dest, strerror( saved_errno ) );
+        return false;
+    }
+
+    dest_fd = open( dest, O_RDWR|O_DIRECTORY|O_CLOEXEC|O_PATH );
+
+    if( dest_fd < 0 )
+    {
+        int saved_errno = errno;
+
+        _capsule_set_error( code, message, saved_errno,
+                            "opening \"%s\": %s",
+                            dest, strerror( saved_errno ) );
+        return false;
+    }
+
+    option_dest = dest;
+    return true;
+}
+
+static void
+close_dest( void )
+{
+    if( dest_fd >= 0 )
+        close( dest_fd );
+
+    dest_fd = -1;
+    option_dest = ".";
+}
+
+/*
+ * capture_request:
+ * @request: (array zero-terminated=1): LIBDIR followed by PATTERNs
+ *
+ * Handle one request in --batch mode.
+ */
+static bool
+capture_request( const char * const *request,
+                 const capture_options *options,
+                 int *code, char **message )
+{
+    bool ret;
+
+    if( request[0] == NULL || request[1] == NULL )
+    {
+        _capsule_set_error( code, message, EINVAL,
+                            "A request must contain a LIBDIR and "
+                            "one or more patterns" );
+        return false;
+    }
+
+    if( !open_dest( request[0], code, message ) )
+        return false;
+
+    ret = capture_patterns( request + 1, options, code, message );
+    close_dest();
+    return ret;
+}
+
+/*
+ * run_batch:
+ *
+ * Read requests from standard input until EOF, and reply to each one
+ * on standard output. The ld.so.cache and the options parsed from the
+ * command line are kept for the whole run, so this is considerably
+ * cheaper than starting a new process per request.
+ */
+static bool
+run_batch( const capture_options *options, int *code, char **message )
+{
+    _capsule_autofree char *buf = NULL;
+    size_t buf_size = 0;
+    ptr_list *fields = ptr_list_alloc( 16 );
+    bool ret = false;
+
+    while( 1 )
+    {
+        ssize_t len = getdelim( &buf, &buf_size, '\0', stdin );
+
+        if( len < 0 )
+        {
+            if( ferror( stdin ) )
+            {
+                int saved_errno = errno;
+
+                _capsule_set_error( code, message, saved_errno,
+                                    "reading request: %s",
+                                    strerror( saved_errno ) );
+                goto out;
+            }
+
+            if( fields->next > 0 )
+            {
+                _capsule_set_error( code, message, EPROTO,
+                                    "Unexpected end of input in request" );
+                goto out;
+            }
+
+            break;
+        }
+
+        if( buf[len - 1] != '\0' )
+        {
+            _capsule_set_error( code, message, EPROTO,
+                                "Unterminated field at end of input" );
+            goto out;
+        }
+
+        if( len > 1 )
+        {
+            ptr_list_push_ptr( fields, xstrdup( buf ) );
+        }
+        else
+        {
+            int local_code = 0;
+            _capsule_autofree char *local_message = NULL;
+            char **request;
+
+            request = (char **) ptr_list_free_to_array(
+                _capsule_steal_pointer( &fields ), NULL );
+            fields = ptr_list_alloc( 16 );
+
+            if( capture_request( (const char * const *) request, options,
+                                 &local_code, &local_message ) )
+            {
+                puts( "ok" );
+            }
+            else
+            {
+                char *p;
+
+                // The reply must stay on one line
+                for( p = local_message; p != NULL && *p != '\0'; p++ )
+                {
+                    if( *p == '\n' )
+                        *p = ' ';
+                }
+
+                printf( "error %d %s\n", local_code,
+                        local_message != NULL ? local_message : "(no message)" );
+            }
+
+            free_strv_full( request );
+
+            if( fflush( stdout ) != 0 )
+            {
+                int saved_errno = errno;
+
+                _capsule_set_error( code, message, saved_errno,
+                                    "writing reply: %s",
+                                    strerror( saved_errno ) );
+                goto out;
+            }
+        }
+    }
+
+    ret = true;
+
+out:
+    if( fields != NULL )
+    {
+        char **tmp_to_free = (char **) ptr_list_free_to_array( _capsule_steal_pointer( &fields ), NULL );
+        free_strv_full( tmp_to_free );
+    }
+
+    return ret;
+}
+
 int
 main (int argc, char **argv)
 {
@@ -1344,6 +1594,7 @@ main (int argc, char **argv)
     };
     const char *option_compare_by = "name,provider";
     const char *option_library_knowledge = NULL;
+    bool option_batch = false;
     int code = 0;
     _capsule_autofree char *message = NULL;
     // Arbitrary initialization size
@@ -1371,6 +1622,10 @@ main (int argc, char **argv)
                 usage( 0 );
                 break;  // not reached
 
+            case OPTION_BATCH:
+                option_batch = true;
+                break;
+
             case OPTION_COMPARE_BY:
                 option_compare_by = optarg;
                 break;
@@ -1439,7 +1694,14 @@ main (int argc, char **argv)
         }
     }
 
-    if( optind >= argc )
+    if( option_batch && optind < argc )
+    {
+        capsule_warn( "Patterns cannot be provided on the command line "
+                      "with --batch" );
+        usage( 2 );
+    }
+
+    if( !option_batch && optind >= argc )
     {
         capsule_warn( "One or more patterns must be provided" );
         usage( 2 );
@@ -1470,13 +1732,6 @@ main (int argc, char **argv)
     arg_patterns = (const char * const *) argv + optind;
     assert( arg_patterns[argc - optind] == NULL );
 
-    if( strcmp( option_dest, "." ) != 0 &&
-        mkdir( option_dest, 0755 ) < 0 &&
-        errno != EEXIST )
-    {
-        capsule_err( 1, "creating \"%s\": %s", option_dest, strerror( errno ) );
-    }
-
     options.comparators = library_cmp_list_from_string( option_compare_by, ",",
                                                         &code, &message );
 
@@ -1504,19 +1759,29 @@ main (int argc, char **argv)
         fclose( fh );
     }
 
-    dest_fd = open( option_dest, O_RDWR|O_DIRECTORY|O_CLOEXEC|O_PATH );
-
-    if( dest_fd < 0 )
+    if( option_batch )
     {
-        capsule_err( 1, "opening \"%s\": %s", option_dest, strerror( errno ) );
+        if( !run_batch( &options, &code, &message ) )
+        {
+            capsule_err( 1, "code %d: %s", code, message );
+        }
     }
-
-    if( !capture_patterns( arg_patterns, &options, &code, &message ) )
+    else
     {
-        capsule_err( 1, "code %d: %s", code, message );
+        if( !open_dest( option_dest, &code, &message ) )
+        {
+            capsule_err( 1, "%s", message );
+        }
+
+        if( !capture_patterns( arg_patterns, &options, &code, &message ) )
+        {
+            capsule_err( 1, "code %d: %s", code, message );
+        }
+
+        close_dest();
     }
 
-    close( dest_fd );
+    close_shared_ld_caches();
     free( options.comparators );
     library_knowledge_clear( &options.knowledge );
 
@@ -17,8 +17,10 @@
 // You should have received a copy of the GNU Lesser General Public
 // License along with libcapsule.  If not, see <http://www.gnu.org/licenses/>.
 
+#include <elf.h>
 #include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -78,6 +80,21 @@ static const char *const abi_tag_os[] =
 // end of stolen header structures
 ////////////////////////////////////////////////////////////////////////////
 
+// A hash table mapping each name in the cache to the entries with that
+// name, so that we don't have to walk the whole cache for each lookup.
+// It is built on first use, and shared by a cache and any borrowed
+// copies of it.
+struct ld_cache_index
+{
+    int built;
+    // always a power of 2
+    uint32_t n_buckets;
+    // (1 + the first entry) in each bucket, or 0 if empty
+    uint32_t *buckets;
+    // (1 + the next entry) in the same bucket as each entry, or 0
+    uint32_t *next;
+};
+
 const char * const ld_cache_filenames[] =
 {
 #ifdef __i386__
@@ -100,12 +117,33 @@ ld_cache_reset (ld_cache *cache)
     cache->file.old = NULL;
     cache->type     = CACHE_NONE;
     cache->mmap     = MAP_FAILED;
+    cache->index    = NULL;
     cache->is_open  = 0;
+    cache->is_borrowed = 0;
+}
+
+static void
+ld_cache_index_free (ld_cache_index *index)
+{
+    if( index == NULL )
+        return;
+
+    free( index->buckets );
+    free( index->next );
+    free( index );
 }
 
 void
 ld_cache_close (ld_cache *cache)
 {
+    // a borrowed cache shares its fd and mapping with the original,
+    // which remains responsible for releasing them:
+    if( cache->is_borrowed )
+    {
+        ld_cache_reset( cache );
+        return;
+    }
+
     // 0 is a valid fd, but is also the default value of the unset
     // struct member, so we have to check if it's _really_ open:
     if( cache->is_open )
@@ -117,9 +155,25 @@ ld_cache_close (ld_cache *cache)
     if( cache->mmap && cache->map_size )
         munmap( cache->mmap, cache->map_size );
 
+    ld_cache_index_free( cache->index );
     ld_cache_reset( cache );
 }
 
+// make dest a view of the cache already opened in src, so that the
+// same mapping can be searched by several users without re-opening it.
+// src must remain open for as long as dest is in use:
+void
+ld_cache_borrow (ld_cache *dest, const ld_cache *src)
+{
+    ld_cache_close( dest );
+
+    if( !src->is_open )
+        return;
+
+    *dest = *src;
+    dest->is_borrowed = 1;
+}
+
 int
 ld_cache_open (ld_cache *cache, const char *path, int *code, char **message)
 {
@@ -230,6 +284,8 @@ ld_cache_open (ld_cache *cache, const char *path, int *code, char **message)
         }
     }
 
+    cache->index = new0( ld_cache_index, 1 );
+
     DEBUG( DEBUG_LDCACHE, "Opened ld.cache at %s", path );
     return 1;
 
@@ -277,6 +333,186 @@ ld_cache_foreach (ld_cache *cache, ld_cache_entry_cb cb, void *data)
     return rval;
 }
 
+static unsigned int
+ld_cache_n_entries (const ld_cache *cache)
+{
+    switch( cache->type )
+    {
+      case CACHE_OLD:
+        return cache->file.old->nlibs;
+
+      case CACHE_NEW:
+        return cache->file.new->nlibs;
+
+      case CACHE_NONE:
+      default:
+        return 0;
+    }
+}
+
+static const char *
+ld_cache_entry_name (const ld_cache *cache, unsigned int i)
+{
+    if( cache->type == CACHE_NEW )
+        return cache->data + cache->file.new->libs[i].key;
+    else
+        return cache->data + cache->file.old->libs[i].key;
+}
+
+static intptr_t
+ld_cache_entry_call (const ld_cache *cache, unsigned int i,
+                     ld_cache_entry_cb cb, void *data)
+{
+    const char *base = cache->data;
+
+    if( cache->type == CACHE_NEW )
+    {
+        struct file_entry_new *f = &cache->file.new->libs[i];
+        return cb( base + f->key, f->flags,
+                   f->osversion, f->hwcap, base + f->value, data );
+    }
+    else
+    {
+        struct file_entry *f = &cache->file.old->libs[i];
+        return cb( base + f->key, f->flags, 0, 0, base + f->value, data );
+    }
+}
+
+// FNV-1a
+static uint32_t
+ld_cache_hash (const char *name)
+{
+    uint32_t h = 2166136261U;
+
+    for( ; *name != '\0'; name++ )
+    {
+        h ^= (unsigned char) *name;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+static void
+ld_cache_index_build (ld_cache *cache)
+{
+    ld_cache_index *index = cache->index;
+    unsigned int n = ld_cache_n_entries( cache );
+    uint32_t n_buckets = 16;
+    unsigned int i;
+
+    // aim for a load factor of no more than 0.5
+    while( n_buckets < n * 2 )
+        n_buckets <<= 1;
+
+    index->n_buckets = n_buckets;
+    index->buckets = xcalloc( n_buckets, sizeof( uint32_t ) );
+    index->next = xcalloc( n > 0 ? n : 1, sizeof( uint32_t ) );
+
+    // Insert in reverse order, so that each chain ends up in the same
+    // order as the cache itself, which is the order ld.so would use
+    for( i = n; i > 0; i-- )
+    {
+        const char *name = ld_cache_entry_name( cache, i - 1 );
+        uint32_t bucket;
+
+        if( name == NULL || *name == '\0' )
+            continue;
+
+        bucket = ld_cache_hash( name ) & ( n_buckets - 1 );
+        index->next[i - 1] = index->buckets[bucket];
+        index->buckets[bucket] = i;
+    }
+
+    index->built = 1;
+    DEBUG( DEBUG_LDCACHE, "Indexed %u ld.cache entries in %u buckets",
+           n, n_buckets );
+}
+
+// Like ld_cache_foreach(), but only for the entries whose name is
+// exactly name, in the same order as ld_cache_foreach() would visit them.
+intptr_t
+ld_cache_foreach_name (ld_cache *cache, const char *name,
+                       ld_cache_entry_cb cb, void *data)
+{
+    ld_cache_index *index = cache->index;
+    uint32_t e;
+
+    // not opened with ld_cache_open(): fall back to a linear search
+    if( index == NULL )
+        return ld_cache_foreach( cache, cb, data );
+
+    if( !index->built )
+        ld_cache_index_build( cache );
+
+    for( e = index->buckets[ld_cache_hash( name ) & ( index->n_buckets - 1 )];
+         e != 0;
+         e = index->next[e - 1] )
+    {
+        intptr_t rval;
+
+        if( strcmp( ld_cache_entry_name( cache, e - 1 ), name ) != 0 )
+            continue;
+
+        rval = ld_cache_entry_call( cache, e - 1, cb, data );
+
+        if( rval )
+            return rval;
+    }
+
+    return 0;
+}
+
+// Return the FLAG_REQUIRED_MASK bits that ldconfig would have set for
+// libraries of the given ELF class and machine, or -1 if unknown.
+int
+ld_cache_flags_for_elf (int elf_class, int elf_machine)
+{
+    switch( elf_machine )
+    {
+      case EM_386:
+        if( elf_class == ELFCLASS32 )
+            return 0;
+        else
+            return -1;
+
+      case EM_X86_64:
+        if( elf_class == ELFCLASS64 )
+            return FLAG_X8664_LIB64;
+        else if( elf_class == ELFCLASS32 )
+            return FLAG_X8664_LIBX32;
+        else
+            return -1;
+
+      case EM_AARCH64:
+        // we do not know what ldconfig sets for ILP32: leave it to the caller
+        if( elf_class == ELFCLASS64 )
+            return FLAG_AARCH64_LIB64;
+        else
+            return -1;
+
+      default:
+        return -1;
+    }
+}
+
+// Return true if an entry with the given flags might be suitable for
+// a library with FLAG_REQUIRED_MASK bits required, as returned by
+// ld_cache_flags_for_elf(). Anything we don't understand is assumed
+// to be suitable, leaving it to the caller to check the ELF headers.
+int
+ld_cache_flags_match (int flags, int required)
+{
+    if( required < 0 )
+        return 1;
+
+    if( ( flags & FLAG_TYPE_MASK ) != FLAG_ELF_LIBC6 &&
+        ( flags & FLAG_TYPE_MASK ) != FLAG_ELF )
+        return 1;
+
+    return ( flags & FLAG_REQUIRED_MASK ) == required;
+}
+
 intptr_t
 ld_entry_dump (const char *name,
                int flag,
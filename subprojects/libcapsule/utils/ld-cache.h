@@ -73,6 +73,8 @@ struct cache_file
     struct file_entry libs[0];
 };
 
+typedef struct ld_cache_index ld_cache_index;
+
 typedef struct
 {
     int fd;
@@ -81,7 +83,9 @@ typedef struct
     const char *data;
     union { struct cache_file *old; struct cache_file_new *new; } file;
     cache_type type;
+    ld_cache_index *index;
     int is_open;
+    int is_borrowed;
 } ld_cache;
 
 // ==========================================================================
@@ -98,7 +102,12 @@ typedef intptr_t (*ld_cache_entry_cb) (const char *name,
 int      ld_cache_open    (ld_cache *cache, const char *path, int *code,
                            char **message);
 void     ld_cache_close   (ld_cache *cache);
+void     ld_cache_borrow  (ld_cache *dest, const ld_cache *src);
 intptr_t ld_cache_foreach (ld_cache *cache, ld_cache_entry_cb cb, void *data);
+intptr_t ld_cache_foreach_name (ld_cache *cache, const char *name,
+                                ld_cache_entry_cb cb, void *data);
+int      ld_cache_flags_for_elf (int elf_class, int elf_machine);
+int      ld_cache_flags_match   (int flags, int required);
 
 intptr_t ld_entry_dump (const char *name, int flag, unsigned int osv,
                         uint64_t hwcap, const char *path, void *data);
@@ -39,6 +39,8 @@ struct dso_cache_search
     int idx;
     const char *name;
     ld_libs *ldlibs;
+    // ld.so.cache flags expected for our ELF class and machine, or -1
+    int required_flags;
 };
 
 static const struct stat *stat_caller (void);
@@ -399,6 +401,15 @@ search_ldcache_cb (const char *name, // name of the DSO in the ldcache
         int    idx    = target->idx;
         char  *lpath  = target->ldlibs->needed[ idx ].path;
 
+        // entries for a different architecture can't possibly be
+        // what we want, so don't waste time opening them
+        if( !ld_cache_flags_match( flag, target->required_flags ) )
+        {
+            LDLIB_DEBUG( target->ldlibs, DEBUG_SEARCH|DEBUG_LDCACHE,
+                         "skipping %s [%s]: flags 0x%x", name, path, flag );
+            return 0;
+        }
+
         LDLIB_DEBUG( target->ldlibs, DEBUG_SEARCH|DEBUG_LDCACHE,
                      "checking %s vs %s [%s]",
                      target->name, name, path );
@@ -446,6 +457,8 @@ search_ldcache (const char *name, ld_libs *ldlibs, int i)
     target.idx    = i;
     target.name   = name;
     target.ldlibs = ldlibs;
+    target.required_flags = ld_cache_flags_for_elf( ldlibs->elf_class,
+                                                    ldlibs->elf_machine );
 
     if( !ldlibs->ldcache.is_open )
     {
@@ -456,8 +469,8 @@ search_ldcache (const char *name, ld_libs *ldlibs, int i)
         }
     }
 
-    ld_cache_foreach( &ldlibs->ldcache,
-                      search_ldcache_cb, &target );
+    ld_cache_foreach_name( &ldlibs->ldcache, name,
+                           search_ldcache_cb, &target );
 
     return ldlibs->needed[i].fd >= 0;
 }
@@ -0,0 +1,147 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/env-overlay-internal.h"
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+
+/*
+ * Usage: env-builder-benchmark [ITERATIONS]
+ *
+ * steam-runtime-launcher-service starts from its own environment and
+ * applies the client's variables and unset requests to it. Do the same
+ * ITERATIONS times (default 100) for environments of 50, 500 and 5000
+ * variables, first with g_environ_setenv() and g_environ_unsetenv(),
+ * then with SrtEnvBuilder, and print the average time per environment.
+ */
+
+static GStrv
+make_environ (guint n,
+              const char *prefix)
+{
+  GStrv ret = g_new0 (gchar *, n + 1);
+  guint i;
+
+  for (i = 0; i < n; i++)
+    ret[i] = g_strdup_printf ("%s_VARIABLE_%u=value number %u", prefix, i, i);
+
+  return ret;
+}
+
+static GStrv
+build_with_environ (const char * const *base,
+                    const char * const *overrides,
+                    const char * const *unset)
+{
+  GStrv env = g_strdupv ((gchar **) base);
+  gsize i;
+
+  for (i = 0; overrides[i] != NULL; i++)
+    {
+      const char *eq = strchr (overrides[i], '=');
+      g_autofree gchar *var = g_strndup (overrides[i], eq - overrides[i]);
+
+      env = g_environ_setenv (env, var, eq + 1, TRUE);
+    }
+
+  for (i = 0; unset[i] != NULL; i++)
+    env = g_environ_unsetenv (env, unset[i]);
+
+  return g_environ_setenv (env, "PWD", "/", TRUE);
+}
+
+static GStrv
+build_with_builder (const char * const *base,
+                    const char * const *overrides,
+                    const char * const *unset)
+{
+  g_autoptr(SrtEnvBuilder) builder = _srt_env_builder_new (base);
+  gsize i;
+
+  for (i = 0; overrides[i] != NULL; i++)
+    {
+      const char *eq = strchr (overrides[i], '=');
+      g_autofree gchar *var = g_strndup (overrides[i], eq - overrides[i]);
+
+      _srt_env_builder_set (builder, var, eq + 1);
+    }
+
+  for (i = 0; unset[i] != NULL; i++)
+    _srt_env_builder_set (builder, unset[i], NULL);
+
+  _srt_env_builder_set (builder, "PWD", "/");
+  return _srt_env_builder_free_to_environ (g_steal_pointer (&builder));
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  static const guint sizes[] = { 50, 500, 5000 };
+  guint iterations = 100;
+  gsize i;
+
+  if (argc > 2)
+    {
+      g_printerr ("Usage: %s [ITERATIONS]\n", argv[0]);
+      return 2;
+    }
+
+  if (argc > 1)
+    iterations = (guint) g_ascii_strtoull (argv[1], NULL, 10);
+
+  for (i = 0; i < G_N_ELEMENTS (sizes); i++)
+    {
+      /* The launcher forwards the whole environment of the client,
+       * most of which is the same as its own */
+      g_auto(GStrv) base = make_environ (sizes[i], "BASE");
+      g_auto(GStrv) overrides = make_environ (sizes[i], "BASE");
+      g_auto(GStrv) unset = g_new0 (gchar *, sizes[i] / 10 + 1);
+      gint64 start, with_environ, with_builder;
+      guint j;
+
+      for (j = 0; j < sizes[i] / 10; j++)
+        unset[j] = g_strdup_printf ("BASE_VARIABLE_%u", j * 10);
+
+      start = g_get_monotonic_time ();
+
+      for (j = 0; j < iterations; j++)
+        {
+          g_auto(GStrv) env = NULL;
+
+          env = build_with_environ (_srt_const_strv (base),
+                                    _srt_const_strv (overrides),
+                                    _srt_const_strv (unset));
+        }
+
+      with_environ = g_get_monotonic_time () - start;
+      start = g_get_monotonic_time ();
+
+      for (j = 0; j < iterations; j++)
+        {
+          g_auto(GStrv) env = NULL;
+
+          env = build_with_builder (_srt_const_strv (base),
+                                    _srt_const_strv (overrides),
+                                    _srt_const_strv (unset));
+        }
+
+      with_builder = g_get_monotonic_time () - start;
+
+      g_print ("%u variables: g_environ_setenv %.3fms, "
+               "SrtEnvBuilder %.3fms per environment\n",
+               sizes[i],
+               with_environ / 1000.0 / iterations,
+               with_builder / 1000.0 / iterations);
+    }
+
+  return 0;
+}
@@ -110,6 +110,76 @@ test_apply (Fixture *f,
   g_assert_cmpstrv (envp, (gchar **) expected);
 }
 
+/*
+ * SrtEnvBuilder sets and unsets variables like g_environ_setenv() and
+ * g_environ_unsetenv(), except that the original order is preserved
+ * and duplicates are dropped.
+ */
+static void
+test_builder (Fixture *f,
+              gconstpointer context)
+{
+  static const char * const base[] =
+  {
+    "HOME=/home/me",
+    "MALFORMED",
+    "PATH=/usr/bin:/bin",
+    "SHELL=/bin/sh",
+    "TERM=xterm",
+    "HOME=/duplicate",
+    NULL
+  };
+  static const struct
+  {
+    const char *var;
+    const char *val;
+  } changes[] =
+  {
+    { "TERM", "dumb" },
+    { "NEW", "1" },
+    { "SHELL", NULL },
+    { "NOT_SET", NULL },
+    { "NEW", "2" },
+    { "EMPTY", "" },
+    { "SHELL", "/bin/bash" },
+    { "PATH", NULL },
+  };
+  static const char * const expected[] =
+  {
+    "HOME=/home/me",
+    "SHELL=/bin/bash",
+    "TERM=dumb",
+    "NEW=2",
+    "EMPTY=",
+    "MALFORMED",
+    NULL
+  };
+  g_autoptr(SrtEnvBuilder) builder = NULL;
+  g_auto(GStrv) envp = NULL;
+  gsize i;
+
+  builder = _srt_env_builder_new (base);
+  g_assert_cmpstr (_srt_env_builder_get (builder, "HOME"), ==, "/home/me");
+  g_assert_cmpstr (_srt_env_builder_get (builder, "MALFORMED"), ==, NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (changes); i++)
+    _srt_env_builder_set (builder, changes[i].var, changes[i].val);
+
+  g_assert_cmpstr (_srt_env_builder_get (builder, "NEW"), ==, "2");
+  g_assert_cmpstr (_srt_env_builder_get (builder, "PATH"), ==, NULL);
+
+  envp = _srt_env_builder_free_to_environ (g_steal_pointer (&builder));
+  dump_envp (_srt_const_strv (envp));
+  g_assert_cmpstrv (envp, (gchar **) expected);
+
+  builder = _srt_env_builder_new (NULL);
+  _srt_env_builder_set (builder, "ONLY", "this");
+  g_clear_pointer (&envp, g_strfreev);
+  envp = _srt_env_builder_free_to_environ (g_steal_pointer (&builder));
+  g_assert_cmpstr (envp[0], ==, "ONLY=this");
+  g_assert_cmpstr (envp[1], ==, NULL);
+}
+
 static void
 dump_env0 (GBytes *env0)
 {
@@ -263,6 +333,8 @@ main (int argc,
   _srt_tests_init (&argc, &argv, NULL);
   g_test_add ("/env-overlay/apply", Fixture, NULL,
               setup, test_apply, teardown);
+  g_test_add ("/env-overlay/builder", Fixture, NULL,
+              setup, test_builder, teardown);
   g_test_add ("/env-overlay/to-env0", Fixture, NULL,
               setup, test_to_env0, teardown);
   g_test_add ("/env-overlay/to-shell", Fixture, NULL,
@@ -31,7 +31,9 @@
 #include <steam-runtime-tools/steam-runtime-tools.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 #include <libelf.h>
 
@@ -41,6 +43,7 @@
 #include "steam-runtime-tools/graphics-internal.h"
 #include "steam-runtime-tools/graphics-drivers-json-based-internal.h"
 #include "steam-runtime-tools/system-info.h"
+#include "steam-runtime-tools/system-info-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
 #include "graphics-test-defines.h"
 #include "test-utils.h"
@@ -1952,6 +1955,7 @@ test_icd_openxr_json (Fixture *f,
   rt = (SrtOpenXr1Runtime *)
         load_manifest_from_json (SRT_TYPE_OPENXR_1_RUNTIME,
                                  sysroot,
+                                 NULL,
                                  sysroot_path_runtime_link,
                                  _SRT_GRAPHICS_MANIFEST_MEMBER_OPENXR_1_RUNTIME);
   g_assert_true (SRT_IS_OPENXR_1_RUNTIME (rt));
@@ -2035,6 +2039,7 @@ test_icd_openxr_json_functions (Fixture *f,
   rt = (SrtOpenXr1Runtime *)
         load_manifest_from_json (SRT_TYPE_OPENXR_1_RUNTIME,
                                  sysroot,
+                                 NULL,
                                  sysroot_path_runtime,
                                  _SRT_GRAPHICS_MANIFEST_MEMBER_OPENXR_1_RUNTIME);
   g_assert_true (SRT_IS_OPENXR_1_RUNTIME (rt));
@@ -2092,6 +2097,7 @@ test_icd_openxr_json_errors (Fixture *f,
       rt = (SrtOpenXr1Runtime *)
             load_manifest_from_json (SRT_TYPE_OPENXR_1_RUNTIME,
                                      sysroot,
+                                     NULL,
                                      tests[i].sysroot_runtime_path,
                                      _SRT_GRAPHICS_MANIFEST_MEMBER_OPENXR_1_RUNTIME);
       g_assert_true (SRT_IS_OPENXR_1_RUNTIME (rt));
@@ -2109,6 +2115,148 @@ test_icd_openxr_json_errors (Fixture *f,
     }
 }
 
+static void
+test_json_manifest_cache (Fixture *f,
+                          gconstpointer context)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SrtSysroot) sysroot = NULL;
+  g_autoptr(SrtJsonManifestCache) cache = NULL;
+  g_autoptr(SrtJsonManifestCache) other_cache = NULL;
+  g_autoptr(SrtJsonManifest) manifest = NULL;
+  g_autoptr(SrtJsonManifest) again = NULL;
+  g_autoptr(SrtJsonManifest) linked = NULL;
+  g_autoptr(SrtJsonManifest) uncached = NULL;
+  g_autoptr(SrtJsonManifest) elsewhere = NULL;
+  g_autoptr(SrtJsonManifest) replaced = NULL;
+  g_autoptr(SrtJsonManifest) rewritten = NULL;
+  g_autoptr(SrtJsonManifest) invalid = NULL;
+  g_autoptr(GPtrArray) paths = NULL;
+  struct timespec times[2];
+  struct stat before, after;
+  glnx_autofd int fd = -1;
+  g_autofree gchar *tmp_dir = NULL;
+  g_autofree gchar *a = NULL;
+  g_autofree gchar *b = NULL;
+  g_autofree gchar *c = NULL;
+  JsonNode *node = NULL;
+  const char *contents;
+  gsize len;
+
+  g_test_message ("Entering %s", G_STRFUNC);
+
+  tmp_dir = g_dir_make_tmp ("json-manifest-test-XXXXXX", &error);
+  g_assert_no_error (error);
+  a = g_build_filename (tmp_dir, "a.json", NULL);
+  b = g_build_filename (tmp_dir, "b.json", NULL);
+  c = g_build_filename (tmp_dir, "c.json", NULL);
+  g_file_set_contents (a, "{\"a\": 1}", -1, &error);
+  g_assert_no_error (error);
+  g_assert_cmpint (link (a, b), ==, 0);
+  g_file_set_contents (c, "{\"c\": ", -1, &error);
+  g_assert_no_error (error);
+
+  sysroot = _srt_sysroot_new (tmp_dir, &error);
+  g_assert_no_error (error);
+
+  paths = g_ptr_array_new ();
+  g_ptr_array_add (paths, (char *) "/a.json");
+  g_ptr_array_add (paths, (char *) "/a.json");
+  g_ptr_array_add (paths, (char *) "/b.json");
+  g_ptr_array_add (paths, (char *) "/c.json");
+  g_ptr_array_add (paths, (char *) "/missing.json");
+  cache = _srt_json_manifest_cache_new ();
+  _srt_json_manifest_prefetch (cache, sysroot, paths);
+
+  manifest = _srt_json_manifest_load (cache, sysroot, "/a.json",
+                                      SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (manifest);
+  contents = _srt_json_manifest_get_contents (manifest, &len);
+  g_assert_cmpstr (contents, ==, "{\"a\": 1}");
+  g_assert_cmpuint (len, ==, strlen (contents));
+  g_assert_true (_srt_json_manifest_get_root (manifest, &node, &error));
+  g_assert_no_error (error);
+  g_assert_nonnull (node);
+  g_assert_true (JSON_NODE_HOLDS_OBJECT (node));
+
+  /* The same file is only parsed once, even via a different name */
+  again = _srt_json_manifest_load (cache, sysroot, "/a.json",
+                                   SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (again == manifest);
+  linked = _srt_json_manifest_load (cache, sysroot, "/b.json",
+                                    SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (linked == manifest);
+
+  /* Without a cache, or with a different one, it is read again */
+  uncached = _srt_json_manifest_load (NULL, sysroot, "/a.json",
+                                      SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (uncached != manifest);
+  other_cache = _srt_json_manifest_cache_new ();
+  elsewhere = _srt_json_manifest_load (other_cache, sysroot, "/a.json",
+                                       SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (elsewhere != manifest);
+
+  /* A file that has been replaced is loaded again */
+  g_file_set_contents (a, "{\"a\": 2, \"b\": 3}", -1, &error);
+  g_assert_no_error (error);
+  replaced = _srt_json_manifest_load (cache, sysroot, "/a.json",
+                                      SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_true (replaced != manifest);
+  contents = _srt_json_manifest_get_contents (replaced, NULL);
+  g_assert_cmpstr (contents, ==, "{\"a\": 2, \"b\": 3}");
+
+  /* A file that was rewritten in-place with the same size, and had its
+   * mtime put back, is only distinguishable by its ctime */
+  fd = open (a, O_WRONLY | O_CLOEXEC);
+  g_assert_cmpint (fd, >=, 0);
+  g_assert_cmpint (fstat (fd, &before), ==, 0);
+  g_assert_cmpint (pwrite (fd, "{\"a\": 4, \"b\": 5}", 16, 0), ==, 16);
+  times[0] = before.st_atim;
+  times[1] = before.st_mtim;
+  g_assert_cmpint (futimens (fd, times), ==, 0);
+  g_assert_cmpint (fstat (fd, &after), ==, 0);
+  g_assert_cmpint (after.st_size, ==, before.st_size);
+  rewritten = _srt_json_manifest_load (cache, sysroot, "/a.json",
+                                       SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+
+  if (after.st_ctim.tv_sec != before.st_ctim.tv_sec
+      || after.st_ctim.tv_nsec != before.st_ctim.tv_nsec)
+    {
+      g_assert_true (rewritten != replaced);
+      contents = _srt_json_manifest_get_contents (rewritten, NULL);
+      g_assert_cmpstr (contents, ==, "{\"a\": 4, \"b\": 5}");
+    }
+  else
+    {
+      g_test_message ("ctime did not change within the timestamp granularity");
+    }
+
+  /* Invalid JSON is reported by get_root, not by load */
+  invalid = _srt_json_manifest_load (cache, sysroot, "/c.json",
+                                     SRT_RESOLVE_FLAGS_NONE, NULL, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (invalid);
+  g_assert_false (_srt_json_manifest_get_root (invalid, &node, &error));
+  g_assert_error (error, JSON_PARSER_ERROR, error->code);
+  g_assert_null (node);
+  g_clear_error (&error);
+
+  g_assert_null (_srt_json_manifest_load (cache, sysroot, "/missing.json",
+                                          SRT_RESOLVE_FLAGS_NONE, NULL,
+                                          &error));
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_clear_error (&error);
+
+  _srt_rm_rf (tmp_dir);
+}
+
 static void
 test_icd_openxr_search_paths_default (Fixture *f,
                                       gconstpointer context)
@@ -3328,6 +3476,136 @@ test_dri_flatpak (Fixture *f,
   check_list_suffixes (va_api, va_api_suffixes, SRT_GRAPHICS_VAAPI_MODULE);
 }
 
+/*
+ * Assert that the list of DRI drivers is reused from the cache, and
+ * that the cache is invalidated when a searched directory changes.
+ */
+static void
+test_dri_cache (Fixture *f,
+                gconstpointer context)
+{
+  g_autoptr(GError) error = NULL;
+  g_auto(GStrv) envp = NULL;
+  g_autofree gchar *tmp_dir = NULL;
+  g_autofree gchar *sysroot = NULL;
+  g_autofree gchar *cache_dir = NULL;
+  g_autofree gchar *dri_dir = NULL;
+  g_autofree gchar *cache_file = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autoptr(GString) injected = NULL;
+  g_autofree gchar *new_file = NULL;
+  const struct timespec old_times[2] = { { 1000000000, 0 }, { 1000000000, 0 } };
+  const char *name;
+  GDir *dir;
+  gsize i;
+
+  g_test_message ("Entering %s", G_STRFUNC);
+
+  tmp_dir = g_dir_make_tmp ("dri-cache-test-XXXXXX", &error);
+  g_assert_no_error (error);
+  sysroot = g_build_filename (tmp_dir, "sysroot", NULL);
+  cache_dir = g_build_filename (tmp_dir, "cache", NULL);
+  dri_dir = g_build_filename (sysroot, "custom_path", "dri", NULL);
+  g_assert_cmpint (g_mkdir_with_parents (dri_dir, 0755), ==, 0);
+
+  /* Results are not cached if a dependency changed less than a second
+   * before the search, so make the directory look older than that */
+  g_assert_cmpint (utimensat (AT_FDCWD, dri_dir, old_times, 0), ==, 0);
+
+  envp = g_get_environ ();
+  envp = g_environ_setenv (envp, "LIBGL_DRIVERS_PATH", "/custom_path/dri", TRUE);
+
+  for (i = 0; i < 3; i++)
+    {
+      g_autoptr(SrtSystemInfo) info = srt_system_info_new (NULL);
+      g_autoptr(SrtObjectList) dri = NULL;
+
+      srt_system_info_set_environ (info, envp);
+      srt_system_info_set_sysroot (info, sysroot);
+      _srt_system_info_set_check_flags (info, SRT_CHECK_FLAGS_SKIP_EXTRAS);
+      _srt_system_info_set_driver_cache_dir (info, cache_dir);
+      dri = srt_system_info_list_dri_drivers (info, SRT_ABI_X86_64,
+                                              SRT_DRIVER_FLAGS_NONE);
+
+      switch (i)
+        {
+          case 0:
+            /* The first search finds nothing, and is cached */
+            g_assert_null (dri);
+
+            dir = g_dir_open (cache_dir, 0, &error);
+            g_assert_no_error (error);
+            name = g_dir_read_name (dir);
+            g_assert_nonnull (name);
+            cache_file = g_build_filename (cache_dir, name, NULL);
+            g_assert_null (g_dir_read_name (dir));
+            g_dir_close (dir);
+
+            /* Edit the cached result, so that we can tell whether it
+             * was reused */
+            g_file_get_contents (cache_file, &contents, NULL, &error);
+            g_assert_no_error (error);
+            injected = g_string_new (contents);
+            g_assert_cmpuint (g_string_replace (injected,
+                                                "\"dri_drivers\":[]",
+                                                "\"dri_drivers\":[{\"library_path\":"
+                                                "\"/custom_path/dri/cached_dri.so\"}]",
+                                                0), ==, 1);
+            g_file_set_contents (cache_file, injected->str, -1, &error);
+            g_assert_no_error (error);
+            break;
+
+          case 1:
+            /* Nothing has changed, so the cached result is used */
+            g_assert_nonnull (dri);
+            g_assert_null (dri->next);
+            g_assert_cmpstr (srt_dri_driver_get_library_path (dri->data), ==,
+                             "/custom_path/dri/cached_dri.so");
+
+            /* Simulate a package upgrade by adding a file to the
+             * directory, which changes its mtime */
+            new_file = g_build_filename (dri_dir, "README", NULL);
+            g_file_set_contents (new_file, "", 0, &error);
+            g_assert_no_error (error);
+            break;
+
+          case 2:
+            /* The directory changed, so the cached result was discarded
+             * and we searched again */
+            g_assert_null (dri);
+            break;
+
+          default:
+            g_assert_not_reached ();
+        }
+    }
+
+  /* If the helper that looks for the loader libraries can't be run,
+   * the search is incomplete and its result is not cached */
+  {
+    g_autoptr(SrtSystemInfo) info = srt_system_info_new (NULL);
+    g_autoptr(SrtObjectList) dri = NULL;
+    g_autofree gchar *incomplete_cache_dir = NULL;
+    g_autofree gchar *no_helpers = NULL;
+
+    incomplete_cache_dir = g_build_filename (tmp_dir, "incomplete-cache", NULL);
+    no_helpers = g_build_filename (tmp_dir, "no-helpers", NULL);
+    envp = g_environ_unsetenv (envp, "LIBGL_DRIVERS_PATH");
+    envp = g_environ_setenv (envp, "SRT_TEST_DISABLE_LIBRARY_SCANNER", "1", TRUE);
+    srt_system_info_set_environ (info, envp);
+    srt_system_info_set_sysroot (info, sysroot);
+    srt_system_info_set_helpers_path (info, no_helpers);
+    _srt_system_info_set_driver_cache_dir (info, incomplete_cache_dir);
+    dri = srt_system_info_list_dri_drivers (info, SRT_ABI_X86_64,
+                                            SRT_DRIVER_FLAGS_NONE);
+    g_assert_null (dri);
+    g_assert_false (g_file_test (incomplete_cache_dir, G_FILE_TEST_EXISTS));
+  }
+
+  if (!_srt_rm_rf (tmp_dir))
+    g_debug ("Unable to remove temporary directory: %s", tmp_dir);
+}
+
 typedef struct
 {
   const gchar *description;
@@ -3874,6 +4152,79 @@ test_check_graphics (Fixture *f,
     }
 }
 
+static void
+assert_same_graphics (SrtGraphics *graphics,
+                      SrtGraphics *expected)
+{
+  g_assert_cmpint (srt_graphics_get_window_system (graphics), ==,
+                   srt_graphics_get_window_system (expected));
+  g_assert_cmpint (srt_graphics_get_rendering_interface (graphics), ==,
+                   srt_graphics_get_rendering_interface (expected));
+  g_assert_cmpint (srt_graphics_get_issues (graphics), ==,
+                   srt_graphics_get_issues (expected));
+  g_assert_cmpstr (srt_graphics_get_renderer_string (graphics), ==,
+                   srt_graphics_get_renderer_string (expected));
+  g_assert_cmpstr (srt_graphics_get_version_string (graphics), ==,
+                   srt_graphics_get_version_string (expected));
+  g_assert_cmpint (srt_graphics_get_exit_status (graphics), ==,
+                   srt_graphics_get_exit_status (expected));
+}
+
+/*
+ * Running the graphics checks in parallel, for one or several ABIs,
+ * gives the same results as running them one at a time.
+ */
+static void
+test_check_all_graphics_parallel (Fixture *f,
+                                  gconstpointer context)
+{
+  static const char * const multiarch_tuples[] =
+  {
+    "mock-good", "mock-bad", "mock-mixed", "mock-software", NULL
+  };
+  g_autoptr(SrtSystemInfo) sequential = srt_system_info_new (NULL);
+  g_autoptr(SrtSystemInfo) parallel = srt_system_info_new (NULL);
+  g_autoptr(SrtSystemInfo) all_abis = srt_system_info_new (NULL);
+  gsize i;
+
+  g_test_message ("Entering %s", G_STRFUNC);
+
+  srt_system_info_set_helpers_path (sequential, f->builddir);
+  _srt_system_info_set_max_parallel_checks (sequential, 1);
+  srt_system_info_set_helpers_path (parallel, f->builddir);
+  _srt_system_info_set_max_parallel_checks (parallel, 3);
+  srt_system_info_set_helpers_path (all_abis, f->builddir);
+  _srt_system_info_set_max_parallel_checks (all_abis, 0);
+  _srt_system_info_check_graphics_for_abis (all_abis, multiarch_tuples);
+
+  for (i = 0; multiarch_tuples[i] != NULL; i++)
+    {
+      g_autoptr(SrtObjectList) expected = NULL;
+      g_autoptr(SrtObjectList) list = NULL;
+      g_autoptr(SrtObjectList) list2 = NULL;
+      const GList *e, *l, *l2;
+
+      g_test_message ("%s", multiarch_tuples[i]);
+      expected = srt_system_info_check_all_graphics (sequential,
+                                                     multiarch_tuples[i]);
+      list = srt_system_info_check_all_graphics (parallel,
+                                                 multiarch_tuples[i]);
+      list2 = srt_system_info_check_all_graphics (all_abis,
+                                                  multiarch_tuples[i]);
+      g_assert_cmpuint (g_list_length (expected), ==, 6);
+      g_assert_cmpuint (g_list_length (list), ==, g_list_length (expected));
+      g_assert_cmpuint (g_list_length (list2), ==, g_list_length (expected));
+
+      for (e = expected, l = list, l2 = list2;
+           e != NULL;
+           e = e->next, l = l->next, l2 = l2->next)
+        {
+          assert_same_graphics (l->data, e->data);
+          assert_same_graphics (l2->data, e->data);
+        }
+    }
+}
+
 static gint
 glx_icd_compare (SrtGlxIcd *a, SrtGlxIcd *b)
 {
@@ -4060,6 +4411,9 @@ main (int argc,
               &openxr_loading_config_override,
               setup, test_icd_openxr_loading, teardown);
 
+  g_test_add ("/graphics/json-manifest/cache", Fixture, NULL,
+              setup, test_json_manifest_cache, teardown);
+
   g_test_add ("/graphics/layers/vulkan/xdg", Fixture, NULL,
               setup, test_layer_vulkan, teardown);
 
@@ -4073,12 +4427,16 @@ main (int argc,
               setup, test_dri_with_env, teardown);
   g_test_add ("/graphics/dri/flatpak", Fixture, NULL,
               setup, test_dri_flatpak, teardown);
+  g_test_add ("/graphics/dri/cache", Fixture, NULL,
+              setup, test_dri_cache, teardown);
 
   g_test_add ("/graphics/vdpau/basic", Fixture, NULL,
               setup, test_vdpau, teardown);
 
   g_test_add ("/graphics/check", Fixture, NULL,
               setup, test_check_graphics, teardown);
+  g_test_add ("/graphics/check-all-parallel", Fixture, NULL,
+              setup, test_check_all_graphics_parallel, teardown);
 
   g_test_add ("/graphics/glx/debian", Fixture, NULL,
               setup, test_glx_debian, teardown);
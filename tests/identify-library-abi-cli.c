@@ -284,6 +284,27 @@ test_arguments_validation (Fixture *f,
       .exit_status = 1,
       .stderr_contains = "Unable to find real path",
     },
+    {
+      .argv =
+      {
+        "steam-runtime-identify-library-abi",
+        "--ldconfig",
+        "--ld-so-cache=/etc/ld.so.cache",
+        NULL,
+      },
+      .exit_status = EX_USAGE,
+      .stderr_contains = "Exactly one of",
+    },
+    {
+      .argv =
+      {
+        "steam-runtime-identify-library-abi",
+        "--ld-so-cache",
+        "/this_file_does_not_exist",
+        NULL,
+      },
+      .exit_status = 1,
+    },
   };
 
   for (gsize i = 0; i < G_N_ELEMENTS (identify_lib_abi); i++)
@@ -347,25 +368,12 @@ test_library_identification (Fixture *f,
     NULL,
     NULL,
   };
-
-  ret = g_spawn_sync (NULL,    /* working directory */
-                      (gchar **) argv,
-                      NULL,    /* envp */
-                      G_SPAWN_SEARCH_PATH,
-                      NULL,    /* child setup */
-                      NULL,    /* user data */
-                      &child_stdout,
-                      &child_stderr,
-                      &exit_status,
-                      &error);
-  g_assert_no_error (error);
-  g_assert_true (ret);
-  g_assert_cmpint (exit_status, ==, 0);
-  g_assert_nonnull (child_stdout);
-  g_assert_cmpstr (child_stdout, !=, "");
-  g_assert_true (g_utf8_validate (child_stdout, -1, NULL));
-  g_assert_nonnull (child_stderr);
-
+  const gchar *list_modes[] =
+  {
+    "--ldconfig",
+    "--ld-so-cache=/etc/ld.so.cache",
+  };
+  gsize mode;
   const LibInfo glib_info[] =
   {
     {
@@ -386,28 +394,61 @@ test_library_identification (Fixture *f,
     },
   };
 
-  for (i = 0; i < G_N_ELEMENTS (glib_info); i++)
+  for (mode = 0; mode < G_N_ELEMENTS (list_modes); mode++)
     {
-      g_autofree gchar *expected_out_line = NULL;
-      gchar *out_line = strstr (child_stdout, glib_info[i].path);
-      if (out_line != NULL)
+      if (mode > 0 && !g_file_test ("/etc/ld.so.cache", G_FILE_TEST_EXISTS))
         {
-          gchar *end_of_line = strstr (out_line, "\n");
-          g_assert_nonnull (end_of_line);
-          end_of_line[0] = '\0';
-          expected_out_line = g_strdup_printf ("%s=%s", glib_info[i].path, glib_info[i].abi);
-          g_assert_cmpstr (out_line, ==, expected_out_line);
-          end_of_line[0] = '\n';
+          g_test_message ("/etc/ld.so.cache not found, skipping %s",
+                          list_modes[mode]);
+          continue;
         }
-      else
+
+      argv[1] = list_modes[mode];
+      /* Also check that the optional unordered output works */
+      argv[2] = (mode > 0 ? "--unordered" : NULL);
+      g_test_message ("Running: %s %s", argv[0], argv[1]);
+
+      ret = g_spawn_sync (NULL,    /* working directory */
+                          (gchar **) argv,
+                          NULL,    /* envp */
+                          G_SPAWN_SEARCH_PATH,
+                          NULL,    /* child setup */
+                          NULL,    /* user data */
+                          &child_stdout,
+                          &child_stderr,
+                          &exit_status,
+                          &error);
+      g_assert_no_error (error);
+      g_assert_true (ret);
+      g_assert_cmpint (exit_status, ==, 0);
+      g_assert_nonnull (child_stdout);
+      g_assert_cmpstr (child_stdout, !=, "");
+      g_assert_true (g_utf8_validate (child_stdout, -1, NULL));
+      g_assert_nonnull (child_stderr);
+
+      for (i = 0; i < G_N_ELEMENTS (glib_info); i++)
         {
-          g_test_message ("\"%s\" seems to not be available in ldconfig output, "
-                          "skipping this part of the test", glib_info[i].path);
+          g_autofree gchar *expected_out_line = NULL;
+          gchar *out_line = strstr (child_stdout, glib_info[i].path);
+          if (out_line != NULL)
+            {
+              gchar *end_of_line = strstr (out_line, "\n");
+              g_assert_nonnull (end_of_line);
+              end_of_line[0] = '\0';
+              expected_out_line = g_strdup_printf ("%s=%s", glib_info[i].path, glib_info[i].abi);
+              g_assert_cmpstr (out_line, ==, expected_out_line);
+              end_of_line[0] = '\n';
+            }
+          else
+            {
+              g_test_message ("\"%s\" seems to not be available in ldconfig output, "
+                              "skipping this part of the test", glib_info[i].path);
+            }
         }
-    }
 
-  g_free (child_stdout);
-  g_free (child_stderr);
+      g_free (child_stdout);
+      g_free (child_stderr);
+    }
 
   argv[1] = "--directory";
   for (i = 0; i < G_N_ELEMENTS (glib_info); i++)
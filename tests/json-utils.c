@@ -25,6 +25,8 @@
 
 #include <steam-runtime-tools/steam-runtime-tools.h>
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <glib-object.h>
@@ -182,6 +184,85 @@ test_get_hex_uint32_member (Fixture *f,
   g_assert_cmpuint (value, ==, 99);
 }
 
+static void
+test_scan_object_members (Fixture *f,
+                          gconstpointer context)
+{
+  static const char * const invalid[] =
+  {
+    "",
+    "[]",
+    "{\"a\" 1}",
+    "{\"a\": }",
+    "{\"a\": {\"b\": [1, 2}",
+    "{\"a\": \"unterminated}",
+    "{\"a\": 1,}",
+    "{\"a\": 1} {}",
+  };
+  static const char text[] =
+    " {\"empty\": {}, \"s\" : \"a \\\"}\\\" b\",\n"
+    "  \"n\":-1.5e3,\"t\\u0041b\": true,\n"
+    "  \"nested\": {\"x\": [1, {\"y\": \"]\"}], \"z\": null} }\n";
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GArray) members = NULL;
+  const SrtJsonMember *m;
+  gsize i;
+
+  members = _srt_json_scan_object_members (text, strlen (text), &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (members);
+  g_assert_cmpuint (members->len, ==, 5);
+
+  m = &g_array_index (members, SrtJsonMember, 0);
+  g_assert_cmpstr (m->name, ==, "empty");
+  g_assert_cmpuint (m->key_start, ==, 2);
+  g_assert_cmpmem (text + m->start, m->end - m->start, "{}", 2);
+
+  m = &g_array_index (members, SrtJsonMember, 1);
+  g_assert_cmpstr (m->name, ==, "s");
+  g_assert_cmpmem (text + m->start, m->end - m->start,
+                   "\"a \\\"}\\\" b\"", strlen ("\"a \\\"}\\\" b\""));
+
+  m = &g_array_index (members, SrtJsonMember, 2);
+  g_assert_cmpstr (m->name, ==, "n");
+  g_assert_cmpmem (text + m->start, m->end - m->start, "-1.5e3", 6);
+
+  m = &g_array_index (members, SrtJsonMember, 3);
+  g_assert_cmpstr (m->name, ==, "tAb");
+  g_assert_cmpmem (text + m->start, m->end - m->start, "true", 4);
+
+  m = &g_array_index (members, SrtJsonMember, 4);
+  g_assert_cmpstr (m->name, ==, "nested");
+  g_assert_cmpint (text[m->start], ==, '{');
+  g_assert_cmpint (text[m->end - 1], ==, '}');
+  g_assert_cmpint (text[m->end], ==, ' ');
+
+  g_clear_pointer (&members, g_array_unref);
+  members = _srt_json_scan_object_members ("{ }", 3, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (members);
+  g_assert_cmpuint (members->len, ==, 0);
+
+  for (i = 0; i < G_N_ELEMENTS (invalid); i++)
+    {
+      g_test_message ("%s", invalid[i]);
+      g_clear_pointer (&members, g_array_unref);
+      members = _srt_json_scan_object_members (invalid[i], strlen (invalid[i]),
+                                               &error);
+      g_assert_null (members);
+      g_assert_nonnull (error);
+      g_test_message ("-> %s", error->message);
+      g_clear_error (&error);
+    }
+
+  /* '\0' is not whitespace, even though strchr() would find it */
+  g_clear_pointer (&members, g_array_unref);
+  members = _srt_json_scan_object_members ("{\0\"a\": 1}", 9, &error);
+  g_assert_null (members);
+  g_assert_nonnull (error);
+  g_clear_error (&error);
+}
+
 int
 main (int argc,
       char **argv)
@@ -193,6 +274,8 @@ main (int argc,
               setup, test_dup_strv_member, teardown);
   g_test_add ("/json-utils/get-hex-uint32-member", Fixture, NULL,
               setup, test_get_hex_uint32_member, teardown);
+  g_test_add ("/json-utils/scan-object-members", Fixture, NULL,
+              setup, test_scan_object_members, teardown);
 
   return g_test_run ();
 }
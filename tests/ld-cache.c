@@ -0,0 +1,295 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <string.h>
+
+#include <glib.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/ld-cache-internal.h"
+#include "test-utils.h"
+
+typedef struct
+{
+  GLnxTmpDir tmpdir;
+} Fixture;
+
+typedef struct
+{
+  int unused;
+} Config;
+
+static void
+setup (Fixture *f,
+       gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+  g_autoptr(GError) error = NULL;
+
+  glnx_mkdtemp ("test-XXXXXX", 0700, &f->tmpdir, &error);
+  g_assert_no_error (error);
+}
+
+static void
+teardown (Fixture *f,
+          gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+  g_autoptr(GError) error = NULL;
+
+  glnx_tmpdir_delete (&f->tmpdir, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+append_uint32 (GByteArray *buf,
+               guint32 value)
+{
+  g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+}
+
+static void
+append_zeroes (GByteArray *buf,
+               gsize n)
+{
+  static const guint8 zeroes[64] = {};
+
+  g_assert_cmpuint (n, <=, sizeof (zeroes));
+  g_byte_array_append (buf, zeroes, n);
+}
+
+/*
+ * Append a cache in the old format. Each key is the basename of the
+ * corresponding path, sharing its storage, as ldconfig(8) does.
+ * String offsets are relative to the end of the entries, and the first
+ * string is at @first_offset.
+ *
+ * If @with_strings is false, the string table is not appended:
+ * this is used for the compat format, where the old entries refer to
+ * strings stored after the new entries.
+ */
+static void
+append_old_cache (GByteArray *buf,
+                  const char * const *paths,
+                  gsize n_paths,
+                  guint32 first_offset,
+                  gboolean with_strings)
+{
+  guint32 offset = first_offset;
+  gsize i;
+
+  g_byte_array_append (buf, (const guint8 *) "ld.so-1.7.0", 11);
+  append_zeroes (buf, 1);
+  append_uint32 (buf, n_paths);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      append_uint32 (buf, 0x0303);
+      append_uint32 (buf, offset + (strrchr (paths[i], '/') + 1 - paths[i]));
+      append_uint32 (buf, offset);
+      offset += strlen (paths[i]) + 1;
+    }
+
+  if (with_strings)
+    {
+      for (i = 0; i < n_paths; i++)
+        g_byte_array_append (buf, (const guint8 *) paths[i],
+                             strlen (paths[i]) + 1);
+    }
+}
+
+static void
+write_cache (Fixture *f,
+             const char *name,
+             GByteArray *buf)
+{
+  g_autoptr(GError) error = NULL;
+
+  glnx_file_replace_contents_at (f->tmpdir.fd, name, buf->data, buf->len,
+                                 0, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+assert_libraries (GPtrArray *libraries,
+                  const char * const *expected,
+                  gsize n_expected)
+{
+  gsize i;
+
+  g_assert_nonnull (libraries);
+
+  for (i = 0; i < libraries->len; i++)
+    g_test_message ("%s", (const char *) g_ptr_array_index (libraries, i));
+
+  g_assert_cmpuint (libraries->len, ==, n_expected);
+
+  for (i = 0; i < n_expected; i++)
+    g_assert_cmpstr (g_ptr_array_index (libraries, i), ==, expected[i]);
+}
+
+static const char * const old_paths[] =
+{
+  "/old/lib/libfoo.so.1",
+  "/old/lib/libbar.so.2",
+};
+
+static const char * const new_paths[] =
+{
+  "/lib/x86_64-linux-gnu/libfoo.so.1",
+  "/lib/x86_64-linux-gnu/glibc-hwcaps/x86-64-v3/libbar.so.2",
+  "/lib/x86_64-linux-gnu/libbar.so.2",
+  "/lib/x86_64-linux-gnu/libfoo.so.1",
+};
+
+/* new_paths, without the duplicate */
+static const char * const expected_new_paths[] =
+{
+  "/lib/x86_64-linux-gnu/libfoo.so.1",
+  "/lib/x86_64-linux-gnu/glibc-hwcaps/x86-64-v3/libbar.so.2",
+  "/lib/x86_64-linux-gnu/libbar.so.2",
+};
+
+static void
+test_formats (Fixture *f,
+              gconstpointer context)
+{
+  g_autoptr(GByteArray) buf = NULL;
+  g_autoptr(GPtrArray) libraries = NULL;
+  g_autoptr(GPtrArray) entries = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize padding;
+  gsize i;
+
+  g_test_message ("New format (glibc >= 2.32 default)");
+  buf = g_byte_array_new ();
+  tests_append_ld_cache (buf, new_paths, G_N_ELEMENTS (new_paths), 0x0303);
+  write_cache (f, "new.cache", buf);
+  libraries = _srt_ld_cache_list_libraries (f->tmpdir.fd, "new.cache", &error);
+  g_assert_no_error (error);
+  assert_libraries (libraries, expected_new_paths,
+                    G_N_ELEMENTS (expected_new_paths));
+  g_clear_pointer (&libraries, g_ptr_array_unref);
+  g_clear_pointer (&buf, g_byte_array_unref);
+
+  g_test_message ("Old format");
+  buf = g_byte_array_new ();
+  append_old_cache (buf, old_paths, G_N_ELEMENTS (old_paths), 0, TRUE);
+  write_cache (f, "old.cache", buf);
+  libraries = _srt_ld_cache_list_libraries (f->tmpdir.fd, "old.cache", &error);
+  g_assert_no_error (error);
+  assert_libraries (libraries, old_paths, G_N_ELEMENTS (old_paths));
+  g_clear_pointer (&libraries, g_ptr_array_unref);
+  g_clear_pointer (&buf, g_byte_array_unref);
+
+  g_test_message ("Compat format (glibc < 2.32 default)");
+  buf = g_byte_array_new ();
+  /* The old entries are followed by padding to a multiple of 8 bytes,
+   * then the new header and entries, then the shared string table */
+  padding = (8 - ((16 + 12 * G_N_ELEMENTS (new_paths)) % 8)) % 8;
+  append_old_cache (buf, new_paths, G_N_ELEMENTS (new_paths),
+                    padding + 48 + 24 * G_N_ELEMENTS (new_paths), FALSE);
+  append_zeroes (buf, padding);
+  g_assert_cmpuint (buf->len % 8, ==, 0);
+  tests_append_ld_cache (buf, new_paths, G_N_ELEMENTS (new_paths), 0x0303);
+  write_cache (f, "compat.cache", buf);
+  libraries = _srt_ld_cache_list_libraries (f->tmpdir.fd, "compat.cache",
+                                            &error);
+  g_assert_no_error (error);
+  assert_libraries (libraries, expected_new_paths,
+                    G_N_ELEMENTS (expected_new_paths));
+
+  g_test_message ("Entries, including duplicates");
+  entries = _srt_ld_cache_list_entries (f->tmpdir.fd, "compat.cache", &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (entries);
+  g_assert_cmpuint (entries->len, ==, G_N_ELEMENTS (new_paths));
+
+  for (i = 0; i < entries->len; i++)
+    {
+      const SrtLdCacheEntry *entry = g_ptr_array_index (entries, i);
+
+      g_assert_cmpstr (entry->path, ==, new_paths[i]);
+      g_assert_cmpstr (entry->soname, ==, strrchr (new_paths[i], '/') + 1);
+    }
+}
+
+static void
+test_invalid (Fixture *f,
+              gconstpointer context)
+{
+  g_autoptr(GByteArray) buf = NULL;
+  g_autoptr(GPtrArray) libraries = NULL;
+  g_autoptr(GError) error = NULL;
+
+  g_test_message ("Nonexistent");
+  libraries = _srt_ld_cache_list_libraries (f->tmpdir.fd, "nope", &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND);
+  g_assert_null (libraries);
+  g_clear_error (&error);
+
+  g_test_message ("Not a cache");
+  buf = g_byte_array_new ();
+  g_byte_array_append (buf, (const guint8 *) "#!/bin/sh\nexit 0\n", 17);
+  write_cache (f, "garbage", buf);
+  libraries = _srt_ld_cache_list_libraries (f->tmpdir.fd, "garbage", &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_test_message ("-> %s", error->message);
+  g_assert_null (libraries);
+  g_clear_error (&error);
+  g_clear_pointer (&buf, g_byte_array_unref);
+
+  g_test_message ("Truncated");
+  buf = g_byte_array_new ();
+  tests_append_ld_cache (buf, new_paths, G_N_ELEMENTS (new_paths), 0x0303);
+  g_byte_array_set_size (buf, 48 + 24);
+  write_cache (f, "truncated", buf);
+  libraries = _srt_ld_cache_list_libraries (f->tmpdir.fd, "truncated", &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_test_message ("-> %s", error->message);
+  g_assert_null (libraries);
+  g_clear_error (&error);
+}
+
+static void
+test_system (Fixture *f,
+             gconstpointer context)
+{
+  g_autoptr(GPtrArray) libraries = NULL;
+  g_autoptr(GError) error = NULL;
+  gsize i;
+
+  if (!g_file_test ("/etc/ld.so.cache", G_FILE_TEST_EXISTS))
+    {
+      g_test_skip ("/etc/ld.so.cache not found");
+      return;
+    }
+
+  libraries = _srt_ld_cache_list_libraries (AT_FDCWD, "/etc/ld.so.cache",
+                                            &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (libraries);
+  g_test_message ("%u libraries", libraries->len);
+
+  for (i = 0; i < libraries->len; i++)
+    g_assert_true (g_path_is_absolute (g_ptr_array_index (libraries, i)));
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  _srt_tests_init (&argc, &argv, NULL);
+  g_test_add ("/ld-cache/formats", Fixture, NULL,
+              setup, test_formats, teardown);
+  g_test_add ("/ld-cache/invalid", Fixture, NULL,
+              setup, test_invalid, teardown);
+  g_test_add ("/ld-cache/system", Fixture, NULL,
+              setup, test_system, teardown);
+
+  return g_test_run ();
+}
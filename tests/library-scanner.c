@@ -0,0 +1,537 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <elf.h>
+#include <string.h>
+
+#include <glib.h>
+
+#include "libglnx.h"
+
+#include <steam-runtime-tools/steam-runtime-tools.h>
+#include "steam-runtime-tools/architecture-internal.h"
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/library-scanner-internal.h"
+#include "steam-runtime-tools/resolve-in-sysroot-internal.h"
+#include "steam-runtime-tools/subprocess-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+#include "test-utils.h"
+
+typedef struct
+{
+  GLnxTmpDir tmpdir;
+  SrtSysroot *sysroot;
+  const char *multiarch_tuple;
+  gchar *libdir;
+  gchar *exe_contents;
+  gsize exe_len;
+} Fixture;
+
+typedef struct
+{
+  int unused;
+} Config;
+
+/*
+ * Return the flags that ldconfig(8) would have set in the ld.so cache
+ * for a library of architecture @arch.
+ */
+static guint32
+ld_cache_flags_for_architecture (const SrtKnownArchitecture *arch)
+{
+  /* FLAG_ELF_LIBC6 */
+  guint32 flags = 0x0003;
+
+  switch (arch->machine_type)
+    {
+      case EM_X86_64:
+        if (arch->elf_class == ELFCLASS64)
+          flags |= 0x0300;    /* FLAG_X8664_LIB64 */
+        else
+          flags |= 0x0800;    /* FLAG_X8664_LIBX32 */
+        break;
+
+      case EM_AARCH64:
+        flags |= 0x0a00;      /* FLAG_AARCH64_LIB64 */
+        break;
+
+      default:
+        break;
+    }
+
+  return flags;
+}
+
+/*
+ * Create @path in the sysroot as a copy of the test executable, which
+ * is an ELF object of a known ABI, so it can stand in for a library.
+ */
+static void
+create_library (Fixture *f,
+                const char *path)
+{
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *dir = g_path_get_dirname (path);
+
+  glnx_shutil_mkdir_p_at (f->tmpdir.fd, dir, 0755, NULL, &error);
+  g_assert_no_error (error);
+  glnx_file_replace_contents_at (f->tmpdir.fd, path,
+                                 (const guint8 *) f->exe_contents,
+                                 f->exe_len, 0, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+create_symlink (Fixture *f,
+                const char *target,
+                const char *path)
+{
+  if (symlinkat (target, f->tmpdir.fd, path) != 0)
+    g_error ("symlinkat %s: %s", path, g_strerror (errno));
+}
+
+static void
+setup (Fixture *f,
+       gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+  const SrtKnownArchitecture *arch;
+  g_autoptr(GByteArray) cache = g_byte_array_new ();
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *foo = NULL;
+  g_autofree gchar *bar = NULL;
+  g_autofree gchar *notelf = NULL;
+
+  glnx_mkdtemp ("test-XXXXXX", 0700, &f->tmpdir, &error);
+  g_assert_no_error (error);
+
+  f->multiarch_tuple = _srt_architecture_guess_from_elf (AT_FDCWD,
+                                                         "/proc/self/exe",
+                                                         &error);
+
+  if (f->multiarch_tuple == NULL)
+    {
+      g_test_message ("Unable to identify ABI: %s", error->message);
+      return;
+    }
+
+  arch = _srt_architecture_get_by_tuple (f->multiarch_tuple);
+  g_assert_nonnull (arch);
+
+  g_file_get_contents ("/proc/self/exe", &f->exe_contents, &f->exe_len,
+                       &error);
+  g_assert_no_error (error);
+
+  /* Listed in the ld.so cache */
+  f->libdir = g_build_filename ("lib", f->multiarch_tuple, NULL);
+  foo = g_build_filename ("/", f->libdir, "libfoo.so.1", NULL);
+  create_library (f, foo + 1);
+  bar = g_build_filename ("/", f->libdir, "libbar.so.1", NULL);
+  create_symlink (f, "libfoo.so.1", bar + 1);
+  notelf = g_build_filename ("/", f->libdir, "libnotelf.so.1", NULL);
+  glnx_file_replace_contents_at (f->tmpdir.fd, notelf + 1,
+                                 (const guint8 *) "hello\n", 6,
+                                 0, NULL, &error);
+  g_assert_no_error (error);
+
+  /* Only found via the default search path */
+  create_library (f, "usr/lib/libdefault.so.1");
+  /* Not in a directory that is searched by default */
+  path = g_build_filename ("usr", f->libdir, "libhidden.so.1", NULL);
+  create_library (f, path);
+
+  /* Only found via LD_LIBRARY_PATH */
+  create_library (f, "opt/lib/libfoo.so.1");
+  create_symlink (f, foo, "opt/lib/libabsolute.so.1");
+
+  {
+    const char * const paths[] = { bar, foo, notelf };
+
+    tests_append_ld_cache (cache, paths, G_N_ELEMENTS (paths),
+                           ld_cache_flags_for_architecture (arch));
+  }
+
+  glnx_shutil_mkdir_p_at (f->tmpdir.fd, "etc", 0755, NULL, &error);
+  g_assert_no_error (error);
+  glnx_file_replace_contents_at (f->tmpdir.fd, "etc/ld.so.cache",
+                                 cache->data, cache->len,
+                                 0, NULL, &error);
+  g_assert_no_error (error);
+
+  f->sysroot = _srt_sysroot_new (f->tmpdir.path, &error);
+  g_assert_no_error (error);
+}
+
+static void
+teardown (Fixture *f,
+          gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+  g_autoptr(GError) error = NULL;
+
+  g_clear_object (&f->sysroot);
+  g_clear_pointer (&f->libdir, g_free);
+  g_clear_pointer (&f->exe_contents, g_free);
+  glnx_tmpdir_delete (&f->tmpdir, NULL, &error);
+  g_assert_no_error (error);
+}
+
+static void
+test_find_soname (Fixture *f,
+                  gconstpointer context)
+{
+  g_autoptr(SrtFoundLibrary) found = NULL;
+  g_autoptr(SrtLibraryScanner) scanner = NULL;
+  g_autoptr(SrtLibraryScanner) again = NULL;
+  g_autofree gchar *expected = NULL;
+
+  if (f->sysroot == NULL)
+    {
+      g_test_skip ("ABI of test executable not known");
+      return;
+    }
+
+  scanner = _srt_library_scanner_get (f->sysroot);
+  g_assert_nonnull (scanner);
+  /* The same scanner is reused for the same sysroot */
+  again = _srt_library_scanner_get (f->sysroot);
+  g_assert_true (again == scanner);
+
+  /* Found in the ld.so cache */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libfoo.so.1", NULL);
+  g_assert_nonnull (found);
+  expected = g_build_filename ("/", f->libdir, "libfoo.so.1", NULL);
+  g_assert_cmpstr (found->name, ==, "libfoo.so.1");
+  g_assert_cmpstr (found->path, ==, expected);
+  g_assert_cmpstr (found->real_path, ==, expected);
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  /* A relative symlink is followed relative to its directory */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libbar.so.1", NULL);
+  g_assert_nonnull (found);
+  g_assert_cmpstr (found->name, ==, "libbar.so.1");
+  g_assert_true (g_str_has_prefix (found->path, "/lib/"));
+  g_assert_true (g_str_has_suffix (found->path, "/libbar.so.1"));
+  g_assert_cmpstr (found->real_path, ==, expected);
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  /* Listed in the ld.so cache, but not an ELF object */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libnotelf.so.1", NULL);
+  g_assert_null (found);
+
+  /* Not in the ld.so cache, so found in the default search path */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libdefault.so.1", NULL);
+  g_assert_nonnull (found);
+  g_assert_cmpstr (found->path, ==, "/usr/lib/libdefault.so.1");
+  g_assert_cmpstr (found->real_path, ==, "/usr/lib/libdefault.so.1");
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  /* Like capsule-capture-libs, we don't look in multiarch directories
+   * that are not in the ld.so cache */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libhidden.so.1", NULL);
+  g_assert_null (found);
+
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libmissing.so.1", NULL);
+  g_assert_null (found);
+
+  /* LD_LIBRARY_PATH takes precedence over the ld.so cache, and is
+   * interpreted relative to the sysroot */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libfoo.so.1",
+                                            ":/nonexistent:/opt/lib");
+  g_assert_nonnull (found);
+  g_assert_cmpstr (found->path, ==, "/opt/lib/libfoo.so.1");
+  g_assert_cmpstr (found->real_path, ==, "/opt/lib/libfoo.so.1");
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  /* An absolute symlink is followed relative to the sysroot */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libabsolute.so.1",
+                                            "/opt/lib");
+  g_assert_nonnull (found);
+  g_assert_cmpstr (found->path, ==, "/opt/lib/libabsolute.so.1");
+  g_assert_cmpstr (found->real_path, ==, expected);
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  /* Libraries that are not in LD_LIBRARY_PATH are still found in the
+   * ld.so cache and default search path */
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libbar.so.1", "/opt/lib");
+  g_assert_nonnull (found);
+  g_assert_cmpstr (found->real_path, ==, expected);
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  found = _srt_library_scanner_find_soname (scanner, f->multiarch_tuple,
+                                            "libdefault.so.1", "/opt/lib");
+  g_assert_nonnull (found);
+  g_assert_cmpstr (found->path, ==, "/usr/lib/libdefault.so.1");
+}
+
+static void
+test_match (Fixture *f,
+            gconstpointer context)
+{
+  g_autoptr(GPtrArray) found = NULL;
+  g_autoptr(SrtLibraryScanner) scanner = NULL;
+  g_autofree gchar *dir = NULL;
+  const SrtFoundLibrary *library;
+
+  if (f->sysroot == NULL)
+    {
+      g_test_skip ("ABI of test executable not known");
+      return;
+    }
+
+  scanner = _srt_library_scanner_get (f->sysroot);
+
+  /* Only ELF objects of the right ABI are matched, in ld.so cache order */
+  found = _srt_library_scanner_match_soname (scanner, f->multiarch_tuple,
+                                             "lib*.so.1");
+  g_assert_nonnull (found);
+  g_assert_cmpuint (found->len, ==, 2);
+  library = g_ptr_array_index (found, 0);
+  g_assert_cmpstr (library->name, ==, "libbar.so.1");
+  library = g_ptr_array_index (found, 1);
+  g_assert_cmpstr (library->name, ==, "libfoo.so.1");
+  g_clear_pointer (&found, g_ptr_array_unref);
+
+  found = _srt_library_scanner_match_soname (scanner, f->multiarch_tuple,
+                                             "libdefault.so.*");
+  g_assert_nonnull (found);
+  g_assert_cmpuint (found->len, ==, 0);
+  g_clear_pointer (&found, g_ptr_array_unref);
+
+  dir = g_build_filename ("/", f->libdir, NULL);
+  found = _srt_library_scanner_match_path (scanner, f->multiarch_tuple,
+                                           dir, "lib*.so.1");
+  g_assert_nonnull (found);
+  g_assert_cmpuint (found->len, ==, 2);
+  library = g_ptr_array_index (found, 0);
+  g_assert_cmpstr (library->name, ==, "libbar.so.1");
+  library = g_ptr_array_index (found, 1);
+  g_assert_cmpstr (library->name, ==, "libfoo.so.1");
+  g_clear_pointer (&found, g_ptr_array_unref);
+
+  found = _srt_library_scanner_match_path (scanner, f->multiarch_tuple,
+                                           "/nonexistent", "lib*.so.1");
+  g_assert_nonnull (found);
+  g_assert_cmpuint (found->len, ==, 0);
+}
+
+/*
+ * Return the library paths of @glx_icds and @vdpau_drivers, one per line,
+ * sorted so that they can be compared with _srt_assert_streq_diff().
+ */
+static gchar *
+describe_drivers (GList *glx_icds,
+                  GList *vdpau_drivers)
+{
+  g_autoptr(GPtrArray) lines = g_ptr_array_new_with_free_func (g_free);
+  GList *iter;
+
+  for (iter = glx_icds; iter != NULL; iter = iter->next)
+    g_ptr_array_add (lines,
+                     g_strdup_printf ("glx:%s=%s",
+                                      srt_glx_icd_get_library_soname (iter->data),
+                                      srt_glx_icd_get_library_path (iter->data)));
+
+  for (iter = vdpau_drivers; iter != NULL; iter = iter->next)
+    g_ptr_array_add (lines,
+                     g_strdup_printf ("vdpau:%s",
+                                      srt_vdpau_driver_get_library_path (iter->data)));
+
+  g_ptr_array_sort (lines, _srt_indirect_strcmp0);
+  g_ptr_array_add (lines, NULL);
+  return g_strjoinv ("\n", (gchar **) lines->pdata);
+}
+
+/*
+ * Replacing the ld.so cache, as ldconfig does after a package is
+ * installed or removed, makes _srt_library_scanner_get() start again.
+ */
+static void
+test_ld_cache_changed (Fixture *f,
+                       gconstpointer context)
+{
+  g_autoptr(GByteArray) cache = g_byte_array_new ();
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SrtFoundLibrary) found = NULL;
+  g_autoptr(SrtLibraryScanner) before = NULL;
+  g_autoptr(SrtLibraryScanner) after = NULL;
+  const char * const paths[] = { "/usr/lib/libdefault.so.1" };
+  const SrtKnownArchitecture *arch;
+
+  if (f->sysroot == NULL)
+    {
+      g_test_skip ("ABI of test executable not known");
+      return;
+    }
+
+  before = _srt_library_scanner_get (f->sysroot);
+  found = _srt_library_scanner_find_soname (before, f->multiarch_tuple,
+                                            "libfoo.so.1", NULL);
+  g_assert_nonnull (found);
+  g_clear_pointer (&found, _srt_found_library_free);
+
+  arch = _srt_architecture_get_by_tuple (f->multiarch_tuple);
+  tests_append_ld_cache (cache, paths, G_N_ELEMENTS (paths),
+                         ld_cache_flags_for_architecture (arch));
+  glnx_file_replace_contents_at (f->tmpdir.fd, "etc/ld.so.cache",
+                                 cache->data, cache->len,
+                                 0, NULL, &error);
+  g_assert_no_error (error);
+
+  after = _srt_library_scanner_get (f->sysroot);
+  g_assert_true (after != before);
+
+  /* The new scanner only sees the new ld.so cache */
+  found = _srt_library_scanner_find_soname (after, f->multiarch_tuple,
+                                            "libfoo.so.1", NULL);
+  g_assert_null (found);
+
+  /* A scanner that was already in use carries on with the old one */
+  found = _srt_library_scanner_find_soname (before, f->multiarch_tuple,
+                                            "libfoo.so.1", NULL);
+  g_assert_nonnull (found);
+}
+
+/*
+ * Check that the in-process scanner finds the same graphics drivers as
+ * the real capsule-capture-libs helper for the same sysroot.
+ */
+static void
+test_compare_with_helper (Fixture *f,
+                          gconstpointer context)
+{
+  g_autoptr(SrtSubprocessRunner) runner = _srt_subprocess_runner_new ();
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *helper = NULL;
+  g_autofree gchar *path = NULL;
+  g_autofree gchar *expected = NULL;
+  g_autofree gchar *actual = NULL;
+  g_auto(GStrv) envp = NULL;
+  g_auto(GStrv) helper_envp = NULL;
+  const char *helpers_path;
+  gsize i;
+
+  if (f->sysroot == NULL)
+    {
+      g_test_skip ("ABI of test executable not known");
+      return;
+    }
+
+  helpers_path = _srt_subprocess_runner_resolve_helpers_path (runner, &error);
+
+  if (helpers_path == NULL)
+    {
+      g_test_skip (error->message);
+      return;
+    }
+
+  helper = g_strdup_printf ("%s/%s-capsule-capture-libs",
+                            helpers_path, f->multiarch_tuple);
+
+  if (!g_file_test (helper, G_FILE_TEST_IS_EXECUTABLE))
+    {
+      g_test_skip ("capsule-capture-libs helper not available");
+      return;
+    }
+
+  /* A GLX ICD in the ld.so cache, found via a symlink */
+  path = g_build_filename ("usr", f->libdir, "libGLX_mesa.so.0.0.0", NULL);
+  create_library (f, path);
+  g_clear_pointer (&path, g_free);
+  path = g_build_filename ("usr", f->libdir, "libGLX_mesa.so.0", NULL);
+  create_symlink (f, "libGLX_mesa.so.0.0.0", path);
+  g_clear_pointer (&path, g_free);
+  /* A well-known GLX ICD only in the default search path */
+  create_library (f, "usr/lib/libGLX_nvidia.so.0");
+  /* A VDPAU driver in the ld.so cache */
+  path = g_build_filename ("usr", f->libdir, "libvdpau_nvidia.so", NULL);
+  create_library (f, path);
+  g_clear_pointer (&path, g_free);
+  /* A well-known VDPAU driver only in LD_LIBRARY_PATH */
+  create_library (f, "opt/lib/libvdpau_radeonsi.so");
+
+  {
+    const SrtKnownArchitecture *arch = _srt_architecture_get_by_tuple (f->multiarch_tuple);
+    g_autoptr(GByteArray) cache = g_byte_array_new ();
+    g_autofree gchar *glx = g_build_filename ("/usr", f->libdir,
+                                              "libGLX_mesa.so.0", NULL);
+    g_autofree gchar *vdpau = g_build_filename ("/usr", f->libdir,
+                                                "libvdpau_nvidia.so", NULL);
+    const char * const paths[] = { glx, vdpau };
+
+    tests_append_ld_cache (cache, paths, G_N_ELEMENTS (paths),
+                           ld_cache_flags_for_architecture (arch));
+    glnx_file_replace_contents_at (f->tmpdir.fd, "etc/ld.so.cache",
+                                   cache->data, cache->len,
+                                   0, NULL, &error);
+    g_assert_no_error (error);
+  }
+
+  envp = g_get_environ ();
+  envp = g_environ_unsetenv (envp, "VDPAU_DRIVER");
+  envp = g_environ_unsetenv (envp, "VDPAU_DRIVER_PATH");
+  envp = g_environ_setenv (envp, "LD_LIBRARY_PATH", "/opt/lib", TRUE);
+  helper_envp = g_strdupv (envp);
+  helper_envp = g_environ_setenv (helper_envp,
+                                  "SRT_TEST_DISABLE_LIBRARY_SCANNER", "1",
+                                  TRUE);
+
+  for (i = 0; i < 2; i++)
+    {
+      g_autoptr(SrtSystemInfo) info = srt_system_info_new (NULL);
+      g_autoptr(SrtObjectList) glx_icds = NULL;
+      g_autoptr(SrtObjectList) vdpau_drivers = NULL;
+
+      srt_system_info_set_environ (info, i == 0 ? helper_envp : envp);
+      srt_system_info_set_sysroot (info, f->tmpdir.path);
+      glx_icds = srt_system_info_list_glx_icds (info, f->multiarch_tuple,
+                                                SRT_DRIVER_FLAGS_NONE);
+      vdpau_drivers = srt_system_info_list_vdpau_drivers (info,
+                                                          f->multiarch_tuple,
+                                                          SRT_DRIVER_FLAGS_NONE);
+
+      if (i == 0)
+        expected = describe_drivers (glx_icds, vdpau_drivers);
+      else
+        actual = describe_drivers (glx_icds, vdpau_drivers);
+    }
+
+  g_test_message ("Helper found:\n%s", expected);
+  _srt_assert_streq_diff (expected, actual);
+
+  /* Make sure the test is meaningful */
+  g_assert_nonnull (strstr (actual, "glx:libGLX_mesa.so.0="));
+  g_assert_nonnull (strstr (actual, "/libGLX_mesa.so.0.0.0"));
+  g_assert_nonnull (strstr (actual, "glx:libGLX_nvidia.so.0="));
+  g_assert_nonnull (strstr (actual, "/libvdpau_nvidia.so"));
+  g_assert_nonnull (strstr (actual, "/opt/lib/libvdpau_radeonsi.so"));
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  _srt_tests_init (&argc, &argv, NULL);
+  g_test_add ("/library-scanner/find-soname", Fixture, NULL,
+              setup, test_find_soname, teardown);
+  g_test_add ("/library-scanner/ld-cache-changed", Fixture, NULL,
+              setup, test_ld_cache_changed, teardown);
+  g_test_add ("/library-scanner/match", Fixture, NULL,
+              setup, test_match, teardown);
+  g_test_add ("/library-scanner/compare-with-helper", Fixture, NULL,
+              setup, test_compare_with_helper, teardown);
+
+  return g_test_run ();
+}
@@ -33,6 +33,7 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -546,6 +547,189 @@ test_libraries (Fixture *f,
   g_unlink (tmp_file);
 }
 
+/*
+ * Checking several libraries in one batch gives the same results as
+ * checking each one separately.
+ */
+static void
+test_libraries_batch (Fixture *f,
+                      gconstpointer context)
+{
+  static const SrtLibrarySymbolsFormat formats[] =
+  {
+    SRT_LIBRARY_SYMBOLS_FORMAT_PLAIN,
+    SRT_LIBRARY_SYMBOLS_FORMAT_DEB_SYMBOLS,
+  };
+  static const char * const helpers[] =
+  {
+    "inspect-library",
+    "inspect-library-libelf",
+  };
+  g_autoptr(SrtSubprocessRunner) real_runner = _srt_subprocess_runner_new ();
+  g_autoptr(SrtSubprocessRunner) runner = NULL;
+  g_autoptr(GPtrArray) tmp_files = g_ptr_array_new_with_free_func (g_free);
+  g_autofree gchar *wrappers = NULL;
+  g_autofree gchar *log_path = NULL;
+  const char *multiarch_tuple = NULL;
+  const char *helpers_path;
+  g_autoptr(GError) error = NULL;
+  gsize i;
+  gsize k;
+
+#ifndef _SRT_MULTIARCH
+  g_test_skip ("Unsupported architecture");
+  return;
+#else
+  multiarch_tuple = _SRT_MULTIARCH;
+#endif
+
+  /* Wrap the real helpers in scripts that log how they were called,
+   * so that we can check that batch mode was really used */
+  helpers_path = _srt_subprocess_runner_resolve_helpers_path (real_runner,
+                                                              &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (helpers_path);
+  wrappers = g_dir_make_tmp ("library-batch-XXXXXX", &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (wrappers);
+  log_path = g_build_filename (wrappers, "log", NULL);
+
+  for (i = 0; i < G_N_ELEMENTS (helpers); i++)
+    {
+      g_autofree gchar *name = g_strdup_printf ("%s-%s", multiarch_tuple,
+                                                helpers[i]);
+      g_autofree gchar *real = g_build_filename (helpers_path, name, NULL);
+      g_autofree gchar *wrapper = g_build_filename (wrappers, name, NULL);
+      g_autofree gchar *quoted_log = g_shell_quote (log_path);
+      g_autofree gchar *quoted_real = g_shell_quote (real);
+      g_autofree gchar *script = NULL;
+
+      script = g_strdup_printf ("#!/bin/sh\n"
+                                "echo \"%s $*\" >> %s\n"
+                                "exec %s \"$@\"\n",
+                                helpers[i], quoted_log, quoted_real);
+      g_file_set_contents (wrapper, script, -1, &error);
+      g_assert_no_error (error);
+      g_assert_no_errno (chmod (wrapper, 0755));
+    }
+
+  runner = _srt_subprocess_runner_new_full (_srt_const_strv (environ),
+                                            NULL, wrappers,
+                                            SRT_TEST_FLAGS_NONE);
+
+  for (k = 0; k < G_N_ELEMENTS (formats); k++)
+    {
+      SrtLibraryCheck checks[G_N_ELEMENTS (library_test)] = {};
+      SrtLibrary *libraries[G_N_ELEMENTS (library_test)] = {};
+      const LibraryTest *tests[G_N_ELEMENTS (library_test)] = {};
+      g_autoptr(GHashTable) unique = g_hash_table_new (g_str_hash, g_str_equal);
+      g_autofree gchar *log = NULL;
+      g_auto(GStrv) lines = NULL;
+      SrtLibraryIssues combined;
+      SrtLibraryIssues expected_combined = SRT_LIBRARY_ISSUES_NONE;
+      gsize n = 0;
+      gsize n_batch = 0;
+      gsize n_single = 0;
+
+      for (i = 0; i < G_N_ELEMENTS (library_test); i++)
+        {
+          const LibraryTest *test = &library_test[i];
+          g_autofree gchar *tmp_file = NULL;
+          int fd;
+
+          if (test->format != formats[k])
+            continue;
+
+          checks[n].requested_name = test->library_name == NULL ? "libz.so.1" : test->library_name;
+          g_hash_table_add (unique, (char *) checks[n].requested_name);
+
+          if (test->expected_symbols != NULL)
+            {
+              fd = g_file_open_tmp ("library-XXXXXX", &tmp_file, &error);
+              g_assert_no_error (error);
+              g_assert_cmpint (fd, !=, -1);
+              close (fd);
+
+              g_file_set_contents (tmp_file, test->expected_symbols, -1, &error);
+              g_assert_no_error (error);
+              checks[n].symbols_path = tmp_file;
+              g_ptr_array_add (tmp_files, g_steal_pointer (&tmp_file));
+            }
+
+          tests[n] = test;
+          expected_combined |= test->issues_extended;
+          n++;
+        }
+
+      combined = _srt_check_libraries_presence (runner, multiarch_tuple,
+                                                checks, n,
+                                                SRT_CHECK_FLAGS_NONE,
+                                                formats[k],
+                                                libraries);
+      g_assert_cmpint (combined, ==, expected_combined);
+
+      g_file_get_contents (log_path, &log, NULL, &error);
+      g_assert_no_error (error);
+      g_assert_no_errno (g_unlink (log_path));
+      lines = g_strsplit (log, "\n", -1);
+
+      for (i = 0; lines[i] != NULL; i++)
+        {
+          g_test_message ("%s", lines[i]);
+
+          if (!g_str_has_prefix (lines[i], "inspect-library "))
+            continue;
+
+          if (strstr (lines[i], " --batch=") != NULL)
+            n_batch++;
+          else
+            n_single++;
+        }
+
+      /* One batch covers each distinct name, and only duplicates are
+       * checked individually */
+      g_assert_cmpuint (n_batch, ==, 1);
+      g_assert_cmpuint (n_single, <=, n - g_hash_table_size (unique));
+
+      for (i = 0; i < n; i++)
+        {
+          const LibraryTest *test = tests[i];
+          g_autoptr(SrtLibrary) library = g_steal_pointer (&libraries[i]);
+          g_autoptr(SrtLibrary) single = NULL;
+
+          g_test_message ("%s", test->description);
+          g_assert_nonnull (library);
+          g_assert_cmpstr (srt_library_get_requested_name (library), ==,
+                           checks[i].requested_name);
+          g_assert_cmpint (srt_library_get_issues (library), ==,
+                           test->issues_extended);
+
+          srt_check_library_presence (checks[i].requested_name, multiarch_tuple,
+                                      checks[i].symbols_path, test->format,
+                                      &single);
+          g_assert_cmpstr (srt_library_get_absolute_path (library), ==,
+                           srt_library_get_absolute_path (single));
+          g_assert_cmpint (srt_library_get_exit_status (library), ==,
+                           srt_library_get_exit_status (single));
+          g_assert_cmpint (srt_library_get_terminating_signal (library), ==, 0);
+          check_list_elements (srt_library_get_missing_symbols (library),
+                               test->missing_symbols);
+          check_list_elements (srt_library_get_missing_versions (library),
+                               test->missing_versions);
+          check_list_elements (srt_library_get_misversioned_symbols (library),
+                               test->misversioned_symbols);
+          g_assert_true (g_strv_equal (srt_library_get_dependencies (library),
+                                       srt_library_get_dependencies (single)));
+        }
+    }
+
+  for (i = 0; i < tmp_files->len; i++)
+    g_unlink (g_ptr_array_index (tmp_files, i));
+
+  if (!_srt_rm_rf (wrappers))
+    g_debug ("Unable to remove %s", wrappers);
+}
+
 /*
  * Test a not supported architecture.
  */
@@ -605,6 +789,8 @@ main (int argc,
               setup, test_object, teardown);
   g_test_add ("/library/expectations", Fixture, NULL, setup, test_libraries,
               teardown);
+  g_test_add ("/library/expectations-batch", Fixture, NULL, setup,
+              test_libraries_batch, teardown);
   g_test_add ("/library/missing_arch", Fixture, NULL, setup,
               test_missing_arch, teardown);
 
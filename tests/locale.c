@@ -27,11 +27,14 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
 
 #include "steam-runtime-tools/locale-internal.h"
+#include "steam-runtime-tools/system-info-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
 #include "test-utils.h"
 
 #define MOCK_DEFAULT_RESULTING_NAME \
@@ -215,6 +218,118 @@ test_complete (Fixture *f,
   g_clear_object (&info);
 }
 
+/*
+ * Checking several locales in one helper run gives the same results
+ * as checking them one at a time, and really does use one helper run.
+ */
+static void
+test_prefetch (Fixture *f,
+               gconstpointer context)
+{
+  static const char * const names[] =
+  {
+    "",
+    "C",
+    "POSIX",
+    "fr_CA",
+    "C.UTF-8",
+    "en_GB.UTF-8",
+    "C",
+    NULL
+  };
+  g_autoptr(SrtSystemInfo) batch = srt_system_info_new (NULL);
+  g_autoptr(SrtSystemInfo) single = srt_system_info_new (NULL);
+  g_autoptr(GError) local_error = NULL;
+  g_autofree gchar *wrappers = NULL;
+  g_autofree gchar *wrapper = NULL;
+  g_autofree gchar *real = NULL;
+  g_autofree gchar *quoted_log = NULL;
+  g_autofree gchar *quoted_real = NULL;
+  g_autofree gchar *script = NULL;
+  g_autofree gchar *log_path = NULL;
+  g_autofree gchar *log = NULL;
+  g_auto(GStrv) lines = NULL;
+  gsize n_runs = 0;
+  gsize i;
+
+  /* Wrap the mock helper in a script that logs each time it is run,
+   * so that we can check that the locales were checked together */
+  wrappers = g_dir_make_tmp ("locale-prefetch-XXXXXX", &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (wrappers);
+  log_path = g_build_filename (wrappers, "log", NULL);
+  wrapper = g_build_filename (wrappers, "mock-check-locale", NULL);
+  real = g_build_filename (f->builddir, "mock-check-locale", NULL);
+  quoted_log = g_shell_quote (log_path);
+  quoted_real = g_shell_quote (real);
+  script = g_strdup_printf ("#!/bin/sh\n"
+                            "echo \"check-locale $*\" >> %s\n"
+                            "exec %s \"$@\"\n",
+                            quoted_log, quoted_real);
+  g_file_set_contents (wrapper, script, -1, &local_error);
+  g_assert_no_error (local_error);
+  g_assert_no_errno (chmod (wrapper, 0755));
+
+  srt_system_info_set_primary_multiarch_tuple (batch, "mock");
+  srt_system_info_set_helpers_path (batch, wrappers);
+  srt_system_info_set_primary_multiarch_tuple (single, "mock");
+  srt_system_info_set_helpers_path (single, f->builddir);
+
+  _srt_system_info_prefetch_locales (batch, names);
+
+  for (i = 0; names[i] != NULL; i++)
+    {
+      g_autoptr(SrtLocale) expected = NULL;
+      g_autoptr(SrtLocale) locale = NULL;
+      g_autoptr(GError) expected_error = NULL;
+      g_autoptr(GError) error = NULL;
+
+      g_test_message ("%s", names[i]);
+      expected = srt_system_info_check_locale (single, names[i],
+                                               &expected_error);
+      locale = srt_system_info_check_locale (batch, names[i], &error);
+
+      if (expected == NULL)
+        {
+          g_assert_nonnull (expected_error);
+          g_assert_null (locale);
+          g_assert_error (error, expected_error->domain, expected_error->code);
+        }
+      else
+        {
+          g_assert_no_error (error);
+          g_assert_nonnull (locale);
+          g_assert_cmpstr (srt_locale_get_requested_name (locale), ==,
+                           srt_locale_get_requested_name (expected));
+          g_assert_cmpstr (srt_locale_get_resulting_name (locale), ==,
+                           srt_locale_get_resulting_name (expected));
+          g_assert_cmpstr (srt_locale_get_charset (locale), ==,
+                           srt_locale_get_charset (expected));
+          g_assert_cmpint (srt_locale_is_utf8 (locale), ==,
+                           srt_locale_is_utf8 (expected));
+        }
+    }
+
+  g_file_get_contents (log_path, &log, NULL, &local_error);
+  g_assert_no_error (local_error);
+  lines = g_strsplit (log, "\n", -1);
+
+  for (i = 0; lines[i] != NULL; i++)
+    {
+      g_test_message ("%s", lines[i]);
+
+      if (g_str_has_prefix (lines[i], "check-locale"))
+        n_runs++;
+    }
+
+  /* Every locale, including the ones that could not be set, came from
+   * the same run of the helper */
+  g_assert_cmpuint (n_runs, ==, 1);
+
+  if (!_srt_rm_rf (wrappers))
+    g_debug ("Unable to remove %s", wrappers);
+}
+
 static void
 test_legacy (Fixture *f,
              gconstpointer context)
@@ -389,6 +504,8 @@ main (int argc,
               setup, test_object, teardown);
   g_test_add ("/locale/complete", Fixture, NULL,
               setup, test_complete, teardown);
+  g_test_add ("/locale/prefetch", Fixture, NULL,
+              setup, test_prefetch, teardown);
   g_test_add ("/locale/legacy", Fixture, NULL,
               setup, test_legacy, teardown);
   g_test_add ("/locale/unamerican", Fixture, NULL,
@@ -0,0 +1,172 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <steam-runtime-tools/steam-runtime-tools.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/logger-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+
+/*
+ * Usage: logger-throughput [MEGABYTES [LOG_DIR]]
+ *
+ * Feed MEGABYTES (default 64) of Fossilize-style log lines through a
+ * pipe into _srt_logger_process(), as a chatty game would feed them to
+ * srt-logger, and print how many lines and MiB per second reached the
+ * log file. The log goes in LOG_DIR, or in a temporary directory that
+ * is deleted afterwards.
+ *
+ * Run it under `strace -c -f` to see how many write() calls each line
+ * costs.
+ */
+
+typedef struct
+{
+  int fd;
+  guint64 bytes;
+  guint64 written;
+  guint64 lines;
+} Writer;
+
+static gpointer
+writer_thread_cb (gpointer user_data)
+{
+  Writer *writer = user_data;
+  g_autoptr(GString) chunk = g_string_new ("");
+
+  while (writer->written < writer->bytes)
+    {
+      g_string_truncate (chunk, 0);
+
+      while (chunk->len < 60000)
+        g_string_append_printf (chunk,
+                                "Line %" G_GUINT64_FORMAT ": fossilize "
+                                "replayed pipeline %08x\n",
+                                writer->lines++,
+                                g_random_int ());
+
+      if (glnx_loop_write (writer->fd, chunk->str, chunk->len) < 0)
+        break;
+
+      writer->written += chunk->len;
+    }
+
+  glnx_close_fd (&writer->fd);
+  return NULL;
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SrtLogger) logger = NULL;
+  g_autoptr(GThread) thread = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  const char *log_dir;
+  int pipe_fds[2];
+  int original_stdout = -1;
+  Writer writer = { -1, 64 * 1024 * 1024, 0, 0 };
+  gint64 start, elapsed;
+  int ret = 0;
+
+  if (argc > 3)
+    {
+      g_printerr ("Usage: %s [MEGABYTES [LOG_DIR]]\n", argv[0]);
+      return 2;
+    }
+
+  if (argc > 1)
+    writer.bytes = g_ascii_strtoull (argv[1], NULL, 10) * 1024 * 1024;
+
+  if (argc > 2)
+    {
+      log_dir = argv[2];
+    }
+  else
+    {
+      tmpdir = g_dir_make_tmp ("srt-logger-throughput-XXXXXX", &error);
+
+      if (tmpdir == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          return 1;
+        }
+
+      log_dir = tmpdir;
+    }
+
+  if (!g_unix_open_pipe (pipe_fds, FD_CLOEXEC, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  if (dup2 (pipe_fds[0], STDIN_FILENO) != STDIN_FILENO)
+    {
+      g_printerr ("dup2: %s\n", g_strerror (errno));
+      return 1;
+    }
+
+  glnx_close_fd (&pipe_fds[0]);
+  writer.fd = pipe_fds[1];
+
+  logger = _srt_logger_new_take (NULL,
+                                 FALSE,
+                                 SRT_SYSLOG_LEVEL_DEFAULT_LINE,
+                                 g_strdup ("throughput.txt"),
+                                 -1,
+                                 SRT_SYSLOG_LEVEL_DEFAULT_FILE,
+                                 NULL,
+                                 FALSE,
+                                 -1,
+                                 SRT_SYSLOG_LEVEL_DEFAULT_JOURNAL,
+                                 g_strdup (log_dir),
+                                 -1,
+                                 -1,
+                                 FALSE,
+                                 FALSE,
+                                 FALSE,
+                                 -1,
+                                 SRT_SYSLOG_LEVEL_DEFAULT_TERMINAL,
+                                 TRUE);
+
+  start = g_get_monotonic_time ();
+  thread = g_thread_new ("writer", writer_thread_cb, &writer);
+
+  if (_srt_logger_process (logger, &original_stdout, &error))
+    {
+      g_thread_join (g_steal_pointer (&thread));
+      elapsed = g_get_monotonic_time () - start;
+
+      g_print ("%" G_GUINT64_FORMAT " lines, %" G_GUINT64_FORMAT " MiB "
+               "in %.3fs: %.1f MiB/s, %.0f lines/s\n",
+               writer.lines, writer.written / (1024 * 1024),
+               elapsed / (double) G_USEC_PER_SEC,
+               (writer.written / (1024.0 * 1024.0)) / (elapsed / (double) G_USEC_PER_SEC),
+               writer.lines / (elapsed / (double) G_USEC_PER_SEC));
+    }
+  else
+    {
+      /* Don't wait for the writer, which might be blocked on a full pipe */
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+      ret = 1;
+    }
+
+  if (tmpdir != NULL
+      && !glnx_shutil_rm_rf_at (AT_FDCWD, tmpdir, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = 1;
+    }
+
+  return ret;
+}
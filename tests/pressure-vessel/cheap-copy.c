@@ -33,6 +33,7 @@
 #include "utils.h"
 
 static gboolean opt_expect_hard_links = FALSE;
+static gboolean opt_fake_pseudo_files = FALSE;
 static gboolean opt_usrmerge = FALSE;
 
 static GOptionEntry options[] =
@@ -42,6 +43,11 @@ static GOptionEntry options[] =
     "Show a warning if we can't use hard-links.",
     NULL },
 
+  { "fake-pseudo-files", '\0',
+    G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_fake_pseudo_files,
+    "Copy files as though they were in procfs or sysfs.",
+    NULL },
+
   { "usrmerge", '\0',
     G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_usrmerge,
     "Assume SOURCE is a sysroot, and carry out the /usr merge in DEST.",
@@ -90,6 +96,9 @@ main (int argc,
   if (opt_expect_hard_links)
     flags |= PV_COPY_FLAGS_EXPECT_HARD_LINKS;
 
+  if (opt_fake_pseudo_files)
+    flags |= PV_COPY_FLAGS_FAKE_PSEUDO_FILES;
+
   if (!pv_cheap_tree_copy (argv[1], argv[2], flags, error))
     goto out;
 
@@ -168,6 +168,93 @@ class TestCheapCopy(BaseTest):
             )
             self.assert_tree_is_same(source, dest, require_hard_links)
 
+    def test_many_files(
+        self,
+        dir1=None,      # type: typing.Optional[str]
+        dir2=None,      # type: typing.Optional[str]
+        require_hard_links=True,
+    ) -> None:
+        """
+        Assert that copying more files than can be queued for the
+        worker threads at once still produces a complete copy.
+        """
+        with tempfile.TemporaryDirectory(
+            dir=dir1,
+        ) as source, tempfile.TemporaryDirectory(
+            dir=dir2,
+        ) as parent:
+            for i in range(20):
+                subdir = os.path.join(source, 'dir%d' % i)
+                os.makedirs(subdir)
+
+                for j in range(50):
+                    path = os.path.join(subdir, 'file%d' % j)
+
+                    with open(path, 'w') as writer:
+                        writer.write('%d/%d\n' % (i, j) * (i + j))
+
+                    os.chmod(path, 0o644 if j % 2 else 0o755)
+
+            dest = os.path.join(parent, 'dest')
+            subprocess.run(
+                [
+                    self.cheap_copy,
+                    source,
+                    dest,
+                ],
+                check=True,
+                stdout=2,       # >&2, i.e. stderr
+            )
+            self.assert_tree_is_same(source, dest, require_hard_links)
+
+            for i in range(20):
+                for j in range(50):
+                    rel = os.path.join('dir%d' % i, 'file%d' % j)
+
+                    with open(os.path.join(dest, rel)) as reader:
+                        self.assertEqual(
+                            reader.read(),
+                            '%d/%d\n' % (i, j) * (i + j),
+                        )
+
+    def test_many_files_cannot_hard_link(self):
+        self.test_many_files('/tmp', '/var/tmp', require_hard_links=False)
+
+    def test_copy_file_range_empty(self):
+        """
+        Assert that if copy_file_range() reports end-of-file immediately,
+        as it can for pseudo-files in procfs or sysfs, the contents are
+        copied by read() and write() instead of being left empty.
+        """
+        with tempfile.TemporaryDirectory(
+        ) as source, tempfile.TemporaryDirectory(
+        ) as parent:
+            (Path(source) / 'empty').touch()
+            (Path(source) / 'file').write_text('hello, world\n')
+
+            dest = os.path.join(parent, 'dest')
+            completed = subprocess.run(
+                [
+                    self.cheap_copy,
+                    '--fake-pseudo-files',
+                    source,
+                    dest,
+                ],
+                check=True,
+                stdout=2,       # >&2, i.e. stderr
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            sys.stderr.write(completed.stderr)
+            self.assertIn('Copied 2 files', completed.stderr)
+            self.assertIn('by read/write', completed.stderr)
+            self.assertEqual(
+                (Path(dest) / 'file').read_text(),
+                'hello, world\n',
+            )
+            self.assertEqual((Path(dest) / 'empty').read_text(), '')
+            self.assert_tree_is_same(source, dest, require_hard_links=False)
+
     def test_cannot_hard_link(self):
         """
         Assert that we can copy a directory hierarchy between directories
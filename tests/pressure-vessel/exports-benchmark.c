@@ -0,0 +1,159 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+
+#include "flatpak-bwrap-private.h"
+#include "flatpak-exports-private.h"
+
+/*
+ * Usage: test-exports-benchmark [N_EXPORTS...]
+ *
+ * For each N_EXPORTS (default: 100, 1000 and 5000), create a mock host
+ * with that many game directories and time the FlatpakExports
+ * operations that pressure-vessel does for --filesystem paths:
+ * adding the exports, converting them into bwrap arguments, and asking
+ * whether each path is visible.
+ */
+
+static double
+elapsed_ms (gint64 start)
+{
+  return (g_get_monotonic_time () - start) / 1000.0;
+}
+
+static gboolean
+run_benchmark (const char *tmpdir,
+               guint n,
+               GError **error)
+{
+  g_autoptr(FlatpakExports) exports = flatpak_exports_new ();
+  g_autoptr(FlatpakBwrap) bwrap = flatpak_bwrap_new (NULL);
+  g_autoptr(GPtrArray) paths = g_ptr_array_new_with_free_func (g_free);
+  g_autofree gchar *root = g_strdup_printf ("%s/%u", tmpdir, n);
+  glnx_autofd int root_fd = -1;
+  gint64 start;
+  double add_ms, bwrap_ms, query_ms;
+  guint visible = 0;
+  guint i;
+
+  for (i = 0; i < n; i++)
+    {
+      g_autofree gchar *path = g_strdup_printf ("/home/user/Games/library%u/game%u/bin",
+                                                i % 10, i);
+      g_autofree gchar *host_path = g_build_filename (root, path, NULL);
+
+      if (g_mkdir_with_parents (host_path, 0755) != 0)
+        return glnx_throw_errno_prefix (error, "Unable to create \"%s\"",
+                                        host_path);
+
+      g_ptr_array_add (paths, g_steal_pointer (&path));
+    }
+
+  if (!glnx_opendirat (AT_FDCWD, root, TRUE, &root_fd, error))
+    return FALSE;
+
+  flatpak_exports_take_host_fd (exports, g_steal_fd (&root_fd));
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    {
+      const char *path = g_ptr_array_index (paths, i);
+      g_autofree gchar *parent = g_path_get_dirname (path);
+
+      /* Export each library read/write and each game's bin directory
+       * read-only, so that lookups have to consider nested exports.
+       * The libraries are exported repeatedly, as happens when several
+       * options ask for the same directory. */
+      if (!flatpak_exports_add_path_expose (exports,
+                                            FLATPAK_FILESYSTEM_MODE_READ_WRITE,
+                                            parent, error))
+        return FALSE;
+
+      if (!flatpak_exports_add_path_expose (exports,
+                                            FLATPAK_FILESYSTEM_MODE_READ_ONLY,
+                                            path, error))
+        return FALSE;
+    }
+
+  add_ms = elapsed_ms (start);
+  start = g_get_monotonic_time ();
+  flatpak_exports_append_bwrap_args (exports, bwrap);
+  bwrap_ms = elapsed_ms (start);
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < n; i++)
+    {
+      if (flatpak_exports_path_is_visible (exports,
+                                           g_ptr_array_index (paths, i)))
+        visible++;
+    }
+
+  query_ms = elapsed_ms (start);
+
+  g_print ("%u exports: add %.3fms, bwrap args %.3fms, "
+           "%u/%u visible in %.3fms\n",
+           n, add_ms, bwrap_ms, visible, n, query_ms);
+  return TRUE;
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  static const guint default_sizes[] = { 100, 1000, 5000 };
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  int ret = 0;
+  int i;
+
+  tmpdir = g_dir_make_tmp ("pv-exports-benchmark-XXXXXX", &error);
+
+  if (tmpdir == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      return 1;
+    }
+
+  if (argc > 1)
+    {
+      for (i = 1; i < argc && ret == 0; i++)
+        {
+          if (!run_benchmark (tmpdir, (guint) g_ascii_strtoull (argv[i], NULL, 10),
+                              &error))
+            ret = 1;
+        }
+    }
+  else
+    {
+      for (i = 0; i < (int) G_N_ELEMENTS (default_sizes) && ret == 0; i++)
+        {
+          if (!run_benchmark (tmpdir, default_sizes[i], &error))
+            ret = 1;
+        }
+    }
+
+  if (error != NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      g_clear_error (&error);
+    }
+
+  if (!glnx_shutil_rm_rf_at (AT_FDCWD, tmpdir, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = 1;
+    }
+
+  return ret;
+}
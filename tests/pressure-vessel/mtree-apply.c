@@ -35,8 +35,15 @@
 #include "mtree.h"
 #include "utils.h"
 
+static gboolean opt_parallel = FALSE;
+
 static GOptionEntry options[] =
 {
+  { "parallel", '\0',
+    G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &opt_parallel,
+    "Populate regular files from a pool of worker threads.",
+    NULL },
+
   { NULL }
 };
 
@@ -74,6 +81,9 @@ main (int argc,
 
   ret = EX_UNAVAILABLE;
 
+  if (opt_parallel)
+    flags |= PV_MTREE_APPLY_FLAGS_PARALLEL;
+
   if (!glnx_opendirat (AT_FDCWD, argv[2], TRUE, &fd, error))
     goto out;
 
@@ -218,6 +218,15 @@ class TestMtreeApply(BaseTest):
             )
 
     def test_populate_copy(self) -> None:
+        self._test_populate_copy()
+
+    def test_populate_copy_parallel(self) -> None:
+        self._test_populate_copy(['--parallel'])
+
+    def _test_populate_copy(
+        self,
+        options=(),     # type: typing.Sequence[str]
+    ) -> None:
         content = b'''\
 # Content-addressed storage indexed by a truncated sha256
 ./make-executable type=file mode=755 contents=a8/076d3d28d21e02012b20eaf7dbf754
@@ -255,6 +264,8 @@ class TestMtreeApply(BaseTest):
             subprocess.run(
                 [
                     self.mtree_apply,
+                ] + list(options) + [
+                    '--',
                     source.name,
                     dest,
                     reference,
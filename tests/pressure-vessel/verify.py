@@ -179,6 +179,184 @@ class TestPvVerify(BaseTest):
             )
             self.assert_completed_success(completed)
 
+    def test_index(
+        self,
+    ) -> None:
+        with tempfile.TemporaryDirectory() as tree:
+            (Path(tree) / 'file').touch()
+            self.write_mtree(
+                Path(tree), 'mtree.txt.gz',
+                [
+                    './file type=file size=0',
+                ]
+            )
+
+            completed = subprocess.run(
+                [
+                    str(self.pv_verify),
+                    '--write-index',
+                    '--',
+                    tree,
+                ],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assert_completed_success(completed)
+            self.assertTrue((Path(tree) / 'mtree.bin').is_file())
+
+            # The index is used, and is not reported as an unexpected
+            # file even though the manifest doesn't list it
+            completed = subprocess.run(
+                [
+                    str(self.pv_verify),
+                    '--verbose',
+                    '--',
+                    tree,
+                ],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assert_completed_success(completed)
+            self.assertRegex(
+                completed.stderr,
+                r'Reading ".*mtree.bin" instead of ".*mtree.txt.gz"',
+            )
+            self.assertNotIn('not found in manifest', completed.stderr)
+
+            # Other files whose names end with .bin are not ignored
+            (Path(tree) / 'file.bin').write_bytes(b'PVMTREE\x01')
+            stderr = self.assert_verify_fails(Path(tree))
+            self.assertRegex(
+                stderr,
+                r'regular file "file.bin" in ".*" not found in manifest',
+            )
+            (Path(tree) / 'file.bin').unlink()
+
+            # Replace the text manifest with one that fails, and make it
+            # older than the index, as "cp -p" or unpacking an archive
+            # might: the index is no longer used
+            os.utime(str(Path(tree) / 'mtree.bin'), times=(2, 2))
+            self.write_mtree(
+                Path(tree), 'mtree.txt.gz',
+                [
+                    './file type=file size=1',
+                ]
+            )
+            os.utime(str(Path(tree) / 'mtree.txt.gz'), times=(1, 1))
+            stderr = self.assert_verify_fails(Path(tree))
+            self.assertRegex(
+                stderr,
+                r'"file" in ".*" should have size 1, not 0',
+            )
+            self.assertNotIn('not found in manifest', stderr)
+
+            # If the text manifest can't be checked, the index is not
+            # trusted either
+            self.write_mtree(
+                Path(tree), 'mtree.txt.gz',
+                [
+                    './file type=file size=0',
+                ]
+            )
+            completed = subprocess.run(
+                [
+                    str(self.pv_verify),
+                    '--write-index',
+                    '--',
+                    tree,
+                ],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assert_completed_success(completed)
+            (Path(tree) / 'mtree.txt.gz').unlink()
+            completed = subprocess.run(
+                [
+                    str(self.pv_verify),
+                    '--',
+                    tree,
+                ],
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assertEqual(completed.returncode, 1)
+            self.assertIn('mtree.txt.gz', completed.stderr)
+
+    def test_cache(
+        self,
+    ) -> None:
+        with tempfile.TemporaryDirectory(
+        ) as tree, tempfile.TemporaryDirectory(
+        ) as cache_dir:
+            cache = Path(cache_dir) / 'cache'
+            (Path(tree) / 'file').write_bytes(b'#')
+            self.write_mtree(
+                Path(tree), 'mtree.txt.gz',
+                [
+                    ('./file type=file size=1'
+                     ' sha256='
+                     '334359b90efed75da5f0ada1d5e6b256'
+                     'f4a6bd0aee7eb39c0f90182a021ffc8b'),
+                ]
+            )
+
+            argv = [
+                str(self.pv_verify),
+                '--cache', str(cache),
+                '--',
+                tree,
+            ]
+
+            completed = subprocess.run(
+                argv,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assert_completed_success(completed)
+            self.assertRegex(
+                completed.stderr,
+                r'Hashed .* in 1 files, skipped .* in 0 unchanged files',
+            )
+            self.assertTrue(cache.is_file())
+
+            # The second time, the file doesn't need to be hashed
+            completed = subprocess.run(
+                argv,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assert_completed_success(completed)
+            self.assertRegex(
+                completed.stderr,
+                r'Hashed .* in 0 files, skipped .* in 1 unchanged files',
+            )
+
+            # If the file is modified, even if its size and mtime are
+            # preserved, it is hashed again
+            info = os.stat(str(Path(tree) / 'file'))
+            (Path(tree) / 'file').write_bytes(b'!')
+            os.utime(
+                str(Path(tree) / 'file'),
+                ns=(info.st_atime_ns, info.st_mtime_ns),
+            )
+            completed = subprocess.run(
+                argv,
+                stdout=subprocess.PIPE,
+                stderr=subprocess.PIPE,
+                universal_newlines=True,
+            )
+            self.assertEqual(completed.returncode, 1)
+            self.assertRegex(
+                completed.stderr,
+                r'"file" in ".*" did not have expected contents',
+            )
+
     def test_file_should_be_symlink(
         self,
     ) -> None:
@@ -206,7 +206,7 @@ fixture_create_runtime (Fixture *f,
     gfx_in_container = "/run/host";
 
   graphics_provider = pv_graphics_provider_new ("/", gfx_in_container,
-                                                TRUE, &local_error);
+                                                TRUE, NULL, &local_error);
   g_assert_no_error (local_error);
   g_assert_nonnull (graphics_provider);
 
@@ -1086,6 +1086,7 @@ test_options_defaults (Fixture *f,
       g_assert_cmpint (options->terminal, ==, PV_TERMINAL_AUTO);
       g_assert_cmpint (options->share_home, ==, TRISTATE_MAYBE);
       g_assert_cmpint (options->batch, ==, FALSE);
+      g_assert_cmpint (options->cache_runtimes, ==, FALSE);
       g_assert_cmpint (options->copy_runtime, ==, FALSE);
       g_assert_cmpint (options->deterministic, ==, FALSE);
       g_assert_cmpint (options->devel, ==, FALSE);
@@ -1126,6 +1127,7 @@ test_options_false (Fixture *f,
   {
     "pressure-vessel-wrap-test",
     "--graphics-provider=",
+    "--no-cache-runtimes",
     "--no-copy-runtime",
     "--no-gc-runtimes",
     "--no-generate-locales",
@@ -1186,6 +1188,7 @@ test_options_false (Fixture *f,
   g_assert_cmpint (options->terminal, ==, PV_TERMINAL_NONE);
   g_assert_cmpint (options->share_home, ==, TRISTATE_NO);
   g_assert_cmpint (options->batch, ==, FALSE);
+  g_assert_cmpint (options->cache_runtimes, ==, FALSE);
   g_assert_cmpint (options->copy_runtime, ==, FALSE);
   g_assert_cmpint (options->deterministic, ==, FALSE);
   g_assert_cmpint (options->devel, ==, FALSE);
@@ -1217,6 +1220,7 @@ test_options_true (Fixture *f,
   {
     "pressure-vessel-wrap-test",
     "--batch",
+    "--cache-runtimes",
     "--copy-runtime",
     "--deterministic",
     "--devel",
@@ -1313,6 +1317,7 @@ test_options_true (Fixture *f,
   g_assert_cmpint (options->terminal, ==, PV_TERMINAL_XTERM);
   g_assert_cmpint (options->share_home, ==, TRISTATE_YES);
   g_assert_cmpint (options->batch, ==, TRUE);
+  g_assert_cmpint (options->cache_runtimes, ==, TRUE);
   g_assert_cmpint (options->copy_runtime, ==, TRUE);
   g_assert_cmpint (options->deterministic, ==, TRUE);
   g_assert_cmpint (options->devel, ==, TRUE);
@@ -1371,6 +1376,100 @@ test_options_true (Fixture *f,
   g_assert_cmpuint (i, ==, options->preload_modules->len);
 }
 
+static PvRuntime *
+create_cached_runtime (Fixture *f,
+                       const char * const *envp)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(PvGraphicsProvider) graphics_provider = NULL;
+  PvRuntime *runtime;
+
+  graphics_provider = pv_graphics_provider_new ("/", "/run/host",
+                                                TRUE, NULL, &local_error);
+  g_assert_no_error (local_error);
+
+  runtime = pv_runtime_new (f->mock_runtime,
+                            f->var,
+                            NULL,
+                            graphics_provider,
+                            NULL,
+                            envp,
+                            (PV_RUNTIME_FLAGS_COPY_RUNTIME
+                             | PV_RUNTIME_FLAGS_CACHE_PREPARED
+                             | PV_RUNTIME_FLAGS_VERBOSE
+                             | PV_RUNTIME_FLAGS_SINGLE_THREAD),
+                            PV_WORKAROUND_FLAGS_NONE,
+                            &local_error);
+  g_assert_no_error (local_error);
+  g_assert_nonnull (runtime);
+  g_assert_nonnull (pv_runtime_get_mutable_sysroot (runtime));
+  return runtime;
+}
+
+static void
+test_prepared_runtime_cache (Fixture *f,
+                             gconstpointer context)
+{
+  g_autoptr(GError) local_error = NULL;
+  g_autoptr(PvRuntime) first = NULL;
+  g_autoptr(PvRuntime) second = NULL;
+  g_autoptr(PvRuntime) concurrent = NULL;
+  g_autoptr(PvRuntime) changed = NULL;
+  g_autofree gchar *prepared = NULL;
+  g_autofree gchar *state = NULL;
+  g_auto(GStrv) envp = NULL;
+  SrtSysroot *sysroot;
+  const char *base;
+
+  envp = g_strdupv (f->context->original_environ);
+  envp = g_environ_unsetenv (envp, "VK_ICD_FILENAMES");
+  envp = g_environ_setenv (envp, "XDG_SESSION_ID", "1", TRUE);
+  envp = g_environ_setenv (envp, "PRESSURE_VESSEL_TRACE_FILE", "/a", TRUE);
+
+  first = create_cached_runtime (f, (const char * const *) envp);
+  sysroot = pv_runtime_get_mutable_sysroot (first);
+  base = glnx_basename (sysroot->path);
+  g_test_message ("First launch: %s", base);
+  g_assert_true (g_str_has_prefix (base, "prepared-"));
+  prepared = g_strdup (sysroot->path);
+
+  /* Pretend the first launch finished setting up the container */
+  state = g_strdup_printf ("[Prepared]\nKey=%s\n",
+                           base + strlen ("prepared-"));
+  glnx_file_replace_contents_at (sysroot->fd, "prepared.keyfile",
+                                 (const guint8 *) state, strlen (state),
+                                 0, NULL, &local_error);
+  g_assert_no_error (local_error);
+  g_clear_object (&first);
+
+  /* Variables that change on every launch don't affect the key,
+   * so the second launch reuses the first launch's copy */
+  envp = g_environ_setenv (envp, "XDG_SESSION_ID", "2", TRUE);
+  envp = g_environ_setenv (envp, "PRESSURE_VESSEL_TRACE_FILE", "/b", TRUE);
+  second = create_cached_runtime (f, (const char * const *) envp);
+  sysroot = pv_runtime_get_mutable_sysroot (second);
+  g_test_message ("Second launch: %s", glnx_basename (sysroot->path));
+  g_assert_cmpstr (sysroot->path, ==, prepared);
+
+  /* While it is in use, a concurrent launch makes its own copy */
+  concurrent = create_cached_runtime (f, (const char * const *) envp);
+  sysroot = pv_runtime_get_mutable_sysroot (concurrent);
+  base = glnx_basename (sysroot->path);
+  g_test_message ("Concurrent launch: %s", base);
+  g_assert_true (g_str_has_prefix (base, "tmp-"));
+  g_clear_object (&concurrent);
+  g_clear_object (&second);
+
+  /* A variable that affects the graphics stack invalidates it */
+  envp = g_environ_setenv (envp, "VK_ICD_FILENAMES", "/icd.json", TRUE);
+  changed = create_cached_runtime (f, (const char * const *) envp);
+  sysroot = pv_runtime_get_mutable_sysroot (changed);
+  base = glnx_basename (sysroot->path);
+  g_test_message ("Launch with different environment: %s", base);
+  g_assert_true (g_str_has_prefix (base, "prepared-"));
+  g_assert_cmpstr (sysroot->path, !=, prepared);
+}
+
 static void
 test_make_symlink_in_container (Fixture *f,
                                 gconstpointer context)
@@ -2543,6 +2642,8 @@ main (int argc,
   g_test_add ("/options/true", Fixture, NULL,
               setup, test_options_true, teardown);
   g_test_add ("/passwd", Fixture, NULL, setup, test_passwd, teardown);
+  g_test_add ("/prepared-runtime-cache", Fixture, NULL,
+              setup, test_prepared_runtime_cache, teardown);
   g_test_add ("/remap-ld-preload", Fixture, &default_config,
               setup_ld_preload, test_remap_ld_preload, teardown);
   g_test_add ("/remap-ld-preload-flatpak", Fixture, &default_config,
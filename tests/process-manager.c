@@ -185,6 +185,36 @@ test_terminate_sigkill_immediately (Fixture *f,
   g_assert_true (ret);
 }
 
+static void
+test_terminate_descendants (Fixture *f,
+                            gconstpointer context)
+{
+  g_autoptr(GError) error = NULL;
+  gboolean ret;
+  /* The grandchildren inherit SIG_IGN for SIGTERM, so they can only be
+   * killed with SIGKILL after they have been reparented to us */
+  const char * const argv[] =
+  {
+    "sh", "-c", "trap '' TERM; sleep 3600 & sleep 3600 & wait", NULL
+  };
+
+  ret = g_spawn_async (NULL,  /* cwd */
+                       (char **) argv,
+                       NULL,  /* envp */
+                       SPAWN_FLAGS,
+                       NULL, NULL,    /* child setup */
+                       NULL,  /* pid */
+                       &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+
+  ret = _srt_subreaper_terminate_all_child_processes (100 * G_TIME_SPAN_MILLISECOND,
+                                                      100 * G_TIME_SPAN_MILLISECOND,
+                                                      &error);
+  g_assert_no_error (error);
+  g_assert_true (ret);
+}
+
 static void
 test_wait_for_all (Fixture *f,
                    gconstpointer context)
@@ -344,6 +374,8 @@ main (int argc,
               setup, test_terminate_sigkill, teardown);
   g_test_add ("/terminate/sigkill-immediately", Fixture, NULL,
               setup, test_terminate_sigkill_immediately, teardown);
+  g_test_add ("/terminate/descendants", Fixture, NULL,
+              setup, test_terminate_descendants, teardown);
   g_test_add ("/wait/for-all", Fixture, NULL,
               setup, test_wait_for_all, teardown);
   g_test_add ("/wait/for-main", Fixture, NULL,
@@ -0,0 +1,222 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <glib.h>
+#include <glib/gstdio.h>
+#include <json-glib/json-glib.h>
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/json-glib-backports-internal.h"
+#include "steam-runtime-tools/profiling-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+#include "libglnx.h"
+
+#include "tests/test-utils.h"
+
+/* There is no fd leak check here: enabling the trace deliberately
+ * leaves the trace file open until the process exits */
+typedef struct
+{
+  int unused;
+} Fixture;
+
+typedef struct
+{
+  int unused;
+} Config;
+
+static void
+setup (Fixture *f,
+       gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+}
+
+static void
+teardown (Fixture *f,
+          gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+}
+
+static gpointer
+end_in_other_thread_cb (gpointer user_data)
+{
+  SrtProfilingTimer *timer = user_data;
+
+  _srt_profiling_end (timer);
+  return NULL;
+}
+
+/*
+ * Return the first event in @events with the given @name and @phase.
+ */
+static JsonObject *
+find_event (JsonArray *events,
+            const char *name,
+            const char *phase)
+{
+  guint i;
+
+  for (i = 0; i < json_array_get_length (events); i++)
+    {
+      JsonObject *event = json_array_get_object_element (events, i);
+
+      if (g_strcmp0 (json_object_get_string_member (event, "name"), name) == 0
+          && g_strcmp0 (json_object_get_string_member (event, "ph"), phase) == 0)
+        return event;
+    }
+
+  g_error ("No event \"%s\" with phase \"%s\"", name, phase);
+}
+
+static void
+test_trace (Fixture *f,
+            gconstpointer context)
+{
+  g_autoptr(GError) error = NULL;
+  g_auto(GLnxTmpDir) tmpdir = { FALSE };
+  g_autoptr(GString) json = NULL;
+  g_autoptr(JsonNode) node = NULL;
+  g_autofree gchar *contents = NULL;
+  g_autofree gchar *path = NULL;
+  SrtProfilingTimer *outer;
+  SrtProfilingTimer *inner;
+  SrtProfilingTimer *orphan;
+  SrtProfilingTimer *after;
+  GThread *thread;
+  gint64 tid;
+  JsonArray *events;
+  JsonObject *event;
+  JsonObject *args;
+  guint i;
+
+  glnx_mkdtemp ("profiling-XXXXXX", 0700, &tmpdir, &error);
+  g_assert_no_error (error);
+  path = g_build_filename (tmpdir.path, "trace.json", NULL);
+
+  _srt_profiling_enable_trace (path);
+
+  outer = _srt_profiling_start ("outer %d", 1);
+  g_assert_nonnull (outer);
+  _srt_profiling_counter ("Things", 42);
+  inner = _srt_profiling_start ("inner \"%s\"\n", "quoted");
+  g_assert_nonnull (inner);
+  _srt_profiling_rate (inner, 3, "items");
+  _srt_profiling_end (inner);
+
+  /* A timer can be ended in a thread other than the one that started
+   * it, and is removed from the starting thread's stack of timers */
+  orphan = _srt_profiling_start ("orphan");
+  thread = g_thread_new ("other", end_in_other_thread_cb, orphan);
+  g_thread_join (thread);
+  after = _srt_profiling_start ("after");
+  _srt_profiling_end (after);
+
+  _srt_profiling_end (outer);
+
+  g_file_get_contents (path, &contents, NULL, &error);
+  g_assert_no_error (error);
+  g_test_message ("%s", contents);
+
+  /* The file is an array that has been started but not finished,
+   * with a trailing comma after each event */
+  g_assert_true (g_str_has_prefix (contents, "[\n"));
+  g_assert_true (g_str_has_suffix (contents, "},\n"));
+  json = g_string_new (contents);
+  g_string_truncate (json, json->len - 2);
+  g_string_append (json, "]");
+
+  node = json_from_string (json->str, &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (node);
+  g_assert_true (JSON_NODE_HOLDS_ARRAY (node));
+  events = json_node_get_array (node);
+
+  for (i = 0; i < json_array_get_length (events); i++)
+    {
+      event = json_array_get_object_element (events, i);
+      g_assert_nonnull (event);
+      g_assert_true (json_object_has_member (event, "name"));
+      g_assert_true (json_object_has_member (event, "ph"));
+      g_assert_true (json_object_has_member (event, "ts"));
+      g_assert_cmpint (json_object_get_int_member (event, "pid"), ==, getpid ());
+      g_assert_true (json_object_has_member (event, "tid"));
+    }
+
+  event = find_event (events, "process_name", "M");
+  args = json_object_get_object_member (event, "args");
+  g_assert_cmpstr (json_object_get_string_member (args, "name"), ==,
+                   g_get_prgname ());
+
+  event = find_event (events, "Things", "C");
+  args = json_object_get_object_member (event, "args");
+  g_assert_cmpint (json_object_get_int_member (args, "value"), ==, 42);
+
+  event = find_event (events, "outer 1", "X");
+  g_assert_cmpfloat (json_object_get_double_member (event, "dur"), >=, 0.0);
+  args = json_object_get_object_member (event, "args");
+  g_assert_cmpint (json_object_get_int_member (args, "depth"), ==, 0);
+  g_assert_false (json_object_has_member (args, "parent"));
+  tid = json_object_get_int_member (event, "tid");
+
+  event = find_event (events, "inner \"quoted\"\n", "X");
+  args = json_object_get_object_member (event, "args");
+  g_assert_cmpint (json_object_get_int_member (args, "depth"), ==, 1);
+  g_assert_cmpstr (json_object_get_string_member (args, "parent"), ==,
+                   "outer 1");
+  g_assert_cmpint (json_object_get_int_member (args, "items"), ==, 3);
+
+  /* It is shown on the timeline of the thread that started it, but
+   * that thread's CPU time can't be measured from the other thread */
+  event = find_event (events, "orphan", "X");
+  g_assert_cmpint (json_object_get_int_member (event, "tid"), ==, tid);
+  g_assert_true (json_object_has_member (event, "dur"));
+  g_assert_false (json_object_has_member (event, "tdur"));
+  args = json_object_get_object_member (event, "args");
+  g_assert_cmpint (json_object_get_int_member (args, "depth"), ==, 1);
+  g_assert_cmpstr (json_object_get_string_member (args, "parent"), ==,
+                   "outer 1");
+
+  event = find_event (events, "after", "X");
+  g_assert_true (json_object_has_member (event, "tdur"));
+  args = json_object_get_object_member (event, "args");
+  g_assert_cmpint (json_object_get_int_member (args, "depth"), ==, 1);
+  g_assert_cmpstr (json_object_get_string_member (args, "parent"), ==,
+                   "outer 1");
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  _srt_setenv_disable_gio_modules ();
+
+  _srt_tests_init (&argc, &argv, NULL);
+  g_test_add ("/profiling/trace", Fixture, NULL,
+              setup, test_trace, teardown);
+
+  return g_test_run ();
+}
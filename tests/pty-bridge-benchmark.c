@@ -0,0 +1,228 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <termios.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "libglnx.h"
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/pty-bridge-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+
+/*
+ * Usage: pty-bridge-benchmark [FILE]
+ *
+ * Write FILE into the terminal side of a SrtPtyBridge in raw mode, as
+ * a command run by steam-runtime-launcher-service would, and read it
+ * back from the pipe on the other side. Without FILE, 64 MiB of log
+ * lines are generated in a temporary directory.
+ *
+ * The throughput is printed along with the number of bytes that were
+ * moved by splice(). It fails if any bytes are lost.
+ */
+
+typedef struct
+{
+  const char *path;
+  int fd;
+} Writer;
+
+typedef struct
+{
+  int fd;
+  guint64 expected;
+  guint64 received;
+  gboolean done;
+} Reader;
+
+static gpointer
+writer_thread_cb (gpointer user_data)
+{
+  Writer *writer = user_data;
+  glnx_autofd int file_fd = -1;
+  g_autoptr(GError) error = NULL;
+  char buf[65536];
+  ssize_t n;
+
+  if (!glnx_openat_rdonly (AT_FDCWD, writer->path, TRUE, &file_fd, &error))
+    g_error ("%s", error->message);
+
+  while ((n = TEMP_FAILURE_RETRY (read (file_fd, buf, sizeof (buf)))) > 0)
+    {
+      if (glnx_loop_write (writer->fd, buf, n) < 0)
+        g_error ("write: %s", g_strerror (errno));
+    }
+
+  if (n < 0)
+    g_error ("read %s: %s", writer->path, g_strerror (errno));
+
+  glnx_close_fd (&writer->fd);
+  return NULL;
+}
+
+static gpointer
+reader_thread_cb (gpointer user_data)
+{
+  Reader *reader = user_data;
+  char buf[65536];
+  ssize_t n;
+
+  while (reader->received < reader->expected
+         && (n = TEMP_FAILURE_RETRY (read (reader->fd, buf, sizeof (buf)))) > 0)
+    reader->received += n;
+
+  g_atomic_int_set (&reader->done, TRUE);
+  g_main_context_wakeup (NULL);
+  return NULL;
+}
+
+static gchar *
+make_log_file (const char *dir,
+               guint64 bytes,
+               GError **error)
+{
+  g_autofree gchar *path = g_build_filename (dir, "input.txt", NULL);
+  g_autoptr(GString) contents = g_string_new ("");
+  guint64 lines = 0;
+
+  while (contents->len < bytes)
+    g_string_append_printf (contents,
+                            "Line %" G_GUINT64_FORMAT ": fossilize "
+                            "replayed pipeline %08x\n",
+                            lines++, g_random_int ());
+
+  if (!g_file_set_contents (path, contents->str, contents->len, error))
+    return NULL;
+
+  return g_steal_pointer (&path);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SrtPtyBridge) bridge = NULL;
+  g_autoptr(GThread) writer_thread = NULL;
+  g_autoptr(GThread) reader_thread = NULL;
+  g_autofree gchar *tmpdir = NULL;
+  g_autofree gchar *generated = NULL;
+  SrtPtyBridgeCounters counters = {};
+  struct termios attrs;
+  struct stat stat_buf;
+  Writer writer = { NULL, -1 };
+  Reader reader = { -1, 0, 0, FALSE };
+  int pipe_fds[2];
+  gint64 start, elapsed;
+  double seconds;
+  int ret = 0;
+
+  if (argc > 2)
+    {
+      g_printerr ("Usage: %s [FILE]\n", argv[0]);
+      return 2;
+    }
+
+  if (argc > 1)
+    {
+      writer.path = argv[1];
+    }
+  else
+    {
+      tmpdir = g_dir_make_tmp ("srt-pty-bridge-benchmark-XXXXXX", &error);
+
+      if (tmpdir == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          return 1;
+        }
+
+      generated = make_log_file (tmpdir, 64 * 1024 * 1024, &error);
+
+      if (generated == NULL)
+        {
+          g_printerr ("%s\n", error->message);
+          ret = 1;
+          goto out;
+        }
+
+      writer.path = generated;
+    }
+
+  if (stat (writer.path, &stat_buf) != 0)
+    {
+      g_printerr ("%s: %s\n", writer.path, g_strerror (errno));
+      ret = 1;
+      goto out;
+    }
+
+  reader.expected = stat_buf.st_size;
+
+  if (!g_unix_open_pipe (pipe_fds, FD_CLOEXEC, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = 1;
+      goto out;
+    }
+
+  bridge = _srt_pty_bridge_new (-1, pipe_fds[1], &error);
+  glnx_close_fd (&pipe_fds[1]);
+  reader.fd = pipe_fds[0];
+
+  if (bridge == NULL)
+    {
+      g_printerr ("%s\n", error->message);
+      ret = 1;
+      goto out;
+    }
+
+  writer.fd = fcntl (_srt_pty_bridge_get_terminal_fd (bridge),
+                     F_DUPFD_CLOEXEC, 0);
+  _srt_pty_bridge_close_terminal_fd (bridge);
+
+  /* Pass bytes through unchanged, so that we can count them */
+  if (tcgetattr (writer.fd, &attrs) == 0)
+    {
+      cfmakeraw (&attrs);
+      tcsetattr (writer.fd, TCSANOW, &attrs);
+    }
+
+  start = g_get_monotonic_time ();
+  reader_thread = g_thread_new ("reader", reader_thread_cb, &reader);
+  writer_thread = g_thread_new ("writer", writer_thread_cb, &writer);
+
+  while (!g_atomic_int_get (&reader.done))
+    g_main_context_iteration (NULL, TRUE);
+
+  elapsed = g_get_monotonic_time () - start;
+  seconds = elapsed / (double) G_USEC_PER_SEC;
+  g_thread_join (g_steal_pointer (&writer_thread));
+  g_thread_join (g_steal_pointer (&reader_thread));
+  _srt_pty_bridge_get_counters (bridge, &counters);
+
+  g_print ("%" G_GUINT64_FORMAT " of %" G_GUINT64_FORMAT " bytes "
+           "in %.3fs: %.1f MiB/s (%" G_GUINT64_FORMAT " bytes spliced)\n",
+           reader.received, reader.expected, seconds,
+           (reader.received / (1024.0 * 1024.0)) / seconds,
+           counters.output_bytes_spliced);
+
+  if (reader.received != reader.expected)
+    ret = 1;
+
+out:
+  glnx_close_fd (&reader.fd);
+
+  if (tmpdir != NULL
+      && !glnx_shutil_rm_rf_at (AT_FDCWD, tmpdir, NULL, &error))
+    {
+      g_printerr ("%s\n", error->message);
+      ret = 1;
+    }
+
+  return ret;
+}
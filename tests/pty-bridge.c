@@ -0,0 +1,264 @@
+/*
+ * Copyright © 2025 Collabora Ltd.
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND,
+ * EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+ * IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ * CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <sys/socket.h>
+#include <termios.h>
+
+#include <glib.h>
+#include <glib-unix.h>
+
+#include "steam-runtime-tools/glib-backports-internal.h"
+#include "steam-runtime-tools/pty-bridge-internal.h"
+#include "steam-runtime-tools/utils-internal.h"
+#include "libglnx.h"
+
+#include "tests/test-utils.h"
+
+/* Large enough to wrap around the bridge's 64 KiB ring buffer many
+ * times, and deliberately not a multiple of any buffer size */
+#define TOTAL_BYTES (1024 * 1024 + 17)
+/* Also deliberately unaligned */
+#define WRITE_CHUNK 7919
+#define READ_CHUNK 4096
+
+typedef struct
+{
+  TestsOpenFdSet old_fds;
+} Fixture;
+
+typedef enum
+{
+  OUTPUT_PIPE,
+  OUTPUT_SOCKET,
+} OutputMode;
+
+typedef struct
+{
+  OutputMode output_mode;
+} Config;
+
+static const Config pipe_config = { OUTPUT_PIPE };
+static const Config socket_config = { OUTPUT_SOCKET };
+
+typedef struct
+{
+  int fd;
+} Writer;
+
+typedef struct
+{
+  int fd;
+  gsize received;
+  gsize first_mismatch;
+  gboolean done;
+} Reader;
+
+static inline guchar
+pattern_byte (gsize offset)
+{
+  /* 251 is prime, so the pattern never lines up with a buffer boundary */
+  return offset % 251;
+}
+
+static void
+setup (Fixture *f,
+       gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+
+  f->old_fds = tests_check_fd_leaks_enter ();
+}
+
+static void
+teardown (Fixture *f,
+          gconstpointer context)
+{
+  G_GNUC_UNUSED const Config *config = context;
+
+  tests_check_fd_leaks_leave (f->old_fds);
+}
+
+static gpointer
+writer_thread_cb (gpointer user_data)
+{
+  Writer *writer = user_data;
+  guchar buf[WRITE_CHUNK];
+  gsize sent = 0;
+
+  while (sent < TOTAL_BYTES)
+    {
+      gsize len = MIN (sizeof (buf), TOTAL_BYTES - sent);
+      gsize i;
+
+      for (i = 0; i < len; i++)
+        buf[i] = pattern_byte (sent + i);
+
+      if (glnx_loop_write (writer->fd, buf, len) < 0)
+        g_error ("write: %s", g_strerror (errno));
+
+      sent += len;
+    }
+
+  glnx_close_fd (&writer->fd);
+  return NULL;
+}
+
+static gpointer
+reader_thread_cb (gpointer user_data)
+{
+  Reader *reader = user_data;
+  guchar buf[READ_CHUNK];
+  ssize_t n;
+
+  while (reader->received < TOTAL_BYTES
+         && (n = TEMP_FAILURE_RETRY (read (reader->fd, buf, sizeof (buf)))) > 0)
+    {
+      ssize_t i;
+
+      for (i = 0; i < n; i++)
+        {
+          if (reader->first_mismatch == G_MAXSIZE
+              && buf[i] != pattern_byte (reader->received + i))
+            reader->first_mismatch = reader->received + i;
+        }
+
+      reader->received += n;
+
+      /* Read slowly, so that the bridge's buffer fills up and it has
+       * to deal with partial writes to the output destination */
+      g_usleep (G_USEC_PER_SEC / 1000);
+    }
+
+  g_atomic_int_set (&reader->done, TRUE);
+  g_main_context_wakeup (NULL);
+  return NULL;
+}
+
+/*
+ * Push more data through the bridge than fits in its ring buffer,
+ * with a reader that can't keep up, and check that it comes out
+ * intact and in order.
+ */
+static void
+test_slow_reader (Fixture *f,
+                  gconstpointer context)
+{
+  const Config *config = context;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SrtPtyBridge) bridge = NULL;
+  g_autoptr(GThread) writer_thread = NULL;
+  g_autoptr(GThread) reader_thread = NULL;
+  SrtPtyBridgeCounters counters = {};
+  struct termios attrs;
+  Writer writer = { -1 };
+  Reader reader = { -1, 0, G_MAXSIZE, FALSE };
+  int fds[2] = { -1, -1 };
+
+  if (config->output_mode == OUTPUT_PIPE)
+    {
+      g_unix_open_pipe (fds, FD_CLOEXEC, &error);
+      g_assert_no_error (error);
+
+      /* Make the pipe as small as possible, so that splice() can only
+       * move part of what is available and the bridge has to fall
+       * back to buffering. This is best-effort. */
+      if (fcntl (fds[1], F_SETPIPE_SZ, 4096) < 0)
+        g_test_message ("Unable to shrink pipe: %s", g_strerror (errno));
+    }
+  else
+    {
+      int size = 4096;
+
+      /* Sockets can't be spliced into, so this always goes via the
+       * ring buffer */
+      if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        g_error ("socketpair: %s", g_strerror (errno));
+
+      if (setsockopt (fds[1], SOL_SOCKET, SO_SNDBUF, &size, sizeof (size)) != 0)
+        g_test_message ("Unable to shrink send buffer: %s", g_strerror (errno));
+
+      if (setsockopt (fds[0], SOL_SOCKET, SO_RCVBUF, &size, sizeof (size)) != 0)
+        g_test_message ("Unable to shrink receive buffer: %s", g_strerror (errno));
+    }
+
+  bridge = _srt_pty_bridge_new (-1, fds[1], &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (bridge);
+  glnx_close_fd (&fds[1]);
+  reader.fd = g_steal_fd (&fds[0]);
+
+  writer.fd = fcntl (_srt_pty_bridge_get_terminal_fd (bridge),
+                     F_DUPFD_CLOEXEC, 0);
+  g_assert_cmpint (writer.fd, >=, 0);
+  _srt_pty_bridge_close_terminal_fd (bridge);
+
+  /* Pass bytes through unchanged, so that we can compare them */
+  if (tcgetattr (writer.fd, &attrs) != 0)
+    g_error ("tcgetattr: %s", g_strerror (errno));
+
+  cfmakeraw (&attrs);
+
+  if (tcsetattr (writer.fd, TCSANOW, &attrs) != 0)
+    g_error ("tcsetattr: %s", g_strerror (errno));
+
+  reader_thread = g_thread_new ("reader", reader_thread_cb, &reader);
+  writer_thread = g_thread_new ("writer", writer_thread_cb, &writer);
+
+  while (!g_atomic_int_get (&reader.done))
+    g_main_context_iteration (NULL, TRUE);
+
+  g_thread_join (g_steal_pointer (&writer_thread));
+  g_thread_join (g_steal_pointer (&reader_thread));
+  _srt_pty_bridge_get_counters (bridge, &counters);
+  g_test_message ("%" G_GUINT64_FORMAT " bytes, "
+                  "%" G_GUINT64_FORMAT " spliced",
+                  counters.output_bytes, counters.output_bytes_spliced);
+
+  g_assert_cmpuint (reader.received, ==, TOTAL_BYTES);
+  g_assert_cmpuint (reader.first_mismatch, ==, G_MAXSIZE);
+  g_assert_cmpuint (counters.output_bytes, ==, TOTAL_BYTES);
+  g_assert_cmpuint (counters.input_bytes, ==, 0);
+
+  if (config->output_mode == OUTPUT_SOCKET)
+    g_assert_cmpuint (counters.output_bytes_spliced, ==, 0);
+
+  g_clear_object (&bridge);
+  glnx_close_fd (&reader.fd);
+}
+
+int
+main (int argc,
+      char **argv)
+{
+  _srt_setenv_disable_gio_modules ();
+
+  _srt_tests_init (&argc, &argv, NULL);
+  g_test_add ("/pty-bridge/slow-reader/pipe", Fixture, &pipe_config,
+              setup, test_slow_reader, teardown);
+  g_test_add ("/pty-bridge/slow-reader/socket", Fixture, &socket_config,
+              setup, test_slow_reader, teardown);
+
+  return g_test_run ();
+}
@@ -44,22 +44,30 @@ typedef struct
 typedef struct
 {
   enum { MODE_DIRECT, MODE_FDIO } mode;
+  gboolean no_openat2;
 } Config;
 
 static const Config direct_config = { MODE_DIRECT };
 static const Config fdio_config = { MODE_FDIO };
+static const Config fdio_no_openat2_config = { MODE_FDIO, TRUE };
 
 static void
 setup (Fixture *f,
        gconstpointer context)
 {
+  const Config *config = context;
+
   f->old_fds = tests_check_fd_leaks_enter ();
+
+  if (config != NULL && config->no_openat2)
+    _srt_resolve_in_sysroot_set_use_openat2 (FALSE);
 }
 
 static void
 teardown (Fixture *f,
           gconstpointer context)
 {
+  _srt_resolve_in_sysroot_set_use_openat2 (TRUE);
   tests_check_fd_leaks_leave (f->old_fds);
 }
 
@@ -367,6 +375,10 @@ test_resolve_in_sysroot (Fixture *f,
             g_assert_no_error (error);
             in_path = g_strdup (it->call.path);
             g_string_append (description, " (fd I/O)");
+
+            if (config->no_openat2)
+              g_string_append (description, " (without openat2)");
+
             break;
 
           case MODE_DIRECT:
@@ -527,6 +539,9 @@ main (int argc,
   _srt_tests_init (&argc, &argv, NULL);
   g_test_add ("/resolve-in-sysroot/fdio", Fixture, &fdio_config,
               setup, test_resolve_in_sysroot, teardown);
+  g_test_add ("/resolve-in-sysroot/fdio-no-openat2", Fixture,
+              &fdio_no_openat2_config,
+              setup, test_resolve_in_sysroot, teardown);
   g_test_add ("/resolve-in-sysroot/direct", Fixture, &direct_config,
               setup, test_resolve_in_sysroot, teardown);
 
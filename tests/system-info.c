@@ -70,9 +70,12 @@ typedef struct
 
 typedef struct
 {
-  int unused;
+  /* Load JSON reports with SRT_SYSTEM_INFO_JSON_FLAGS_LAZY */
+  gboolean lazy;
 } Config;
 
+static const Config lazy_config = { .lazy = TRUE };
+
 static void
 setup (Fixture *f,
        gconstpointer context)
@@ -289,6 +292,29 @@ test_object (Fixture *f,
   g_assert_false (srt_system_info_can_run (info, SRT_ABI_I386));
   g_assert_false (srt_system_info_can_run (info, SRT_ABI_X86_64));
   g_object_unref (info);
+
+  /* Checking several architectures together gives the same results */
+    {
+      static const char * const tuples[] =
+      {
+        "mock",
+        SRT_ABI_I386,
+        SRT_ABI_X86_64,
+        "hal9000-linux-gnu",
+        NULL
+      };
+
+      info = srt_system_info_new (NULL);
+      g_assert_nonnull (info);
+      srt_system_info_set_helpers_path (info, f->builddir);
+      _srt_system_info_set_max_parallel_checks (info, 2);
+      _srt_system_info_prefetch_for_abis (info, tuples, NULL);
+      g_assert_true (srt_system_info_can_run (info, "mock"));
+      g_assert_false (srt_system_info_can_run (info, SRT_ABI_I386));
+      g_assert_false (srt_system_info_can_run (info, SRT_ABI_X86_64));
+      g_assert_false (srt_system_info_can_run (info, "hal9000-linux-gnu"));
+      g_object_unref (info);
+    }
 }
 
 static void
@@ -443,16 +469,11 @@ test_null_sysroot (Fixture *f,
 }
 
 static void
-test_libdl (Fixture *f,
-            gconstpointer context)
+check_libdl (SrtSystemInfo *info)
 {
-  g_autoptr(SrtSystemInfo) info = NULL;
   g_autofree gchar *libdl = NULL;
   g_autoptr(GError) error = NULL;
 
-  info = srt_system_info_new (NULL);
-  g_assert_nonnull (info);
-  srt_system_info_set_helpers_path (info, f->builddir);
   libdl = srt_system_info_dup_libdl_lib (info, "mock-good", &error);
   g_assert_cmpstr (libdl, ==, "lib");
   g_assert_no_error (error);
@@ -489,6 +510,39 @@ test_libdl (Fixture *f,
                                        "cannot open shared object file: No such file or directory\n");
 }
 
+static void
+test_libdl (Fixture *f,
+            gconstpointer context)
+{
+  static const char * const tuples[] = { "mock-good", "mock-bad", NULL };
+  g_autoptr(GCancellable) cancellable = NULL;
+  SrtSystemInfo *info;
+
+  info = srt_system_info_new (NULL);
+  g_assert_nonnull (info);
+  srt_system_info_set_helpers_path (info, f->builddir);
+  check_libdl (info);
+  g_object_unref (info);
+
+  /* Checking several architectures together gives the same results */
+  info = srt_system_info_new (NULL);
+  g_assert_nonnull (info);
+  srt_system_info_set_helpers_path (info, f->builddir);
+  _srt_system_info_prefetch_for_abis (info, tuples, NULL);
+  check_libdl (info);
+  g_object_unref (info);
+
+  /* If cancelled, nothing is cached, and the checks are done on-demand */
+  cancellable = g_cancellable_new ();
+  g_cancellable_cancel (cancellable);
+  info = srt_system_info_new (NULL);
+  g_assert_nonnull (info);
+  srt_system_info_set_helpers_path (info, f->builddir);
+  _srt_system_info_prefetch_for_abis (info, tuples, cancellable);
+  check_libdl (info);
+  g_object_unref (info);
+}
+
 static void
 check_libraries_result (GList *libraries)
 {
@@ -3875,6 +3929,8 @@ static void
 json_parsing (Fixture *f,
               gconstpointer context)
 {
+  const Config *config = context;
+
   /* Keep this in sync with the json_test declared above. These are the
    * architecture-specific changes compared to the general json_test defined
    * before. */
@@ -3986,7 +4042,12 @@ json_parsing (Fixture *f,
       input_json = g_build_filename (f->srcdir, "json-report", multiarch_tuples[0],
                                      t->input_name, NULL);
 
-      info = srt_system_info_new_from_json (input_json, &error);
+      if (config != NULL && config->lazy)
+        info = srt_system_info_new_from_json_full (input_json,
+                                                   SRT_SYSTEM_INFO_JSON_FLAGS_LAZY,
+                                                   &error);
+      else
+        info = srt_system_info_new_from_json (input_json, &error);
 
       g_assert_no_error (error);
 
@@ -4486,6 +4547,79 @@ json_parsing (Fixture *f,
     }
 }
 
+/*
+ * A malformed section makes srt_system_info_new_from_json() fail.
+ * When loading lazily, the large sections of a report are only parsed
+ * when first used, so if one of them is malformed, that should not stop
+ * the rest of the report from loading: it is reported as a warning and
+ * treated as empty.
+ */
+static void
+json_malformed_section (Fixture *f,
+                        gconstpointer context)
+{
+  static const char report[] =
+    "{\n"
+    "  \"can-write-uinput\": true,\n"
+    "  \"architectures\": {\n"
+    "    \"" SRT_ABI_X86_64 "\": { \"can-run\": true },\n"
+    /* Structurally balanced, so the initial scan accepts it, but not
+     * valid JSON */
+    "    \"" SRT_ABI_I386 "\": { \"can-run\": true, \"library-issues-summary\": [,] }\n"
+    "  },\n"
+    "  \"egl\": { \"icds\": [ { \"json_path\": } ] },\n"
+    "  \"vulkan\": { \"icds\": [] }\n"
+    "}\n";
+  g_autoptr(SrtSystemInfo) info = NULL;
+  g_autoptr(GError) error = NULL;
+  g_auto(GLnxTmpDir) tmpdir = { FALSE };
+  g_autofree gchar *path = NULL;
+  GList *icds;
+
+  glnx_mkdtemp ("system-info-XXXXXX", 0700, &tmpdir, &error);
+  g_assert_no_error (error);
+  path = g_build_filename (tmpdir.path, "report.json", NULL);
+  g_file_set_contents (path, report, -1, &error);
+  g_assert_no_error (error);
+
+  info = srt_system_info_new_from_json (path, &error);
+  g_assert_nonnull (error);
+  g_assert_null (info);
+  g_clear_error (&error);
+
+  info = srt_system_info_new_from_json_full (path,
+                                             SRT_SYSTEM_INFO_JSON_FLAGS_LAZY,
+                                             &error);
+  g_assert_no_error (error);
+  g_assert_nonnull (info);
+
+  /* Sections that are parsed up front are unaffected */
+  g_assert_true (srt_system_info_can_write_to_uinput (info));
+
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Unable to parse \"egl\" from report:*");
+  icds = srt_system_info_list_egl_icds (info, NULL);
+  g_test_assert_expected_messages ();
+  g_assert_null (icds);
+
+  /* It only warns once */
+  icds = srt_system_info_list_egl_icds (info, NULL);
+  g_assert_null (icds);
+
+  /* A valid deferred section is unaffected */
+  icds = srt_system_info_list_vulkan_icds (info, NULL);
+  g_assert_null (icds);
+  g_assert_true (srt_system_info_can_run (info, SRT_ABI_X86_64));
+
+  /* The malformed ABI is treated as empty, rather than being probed on
+   * the real system */
+  g_test_expect_message (G_LOG_DOMAIN, G_LOG_LEVEL_WARNING,
+                         "Unable to parse \"" SRT_ABI_I386 "\" from report:*");
+  g_assert_false (srt_system_info_can_run (info, SRT_ABI_I386));
+  g_test_assert_expected_messages ();
+  g_assert_false (srt_system_info_can_run (info, SRT_ABI_I386));
+}
+
 static void
 architecture_symlinks (Fixture *f,
                        gconstpointer context)
@@ -4769,6 +4903,10 @@ main (int argc,
 
   g_test_add ("/system-info/json_parsing", Fixture, NULL,
               setup, json_parsing, teardown);
+  g_test_add ("/system-info/json_parsing/lazy", Fixture, &lazy_config,
+              setup, json_parsing, teardown);
+  g_test_add ("/system-info/json_malformed_section", Fixture, NULL,
+              setup, json_malformed_section, teardown);
 
   g_test_add ("/system-info/architecture/symlinks", Fixture, NULL,
               setup, architecture_symlinks, teardown);
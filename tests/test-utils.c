@@ -25,6 +25,8 @@
 
 #include "tests/test-utils.h"
 
+#include <string.h>
+
 #include <glib.h>
 #include <glib-object.h>
 
@@ -399,3 +401,45 @@ _srt_show_diff (const char *expected,
   if (tmpdir != NULL)
     _srt_rm_rf (tmpdir);
 }
+
+/*
+ * Append an ld.so cache in the new format to @buf, with one entry per
+ * element of @paths. Each key is the basename of the corresponding
+ * path, and every entry has the given @flags, for example 0x0303 for
+ * x86_64. String offsets are relative to the start of its header.
+ */
+void
+tests_append_ld_cache (GByteArray *buf,
+                       const char * const *paths,
+                       gsize n_paths,
+                       guint32 flags)
+{
+  static const guint8 zeroes[20] = {};
+  guint32 offset = 48 + 24 * n_paths;
+  guint32 len_strings = 0;
+  guint32 value;
+  gsize i;
+
+  for (i = 0; i < n_paths; i++)
+    len_strings += strlen (paths[i]) + 1;
+
+  g_byte_array_append (buf, (const guint8 *) "glibc-ld.so.cache1.1", 20);
+  value = n_paths;
+  g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+  g_byte_array_append (buf, (const guint8 *) &len_strings, sizeof (len_strings));
+  g_byte_array_append (buf, zeroes, 20);
+
+  for (i = 0; i < n_paths; i++)
+    {
+      g_byte_array_append (buf, (const guint8 *) &flags, sizeof (flags));
+      value = offset + (strrchr (paths[i], '/') + 1 - paths[i]);
+      g_byte_array_append (buf, (const guint8 *) &value, sizeof (value));
+      g_byte_array_append (buf, (const guint8 *) &offset, sizeof (offset));
+      /* osversion, followed by 8 bytes of hwcap */
+      g_byte_array_append (buf, zeroes, 12);
+      offset += strlen (paths[i]) + 1;
+    }
+
+  for (i = 0; i < n_paths; i++)
+    g_byte_array_append (buf, (const guint8 *) paths[i], strlen (paths[i]) + 1);
+}
@@ -55,6 +55,11 @@ gboolean _srt_tests_skip_if_really_in_steam_runtime (void);
 void _srt_show_diff (const char *expected,
                      const char *actual);
 
+void tests_append_ld_cache (GByteArray *buf,
+                            const char * const *paths,
+                            gsize n_paths,
+                            guint32 flags);
+
 /**
  * Asserts two strings as equal, showing a line-based diff of their contents via
  * _srt_show_diff() if they don't match.
@@ -42,6 +42,7 @@
 #include "steam-runtime-tools/logger-internal.h"
 #include "steam-runtime-tools/runtime-internal.h"
 #include "steam-runtime-tools/steam-internal.h"
+#include "steam-runtime-tools/subprocess-internal.h"
 #include "steam-runtime-tools/utils-internal.h"
 #include "test-utils.h"
 
@@ -1707,6 +1708,82 @@ struct
   { "", -1 },
 };
 
+static gboolean
+cancel_cb (gpointer user_data)
+{
+  g_cancellable_cancel (user_data);
+  return G_SOURCE_REMOVE;
+}
+
+static void
+store_result_cb (GObject *source_object,
+                 GAsyncResult *result,
+                 gpointer user_data)
+{
+  GAsyncResult **result_p = user_data;
+
+  g_assert_null (*result_p);
+  *result_p = g_object_ref (result);
+}
+
+static void
+test_subprocess_cancel (Fixture *f,
+                        gconstpointer context)
+{
+  static const char * const argv[] = { "sleep", "600", NULL };
+  g_autoptr(SrtSubprocessRunner) runner = _srt_subprocess_runner_new ();
+  g_autoptr(GMainContext) main_context = g_main_context_new ();
+  g_autoptr(GCancellable) cancellable = g_cancellable_new ();
+  g_autoptr(GAsyncResult) result = NULL;
+  g_autoptr(SrtCompletedSubprocess) completed = NULL;
+  g_autoptr(GSource) source = NULL;
+  g_autoptr(GError) error = NULL;
+  gint64 start;
+
+  g_main_context_push_thread_default (main_context);
+
+  /* Cancelling before it starts means it is never started */
+  g_cancellable_cancel (cancellable);
+  _srt_subprocess_runner_run_async (runner, SRT_HELPER_FLAGS_SEARCH_PATH,
+                                    argv,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                    cancellable, store_result_cb, &result);
+
+  while (result == NULL)
+    g_main_context_iteration (main_context, TRUE);
+
+  completed = _srt_subprocess_runner_run_finish (runner, result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (completed);
+  g_clear_error (&error);
+  g_clear_object (&result);
+  g_clear_object (&cancellable);
+
+  /* Cancelling while it is running kills it */
+  cancellable = g_cancellable_new ();
+  start = g_get_monotonic_time ();
+  _srt_subprocess_runner_run_async (runner, SRT_HELPER_FLAGS_SEARCH_PATH,
+                                    argv,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                    SRT_SUBPROCESS_OUTPUT_CAPTURE,
+                                    cancellable, store_result_cb, &result);
+  source = g_timeout_source_new (100);
+  g_source_set_callback (source, cancel_cb, cancellable, NULL);
+  g_source_attach (source, main_context);
+
+  while (result == NULL)
+    g_main_context_iteration (main_context, TRUE);
+
+  completed = _srt_subprocess_runner_run_finish (runner, result, &error);
+  g_assert_error (error, G_IO_ERROR, G_IO_ERROR_CANCELLED);
+  g_assert_null (completed);
+  g_assert_cmpint (g_get_monotonic_time () - start, <, 60 * G_USEC_PER_SEC);
+
+  g_source_destroy (source);
+  g_main_context_pop_thread_default (main_context);
+}
+
 static void
 test_syslog_level_parse (Fixture *f,
                          gconstpointer context)
@@ -1851,6 +1928,8 @@ main (int argc,
               setup, test_string_ends_with, teardown);
   g_test_add ("/utils/string_read_fd_until_eof", Fixture, NULL,
               setup, test_string_read_fd_until_eof, teardown);
+  g_test_add ("/utils/subprocess-cancel", Fixture, NULL,
+              setup, test_subprocess_cancel, teardown);
   g_test_add ("/utils/syslog_level_parse", Fixture, NULL,
               setup, test_syslog_level_parse, teardown);
   g_test_add ("/utils/uevent-field", Fixture, NULL,